@@ -35,8 +35,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <math.h> // atan2(), sqrt(), tan()
 #include <stdcountof.h>
 #include <stdint.h> // uint16_t
-#include <stdio.h> // EOF, FILE, fclose(), fgets(), fileno(), fseek(),
-		   // getc(), SEEK_SET, setbuf(), stderr, stdout
+#include <stdio.h> // EOF, FILE, fclose(), fgets(), fileno(), fopen(),
+		   // fread(), fseek(), fwrite(), SEEK_SET, setbuf(),
+		   // stderr, stdout
 #include <stdlib.h> // exit(), EXIT_SUCCESS, setenv(), strtol()
 #include <string.h> // strchr(), strcmp(), strcpy(), strerror(),
 		    // strlen(), strncmp(), strstr(), strtok()
@@ -48,7 +49,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <new> // std::bad_alloc
 
 // operating system services
-// needed for SET_BINARY()
+// needed for NULL_DEV, SET_BINARY()
 #include "posix.h"
 #include "nonposix.h"
 
@@ -62,7 +63,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "stringclass.h"
 
 // libdriver
-#include "driver.h" // interpret_troff_output_file()
+#include "driver.h" // input_passes, interpret_troff_output_file()
 #include "printer.h" // environment, printer
 
 // grops
@@ -90,6 +91,15 @@ unsigned broken_flags = 0;
 // Non-zero means we need the CMYK extension for PostScript Level 1
 static int cmyk_flag = 0;
 
+// Non-zero means write the pages directly to the standard output,
+// reading the input twice: first to gather what the document setup
+// needs, then to write the pages.
+static int stream_flag = 0;
+
+// Non-zero means download only the glyphs of fonts that the document
+// uses, unless it contains PostScript code of its own.
+static int subset_fonts_flag = 0;
+
 #define DEFAULT_LINEWIDTH 40	/* in ems/1000 */
 #define MAX_LINE_LENGTH 72
 #define FILL_MAX 1000
@@ -132,9 +142,13 @@ ps_output &ps_output::set_file(FILE *f)
 
 ps_output &ps_output::copy_file(FILE *infp)
 {
-  int c;
-  while ((c = getc(infp)) != EOF)
-    putc(c, fp);
+  char buf[BUFSIZ];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, infp)) > 0)
+    if (fwrite(buf, 1, n, fp) != n)
+      fatal("cannot write output: %1", strerror(errno));
+  if (ferror(infp))
+    fatal("cannot read temporary file: %1", strerror(errno));
   return *this;
 }
 
@@ -453,6 +467,7 @@ public:
   int encoding_index;
   char *encoding;
   char *reencoded_name;
+  resource *download;		// if downloadable and glyph use tracked
   ~ps_font();
   void handle_unknown_font_command(const char * /* command */,
 				   const char * /* arg */,
@@ -480,7 +495,7 @@ ps_font *ps_font::load_ps_font(const char *s)
 
 ps_font::ps_font(const char *nm)
 : font(nm), encoding_index(-1), encoding(0 /* nullptr */),
-  reencoded_name(0 /* nullptr */)
+  reencoded_name(0 /* nullptr */), download(0 /* nullptr */)
 {
 }
 
@@ -580,7 +595,7 @@ int style::operator!=(const style &s) const
 }
 
 class ps_printer : public printer {
-  FILE *tempfp;
+  FILE *tempfp;			// the null device with --stream
   ps_output out;
   int res;
   glyph *space_glyph;
@@ -646,6 +661,7 @@ class ps_printer : public printer {
   int media_width();
   int media_height();
   void media_set();
+  void begin_document();
 
 public:
   ps_printer(double);
@@ -663,6 +679,7 @@ public:
 	       char /* type */);
   font *make_font(const char * /* nm */);
   void end_of_line();
+  void end_pass();
 };
 
 // 'pl' is in inches
@@ -680,7 +697,13 @@ ps_printer::ps_printer(double pl)
   ndefs(0),
   invis_count(0)
 {
-  tempfp = xtmpfile();
+  if (stream_flag) {
+    tempfp = fopen(NULL_DEV, "w");
+    if (0 /* nullptr */ == tempfp)
+      fatal("cannot open '%1': %2", NULL_DEV, strerror(errno));
+  }
+  else
+    tempfp = xtmpfile();
   out.set_file(tempfp);
   if (linewidth < 0)
     linewidth = DEFAULT_LINEWIDTH;
@@ -797,6 +820,9 @@ void ps_printer::set_char(glyph *g, font *f, const environment *env,
 {
   if (g == space_glyph || invis_count > 0)
     return;
+  ps_font *psf = static_cast<ps_font *>(f);
+  if (psf->download != 0 /* nullptr */)
+    rm.note_glyph(psf->download, f->get_special_device_encoding(g));
   uint16_t code[2];
   subencoding *sub = set_subencoding(f, g, code);
   style sty(f, sub, env->size, env->height, env->slant);
@@ -1533,7 +1559,11 @@ void ps_printer::end_page(int)
 
 font *ps_printer::make_font(const char *nm)
 {
-  return ps_font::load_ps_font(nm);
+  ps_font *f = ps_font::load_ps_font(nm);
+  if ((f != 0 /* nullptr */) && subset_fonts_flag
+      && (f->get_internal_name() != 0 /* nullptr */))
+    f->download = rm.track_glyphs(f->get_internal_name());
+  return f;
 }
 
 ps_printer::~ps_printer()
@@ -1542,8 +1572,51 @@ ps_printer::~ps_printer()
   out.simple_comment("Trailer")
      .put_symbol("end")
      .simple_comment("EOF");
-  if (fseek(tempfp, 0L, SEEK_SET) < 0)
-    fatal("cannot seek within temporary file: %1", strerror(errno));
+  if (!stream_flag) {
+    if (fseek(tempfp, 0L, SEEK_SET) < 0)
+      fatal("cannot seek within temporary file: %1", strerror(errno));
+    begin_document();
+    out.copy_file(tempfp);
+    fclose(tempfp);
+  }
+  while (subencodings) {
+    subencoding *tem = subencodings;
+    subencodings = subencodings->next;
+    delete tem;
+  }
+}
+
+// With --stream, the first reading of the input has only gathered the
+// fonts, encodings, and definitions that the document setup declares.
+// Write it, and the pages of the second reading after it.  The second
+// reading starts from the output state of a new printer; but the
+// encoding and subencoding numbers assigned in the first reading are
+// kept, since the setup just written uses them.
+
+void ps_printer::end_pass()
+{
+  fclose(tempfp);
+  tempfp = 0 /* nullptr */;
+  begin_document();
+  pages_output = 0;
+  sbuf_len = 0;
+  sbuf_color = default_color;
+  output_style.f = 0;
+  output_hpos = output_vpos = -1;
+  output_space_code = 32;
+  output_draw_point_size = -1;
+  line_thickness = -1;
+  output_line_thickness = -1;
+  ndefined_styles = 0;
+  defs.clear();
+  ndefs = 0;
+  invis_count = 0;
+}
+
+// Write the header comments, prolog, and setup of the document.
+
+void ps_printer::begin_document()
+{
   fputs("%!PS-Adobe-", stdout);
   fputs((broken_flags & USE_PS_ADOBE_2_0) ? "2.0" : "3.0", stdout);
   putchar('\n');
@@ -1667,22 +1740,17 @@ ps_printer::~ps_printer()
        .simple_comment("EndFeature");
   }
   encode_fonts();
-  while (subencodings) {
-    subencoding *tem = subencodings;
-    subencodings = subencodings->next;
-    encode_subfont(tem);
-    out.put_literal_symbol(tem->subfont)
-       .put_symbol(make_subencoding_name(tem->idx))
-       .put_literal_symbol(tem->p->get_internal_name())
+  for (subencoding *sub = subencodings; sub; sub = sub->next) {
+    encode_subfont(sub);
+    out.put_literal_symbol(sub->subfont)
+       .put_symbol(make_subencoding_name(sub->idx))
+       .put_literal_symbol(sub->p->get_internal_name())
        .put_symbol("RE");
-    delete tem;
   }
   out.simple_comment((broken_flags & NO_SETUP_SECTION)
 		     ? "EndProlog"
 		     : "EndSetup");
   out.end_line();
-  out.copy_file(tempfp);
-  fclose(tempfp);
 }
 
 typedef void (ps_printer::*SPECIAL_PROCP)(char *, const environment *);
@@ -1731,6 +1799,9 @@ void ps_printer::special(char *arg, const environment *env, char type)
       flush_sbuf();
       if (sbuf_color != *env->col)
 	set_color(env->col);
+      if ((proc_table[i].proc != &ps_printer::do_invis)
+	  && (proc_table[i].proc != &ps_printer::do_endinvis))
+	rm.include_whole_fonts();
       (this->*(proc_table[i].proc))(p, env);
       return;
     }
@@ -1978,6 +2049,9 @@ int main(int argc, char **argv)
   int c;
   static const struct option long_options[] = {
     { "help", no_argument, 0 /* nullptr */, CHAR_MAX + 1 },
+    { "stream", no_argument, 0 /* nullptr */, CHAR_MAX + 2 },
+    { "full-fonts", no_argument, 0 /* nullptr */, CHAR_MAX + 3 },
+    { "subset-fonts", no_argument, 0 /* nullptr */, CHAR_MAX + 4 },
     { "version", no_argument, 0 /* nullptr */, 'v' },
     { 0 /* nullptr */, 0, 0 /* nullptr */, 0 }
   };
@@ -2035,6 +2109,16 @@ int main(int argc, char **argv)
       usage(stdout);
       exit(EXIT_SUCCESS);
       break;
+    case CHAR_MAX + 2: // --stream
+      stream_flag = 1;
+      input_passes = 2;
+      break;
+    case CHAR_MAX + 3: // --full-fonts
+      subset_fonts_flag = 0;
+      break;
+    case CHAR_MAX + 4: // --subset-fonts
+      subset_fonts_flag = 1;
+      break;
     case '?':
       if (optopt != 0)
 	error("unrecognized command-line option '%1'", char(optopt));
@@ -2069,7 +2153,8 @@ static void usage(FILE *stream)
   fprintf(stream,
 "usage: %s [-glm] [-b brokenness-flags] [-c num-copies]"
 " [-F font-directory] [-I inclusion-directory] [-p paper-format]"
-" [-P prologue-file] [-w rule-thickness] [file ...]\n"
+" [-P prologue-file] [-w rule-thickness] [--full-fonts] [--stream]"
+" [--subset-fonts] [file ...]\n"
 "usage: %s {-v | --version}\n"
 "usage: %s --help\n",
 	  program_name, program_name, program_name);
@@ -19,6 +19,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <stdint.h> // uint16_t
 
+#include "ptable.h"
+
+// the glyphs used from a font; the values only mark presence
+declare_ptable(char)
+
 class ps_output {
 public:
   ps_output(FILE *, int max_line_length);
@@ -75,12 +80,16 @@ public:
   ~resource_manager();
   void import_file(const char *filename, ps_output &);
   void need_font(const char *name);
+  resource *track_glyphs(const char *name);
+  void note_glyph(resource *font, const char *glyph_name);
+  void include_whole_fonts();
   void print_header_comments(ps_output &);
   void document_setup(ps_output &);
   void output_prolog(ps_output &);
 private:
   unsigned extensions;
   unsigned language_level;
+  bool want_whole_fonts;
   resource *procset_resource;
   resource *resource_list;
   resource *lookup_resource(resource_type type, string &name,
@@ -126,6 +135,9 @@ enum {
   NO_PAPERSIZE = 020
 };
 
+bool write_type1_font(FILE *fp, const char *filename,
+		      PTABLE(char) *glyphs, FILE *outfp);
+
 #include "searchpath.h"
 
 extern search_path include_search_path;
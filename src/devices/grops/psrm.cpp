@@ -36,6 +36,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include "ps.h"
 
+implement_ptable(char)
+
 #define GROPS_PROLOGUE "prologue"
 
 // forward declaration
@@ -110,8 +112,11 @@ struct resource {
   resource *next;
   resource_type type;
   string name;
-  enum { NEEDED = 01, SUPPLIED = 02, FONT_NEEDED = 04, BUSY = 010 };
+  enum { NEEDED = 01, SUPPLIED = 02, FONT_NEEDED = 04, BUSY = 010,
+	 GLYPHS_TRACKED = 020, FONT_INCLUDED = 040 };
   unsigned flags;
+  // of a downloadable font, with GLYPHS_TRACKED; see track_glyphs()
+  PTABLE(char) *glyphs;
   string version;
   unsigned revision;
   char *filename;
@@ -122,8 +127,9 @@ struct resource {
 };
 
 resource::resource(resource_type t, string &n, string &v, unsigned r)
-: next(0 /* nullptr */), type(t), flags(0), revision(r),
-  filename(0 /* nullptr */), rank(-1)
+: next(0 /* nullptr */), type(t), flags(0),
+  glyphs(0 /* nullptr */), revision(r), filename(0 /* nullptr */),
+  rank(-1)
 {
   name.move(n);
   version.move(v);
@@ -136,6 +142,7 @@ resource::resource(resource_type t, string &n, string &v, unsigned r)
 
 resource::~resource()
 {
+  delete glyphs;
   free(filename);
 }
 
@@ -152,7 +159,8 @@ void resource::print_type_and_name(FILE *outfp)
 }
 
 resource_manager::resource_manager()
-: extensions(0), language_level(0), resource_list(0)
+: extensions(0), language_level(0), want_whole_fonts(false),
+  resource_list(0)
 {
   read_download_file();
   string procset_name("grops");
@@ -231,6 +239,48 @@ void resource_manager::need_font(const char *name)
   lookup_font(name)->flags |= resource::FONT_NEEDED;
 }
 
+// If the font 'name' is downloadable, start recording the glyphs the
+// document uses from it, so that only those need be downloaded, and
+// return it for note_glyph().
+
+resource *resource_manager::track_glyphs(const char *name)
+{
+  // Unlike lookup_font(), don't create a resource: the order of the
+  // list is that of the resource comments.
+  for (resource *r = resource_list; r; r = r->next)
+    if (r->type == RESOURCE_FONT
+	&& r->filename != 0 /* nullptr */
+	&& strlen(name) == (size_t)r->name.length()
+	&& memcmp(name, r->name.contents(), r->name.length()) == 0) {
+      r->flags |= resource::GLYPHS_TRACKED;
+      if (0 /* nullptr */ == r->glyphs)
+	r->glyphs = new PTABLE(char);
+      return r;
+    }
+  return 0 /* nullptr */;
+}
+
+void resource_manager::note_glyph(resource *r, const char *glyph_name)
+{
+  if (!(r->flags & resource::GLYPHS_TRACKED))
+    return;
+  // Without a name, the glyph cannot be told apart from the others.
+  if (0 /* nullptr */ == glyph_name)
+    r->flags &= ~resource::GLYPHS_TRACKED;
+  else {
+    static char is_used;
+    r->glyphs->define(glyph_name, &is_used);
+  }
+}
+
+// PostScript code from the document can set any glyph of any font by
+// name; once there is some, download fonts whole.
+
+void resource_manager::include_whole_fonts()
+{
+  want_whole_fonts = true;
+}
+
 // XXX: This comment dates to 1991.  Discard the workaround.
 typedef resource *Presource;	// Work around g++ bug.
 
@@ -403,7 +453,16 @@ void resource_manager::supply_resource(resource *r, int rank,
 	putc('\n', outfp);
       }
     }
-    process_file(rank, fp, path, outfp);
+    // Another resource including a font may use any of its glyphs.
+    bool is_subsettable = (r->flags & resource::GLYPHS_TRACKED)
+			  && !(r->flags & resource::FONT_INCLUDED)
+			  && !want_whole_fonts;
+    if (!(r->type == RESOURCE_FONT
+	  && write_type1_font(fp, path,
+			      is_subsettable ? r->glyphs
+					     : 0 /* nullptr */,
+			      outfp)))
+      process_file(rank, fp, path, outfp);
     fclose(fp);
     if (r->type == RESOURCE_FONT)
       free(path);
@@ -634,6 +693,7 @@ int resource_manager::do_include_resource(const char *ptr, int rank,
   resource *r = read_resource_arg(&ptr);
   if (r) {
     if (r->type == RESOURCE_FONT) {
+      r->flags |= resource::FONT_INCLUDED;
       if (rank >= 0)
 	supply_resource(r, rank + 1, outfp);
       else
@@ -731,6 +791,7 @@ int resource_manager::do_include_font(const char *ptr, int rank, FILE *,
 {
   resource *r = read_font_arg(&ptr);
   if (r) {
+    r->flags |= resource::FONT_INCLUDED;
     if (rank >= 0)
       supply_resource(r, rank + 1, outfp);
     else
@@ -0,0 +1,344 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+grops="${abs_top_builddir:-.}/grops"
+srcdir="${abs_top_srcdir:-..}"
+
+fail=
+
+wail () {
+    echo "...FAILED" >&2
+    fail=yes
+}
+
+if ! command -v perl > /dev/null
+then
+    echo "$0: cannot locate 'perl' command; skipping" >&2
+    exit 77 # skip
+fi
+
+tmp=grops-font-subsetting-works.$$
+trap 'rm -rf $tmp.*' EXIT
+
+# Given the argument "font", write the Type 1 font program used below.
+# Given a PostScript file and a font name, decrypt that font's resource
+# in the file and list its subroutines and glyphs with their
+# charstrings decoded, calling any that is cut short or doesn't end
+# with a command ending a charstring "malformed".
+cat > $tmp.pl <<'PERL'
+use strict;
+use warnings;
+
+my %op = (1 => 'hstem', 3 => 'vstem', 4 => 'vmoveto', 5 => 'rlineto',
+          6 => 'hlineto', 7 => 'vlineto', 8 => 'rrcurveto',
+          9 => 'closepath', 10 => 'callsubr', 11 => 'return',
+          13 => 'hsbw', 14 => 'endchar', 21 => 'rmoveto',
+          22 => 'hmoveto', 30 => 'vhcurveto', 31 => 'hvcurveto',
+          '12 0' => 'dotsection', '12 1' => 'vstem3',
+          '12 2' => 'hstem3', '12 6' => 'seac', '12 7' => 'sbw',
+          '12 12' => 'div', '12 16' => 'callothersubr',
+          '12 17' => 'pop', '12 33' => 'setcurrentpoint');
+my %code = reverse %op;
+
+sub crypt1 {
+  my ($s, $r, $encrypting) = @_;
+  my $res = '';
+  for my $c (unpack('C*', $s)) {
+    my $p = $c ^ ($r >> 8);
+    $res .= chr($p);
+    $r = ((($encrypting ? $p : $c) + $r) * 52845 + 22719) & 0xffff;
+  }
+  return $res;
+}
+
+# Encode a charstring given as text, such as "0 500 hsbw endchar".
+sub charstring {
+  my $cs = "\0" x 4;
+  for my $t (split ' ', shift) {
+    if ($t =~ /^-?\d+$/) {
+      if ($t >= -107 && $t <= 107) {
+        $cs .= chr($t + 139);
+      } elsif ($t >= 108 && $t <= 1131) {
+        $cs .= chr(int(($t - 108) / 256) + 247) . chr(($t - 108) % 256);
+      } elsif ($t <= -108 && $t >= -1131) {
+        $cs .= chr(int((-$t - 108) / 256) + 251)
+               . chr((-$t - 108) % 256);
+      } else {
+        $cs .= chr(255) . pack('N', $t);
+      }
+    } else {
+      die "unknown operator $t" unless defined $code{$t};
+      $cs .= join('', map { chr } split(' ', $code{$t}));
+    }
+  }
+  return crypt1($cs, 4330, 1);
+}
+
+sub decode {
+  my @b = unpack('C*', crypt1(shift, 4330, 0));
+  splice(@b, 0, 4);
+  my @t;
+  while (@b) {
+    my $v = shift @b;
+    if ($v >= 32) {
+      if ($v <= 246) {
+        push @t, $v - 139;
+      } elsif ($v <= 254) {
+        return 'malformed' unless @b;
+        my $w = shift @b;
+        push @t, $v <= 250 ? ($v - 247) * 256 + $w + 108
+                            : -($v - 251) * 256 - $w - 108;
+      } else {
+        return 'malformed' if @b < 4;
+        push @t, unpack('l>', pack('C4', splice(@b, 0, 4)));
+      }
+    } else {
+      if (12 == $v) {
+        return 'malformed' unless @b;
+        $v = "12 " . shift @b;
+      }
+      return 'malformed' unless defined $op{$v};
+      push @t, $op{$v};
+    }
+  }
+  return 'malformed' unless @t && $t[-1] =~ /^(endchar|seac|return)$/;
+  return join(' ', @t);
+}
+
+if ('font' eq $ARGV[0]) {
+  my @subrs = ('3 0 callothersubr pop pop setcurrentpoint return',
+               '0 1 callothersubr return', '0 2 callothersubr return',
+               'return', '0 100 hstem return', '0 200 hstem return');
+  my %glyphs = ('.notdef' => '0 500 hsbw endchar',
+                'space' => '0 250 hsbw endchar',
+                'A' => '0 600 hsbw 4 1 3 callothersubr pop callsubr'
+                       . ' 100 0 rmoveto 400 0 rlineto 0 600 rlineto'
+                       . ' closepath endchar',
+                'acute' => '0 300 hsbw 50 500 rmoveto 100 100 rlineto'
+                           . ' closepath endchar',
+                'B' => '0 600 hsbw 0 0 150 65 194 seac',
+                'C' => '0 600 hsbw 5 callsubr 100 0 rmoveto'
+                       . ' 400 0 rlineto 0 600 rlineto closepath'
+                       . ' endchar');
+  my $private = "dup /Private 8 dict dup begin\n"
+                . "/RD{string currentfile exch readstring pop}"
+                . "executeonly def\n"
+                . "/ND{noaccess def}executeonly def\n"
+                . "/NP{noaccess put}executeonly def\n"
+                . "/BlueValues [] def\n/MinFeature {16 16} def\n"
+                . "/password 5839 def\n/UniqueID 4999999 def\n"
+                . "/Subrs " . @subrs . " array\n";
+  for my $i (0 .. $#subrs) {
+    my $cs = charstring($subrs[$i]);
+    $private .= "dup $i " . length($cs) . " RD $cs NP\n";
+  }
+  $private .= "ND\n2 index /CharStrings " . keys(%glyphs)
+              . " dict dup begin\n";
+  for my $g (sort keys %glyphs) {
+    my $cs = charstring($glyphs{$g});
+    $private .= "/$g " . length($cs) . " RD $cs ND\n";
+  }
+  $private .= "end\nend\nreadonly put\nnoaccess put\n"
+              . "dup/FontName get exch definefont pop\n"
+              . "mark currentfile closefile\n";
+  print "%!PS-AdobeFont-1.0: GropsTestFont 001.000\n",
+        "11 dict begin\n",
+        "/FontName /GropsTestFont def\n",
+        "/Encoding StandardEncoding def\n",
+        "/PaintType 0 def\n/FontType 1 def\n",
+        "/FontMatrix [0.001 0 0 0.001 0 0] readonly def\n",
+        "/FontBBox {0 0 1000 1000} readonly def\n",
+        "/UniqueID 4999999 def\n",
+        "currentdict end\ncurrentfile eexec\n";
+  my $hex = unpack('H*', crypt1("\0" x 4 . $private, 55665, 1));
+  print "$1\n" while $hex =~ /(.{1,64})/g;
+  print "0" x 64, "\n" for 1 .. 8;
+  print "cleartomark\n";
+  exit 0;
+}
+
+open(my $fh, '<', $ARGV[0]) or die "cannot open $ARGV[0]: $!";
+my ($in, $hex) = (0, '');
+while (<$fh>) {
+  if (/^%%BeginResource: font \Q$ARGV[1]\E$/) {
+    $in = 1;
+  } elsif ($in && /^%%EndResource/) {
+    last;
+  } elsif (1 == $in && /eexec\s*$/) {
+    $in = 2;
+  } elsif (2 == $in) {
+    last if /^0+\s*$/;
+    s/\s+//g;
+    $hex .= $_;
+  }
+}
+die "no eexec section in font resource $ARGV[1]\n" unless $hex;
+my $p = substr(crypt1(pack('H*', $hex), 55665, 0), 4);
+print "Subrs $1\n" if $p =~ /\/Subrs (\d+) array/;
+print "CharStrings $1\n" if $p =~ /\/CharStrings (\d+) dict/;
+# Skip over each charstring, lest its bytes be taken for PostScript.
+my $name = qr/[^\s\/\[\]{}()<>]+/;
+while ($p =~ /\G.*?(?:dup (\d+)|\/($name)) (\d+) (RD|-\|) /sg) {
+  my ($subr, $glyph, $len) = ($1, $2, $3);
+  my $end = pos($p);
+  my $cs = substr($p, $end, $len);
+  pos($p) = $end + $len;
+  print defined $subr ? "subr $subr: " : "glyph $glyph: ",
+        decode($cs), "\n";
+}
+print "UniqueID\n" if $p =~ /\/UniqueID\s/;
+PERL
+
+# In this font, glyph "B" is built with the `seac` command from "A" and
+# "acute"; "A" replaces its hints with subroutine 4; and only "C" calls
+# subroutine 5.
+mkdir $tmp.d $tmp.d/devps || exit 99
+perl $tmp.pl font > $tmp.d/devps/testfont.pfa || exit 99
+printf 'GropsTestFont\ttestfont.pfa\n' > $tmp.d/devps/download
+cat > $tmp.d/devps/TESTFONT <<'EOF'
+name TESTFONT
+internalname GropsTestFont
+spacewidth 250
+charset
+A	600,600	2	65	A
+B	600,700	2	66	B
+C	600,600	2	67	C
+EOF
+
+input='#
+x T ps
+x res 72000 1 1
+x init
+p 1
+x font 5 TESTFONT
+f 5
+s 10000
+V 84000
+H 72000
+t B
+x trailer
+V 792000
+x stop
+#'
+
+fontdirs="-F $tmp.d -F font -F $srcdir/font"
+
+printf '%s\n' "$input" | "$grops" $fontdirs > $tmp.full
+printf '%s\n' "$input" | "$grops" $fontdirs --subset-fonts > $tmp.sub
+
+echo "checking that fonts are downloaded whole by default" >&2
+perl $tmp.pl $tmp.full GropsTestFont > $tmp.list
+cat $tmp.list
+grep -q '^CharStrings 6$' $tmp.list || wail
+grep -q '^glyph C: ' $tmp.list || wail
+grep -q '^subr 5: 0 200 hstem return$' $tmp.list || wail
+grep -q '^UniqueID$' $tmp.list || wail
+
+echo "checking the subroutines and glyphs of the subset" >&2
+perl $tmp.pl $tmp.sub GropsTestFont > $tmp.list
+cat $tmp.list
+cat > $tmp.expected <<'EOF'
+Subrs 6
+CharStrings 5
+subr 0: 3 0 callothersubr pop pop setcurrentpoint return
+subr 1: 0 1 callothersubr return
+subr 2: 0 2 callothersubr return
+subr 3: return
+subr 4: 0 100 hstem return
+subr 5: return
+glyph .notdef: 0 500 hsbw endchar
+glyph A: 0 600 hsbw 4 1 3 callothersubr pop callsubr 100 0 rmoveto 400 0 rlineto 0 600 rlineto closepath endchar
+glyph B: 0 600 hsbw 0 0 150 65 194 seac
+glyph acute: 0 300 hsbw 50 500 rmoveto 100 100 rlineto closepath endchar
+glyph space: 0 250 hsbw endchar
+EOF
+cmp $tmp.expected $tmp.list || wail
+
+echo "checking that PostScript code in the document prevents" \
+    "subsetting" >&2
+printf '%s\n' "$input" | sed '/^t B$/a\
+x X ps: exec 0 0 moveto' | "$grops" $fontdirs --subset-fonts > $tmp.exec
+perl $tmp.pl $tmp.exec GropsTestFont | grep -q '^CharStrings 6$' \
+    || wail
+
+echo "checking that --full-fonts cancels --subset-fonts" >&2
+printf '%s\n' "$input" | "$grops" $fontdirs --subset-fonts \
+    --full-fonts > $tmp.full2
+cmp $tmp.full $tmp.full2 || wail
+
+# The FreeEuro font program is generated at build time.
+if [ -f font/devps/freeeuro.pfa ]
+then
+    # One of the 16 glyphs of the downloadable FreeEuro font.
+    input='#
+x T ps
+x res 72000 1 1
+x init
+p 1
+x font 5 TR
+f 5
+s 10000
+V 84000
+H 72000
+t Price:
+x font 41 EURO
+f 41
+h 2500
+N 4
+f 5
+h 9910
+t 10.
+x trailer
+V 792000
+x stop
+#'
+
+    printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font \
+        > $tmp.full
+    printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font \
+        --subset-fonts > $tmp.sub
+
+    echo "checking that the FreeEuro font program is copied" >&2
+    line=$(sed -n '/eexec/{n;p;q;}' font/devps/freeeuro.pfa)
+    grep -qxF "$line" $tmp.full || wail
+
+    echo "checking that the FreeEuro subset is smaller" >&2
+    test $(wc -c < $tmp.sub) -lt $(wc -c < $tmp.full) || wail
+
+    echo "checking the subroutines and glyphs of the FreeEuro" \
+        "subset" >&2
+    perl $tmp.pl $tmp.full FreeEuro > $tmp.listfull
+    perl $tmp.pl $tmp.sub FreeEuro > $tmp.list
+    cat $tmp.list
+    grep -q '^CharStrings 2$' $tmp.list || wail
+    grep -q 'malformed' $tmp.list $tmp.listfull && wail
+    grep -q '^UniqueID$' $tmp.list && wail
+    grep -q '^subr 4: return$' $tmp.list || wail
+    for item in 'subr [0-3]' 'glyph \.notdef' 'glyph Euro\.serif'
+    do
+        grep "^$item: " $tmp.listfull > $tmp.want
+        grep "^$item: " $tmp.list > $tmp.got
+        test -s $tmp.want || wail
+        cmp $tmp.want $tmp.got || wail
+    done
+fi
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=4 tabstop=4 textwidth=72:
@@ -0,0 +1,167 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+grops="${abs_top_builddir:-.}/grops"
+srcdir="${abs_top_srcdir:-..}"
+
+fail=
+
+wail () {
+    echo "...FAILED" >&2
+    fail=yes
+}
+
+# Two pages.  The definition made on page 2 belongs in the document
+# setup, which precedes page 1, so grops must know of it before writing
+# any page.  Page 1 provokes a diagnostic.
+input='#
+x T ps
+x res 72000 1 1
+x init
+p 1
+x font 5 TR
+f 5
+s 10000
+V 84000
+H 72000
+t one
+x X ps: bogus
+p 2
+V 84000
+H 72000
+t two
+x X ps: def /grops-stream-test 42 def
+x trailer
+V 792000
+x stop
+#'
+
+tmp=grops-stream-option-works.$$
+trap 'rm -f $tmp.*' EXIT
+
+SOURCE_DATE_EPOCH=0
+export SOURCE_DATE_EPOCH
+
+printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font \
+    > $tmp.out 2> $tmp.err
+printf '%s\n' "$input" > $tmp.in
+
+echo "checking that --stream output matches normal output" >&2
+printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font --stream \
+    > $tmp.outs 2> $tmp.errs
+cmp $tmp.out $tmp.outs || wail
+
+echo "checking that --stream reports diagnostics once" >&2
+cmp $tmp.err $tmp.errs || wail
+
+echo "checking that --stream works with a file operand" >&2
+"$grops" -F font -F "$srcdir"/font --stream $tmp.in > $tmp.outf \
+    2> /dev/null
+cmp $tmp.out $tmp.outf || wail
+
+echo "checking that the definition made on page 2 precedes page 1" >&2
+test "$(grep -n -m 1 grops-stream-test $tmp.outs | cut -d: -f1)" \
+    -lt "$(grep -n '^%%Page: 1 1$' $tmp.outs | cut -d: -f1)" || wail
+
+# Three pages using four fonts in several sizes, with drawing, color,
+# and an `exec` command, which discards the output state.
+input='#
+x T ps
+x res 72000 1 1
+x init
+p 1
+x font 5 TR
+x font 6 TB
+x font 7 TI
+x font 8 HB
+f 5
+s 10000
+V 84000
+H 72000
+t one
+f 6
+h 30000
+t bold
+f 7
+s 12000
+h 30000
+t italic
+D t 1000 0
+h 5000
+D l 50000 0
+n 12000 0
+f 8
+V 100000
+H 72000
+mr 65536 0 0
+t red
+m d
+x X ps: def /grops-stream-test 42 def
+p 2
+f 5
+s 10000
+V 84000
+H 72000
+t two
+f 7
+h 30000
+t italic
+x X ps: exec 0 0 moveto
+f 6
+s 14000
+h 30000
+t bold
+D c 10000
+p 3
+f 8
+s 9000
+V 84000
+H 72000
+md
+t three
+f 5
+h 30000
+t roman
+D f 500 0
+D P 10000 0 0 10000 -10000 0
+x trailer
+V 792000
+x stop
+#'
+
+echo "checking that --stream output matches for a longer document" >&2
+printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font \
+    > $tmp.out 2> /dev/null
+printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font --stream \
+    > $tmp.outs 2> /dev/null
+grep -q '^%%Pages: 3$' $tmp.outs || wail
+cmp $tmp.out $tmp.outs || wail
+
+if test -w /dev/full
+then
+    echo "checking that --stream reports a failure to write output" >&2
+    printf '%s\n' "$input" | "$grops" -F font -F "$srcdir"/font \
+        --stream > /dev/full 2> $tmp.errf
+    test $? -ne 0 || wail
+    grep -q 'fatal error' $tmp.errf || wail
+fi
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=4 tabstop=4 textwidth=72:
@@ -0,0 +1,853 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+// Write Type 1 font programs, in PFA or PFB format, into the document,
+// keeping only the glyphs it uses.  See Adobe's "Type 1 Font Format"
+// for the structure of the files, the eexec and charstring encryption,
+// and the charstring commands.
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h> // BUFSIZ, FILE, fread(), fwrite(), getc(), putc(),
+		   // rewind()
+#include <stdlib.h> // strtol()
+#include <string.h> // memcmp(), memcpy(), strchr(), strcmp(), strlen()
+
+#include <algorithm> // std::min(), std::sort()
+#include <vector>
+
+#include "driver.h" // error(), warning()
+#include "lib.h" // i_to_a()
+#include "stringclass.h" // prerequisite of ps.h
+
+#include "ps.h"
+
+static const unsigned short EEXEC_KEY = 55665;
+static const unsigned short CHARSTRING_KEY = 4330;
+
+// glyph names of StandardEncoding from code 32 to 251, for the
+// components of accented characters built with the `seac` command;
+// null entries are unencoded
+static const char *standard_encoding[] = {
+  "space", "exclam", "quotedbl", "numbersign", "dollar", "percent",
+  "ampersand", "quoteright", "parenleft", "parenright", "asterisk",
+  "plus", "comma", "hyphen", "period", "slash", "zero", "one", "two",
+  "three", "four", "five", "six", "seven", "eight", "nine", "colon",
+  "semicolon", "less", "equal", "greater", "question", "at", "A", "B",
+  "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P",
+  "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z", "bracketleft",
+  "backslash", "bracketright", "asciicircum", "underscore", "quoteleft",
+  "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n",
+  "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+  "braceleft", "bar", "braceright", "asciitilde", 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, "exclamdown", "cent", "sterling", "fraction", "yen",
+  "florin", "section", "currency", "quotesingle", "quotedblleft",
+  "guillemotleft", "guilsinglleft", "guilsinglright", "fi", "fl", 0,
+  "endash", "dagger", "daggerdbl", "periodcentered", 0, "paragraph",
+  "bullet", "quotesinglbase", "quotedblbase", "quotedblright",
+  "guillemotright", "ellipsis", "perthousand", 0, "questiondown", 0,
+  "grave", "acute", "circumflex", "tilde", "macron", "breve",
+  "dotaccent", "dieresis", 0, "ring", "cedilla", 0, "hungarumlaut",
+  "ogonek", "caron", "emdash", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, "AE", 0, "ordfeminine", 0, 0, 0, 0, "Lslash", "Oslash", "OE",
+  "ordmasculine", 0, 0, 0, 0, 0, "ae", 0, 0, 0, "dotlessi", 0, 0,
+  "lslash", "oslash", "oe", "germandbls"
+};
+
+static const char *standard_encoding_name(int code)
+{
+  if ((code < 32)
+      || (size_t(code - 32) >= sizeof standard_encoding
+				/ sizeof standard_encoding[0]))
+    return 0 /* nullptr */;
+  return standard_encoding[code - 32];
+}
+
+static string decrypt(const string &s, unsigned short r)
+{
+  string res;
+  for (size_t i = 0; i < s.length(); i++) {
+    unsigned char c = s[i];
+    res += char(c ^ (r >> 8));
+    r = (c + r) * 52845 + 22719;
+  }
+  return res;
+}
+
+static string encrypt(const string &s, unsigned short r)
+{
+  string res;
+  for (size_t i = 0; i < s.length(); i++) {
+    unsigned char c = (unsigned char)(s[i]) ^ (r >> 8);
+    res += char(c);
+    r = (c + r) * 52845 + 22719;
+  }
+  return res;
+}
+
+static bool is_white_space(char c)
+{
+  return (' ' == c) || ('\t' == c) || ('\r' == c) || ('\n' == c)
+	 || ('\f' == c) || ('\0' == c);
+}
+
+static bool is_delimiter(char c)
+{
+  return (strchr("()<>[]{}/%", c) != 0 /* nullptr */) && (c != '\0');
+}
+
+// Return whether `s` consists of the characters of `nm`, or, if
+// `is_prefix` is true, begins with them.
+
+static bool matches(const string &s, const char *nm,
+		    bool is_prefix = false)
+{
+  size_t len = strlen(nm);
+  return (is_prefix ? (s.length() >= len) : (s.length() == len))
+	 && (memcmp(s.contents(), nm, len) == 0);
+}
+
+// Return `s` with the `n` characters at `pos` replaced by `with`.
+
+static string replace_substring(const string &s, size_t pos, size_t n,
+				const string &with)
+{
+  string res(s.contents(), pos);
+  res += with;
+  res.append(s.contents() + pos + n, s.length() - pos - n);
+  return res;
+}
+
+// A position returned by the search functions when there is no match.
+static const size_t NO_POSITION = size_t(-1);
+
+// A scanner for the PostScript code of the private dictionary, which
+// is interrupted by the binary charstrings that follow the `RD`
+// procedure (whatever its name) and their length.
+
+class type1_scanner {
+  const string &s;
+public:
+  size_t pos;
+  type1_scanner(const string &str, size_t p = 0)
+    : s(str), pos(p) {}
+  string next_token();
+  bool next_integer(int *);
+  bool next_name(const char *);
+  bool read_binary(size_t, string *);
+};
+
+// Return the next token, or an empty string at the end.  A name's
+// leading slash is kept.
+
+string type1_scanner::next_token()
+{
+  while (pos < s.length() && is_white_space(s[pos]))
+    pos++;
+  size_t start = pos;
+  if (pos < s.length() && is_delimiter(s[pos]))
+    pos++;
+  if ((start == pos) || ('/' == s[start]))
+    while (pos < s.length() && !is_white_space(s[pos])
+	   && !is_delimiter(s[pos]))
+      pos++;
+  return s.substring(start, pos - start);
+}
+
+bool type1_scanner::next_integer(int *res)
+{
+  string tok = next_token();
+  char buf[10];
+  if (tok.empty() || tok.length() >= sizeof buf)
+    return false;
+  memcpy(buf, tok.contents(), tok.length());
+  buf[tok.length()] = '\0';
+  char *end;
+  long n = strtol(buf, &end, 10);
+  if (*end != '\0')
+    return false;
+  *res = int(n);
+  return true;
+}
+
+bool type1_scanner::next_name(const char *nm)
+{
+  return matches(next_token(), nm);
+}
+
+// Read the binary data that follows the `RD` token after a single
+// space.
+
+bool type1_scanner::read_binary(size_t len, string *res)
+{
+  if ((pos >= s.length()) || (s[pos] != ' ')
+      || (len > s.length() - pos - 1))
+    return false;
+  *res = s.substring(pos + 1, len);
+  pos += 1 + len;
+  return true;
+}
+
+// Return the position of the next occurrence of the name `tok` in `s`
+// at or after `from`, or NO_POSITION.
+
+static size_t find_name(const string &s, const char *tok, size_t from)
+{
+  size_t len = strlen(tok);
+  const char *p = s.contents();
+  for (size_t i = from; i + len <= s.length(); i++)
+    if ((memcmp(p + i, tok, len) == 0)
+	&& ((i + len == s.length()) || is_white_space(p[i + len])
+	    || is_delimiter(p[i + len])))
+      return i;
+  return NO_POSITION;
+}
+
+// Remove the definitions of `/UniqueID` and `/XUID` from `s`: a subset
+// is not the font they identify, and a printer that has kept the whole
+// font should not take one for the other.
+
+static void remove_font_ids(string &s, size_t limit)
+{
+  static const char *keys[] = { "/UniqueID", "/XUID" };
+  for (size_t k = 0; k < sizeof keys / sizeof keys[0]; k++) {
+    size_t p = 0;
+    while ((p = find_name(s, keys[k], p)) < limit) {
+      // `/UniqueID n def` or `/XUID [n ...] readonly def`
+      type1_scanner sc(s, p + strlen(keys[k]));
+      int n;
+      bool is_value = sc.next_integer(&n);
+      if (!is_value) {
+	sc.pos = p + strlen(keys[k]);
+	if (sc.next_name("[")) {
+	  string tok;
+	  do
+	    tok = sc.next_token();
+	  while (!tok.empty() && !matches(tok, "]"));
+	  is_value = !tok.empty();
+	}
+      }
+      if (is_value) {
+	size_t end = sc.pos;
+	if (!sc.next_name("readonly"))
+	  sc.pos = end;
+	if (sc.next_name("def")) {
+	  string rest = replace_substring(s, p, sc.pos - p, string());
+	  s.move(rest);
+	  if (limit != NO_POSITION)
+	    limit -= sc.pos - p;
+	  continue;
+	}
+      }
+      p++;
+    }
+  }
+}
+
+struct type1_entry {
+  string name;			// of a glyph; empty for a subroutine
+  size_t start;			// of the entry
+  size_t length_pos;		// of the charstring's length
+  size_t end;			// of the charstring
+  size_t entry_end;		// including the closing operators
+  string charstring;		// encrypted
+  bool is_kept;
+  type1_entry();
+};
+
+type1_entry::type1_entry()
+: start(0), length_pos(0), end(0), entry_end(0), is_kept(false)
+{
+}
+
+// A change that type1_font::subset() makes to the text: the
+// characters from `start` up to `end` are replaced by `with`.
+
+struct type1_edit {
+  size_t start;
+  size_t end;
+  string with;
+};
+
+static bool is_before(const type1_edit &a, const type1_edit &b)
+{
+  return a.start < b.start;
+}
+
+class type1_font {
+  string text;			// of the private dictionary, decrypted
+  int len_iv;
+  string rd;			// name of the procedure reading
+				// charstrings
+  std::vector<type1_entry> subrs;
+  std::vector<type1_entry> charstrings;
+  size_t charstrings_count_pos;
+  size_t charstrings_count_end;
+  bool parse_subrs(type1_scanner &);
+  bool parse_charstrings(type1_scanner &);
+  bool parse_entry(type1_scanner &, type1_entry *);
+  void keep_subr(int, std::vector<int> &);
+  void keep_glyph(const char *, std::vector<const char *> &);
+  void scan_charstring(const type1_entry &, std::vector<int> &,
+		       std::vector<const char *> &);
+public:
+  type1_font(const string &);
+  bool parse();
+  void subset(PTABLE(char) *);
+  const string &contents();
+};
+
+type1_font::type1_font(const string &t)
+: text(t), len_iv(4), charstrings_count_pos(0), charstrings_count_end(0)
+{
+}
+
+// Parse `/Subrs n array` and its `dup i len RD ... NP` entries, if
+// any, and then `/CharStrings n dict dup begin` and its `/name len RD
+// ... ND` entries.
+
+bool type1_font::parse()
+{
+  size_t p = find_name(text, "/lenIV", 0);
+  size_t subrs_pos = find_name(text, "/Subrs", 0);
+  type1_scanner sc(text, 0);
+  if ((p != NO_POSITION) && (p < subrs_pos)) {
+    sc.pos = p + 6;
+    if (!sc.next_integer(&len_iv) || (len_iv < -1))
+      return false;
+  }
+  if (subrs_pos != NO_POSITION) {
+    sc.pos = subrs_pos + 6;
+    if (!parse_subrs(sc))
+      return false;
+  }
+  size_t charstrings_pos = find_name(text, "/CharStrings", sc.pos);
+  if (NO_POSITION == charstrings_pos)
+    return false;
+  sc.pos = charstrings_pos + 12;
+  return parse_charstrings(sc);
+}
+
+bool type1_font::parse_subrs(type1_scanner &sc)
+{
+  int count;
+  if (!sc.next_integer(&count) || !sc.next_name("array"))
+    return false;
+  for (;;) {
+    size_t start = sc.pos;
+    if (!sc.next_name("dup")) {
+      sc.pos = start;
+      return true;
+    }
+    type1_entry e;
+    int n;
+    if (!sc.next_integer(&n) || (n < 0) || (n >= count))
+      return false;
+    e.start = start;
+    if (!parse_entry(sc, &e))
+      return false;
+    if (size_t(n) >= subrs.size())
+      subrs.resize(n + 1);
+    subrs[n] = e;
+    for (;;) {
+      size_t end = sc.pos;
+      string tok = sc.next_token();
+      if (!matches(tok, "NP") && !matches(tok, "|")
+	  && !matches(tok, "noaccess") && !matches(tok, "put")) {
+	sc.pos = end;
+	break;
+      }
+    }
+    subrs[n].entry_end = sc.pos;
+  }
+}
+
+bool type1_font::parse_charstrings(type1_scanner &sc)
+{
+  int count;
+  charstrings_count_pos = sc.pos;
+  if (!sc.next_integer(&count))
+    return false;
+  charstrings_count_end = sc.pos;
+  if (!sc.next_name("dict"))
+    return false;
+  for (;;) {
+    size_t start = sc.pos;
+    string tok = sc.next_token();
+    if (matches(tok, "dup") || matches(tok, "begin")) {
+      if (!charstrings.empty())
+	return false;
+      continue;
+    }
+    if (matches(tok, "end"))
+      return !charstrings.empty();
+    if ((tok.length() < 2) || (tok[0] != '/'))
+      return false;
+    type1_entry e;
+    e.name = tok.substring(1, tok.length() - 1);
+    e.name += '\0';
+    e.start = start;
+    if (!parse_entry(sc, &e))
+      return false;
+    for (;;) {
+      size_t end = sc.pos;
+      tok = sc.next_token();
+      if (!matches(tok, "ND") && !matches(tok, "|-")
+	  && !matches(tok, "noaccess") && !matches(tok, "def")
+	  && !matches(tok, "readonly")) {
+	sc.pos = end;
+	break;
+      }
+    }
+    e.entry_end = sc.pos;
+    charstrings.push_back(e);
+  }
+}
+
+// Parse the `len RD <binary>` part of an entry.
+
+bool type1_font::parse_entry(type1_scanner &sc, type1_entry *e)
+{
+  int len;
+  while (sc.pos < text.length() && is_white_space(text[sc.pos]))
+    sc.pos++;
+  e->length_pos = sc.pos;
+  if (!sc.next_integer(&len) || (len < 0))
+    return false;
+  string tok = sc.next_token();
+  if (rd.empty())
+    rd = tok;
+  else if (tok != rd)
+    return false;
+  if (!sc.read_binary(len, &e->charstring))
+    return false;
+  e->end = sc.pos;
+  return true;
+}
+
+// Note the subroutines and accent components a charstring uses.  The
+// number of a subroutine is the last operand of `callsubr`, or, for
+// hint replacement, the one before `1 3 callothersub`; any other
+// operand on the stack at a `callsubr` is taken for one as well, since
+// a subroutine may pass it on.
+
+void type1_font::scan_charstring(const type1_entry &e,
+				 std::vector<int> &subr_queue,
+				 std::vector<const char *> &glyph_queue)
+{
+  string cs = e.charstring;
+  size_t i = 0;
+  if (len_iv >= 0) {
+    cs = decrypt(cs, CHARSTRING_KEY);
+    i = std::min(cs.length(), size_t(len_iv));
+  }
+  const int STACK_SIZE = 24;
+  int stack[STACK_SIZE];
+  bool is_known[STACK_SIZE];
+  int sp = 0;
+  for (; i < cs.length(); i++) {
+    int v = (unsigned char)(cs[i]);
+    int n = 0;
+    bool is_number = true;
+    if (v >= 32 && v <= 246)
+      n = v - 139;
+    else if (v >= 247 && v <= 250 && i + 1 < cs.length())
+      n = (v - 247) * 256 + (unsigned char)(cs[++i]) + 108;
+    else if (v >= 251 && v <= 254 && i + 1 < cs.length())
+      n = -(v - 251) * 256 - (unsigned char)(cs[++i]) - 108;
+    else if (255 == v && i + 4 < cs.length()) {
+      unsigned long u = 0;
+      for (int j = 0; j < 4; j++)
+	u = (u << 8) | (unsigned char)(cs[++i]);
+      n = (u & 0x80000000UL) ? -int(~u & 0x7fffffffUL) - 1 : int(u);
+    }
+    else
+      is_number = false;
+    if (is_number) {
+      if (sp < STACK_SIZE) {
+	stack[sp] = n;
+	is_known[sp++] = true;
+      }
+      continue;
+    }
+    if (10 == v) {		// callsubr
+      for (int j = 0; j < sp; j++)
+	if (is_known[j])
+	  subr_queue.push_back(stack[j]);
+      sp = 0;
+    }
+    else if (12 == v && i + 1 < cs.length()) {
+      int op = (unsigned char)(cs[++i]);
+      if (6 == op && sp >= 2) {	// seac
+	for (int j = sp - 2; j < sp; j++) {
+	  const char *nm = is_known[j]
+			   ? standard_encoding_name(stack[j])
+			   : 0 /* nullptr */;
+	  if (nm != 0 /* nullptr */)
+	    glyph_queue.push_back(nm);
+	}
+	sp = 0;
+      }
+      else if (16 == op) {	// callothersub
+	if (sp >= 3 && is_known[sp - 1] && 3 == stack[sp - 1]
+	    && is_known[sp - 3])
+	  subr_queue.push_back(stack[sp - 3]);
+	sp = 0;
+      }
+      else if ((17 == op) || (12 == op)) { // pop, div
+	if (12 == op)
+	  sp = (sp >= 2) ? sp - 2 : 0;
+	if (sp < STACK_SIZE)
+	  is_known[sp++] = false;
+      }
+      else
+	sp = 0;
+    }
+    else
+      sp = 0;
+  }
+}
+
+void type1_font::keep_subr(int n, std::vector<int> &subr_queue)
+{
+  if (n < 0 || size_t(n) >= subrs.size() || subrs[n].is_kept
+      || subrs[n].charstring.empty())
+    return;
+  subrs[n].is_kept = true;
+  std::vector<const char *> unused;
+  scan_charstring(subrs[n], subr_queue, unused);
+}
+
+void type1_font::keep_glyph(const char *name,
+			    std::vector<const char *> &glyph_queue)
+{
+  for (size_t i = 0; i < charstrings.size(); i++)
+    if (strcmp(charstrings[i].name.contents(), name) == 0) {
+      if (charstrings[i].is_kept)
+	return;
+      charstrings[i].is_kept = true;
+      std::vector<int> subr_queue;
+      scan_charstring(charstrings[i], subr_queue, glyph_queue);
+      // The first four subroutines implement flex and hint
+      // replacement, which the PostScript interpreter calls itself.
+      for (int n = 0; n < 4; n++)
+	subr_queue.push_back(n);
+      while (!subr_queue.empty()) {
+	int n = subr_queue.back();
+	subr_queue.pop_back();
+	keep_subr(n, subr_queue);
+      }
+      return;
+    }
+}
+
+// Drop the charstrings of the glyphs not in `glyphs`, other than
+// `.notdef` and `space`, and empty the subroutines that the remaining
+// ones do not call.  The subroutines keep their numbers.
+
+void type1_font::subset(PTABLE(char) *glyphs)
+{
+  std::vector<const char *> glyph_queue;
+  PTABLE_ITERATOR(char) iter(glyphs);
+  const char *name;
+  char *unused;
+  while (iter.next(&name, &unused))
+    glyph_queue.push_back(name);
+  glyph_queue.push_back(".notdef");
+  glyph_queue.push_back("space");
+  while (!glyph_queue.empty()) {
+    name = glyph_queue.back();
+    glyph_queue.pop_back();
+    keep_glyph(name, glyph_queue);
+  }
+  string stub;
+  for (int i = 0; i < len_iv; i++)
+    stub += '\0';
+  stub += char(11);		// return
+  if (len_iv >= 0)
+    stub = encrypt(stub, CHARSTRING_KEY);
+  std::vector<type1_edit> edits;
+  type1_edit edit;
+  for (size_t n = 0; n < subrs.size(); n++)
+    if (!subrs[n].is_kept && !subrs[n].charstring.empty()) {
+      edit.start = subrs[n].length_pos;
+      edit.end = subrs[n].end;
+      edit.with = i_to_a(int(stub.length()));
+      edit.with += ' ';
+      edit.with += rd;
+      edit.with += ' ';
+      edit.with += stub;
+      edits.push_back(edit);
+    }
+  int kept = 0;
+  edit.with.clear();
+  for (size_t i = 0; i < charstrings.size(); i++)
+    if (charstrings[i].is_kept)
+      kept++;
+    else {
+      edit.start = charstrings[i].start;
+      edit.end = charstrings[i].entry_end;
+      edits.push_back(edit);
+    }
+  edit.start = charstrings_count_pos;
+  edit.end = charstrings_count_end;
+  edit.with = " ";
+  edit.with += i_to_a(kept);
+  edits.push_back(edit);
+  // Build the new text in one pass; the edits do not overlap.
+  std::sort(edits.begin(), edits.end(), is_before);
+  string res;
+  size_t p = 0;
+  for (size_t i = 0; i < edits.size(); i++) {
+    res.append(text.contents() + p, edits[i].start - p);
+    res += edits[i].with;
+    p = edits[i].end;
+  }
+  res.append(text.contents() + p, text.length() - p);
+  text.move(res);
+  size_t subrs_pos = find_name(text, "/Subrs", 0);
+  remove_font_ids(text, subrs_pos);
+}
+
+const string &type1_font::contents()
+{
+  return text;
+}
+
+// Replace carriage returns, alone or before a newline, with newlines.
+
+static string normalize_line_ends(const string &s)
+{
+  string res;
+  for (size_t i = 0; i < s.length(); i++)
+    if (s[i] != '\r')
+      res += s[i];
+    else if ((i + 1 == s.length()) || (s[i + 1] != '\n'))
+      res += '\n';
+  return res;
+}
+
+// Split a PFB file into its text, binary, and text segments.
+
+static bool split_pfb(const string &data, string *clear,
+		      string *binary, string *trailer)
+{
+  size_t p = 0;
+  while (p + 2 <= data.length()) {
+    if ((unsigned char)(data[p]) != 0x80)
+      return false;
+    int type = data[p + 1];
+    if (3 == type)
+      return !binary->empty();
+    if (p + 6 > data.length())
+      return false;
+    size_t len = 0;
+    for (int i = 3; i >= 0; i--)
+      len = (len << 8) | (unsigned char)(data[p + 2 + i]);
+    p += 6;
+    if (len > data.length() - p)
+      return false;
+    const char *seg = data.contents() + p;
+    p += len;
+    if (1 == type)
+      (binary->empty() ? clear : trailer)->append(seg, len);
+    else if (2 == type)
+      binary->append(seg, len);
+    else
+      return false;
+  }
+  return false;
+}
+
+static int hex_digit_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Split a PFA file into the text up to and including `currentfile
+// eexec`, the hexadecimal encrypted part decoded, and the text from
+// the first line of zeros on.
+
+static bool split_pfa(const string &data, string *clear,
+		      string *binary, string *trailer)
+{
+  size_t p = find_name(data, "eexec", 0);
+  if (NO_POSITION == p)
+    return false;
+  p += 5;
+  while (p < data.length() && (' ' == data[p] || '\t' == data[p]))
+    p++;
+  if (p < data.length() && '\r' == data[p])
+    p++;
+  if (p < data.length() && '\n' == data[p])
+    p++;
+  *clear = data.substring(0, p);
+  int hi = -1;
+  while (p < data.length()) {
+    size_t eol = p;
+    while (eol < data.length() && (data[eol] != '\r')
+	   && (data[eol] != '\n'))
+      eol++;
+    bool is_zeros = false;
+    size_t q;
+    for (q = p; q < eol; q++)
+      if ('0' == data[q])
+	is_zeros = true;
+      else if ((data[q] != ' ') && (data[q] != '\t'))
+	break;
+    if (is_zeros && (q == eol)) {
+      *trailer = data.substring(p, data.length() - p);
+      return (hi < 0) && !binary->empty();
+    }
+    for (; p < eol; p++) {
+      if (is_white_space(data[p]))
+	continue;
+      int d = hex_digit_value(data[p]);
+      if (d < 0)
+	return false;
+      if (hi < 0)
+	hi = d;
+      else {
+	*binary += char(hi * 16 + d);
+	hi = -1;
+      }
+    }
+    p = eol + 1;
+  }
+  return false;
+}
+
+// Write the lines of `s` to `outfp`, leaving out those that begin with
+// `%!` if the 'broken' flags call for it.
+
+static void put_text(const string &s, FILE *outfp)
+{
+  size_t p = 0;
+  while (p < s.length()) {
+    size_t eol = p;
+    while (eol < s.length() && s[eol] != '\n')
+      eol++;
+    if (eol < s.length())
+      eol++;
+    if (!(broken_flags & STRIP_PERCENT_BANG)
+	|| (eol - p < 2) || (s[p] != '%') || (s[p + 1] != '!'))
+      fwrite(s.contents() + p, 1, eol - p, outfp);
+    p = eol;
+  }
+  if (!s.empty() && (s[s.length() - 1] != '\n'))
+    putc('\n', outfp);
+}
+
+static void put_hex(const string &s, FILE *outfp)
+{
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < s.length(); i++) {
+    unsigned char c = s[i];
+    putc(digits[c >> 4], outfp);
+    putc(digits[c & 0xf], outfp);
+    if ((i % 32 == 31) || (i + 1 == s.length()))
+      putc('\n', outfp);
+  }
+}
+
+// If `fp` holds a Type 1 font program, write it to `outfp` in PFA
+// format, keeping only the glyphs named in `glyphs` unless that is
+// null, and return true.  Otherwise, or if `glyphs` is null and the
+// file is in PFA format already, write nothing, rewind `fp`, and
+// return false; the caller is to copy the file.  If `outfp` is null,
+// return whether the file is in PFB format, which has no document
+// structuring comments to read.
+
+bool write_type1_font(FILE *fp, const char *filename,
+		      PTABLE(char) *glyphs, FILE *outfp)
+{
+  if (0 /* nullptr */ == outfp) {
+    bool is_pfb = (getc(fp) == 0x80) && (getc(fp) == 1);
+    rewind(fp);
+    return is_pfb;
+  }
+  string data;
+  char buf[BUFSIZ];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+    data.append(buf, n);
+  string clear, binary, trailer;
+  bool is_pfb = (data.length() > 1)
+		&& (0x80 == (unsigned char)(data[0]))
+		&& (1 == data[1]);
+  if (is_pfb) {
+    if (!split_pfb(data, &clear, &binary, &trailer)) {
+      error("cannot parse PFB font file '%1'", filename);
+      rewind(fp);
+      return false;
+    }
+  }
+  else if ((0 /* nullptr */ == glyphs)
+	   || (!matches(data, "%!PS-AdobeFont", true)
+	       && !matches(data, "%!FontType1", true))
+	   || !split_pfa(data, &clear, &binary, &trailer)) {
+    rewind(fp);
+    return false;
+  }
+  if (glyphs != 0 /* nullptr */) {
+    string text = decrypt(binary, EEXEC_KEY);
+    type1_font f(text.length() > 4
+		 ? text.substring(4, text.length() - 4) : string());
+    if (f.parse()) {
+      f.subset(glyphs);
+      binary = encrypt(text.substring(0, 4) + f.contents(), EEXEC_KEY);
+      size_t p = NO_POSITION;
+      for (size_t i = clear.length(); i >= 5; i--)
+	if (memcmp(clear.contents() + i - 5, "eexec", 5) == 0) {
+	  p = i - 5;
+	  break;
+	}
+      remove_font_ids(clear, p);
+    }
+    else {
+      warning("cannot subset font file '%1'; including all of it",
+	      filename);
+      if (!is_pfb) {
+	rewind(fp);
+	return false;
+      }
+    }
+  }
+  put_text(normalize_line_ends(clear), outfp);
+  put_hex(binary, outfp);
+  string tail = normalize_line_ends(trailer);
+  size_t i = 0;
+  while (i < tail.length() && '\n' == tail[i])
+    i++;
+  put_text(tail.substring(i, tail.length() - i), outfp);
+  return true;
+}
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
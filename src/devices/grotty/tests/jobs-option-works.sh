@@ -0,0 +1,156 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+grotty="${abs_top_builddir:-.}/grotty"
+
+fail=
+
+wail () {
+    echo "...FAILED" >&2
+    fail=yes
+}
+
+# Five pages.  Continuous underlining starts on page 1 and ends on page
+# 3, so the processes rendering pages 2 and 3 must learn of it from a
+# page they don't render.  Pages 2 and 4 provoke diagnostics.
+input='#
+x T ascii
+x res 240 24 40
+x init
+p 1
+x font 1 R
+f 1
+s 10
+V 40
+H 0
+x u 1
+t one
+h 48
+t one
+n 40 0
+p 2
+V 40
+H 0
+t two
+h 48
+t two
+x X ps: bogus
+n 40 0
+p 3
+V 40
+H 0
+t three
+h 48
+t three
+x u 0
+n 40 0
+p 4
+V 40
+H 0
+t four
+h 48
+t four
+x X tty: bogus
+n 40 0
+p 5
+V 40
+H 0
+t five
+h 48
+t five
+n 40 0
+x trailer
+V 40
+x stop
+#'
+
+tmp=grotty-jobs-option-works.$$
+trap 'rm -f $tmp.*' EXIT
+
+printf '%s\n' "$input" | "$grotty" -F font -F build/font -c \
+    > $tmp.out 2> $tmp.err
+printf '%s\n' "$input" > $tmp.in
+
+echo "checking that --jobs=3 output matches sequential output" >&2
+printf '%s\n' "$input" | "$grotty" -F font -F build/font -c --jobs=3 \
+    > $tmp.out3 2> $tmp.err3
+cmp $tmp.out $tmp.out3 || wail
+
+echo "checking that --jobs=3 diagnostics are in page order" >&2
+cmp $tmp.err $tmp.err3 || wail
+
+echo "checking that --jobs=2 works with a file operand" >&2
+"$grotty" -F font -F build/font -c --jobs=2 $tmp.in > $tmp.out2 \
+    2> /dev/null
+cmp $tmp.out $tmp.out2 || wail
+
+# In the legacy output format, continuous underlining appears as
+# underscore-backspace sequences in the gap between the words.
+echo "checking that continuous underlining spans pages" >&2
+for word in one two three
+do
+    grep -q "^${word}_. _. $word\$" $tmp.out3 || wail
+done
+for word in four five
+do
+    grep -q "^$word  $word\$" $tmp.out3 || wail
+done
+
+# Three pages, each beginning where the previous one left off
+# horizontally, in fonts selected and mounted on earlier pages.
+carried='#
+x T ascii
+x res 240 24 40
+x init
+p 1
+x font 1 R
+x font 2 B
+f 1
+s 10
+V 40
+H 0
+t aa
+f 2
+u 24 aa
+p 2
+V 40
+t bb
+x font 2 I
+t bb
+p 3
+V 40
+t cc
+f 1
+t cc
+x trailer
+V 40
+x stop
+#'
+
+echo "checking that horizontal positions carry across pages" >&2
+printf '%s\n' "$carried" | "$grotty" -F font -F build/font -c \
+    > $tmp.out
+printf '%s\n' "$carried" | "$grotty" -F font -F build/font -c \
+    --jobs=3 > $tmp.out3
+cat $tmp.out3
+cmp $tmp.out $tmp.out3 || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=4 tabstop=4 textwidth=72:
@@ -23,7 +23,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <config.h>
 #endif
 
-#include <limits.h> // CHAR_MAX
+#include <errno.h>
+#include <limits.h> // CHAR_MAX, INT_MAX, SHRT_MAX, SHRT_MIN
 #include <locale.h> // setlocale()
 #include <stdio.h> // EOF, FILE, fprintf(), fputs(), printf(),
 		   // putchar(), setbuf(), stderr, stdout
@@ -41,7 +42,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "ptable.h"
 
 // libdriver
-#include "driver.h" // interpret_troff_output_file()
+#include "driver.h" // interpret_troff_output_file(), page_jobs
 #include "printer.h" // environment, printer
 
 typedef signed char schar;
@@ -209,6 +210,12 @@ class tty_printer : public printer {
   bool is_underlining;
   bool is_boldfacing;
   bool is_continuously_underlining;
+  // the last continuous underlining command on a page being skipped
+  bool has_skipped_cu;
+  int skipped_cu_vpos;
+  int skipped_cu_hpos;
+  bool skipped_cu_value;
+  bool is_skipping;
   PTABLE(schar) tty_colors;
   void make_underline(int);
   void make_bold(output_character, int);
@@ -229,6 +236,8 @@ public:
   void set_char(glyph *, font *, const environment *, int, const char *);
   void draw(int, int *, int, const environment *);
   void special(char *, const environment *, char);
+  void skip_special(char *, const environment *, char);
+  void skip_page(int);
   void change_color(const environment * const);
   void change_fill_color(const environment * const);
   void put_char(output_character);
@@ -325,6 +334,11 @@ tty_printer::tty_printer() : cached_v(0)
 		   &dummy, 6);
   begin_page(0 /* dummy */);
   is_continuously_underlining = false;
+  has_skipped_cu = false;
+  skipped_cu_vpos = 0;
+  skipped_cu_hpos = 0;
+  skipped_cu_value = false;
+  is_skipping = false;
 }
 
 tty_printer::~tty_printer()
@@ -481,6 +495,8 @@ void tty_printer::add_char(output_character c, int w,
 void tty_printer::simple_add_char(const output_character c,
 				  const environment *env)
 {
+  if (is_skipping)
+    return;
   add_char(c, 0, env->hpos, env->vpos, env->col, env->fill, 0U);
 }
 
@@ -522,6 +538,38 @@ void tty_printer::special(char *arg, const environment *env, char type)
     warning("unrecognized X command '%1' ignored", command);
 }
 
+// On a page rendered by another process, only continuous underlining
+// and hyperlinks carry over to later pages.  Of the former, keep the
+// command that end_page() would have seen last.
+void tty_printer::skip_special(char *arg, const environment *env,
+			       char type)
+{
+  if (type == 'u') {
+    int hpos = env->hpos / font::hor;
+    int vpos = env->vpos / font::vert;
+    if (hpos < SHRT_MIN || hpos > SHRT_MAX || vpos <= 0)
+      return;
+    if (!has_skipped_cu || vpos > skipped_cu_vpos
+	|| (vpos == skipped_cu_vpos && hpos >= skipped_cu_hpos)) {
+      has_skipped_cu = true;
+      skipped_cu_vpos = vpos;
+      skipped_cu_hpos = hpos;
+      skipped_cu_value = ((*arg - '0') != 0);
+    }
+    return;
+  }
+  is_skipping = true;
+  special(arg, env, type);
+  is_skipping = false;
+}
+
+void tty_printer::skip_page(int)
+{
+  if (has_skipped_cu)
+    is_continuously_underlining = skipped_cu_value;
+  has_skipped_cu = false;
+}
+
 // Produce an OSC 8 hyperlink.  Given ditroff input of the form:
 //   x X tty: link [URI[ KEY=VALUE] ...]
 // produce "OSC 8 [;KEY=VALUE];[URI] ST".  KEY/VALUE pairs can be
@@ -817,6 +865,7 @@ const int default_lines_per_page = 66;
 
 void tty_printer::begin_page(int)
 {
+  cached_v = 0;
   nlines = default_lines_per_page;
   lines = 0 /* nullptr */;
   try {
@@ -1058,6 +1107,7 @@ int main(int argc, char **argv)
   int c;
   static const struct option long_options[] = {
     { "help", no_argument, 0 /* nullptr */, CHAR_MAX + 1 },
+    { "jobs", required_argument, 0 /* nullptr */, CHAR_MAX + 2 },
     { "version", no_argument, 0 /* nullptr */, 'v' },
     { 0 /* nullptr */, 0, 0 /* nullptr */, 0 }
   };
@@ -1126,6 +1176,21 @@ int main(int argc, char **argv)
       usage(stdout);
       exit(EXIT_SUCCESS);
       break;
+    case CHAR_MAX + 2: // --jobs
+      {
+	char *end;
+	errno = 0;
+	long n = strtol(optarg, &end, 10);
+	if (end == optarg || *end != '\0' || n < 1 || n > INT_MAX
+	    || errno != 0) {
+	  error("'--jobs' option requires a positive integer argument,"
+		" got '%1'", optarg);
+	  usage(stderr);
+	  exit(2);
+	}
+	page_jobs = int(n);
+      }
+      break;
     case '?':
       if (optopt != 0)
 	error("unrecognized command-line option '%1'", char(optopt));
@@ -1136,8 +1201,12 @@ int main(int argc, char **argv)
       exit(2);
       break;
     case ':':
-      error("command-line option '%1' requires an argument",
-	    char(optopt));
+      if (optopt <= CHAR_MAX)
+	error("command-line option '%1' requires an argument",
+	      char(optopt));
+      else
+	error("command-line option '%1' requires an argument",
+	      argv[(optind - 1)]);
       usage(stderr);
       exit(2);
       break;
@@ -1157,8 +1226,10 @@ int main(int argc, char **argv)
 static void usage(FILE *stream)
 {
   fprintf(stream,
-"usage: %s [-dfhot] [-i|-r] [-F font-directory] [file ...]\n"
-"usage: %s -c [-bBdfhouU] [-F font-directory] [file ...]\n"
+"usage: %s [-dfhot] [-i|-r] [-F font-directory] [--jobs=n]"
+" [file ...]\n"
+"usage: %s -c [-bBdfhouU] [-F font-directory] [--jobs=n]"
+" [file ...]\n"
 "usage: %s {-v | --version}\n"
 "usage: %s --help\n",
 	  program_name, program_name, program_name, program_name);
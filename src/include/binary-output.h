@@ -0,0 +1,64 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+// Binary encoding of the most frequent groff_out(5) commands.
+//
+// After the prologue, GNU troff announces the encoding with the device
+// control command "x binary 1".  From then on, a command starting with
+// a byte that has its high bit set is binary; all other commands keep
+// their textual syntax, so that drawing and color commands, `x font`,
+// and material copied transparently into the output can be freely
+// interleaved with binary ones.
+//
+// A binary opcode is the letter of the text command it replaces with
+// the high bit set.  Its arguments follow without separators.
+//
+//   integer  zigzag-encoded signed LEB128 ("varint")
+//   byte     a single unsigned character
+//   string   an integer length followed by that many bytes
+//
+// Glyph names are interned: the first use of a special character name
+// defines the next free index (starting at 0) and prints the glyph;
+// subsequent uses print it by index.
+
+#define BINARY_OUTPUT_VERSION 1
+
+enum binary_output_opcode {
+  BINARY_HMOTION_CHAR = 0x80 | '0', // integer, byte ("ddc")
+  BINARY_C = 0x80 | 'C',	// integer glyph index
+  BINARY_GLYPH_DEFINE = 0x80 | 'G', // string glyph name
+  BINARY_H = 0x80 | 'H',	// integer
+  BINARY_N = 0x80 | 'N',	// integer
+  BINARY_V = 0x80 | 'V',	// integer
+  BINARY_X = 0x80 | 'X',	// string ("x X")
+  BINARY_c = 0x80 | 'c',	// byte
+  BINARY_f = 0x80 | 'f',	// integer
+  BINARY_h = 0x80 | 'h',	// integer
+  BINARY_n = 0x80 | 'n',	// (no arguments)
+  BINARY_p = 0x80 | 'p',	// integer
+  BINARY_s = 0x80 | 's',	// integer
+  BINARY_t = 0x80 | 't',	// string
+  BINARY_u = 0x80 | 'u',	// integer kern, string
+  BINARY_v = 0x80 | 'v',	// integer
+  BINARY_w = 0x80 | 'w'		// (no arguments)
+};
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
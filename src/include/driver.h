@@ -20,6 +20,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "font.h"
 
 void interpret_troff_output_file(const char *);
+// number of processes among which to share the rendering of pages
+extern int page_jobs;
+// number of times to read each input file; see printer::end_pass()
+extern int input_passes;
 
 // Local Variables:
 // fill-column: 72
@@ -60,6 +60,9 @@ void debug(const char *,
 	   const errarg & = empty_errarg,
 	   const errarg & = empty_errarg);
 
+// When set, only fatal errors are reported.
+extern bool want_fatal_diagnostics_only;
+
 // libgroff/fatal.cpp
 void fatal_error_exit() __attribute__((__noreturn__));
 
@@ -19,6 +19,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <stdio.h> // FILE
 
+class snapshot_writer;
+class snapshot_reader;
+
 // A function of this type can be registered to define the semantics of
 // arbitrary commands in a font DESC file.
 typedef void (*FONT_COMMAND_HANDLER)(const char *,	// command
@@ -90,8 +93,9 @@ inline int glyph_to_index(glyph *g)
 }
 
 // Types used in non-public members of 'class font'.
-struct font_kern_list;
+struct font_kern_entry;
 struct font_char_metric;
+struct font_wchar_range;
 struct font_widths_cache;
 
 // A 'class font' instance represents the relevant information of a font of
@@ -215,6 +219,13 @@ public:
 			// file before the 'charset' and 'kernpairs'
 			// sections is checked for validity.  Return
 			// null pointer in case of failure.
+  void write_image(snapshot_writer &);	// Append a flat image of
+			// this font's description, as loaded, to arg1.
+  static font *read_image(snapshot_reader &, glyph *(*)(int));
+			// Reconstruct a font from an image written by
+			// write_image(), using arg2 to convert glyph
+			// indices back to glyphs.  Return null pointer
+			// if the image is invalid.
   static void command_line_font_dir(const char *);	// Prepend given
 			// path (arg1) to the list of directories in which
 			// to look up fonts.
@@ -284,8 +295,10 @@ public:
 private:
   unsigned ligatures;	// Bit mask of available ligatures.  Used by
 			// has_ligature().
-  font_kern_list **kern_hash_table;	// Hash table of kerning pairs.
-			// Used by get_kern().
+  font_kern_entry *kern_table;	// Open-addressed hash table of
+			// kerning pairs.  Used by get_kern().
+  int kern_table_size;	// A power of 2, or 0 if there are no pairs.
+  int nkerns;
   int space_width;	// The normal width of a space.  Used by
 			// get_space_width().
   bool special;		// See public is_special() above.
@@ -303,16 +316,21 @@ private:
 			// (if is_unicode).  The indices of this array are
 			// font-specific, found as values in ch_index[].
   font_char_metric *wch;// Metrics for wide characters.
+  font_wchar_range *wch_ranges;	// The code point ranges of `wch`,
+			// disjoint and sorted, for binary search.  Built
+			// by compact().
+  int nwch_ranges;
   int ch_used;
   int ch_size;
-  font_widths_cache *widths_cache;	// A cache of scaled character
-			// widths.  Used by the get_width() function.
+  font_widths_cache *widths_cache;	// A direct-mapped cache of
+			// scaled character widths, one slot per point
+			// size.  Used by the get_width() function.
 
   static FONT_COMMAND_HANDLER unknown_desc_command_handler;	// A
 			// function defining the semantics of arbitrary
 			// commands in the DESC file.
-  enum { KERN_HASH_TABLE_SIZE = 503 };	// Size of the hash table of kerning
-			// pairs.
+  enum { WIDTHS_CACHE_SIZE = 16 };	// Number of slots in
+			// `widths_cache`; a power of 2.
 
   // These methods add new characters to the ch_index[] and ch[] arrays.
   void add_entry(glyph *,			// glyph
@@ -322,12 +340,13 @@ private:
   void alloc_ch_index(int);			// index
   void extend_ch();
   void compact();
+  void index_wchar_ranges();
 
   void add_kern(glyph *, glyph *, int);	// Add to the kerning table a
 			// kerning amount (arg3) between two given glyphs
 			// (arg1 and arg2).
-  static int hash_kern(glyph *, glyph *);	// Return a hash code for
-			// the pair of glyphs (arg1 and arg2).
+  static unsigned hash_kern(int, int);	// Return a hash code for
+			// the pair of glyph indices (arg1 and arg2).
 
   /* Returns w * pointsize / unitwidth, rounded to the nearest integer.  */
   int scale(int w, int pointsize);
@@ -68,6 +68,13 @@ public:
   virtual void end_of_line();
   virtual void special(char *, const environment *, char = 'p');
   virtual void devtag(char *, const environment *, char = 'p');
+  // when rendering pages in parallel, take note of a device control
+  // command on, or the end of, a page rendered by another process
+  virtual void skip_special(char *, const environment *, char = 'p');
+  virtual void skip_page(int);
+  // when reading the input more than once, finish each reading but the
+  // last
+  virtual void end_pass();
 
 protected:
   font_pointer_list *font_list;
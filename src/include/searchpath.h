@@ -17,9 +17,15 @@ for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+// A function of this type can be registered to observe the path name
+// of every file that a search path tries to open for reading, and
+// whether it succeeded.
+typedef void (*SEARCH_PATH_OPEN_HANDLER)(const char *, bool);
+
 class search_path {
   char *dirs;
   unsigned init_len; // TODO: size_t
+  static SEARCH_PATH_OPEN_HANDLER open_handler;
 public:
   // TODO: Boolify 3rd and 4th arguments.
   search_path(const char *envvar, const char *standard,
@@ -29,6 +35,9 @@ public:
   FILE *open_file(const char *, char **);
   FILE *open_file_cautiously(const char *, char ** = 0 /* nullptr */,
 			     const char * = 0 /* nullptr */);
+  // Register arg1 as the open handler; return the previous one.
+  static SEARCH_PATH_OPEN_HANDLER
+    set_open_handler(SEARCH_PATH_OPEN_HANDLER);
 };
 
 // Local Variables:
@@ -0,0 +1,66 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+// Flat images of program state.
+//
+// A `snapshot_writer` accumulates integers, strings, and raw bytes in
+// host byte order; a `snapshot_reader` reads them back, in the same
+// order, from an image in memory such as a mapped file.  Images are
+// not portable between hosts or groff versions; the programs writing
+// them are expected to record enough in them to tell.
+//
+// A reader checks every access against the end of its image.  Once a
+// read runs past it, or a caller calls `invalidate()`, `is_valid()`
+// returns false and all further reads yield zeroes and null pointers,
+// so callers need test validity only where convenient.
+
+class snapshot_writer {
+  string buf;
+public:
+  void put_int(int);
+  void put_double(double);
+  void put_string(const char *); // null pointer permitted
+  void put_bytes(const void *, size_t);
+  void align(size_t);		// pad to a multiple of the argument
+  size_t length() const { return buf.length(); }
+  const char *contents() const { return buf.contents(); }
+};
+
+class snapshot_reader {
+  const char *start;
+  const char *ptr;
+  const char *end;
+  bool is_ok;
+public:
+  snapshot_reader(const char *, size_t);
+  int get_int();
+  // Read an element count, rejecting it if the rest of the image
+  // couldn't hold that many elements of the given size.
+  int get_count(size_t = 1);
+  double get_double();
+  const char *get_string(); // null pointer if so written
+  const void *get_bytes(size_t);
+  void align(size_t);		// skip the writer's padding
+  bool is_valid() const { return is_ok; }
+  void invalidate() { is_ok = false; }
+};
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
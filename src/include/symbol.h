@@ -18,23 +18,22 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <stddef.h> // size_t
-#include <stdint.h> // uintptr_t
 #include <string.h> // strchr()
 
-#define DONT_STORE 1
 #define MUST_ALREADY_EXIST 2
 
 class symbol {
-  static const char **table;
-  static int table_occupancy; // # of entries in use
-  static int table_size;
+  struct table_entry;
+  static table_entry *table;
+  static unsigned int table_occupancy; // # of entries in use
+  static unsigned int table_size; // a power of 2
   static char *block;
   static size_t block_size;
   const char *s;
 public:
   symbol(const char * /* p */, int /* how */ = 0);
   symbol();
-  uintptr_t hash() const;
+  unsigned int hash() const;
   int operator ==(symbol) const;
   int operator !=(symbol) const;
   const char *contents() const;
@@ -64,9 +63,12 @@ inline int symbol::operator!=(symbol p) const
   return s != p.s;
 }
 
-inline uintptr_t symbol::hash() const
+// A symbol's hash code is stored immediately before its contents.
+inline unsigned int symbol::hash() const
 {
-  return reinterpret_cast<uintptr_t>(s);
+  if (0 /* nullptr */ == s)
+    return 0;
+  return reinterpret_cast<const unsigned int *>(s)[-1];
 }
 
 inline const char *symbol::contents() const
@@ -237,20 +237,34 @@ with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ctype.h> // isdigit()
 #include <errno.h>
-#include <stdio.h> // EOF, FILE, fclose(), fopen(), getc(), stdin,
-		   // ungetc()
-#include <stdlib.h> // strtol()
-#include <string.h> // strcmp(), strlen(), strncmp(), strncpy()
+#include <limits.h> // UCHAR_MAX
+#include <stdio.h> // EOF, FILE, fclose(), fopen(), fread(), stdin
+#include <stdlib.h> // atexit(), strtol()
+#include <string.h> // memcpy(), strchr(), strcmp(), strcpy(),
+			// strlen(), strncmp(), strncpy()
 
 // libgroff
 #include "symbol.h" // prerequisite of color.h
 #include "color.h"
 #include "device.h"
+#include "binary-output.h"
+#include "lib.h" // strsave(), xtmptemplate()
 
 // libdriver
-#include "driver.h" // interpret_troff_output_file()
+#include "driver.h" // input_passes, interpret_troff_output_file(),
+		    // page_jobs
 #include "printer.h" // environment, printer
 
+// operating system services
+// needed for close(), dup(), dup2(), fork(), lseek(), open(), read(),
+// stat(), unlink(), waitpid(), write(); NULL_DEV
+#include "posix.h"
+#include "nonposix.h"
+
+#ifdef _POSIX_VERSION
+#include <sys/wait.h> // WEXITSTATUS(), WIFEXITED(), waitpid()
+#endif
+
 
 /**********************************************************************
                            local types
@@ -283,6 +297,11 @@ public:
   void append(IntArg);
   IntArg *get_data(void) const { return (IntArg *)data; }
   size_t len(void) const { return num_stored; }
+  void truncate(const size_t n)	// keep only the first n values
+  {
+    if (n < num_stored)
+      num_stored = n;
+  }
 };
 
 // Characters read from the input queue.
@@ -303,22 +322,42 @@ public:
   operator char() const { return (char) data; }
 };
 
-// Buffer for string arguments (Char, not char).
+// Buffer for string arguments, reused from one argument to the next.
 class StringBuf {
   size_t num_allocated;
   size_t num_stored;
-  Char *data;			// not terminated by '\0'
+  char *data;			// not terminated by '\0'
 public:
   StringBuf(void);		// allocate without storing
   ~StringBuf(void);
   void append(const Char);	// append character to 'data'
-  char *make_string(void);	// return new copy of 'data' with '\0'
+  void append(const char *, size_t);
+				// append characters to 'data'
+  char *contents(void);		// 'data', terminated by '\0'
   bool is_empty(void) {		// true if none stored
     return (num_stored > 0) ? false : true;
   }
   void reset(void);		// set 'num_stored' to 0
 };
 
+// Array of strings allocated by 'new', owned by the array.
+class StringArray {
+  size_t num_allocated;
+  size_t num_stored;
+  char **data;
+public:
+  StringArray(void);
+  ~StringArray(void);
+  const char *operator[](const size_t i) const
+  {
+    if (i >= num_stored)
+      fatal("index out of range");
+    return data[i];
+  }
+  void append(char *);		// take ownership of the string
+  size_t len(void) const { return num_stored; }
+};
+
 #ifdef USE_ENV_STACK
 class EnvStack {
   environment **data;
@@ -361,10 +400,68 @@ printer *pr;
 
 FILE *current_file = 0;		// current input stream for parser
 
+// input_buf: block of current_file being parsed; its first byte keeps
+//            the last character of the previous block, so that it can
+//            be restored onto the input queue.
+// input_ptr: next character to be read from input_buf
+// input_end: end of the characters read into input_buf
+const size_t
+INPUT_BUF_SIZE = 65536;
+char input_buf[1 + INPUT_BUF_SIZE];
+char *input_ptr = input_buf + 1;
+char *input_end = input_buf + 1;
+
 // npages: number of pages processed so far (including current page),
 //         _not_ the page number in the printout (can be set with 'p').
 int npages = 0;
 
+// is_binary_input: set by 'x binary'; enables the binary commands
+//                  described in binary-output.h.
+// glyph_names: special character names interned by binary commands
+bool is_binary_input = false;
+StringArray *glyph_names = 0;
+
+// page_jobs: number of processes rendering the pages of each file;
+//             see interpret_pages_in_parallel().
+// page_worker: in such a process, its number, counting from 0;
+//              otherwise -1.
+// is_rendering: false while a page worker passes over a page that
+//               another one renders; see select_page_worker().
+// worker_stderr_fd: temporary file for diagnostics of a page worker
+// worker_index_fd: temporary file where a page worker records the
+//                  extent of its output for each page it renders
+// null_fd: null device, receiving the diagnostics of pages passed over
+// skipped_width: the widths of the ordinary characters in the font and
+//                size recorded in skipped_width_fontno and
+//                skipped_width_size, looked up on pages passed over
+// is_skipped_width_known: whether each element of skipped_width has
+//                         been looked up; all false after a font is
+//                         mounted
+// spooled_input: the temporary copy of an input file that could be
+//                read only once, to be read instead; otherwise null
+// input_passes: number of times each input file is read; see
+//               interpret_in_passes().
+// input_pass: the current reading of the input, counting from 1, when
+//             there are several; otherwise 0
+int page_jobs = 1;
+int page_worker = -1;
+bool is_rendering = true;
+int worker_stderr_fd = -1;
+int worker_index_fd = -1;
+int null_fd = -1;
+EnvInt skipped_width[UCHAR_MAX + 1];
+bool is_skipped_width_known[UCHAR_MAX + 1];
+EnvInt skipped_width_fontno = -1;
+EnvInt skipped_width_size = -1;
+const char *spooled_input = 0 /* nullptr */;
+int input_passes = 1;
+int input_pass = 0;
+
+// string_arg: holds the latest string argument; see get_string_arg().
+// D_args: holds the integer arguments of the latest D command.
+StringBuf string_arg;
+IntArray D_args;
+
 const ColorArg
 COLORARG_MAX = (ColorArg) 65536U; // == 0xFFFF + 1 == 0x10000
 
@@ -390,21 +487,29 @@ ColorArg color_from_Df_command(IntArg);
 				// transform old color into new
 void delete_current_env(void);	// delete global var current_env
 void fatal_command(char);	// abort for invalid command
-inline Char get_char(void);	// read next character from input stream
+void finish_page(void);		// end the current page, if any
+void forget_skipped_widths(void);
+				// clear is_skipped_width_known
+inline Char get_char(void);	// read next character from input_buf
 ColorArg get_color_arg(void);	// read in argument for new color cmds
-IntArray *get_D_fixed_args(const size_t);
+const IntArray *get_D_fixed_args(const size_t);
 				// read in fixed number of integer
 				// arguments
-IntArray *get_D_fixed_args_odd_dummy(const size_t);
+const IntArray *get_D_fixed_args_odd_dummy(const size_t);
 				// read in a fixed number of integer
 				// arguments plus optional dummy
-IntArray *get_D_variable_args(void);
+const IntArray *get_D_variable_args(void);
                                 // variable, even number of int args
+char *get_counted_string_arg(void);
+				// length-prefixed binary string argument
+bool get_digits(Char &, IntArg &);
+				// accumulate decimal digits
 char *get_extended_arg(void);	// argument for 'x X' (several lines)
 IntArg get_integer_arg(void);	// read in next integer argument
-IntArray *get_possibly_integer_args();
+void get_possibly_integer_args(IntArray &);
 				// 0 or more integer arguments
 char *get_string_arg(void);	// read in next string arg, ended by WS
+IntArg get_varint_arg(void);	// binary integer argument
 inline bool is_space_or_tab(const Char);
 				// test on space/tab char
 Char next_arg_begin(void);	// skip whitespace on current line
@@ -412,12 +517,18 @@ Char next_command(void);	// go to next command, evt. diff. line
 inline bool odd(const int);	// test if integer is odd
 void position_to_end_of_args(const IntArray * const);
 				// positioning after drawing
+Char read_input_block(void);	// refill input_buf from current_file
 void remember_filename(const char *);
 				// set global current_filename
 void remember_source_filename(const char *);
 				// set global current_source_filename
 void send_draw(const Char, const IntArray * const);
 				// call pr->draw
+void send_special(char *, const char);
+				// call pr->special or pr->devtag
+EnvInt set_ascii_char_width(const unsigned char);
+				// print character, return its width
+void set_word(const EnvInt);	// print word of 't' and 'u' commands
 void skip_line(void);		// unconditionally skip to next line
 bool skip_line_checked(void);	// skip line, false if args are left
 void skip_line_fatal(void);	// skip line, fatal if args are left
@@ -425,15 +536,37 @@ void skip_line_warn(void);	// skip line, warn if args are left
 void skip_line_D(void);		// skip line in D commands
 void skip_line_x(void);		// skip line in x commands
 void skip_to_end_of_line(void);	// skip to the end of the current line
+void start_page(const IntArg);	// begin a new page
 inline void unget_char(const Char);
 				// restore character onto input
 
 // parser subcommands
+void parse_binary_command(Char);
+				// commands encoded in binary
 void parse_color_command(color *);
 				// color sub(sub)commands m and DF
 void parse_D_command(void);	// graphical subcommands
 bool parse_x_command(void);	// device control commands
 
+// page-parallel rendering
+void copy_temporary_file(int, off_t, off_t, FILE *);
+				// copy part of a worker's output
+void interpret_pages_in_parallel(const char *);
+				// render a file in several processes
+int make_temporary_file(void);	// create anonymous temporary file
+void record_page_output(void);	// note end of page worker's output
+void run_page_worker(const int, const char *, const int, const int,
+		     const int);
+				// render a share of a file's pages
+void select_page_worker(void);	// render or pass over current page
+
+// reading the input in several passes
+void interpret_in_passes(const char *);
+				// read a file input_passes times
+void remove_spooled_input(void);	// unlink spooled_input on exit
+char *spool_input(const char *);
+				// copy a pipe to a temporary file
+
 
 /**********************************************************************
                          class methods
@@ -535,11 +668,40 @@ IntArray::append(IntArg x)
   num_stored++;
 }
 
+StringArray::StringArray(void)
+{
+  num_allocated = 16;
+  data = new char *[num_allocated];
+  num_stored = 0;
+}
+
+StringArray::~StringArray(void)
+{
+  for (size_t i = 0; i < num_stored; i++)
+    delete[] data[i];
+  delete[] data;
+}
+
+void
+StringArray::append(char *s)
+{
+  if (num_stored >= num_allocated) {
+    char **old_data = data;
+    num_allocated *= 2;
+    data = new char *[num_allocated];
+    for (size_t i = 0; i < num_stored; i++)
+      data[i] = old_data[i];
+    delete[] old_data;
+  }
+  data[num_stored] = s;
+  num_stored++;
+}
+
 StringBuf::StringBuf(void)
 {
   num_stored = 0;
   num_allocated = 128;
-  data = new Char[num_allocated];
+  data = new char[num_allocated];
 }
 
 StringBuf::~StringBuf(void)
@@ -551,25 +713,38 @@ void
 StringBuf::append(const Char c)
 {
   if (num_stored >= num_allocated) {
-    Char *old_data = data;
+    char *old_data = data;
     num_allocated *= 2;
-    data = new Char[num_allocated];
+    data = new char[num_allocated];
     for (size_t i = 0; i < num_stored; i++)
       data[i] = old_data[i];
     delete[] old_data;
   }
-  data[num_stored] = c;
+  data[num_stored] = (char) c;
   num_stored++;
 }
 
+void
+StringBuf::append(const char *s, size_t n)
+{
+  if (num_stored + n > num_allocated) {
+    char *old_data = data;
+    while (num_stored + n > num_allocated)
+      num_allocated *= 2;
+    data = new char[num_allocated];
+    memcpy(data, old_data, num_stored);
+    delete[] old_data;
+  }
+  memcpy(data + num_stored, s, n);
+  num_stored += n;
+}
+
 char *
-StringBuf::make_string(void)
+StringBuf::contents(void)
 {
-  char *result = new char[num_stored + 1];
-  for (size_t i = 0; i < num_stored; i++)
-    result[i] = (char) data[i];
-  result[num_stored] = '\0';
-  return result;
+  append('\0');
+  num_stored--;
+  return data;
 }
 
 void
@@ -623,6 +798,37 @@ fatal_command(char command)
   fatal("'%1' command invalid before first 'p' command", command);
 }
 
+//////////////////////////////////////////////////////////////////////
+/*
+   End the current page, if any.
+
+   The printer outputs the page, unless this is a page worker that
+   passes over it (see select_page_worker()).
+*/
+void
+finish_page(void)
+{
+  if (npages <= 0)
+    return;
+  if (is_rendering)
+    pr->end_page(current_env->vpos);
+  else
+    pr->skip_page(current_env->vpos);
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Forget the widths looked up on pages passed over, because a font
+   has been mounted or a file begins.
+*/
+void
+forget_skipped_widths(void)
+{
+  for (int i = 0; i <= UCHAR_MAX; i++)
+    is_skipped_width_known[i] = false;
+  skipped_width_fontno = -1;
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Retrieve the next character from the input queue.
@@ -632,7 +838,9 @@ fatal_command(char command)
 inline Char
 get_char(void)
 {
-  return (Char) getc(current_file);
+  if (input_ptr < input_end)
+    return (Char) (unsigned char) *input_ptr++;
+  return read_input_block();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -652,6 +860,30 @@ get_color_arg(void)
   return (ColorArg) x;
 }
 
+//////////////////////////////////////////////////////////////////////
+/*
+   Retrieve a string argument of a binary command: its length as a
+   binary integer, followed by that many bytes.
+
+   Return: Retrieved string, valid until the next string argument is
+           read (see get_string_arg()).
+*/
+char *
+get_counted_string_arg(void)
+{
+  IntArg len = get_varint_arg();
+  if (len < 0)
+    fatal("invalid string length in binary command");
+  string_arg.reset();
+  for (IntArg i = 0; i < len; i++) {
+    int c = (int) get_char();
+    if (EOF == c)
+      fatal("unexpected end of input in binary command");
+    string_arg.append((Char) c);
+  }
+  return string_arg.contents();
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Get a fixed number of integer arguments for D commands.
@@ -665,18 +897,18 @@ get_color_arg(void)
            pairs of parameters for 'D' extensions added by groff.
            Default is 'false'.
 
-   Return: New IntArray containing the arguments.
+   Return: D_args, containing the arguments.
 */
-IntArray *
+const IntArray *
 get_D_fixed_args(const size_t number)
 {
   if (number <= 0)
     fatal("requested number of arguments must be > 0");
-  IntArray *args = new IntArray(number);
+  D_args.truncate(0);
   for (size_t i = 0; i < number; i++)
-    args->append(get_integer_arg());
+    D_args.append(get_integer_arg());
   skip_line_D();
-  return args;
+  return &D_args;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -691,24 +923,24 @@ get_D_fixed_args(const size_t number)
 
    number: In-parameter, the number of arguments to be retrieved.
 
-   Return: New IntArray containing the arguments.
+   Return: D_args, containing the arguments without the dummy.
 */
-IntArray *
+const IntArray *
 get_D_fixed_args_odd_dummy(const size_t number)
 {
   if (number <= 0)
     fatal("requested number of arguments must be > 0");
-  IntArray *args = new IntArray(number);
+  D_args.truncate(0);
   for (size_t i = 0; i < number; i++)
-    args->append(get_integer_arg());
+    D_args.append(get_integer_arg());
   if (odd(number)) {
-    IntArray *a = get_possibly_integer_args();
-    if (a->len() > 1)
+    get_possibly_integer_args(D_args);
+    if (D_args.len() > number + 1)
       error("too many arguments");
-    delete a;
+    D_args.truncate(number);
   }
   skip_line_D();
-  return args;
+  return &D_args;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -723,19 +955,53 @@ get_D_fixed_args_odd_dummy(const size_t number)
    - Error on non-digit characters different from these.
    - A final line skip is performed (except for EOF).
 
-   Return: New IntArray of the retrieved arguments.
+   Return: D_args, containing the retrieved arguments.
 */
-IntArray *
+const IntArray *
 get_D_variable_args()
 {
-  IntArray *args = get_possibly_integer_args();
-  size_t n = args->len();
+  D_args.truncate(0);
+  get_possibly_integer_args(D_args);
+  size_t n = D_args.len();
   if (n <= 0)
     error("no arguments found");
   if (odd(n))
     error("even number of arguments expected");
   skip_line_D();
-  return args;
+  return &D_args;
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Accumulate a sequence of decimal digits into an integer.
+
+   The digits are read without being copied anywhere; the value is
+   built up as they arrive.  Digits beyond the range of IntArg are
+   consumed all the same.
+
+   c: In-out-parameter; the first digit on entry, the first character
+      after the digits on return.
+   number: Out-parameter, the value of the digits, or 0 on overflow.
+
+   Return: false if the value exceeds INTARG_MAX, true otherwise.
+*/
+bool
+get_digits(Char &c, IntArg &number)
+{
+  bool is_in_range = true;
+  IntArg n = 0;
+  while (isdigit((int) c)) {
+    int digit = (int) c - '0';
+    if (is_in_range) {
+      if (n > (INTARG_MAX - digit) / 10)
+	is_in_range = false;
+      else
+	n = n * 10 + digit;
+    }
+    c = get_char();
+  }
+  number = is_in_range ? n : 0;
+  return is_in_range;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -748,12 +1014,14 @@ get_D_variable_args()
      as well, with the '+' replaced by a newline.
    - Final line skip is always performed.
 
-   Return: Allocated (new) string of retrieved text argument.
+   Return: Retrieved string, valid until the next string argument is
+           read (see get_string_arg()).
 */
 char *
 get_extended_arg(void)
 {
-  StringBuf buf = StringBuf();
+  StringBuf &buf = string_arg;
+  buf.reset();
   Char c = next_arg_begin();
   while ((int) c != EOF) {
     if ((int) c == '\n') {
@@ -770,7 +1038,7 @@ get_extended_arg(void)
       buf.append(c);
     c = get_char();
   }
-  return buf.make_string();
+  return buf.contents();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -787,30 +1055,21 @@ get_extended_arg(void)
 IntArg
 get_integer_arg(void)
 {
-  StringBuf buf = StringBuf();
+  bool is_negative = false;
   Char c = next_arg_begin();
   if ((int) c == '-') {
-    buf.append(c);
+    is_negative = true;
     c = get_char();
   }
   if (!isdigit((int) c))
     fatal("integer argument expected");
-  while (isdigit((int) c)) {
-    buf.append(c);
-    c = get_char();
-  }
+  IntArg number;
+  bool is_in_range = get_digits(c, number);
   // c is not a digit
   unget_char(c);
-  char *s = buf.make_string();
-  errno = 0;
-  long int number = strtol(s, 0, 10);
-  if (errno != 0
-      || number > INTARG_MAX || number < -INTARG_MAX) {
+  if (!is_in_range)
     error("integer argument too large");
-    number = 0;
-  }
-  delete[] s;
-  return (IntArg) number;
+  return is_negative ? -number : number;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -825,43 +1084,31 @@ get_integer_arg(void)
    - Error on non-digit characters different from these.
    - No line skip is performed.
 
-   Return: New IntArray of the retrieved arguments.
+   args: In-out-parameter, the retrieved arguments are appended to it.
 */
-IntArray *
-get_possibly_integer_args()
+void
+get_possibly_integer_args(IntArray &args)
 {
   bool done = false;
-  StringBuf buf = StringBuf();
   Char c = get_char();
-  IntArray *args = new IntArray();
   while (!done) {
-    buf.reset();
+    bool is_negative = false;
     while (is_space_or_tab(c))
       c = get_char();
     if (c == '-') {
       Char c1 = get_char();
       if (isdigit((int) c1)) {
-	buf.append(c);
+	is_negative = true;
 	c = c1;
       }
       else
 	unget_char(c1);
     }
-    while (isdigit((int) c)) {
-      buf.append(c);
-      c = get_char();
-    }
-    if (!buf.is_empty()) {
-      char *s = buf.make_string();
-      errno = 0;
-      long int x = strtol(s, 0, 10);
-      if (errno
-	  || x > INTARG_MAX || x < -INTARG_MAX) {
+    if (isdigit((int) c)) {
+      IntArg x;
+      if (!get_digits(c, x))
 	error("invalid integer argument, set to 0");
-	x = 0;
-      }
-      args->append((IntArg) x);
-      delete[] s;
+      args.append(is_negative ? -x : x);
     }
     // Here, c is not a digit.
     // Terminate on comment, end of line, or end of file, while
@@ -887,7 +1134,6 @@ get_possibly_integer_args()
       break;
     }
   }
-  return args;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -900,20 +1146,59 @@ get_possibly_integer_args()
    - The terminating space, tab, newline, or EOF character is restored
      onto the input queue, so no line skip.
 
-   Return: Retrieved string as char *, allocated by 'new'.
+   Return: Retrieved string as char *, held in string_arg.  It stays
+           valid until the next string argument is read, so a caller
+           keeping it must copy it.
 */
 char *
 get_string_arg(void)
 {
-  StringBuf buf = StringBuf();
+  string_arg.reset();
   Char c = next_arg_begin();
+  if (!is_space_or_tab(c) && c != Char('\n') && c != Char(EOF)) {
+    // Copy the part of the argument that is in input_buf at once.
+    char *start = input_ptr - 1;
+    char *p = input_ptr;
+    while (p < input_end && *p != ' ' && *p != '\t' && *p != '\n')
+      p++;
+    string_arg.append(start, p - start);
+    input_ptr = p;
+    c = get_char();
+  }
   while (!is_space_or_tab(c)
 	 && c != Char('\n') && c != Char(EOF)) {
-    buf.append(c);
+    string_arg.append(c);
     c = get_char();
   }
   unget_char(c);		// restore whitespace
-  return buf.make_string();
+  return string_arg.contents();
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Retrieve an integer argument of a binary command.
+
+   The integer is zigzag-encoded and stored 7 bits per byte, least
+   significant group first; all bytes but the last have their high bit
+   set.
+
+   Return: Retrieved integer.
+*/
+IntArg
+get_varint_arg(void)
+{
+  unsigned int u = 0;
+  for (int shift = 0; ; shift += 7) {
+    int c = (int) get_char();
+    if (EOF == c)
+      fatal("unexpected end of input in binary command");
+    if (shift > 28)
+      fatal("integer argument too large");
+    u |= (unsigned int) (c & 0x7f) << shift;
+    if (!(c & 0x80))
+      break;
+  }
+  return (IntArg) ((u >> 1) ^ (0U - (u & 1)));
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1024,6 +1309,29 @@ position_to_end_of_args(const IntArray * const args)
     current_env->vpos += (*args)[i];
 }
 
+//////////////////////////////////////////////////////////////////////
+/*
+   Read the next block of current_file into input_buf.
+
+   The last character of the previous block is kept in front of the
+   new one, so that it can still be restored onto the input queue.
+
+   Return: The first character of the new block, or EOF if none is
+           left.
+*/
+Char
+read_input_block(void)
+{
+  if (input_end > input_buf + 1)
+    input_buf[0] = input_end[-1];
+  size_t n = fread(input_buf + 1, 1, INPUT_BUF_SIZE, current_file);
+  input_ptr = input_buf + 1;
+  input_end = input_ptr + n;
+  if (0 == n)
+    return (Char) EOF;
+  return (Char) (unsigned char) *input_ptr++;
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Set global variable current_filename.
@@ -1086,10 +1394,97 @@ remember_source_filename(const char *filename)
 void
 send_draw(const Char subcmd, const IntArray * const args)
 {
+  if (!is_rendering)
+    return;
   EnvInt n = (EnvInt) args->len();
   pr->draw((int) subcmd, (IntArg *)args->get_data(), n, current_env);
 }
 
+//////////////////////////////////////////////////////////////////////
+/*
+   Call special or devtag method of printer class.
+
+   On a page passed over by a page worker, call its skip_special method
+   instead.
+
+   arg: In-parameter, the argument of the device control command.
+   type: In-parameter, 'p' for 'x X', 'u' for 'x u'.
+*/
+void
+send_special(char *arg, const char type)
+{
+  if (!is_rendering)
+    pr->skip_special(arg, current_env, type);
+  else if (('p' == type)
+	   && (strncmp(arg, "devtag:", strlen("devtag:")) == 0))
+    pr->devtag(arg, current_env);
+  else
+    pr->special(arg, current_env, type);
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Print an ordinary character and return its width.
+
+   On a page passed over by a page worker, the character is not
+   printed, but its width is still needed to keep track of the
+   horizontal position.  It is looked up once for each font and size
+   in turn and then kept in skipped_width, so that passing over a page
+   costs little more than reading it.
+
+   c: In-parameter, the character to be printed.
+
+   Return: The width of the character, 0 if the font lacks it.
+*/
+EnvInt
+set_ascii_char_width(const unsigned char c)
+{
+  EnvInt w = 0;
+  if (is_rendering)
+    pr->set_ascii_char(c, current_env, &w);
+  else {
+    if ((current_env->fontno != skipped_width_fontno)
+	|| (current_env->size != skipped_width_size)) {
+      forget_skipped_widths();
+      skipped_width_fontno = current_env->fontno;
+      skipped_width_size = current_env->size;
+    }
+    if (is_skipped_width_known[c])
+      return skipped_width[c];
+    char buf[2];
+    font *f;
+    buf[0] = (char) c;
+    buf[1] = '\0';
+    (void) pr->set_char_and_width(buf, current_env, &w, &f);
+    skipped_width[c] = w;
+    is_skipped_width_known[c] = true;
+  }
+  return w;
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Print the word argument of a 't' or 'u' command.
+
+   The word is scanned like a string argument (see get_string_arg()),
+   but each character is handed to the printer as soon as it is read;
+   the word is never stored.  After each character, the horizontal
+   position is advanced by its width plus kern.
+
+   kern: In-parameter, the extra space after each character.
+*/
+void
+set_word(const EnvInt kern)
+{
+  Char c = next_arg_begin();
+  while (!is_space_or_tab(c)
+	 && c != Char('\n') && c != Char(EOF)) {
+    current_env->hpos += set_ascii_char_width((unsigned char) c) + kern;
+    c = get_char();
+  }
+  unget_char(c);		// restore whitespace
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Go to next line within the input queue.
@@ -1238,6 +1633,25 @@ skip_to_end_of_line(void)
   }
 }
 
+//////////////////////////////////////////////////////////////////////
+/*
+   Begin a new page.
+
+   In a page worker, first decide whether this process renders it.
+
+   number: In-parameter, the page number to be printed.
+*/
+void
+start_page(const IntArg number)
+{
+  npages++;			// increment # of processed pages
+  if (page_worker >= 0)
+    select_page_worker();
+  if (is_rendering)
+    pr->begin_page(number);
+  current_env->vpos = 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Restore character c onto input queue.
@@ -1251,9 +1665,9 @@ inline void
 unget_char(const Char c)
 {
   if (c != EOF) {
-    int ch = (int) c;
-    if (ungetc(ch, current_file) == EOF)
+    if (input_ptr <= input_buf)
       fatal("could not unget character");
+    *--input_ptr = (char) c;
   }
 }
 
@@ -1262,6 +1676,132 @@ unget_char(const Char c)
                        parser subcommands
  **********************************************************************/
 
+//////////////////////////////////////////////////////////////////////
+/*
+   Process a command encoded in binary (see binary-output.h).
+
+   The effect of each command is that of the text command whose letter
+   is the opcode without its high bit.  Binary commands don't occupy
+   lines, so no line skip is done.
+
+   opcode: In-parameter, the first byte of the command.
+*/
+void
+parse_binary_command(Char opcode)
+{
+  char command = (char) ((int) opcode & 0x7f);
+  // Like their text counterparts, most commands need a page.
+  if (npages <= 0 && strchr("fpswX", command) == 0)
+    fatal_command(command);
+  switch ((int) opcode) {
+  case BINARY_HMOTION_CHAR:	// like ddc
+    {
+      current_env->hpos += (EnvInt) get_varint_arg();
+      int c = (int) get_char();
+      if (EOF == c)
+	fatal("unexpected end of input in binary command");
+      if (is_rendering)
+	pr->set_ascii_char((unsigned char) c, current_env);
+      break;
+    }
+  case BINARY_C:		// C, by interned index
+    {
+      IntArg n = get_varint_arg();
+      if (n < 0 || (size_t) n >= glyph_names->len())
+	fatal("invalid glyph index %1 in binary command", n);
+      if (is_rendering)
+	pr->set_special_char((*glyph_names)[n], current_env);
+      break;
+    }
+  case BINARY_GLYPH_DEFINE:	// C, interning the name
+    {
+      char *arg = get_counted_string_arg();
+      char *name = new char[strlen(arg) + 1];
+      strcpy(name, arg);
+      glyph_names->append(name);
+      if (is_rendering)
+	pr->set_special_char(name, current_env);
+      break;
+    }
+  case BINARY_H:
+    current_env->hpos = (EnvInt) get_varint_arg();
+    break;
+  case BINARY_N:
+    {
+      IntArg n = get_varint_arg();
+      if (is_rendering)
+	pr->set_numbered_char(n, current_env);
+      break;
+    }
+  case BINARY_V:
+    current_env->vpos = (EnvInt) get_varint_arg();
+    break;
+  case BINARY_X:		// x X
+    {
+      char *str_arg = get_counted_string_arg();
+      if (npages <= 0)
+	error("'x X' command invalid before first 'p' command");
+      else
+	send_special(str_arg, 'p');
+      break;
+    }
+  case BINARY_c:
+    {
+      int c = (int) get_char();
+      if (EOF == c)
+	fatal("unexpected end of input in binary command");
+      if (is_rendering)
+	pr->set_ascii_char((unsigned char) c, current_env);
+      break;
+    }
+  case BINARY_f:
+    current_env->fontno = get_varint_arg();
+    break;
+  case BINARY_h:
+    current_env->hpos += (EnvInt) get_varint_arg();
+    break;
+  case BINARY_n:
+    if (is_rendering)
+      pr->end_of_line();
+    break;
+  case BINARY_p:
+    finish_page();
+    start_page(get_varint_arg());
+    break;
+  case BINARY_s:
+    current_env->size = get_varint_arg();
+    if (current_env->height == current_env->size)
+      current_env->height = 0;
+    break;
+  case BINARY_t:
+  case BINARY_u:
+    {
+      EnvInt kern = 0;
+      if (BINARY_u == (int) opcode)
+	kern = (EnvInt) get_varint_arg();
+      IntArg len = get_varint_arg();
+      if (len < 0)
+	fatal("invalid string length in binary command");
+      // Set the characters as they are read.
+      for (IntArg i = 0; i < len; i++) {
+	int c = (int) get_char();
+	if (EOF == c)
+	  fatal("unexpected end of input in binary command");
+	current_env->hpos += set_ascii_char_width((unsigned char) c)
+			     + kern;
+      }
+      break;
+    }
+  case BINARY_v:
+    current_env->vpos += (EnvInt) get_varint_arg();
+    break;
+  case BINARY_w:
+    break;
+  default:
+    fatal("unrecognized binary command %1", (int) opcode);
+  }
+}
+
 //////////////////////////////////////////////////////////////////////
 /*
    Process the commands m and DF, but not Df.
@@ -1328,46 +1868,41 @@ parse_D_command()
     // fall through
   default:			// unknown options are passed to device
     {
-      IntArray *args = get_D_variable_args();
+      const IntArray *args = get_D_variable_args();
       send_draw(subcmd, args);
       position_to_end_of_args(args);
-      delete args;
       break;
     }
   case 'a':			// Da: draw arc
     {
-      IntArray *args = get_D_fixed_args(4);
+      const IntArray *args = get_D_fixed_args(4);
       send_draw(subcmd, args);
       position_to_end_of_args(args);
-      delete args;
       break;
     }
   case 'c':			// Dc: draw circle line
     {
-      IntArray *args = get_D_fixed_args(1);
+      const IntArray *args = get_D_fixed_args(1);
       send_draw(subcmd, args);
       // move to right end
       current_env->hpos += (*args)[0];
-      delete args;
       break;
     }
   case 'C':			// DC: draw solid circle
     {
-      IntArray *args = get_D_fixed_args_odd_dummy(1);
+      const IntArray *args = get_D_fixed_args_odd_dummy(1);
       send_draw(subcmd, args);
       // move to right end
       current_env->hpos += (*args)[0];
-      delete args;
       break;
     }
   case 'e':			// De: draw ellipse line
   case 'E':			// DE: draw solid ellipse
     {
-      IntArray *args = get_D_fixed_args(2);
+      const IntArray *args = get_D_fixed_args(2);
       send_draw(subcmd, args);
       // move to right end
       current_env->hpos += (*args)[0];
-      delete args;
       break;
     }
   case 'f':			// Df: set fill gray; obsoleted by DFg
@@ -1383,7 +1918,8 @@ parse_D_command()
 	delete current_env->fill;
 	current_env->fill = new color(current_env->col);
       }
-      pr->change_fill_color(current_env);
+      if (is_rendering)
+	pr->change_fill_color(current_env);
       // skip unused 'vertical' component (\D'...' always emits pairs)
       (void) get_integer_arg();
 #   ifdef STUPID_DRAWING_POSITIONING
@@ -1394,39 +1930,37 @@ parse_D_command()
     }
   case 'F':			// DF: set fill color, several formats
     parse_color_command(current_env->fill);
-    pr->change_fill_color(current_env);
+    if (is_rendering)
+      pr->change_fill_color(current_env);
     // no positioning (setting-only command)
     skip_line_x();
     break;
   case 'l':			// Dl: draw line
     {
-      IntArray *args = get_D_fixed_args(2);
+      const IntArray *args = get_D_fixed_args(2);
       send_draw(subcmd, args);
       position_to_end_of_args(args);
-      delete args;
       break;
     }
   case 'p':			// Dp: draw closed polygon line
   case 'P':			// DP: draw solid closed polygon
     {
-      IntArray *args = get_D_variable_args();
+      const IntArray *args = get_D_variable_args();
       send_draw(subcmd, args);
 #   ifdef STUPID_DRAWING_POSITIONING
       // final args positioning
       position_to_end_of_args(args);
 #   endif
-      delete args;
       break;
     }
   case 't':			// Dt: set line thickness
     {
-      IntArray *args = get_D_fixed_args_odd_dummy(1);
+      const IntArray *args = get_D_fixed_args_odd_dummy(1);
       send_draw(subcmd, args);
 #   ifdef STUPID_DRAWING_POSITIONING
       // final args positioning
       position_to_end_of_args(args);
 #   endif
-      delete args;
       break;
     }
   } // end of D subcommands
@@ -1458,12 +1992,21 @@ parse_x_command(void)
   char *subcmd_str = get_string_arg();
   char subcmd = subcmd_str[0];
   switch (subcmd) {
+  case 'b':			// x binary: binary commands follow
+    {
+      IntArg version = get_integer_arg();
+      if (version != BINARY_OUTPUT_VERSION)
+	fatal("unsupported binary output version %1", version);
+      is_binary_input = true;
+      skip_line_x();
+      break;
+    }
   case 'f':			// x font: mount font
     {
       IntArg n = get_integer_arg();
       char *name = get_string_arg();
       pr->load_font(n, name);
-      delete[] name;
+      forget_skipped_widths();
       skip_line_x();
       break;
     }
@@ -1472,10 +2015,8 @@ parse_x_command(void)
       char *str_arg = get_extended_arg();
       if (str_arg == 0)
 	warning("empty argument for 'x F' command");
-      else {
+      else
 	remember_source_filename(str_arg);
-	delete[] str_arg;
-      }
       break;
     }
   case 'H':			// x Height: set character height
@@ -1513,8 +2054,7 @@ parse_x_command(void)
   case 'u':			// x underline: from .cu
     {
       char *str_arg = get_string_arg();
-      pr->special(str_arg, current_env, 'u');
-      delete[] str_arg;
+      send_special(str_arg, 'u');
       skip_line_x();
       break;
     }
@@ -1523,23 +2063,367 @@ parse_x_command(void)
       char *str_arg = get_extended_arg(); // includes line skip
       if (npages <= 0)
 	error("'x X' command invalid before first 'p' command");
-      else if (str_arg && (strncmp(str_arg, "devtag:",
-				   strlen("devtag:")) == 0))
-	pr->devtag(str_arg, current_env);
       else
-	pr->special(str_arg, current_env);
-      delete[] str_arg;
+	send_special(str_arg, 'p');
       break;
     }
   default:			// ignore unknown x commands, but warn
     warning("unknown command 'x %1'", subcmd);
     skip_line();
   }
-  delete[] subcmd_str;
   return stopped;
 }
 
 
+/**********************************************************************
+                       page-parallel rendering
+ **********************************************************************/
+
+/* With page_jobs greater than 1, the pages of each input file are
+   rendered by that many worker processes, forked by
+   interpret_pages_in_parallel().  Each worker parses the whole file,
+   thereby keeping track of the environment, the mounted fonts, and
+   the interned glyph names across page boundaries, but only renders
+   every page_jobs-th page, passing over the others (see
+   select_page_worker()).  Passing over a page still needs the width
+   of every character, to keep track of the horizontal position, but
+   set_ascii_char_width() keeps the widths it has looked up, so that
+   this costs little more than reading the page.
+
+   A worker's output and diagnostics go to temporary files, together
+   with an index of where each of its pages ends; the parent then
+   copies the pages to the standard output and the diagnostics to the
+   standard error, in order.
+
+   This only suits printers whose output for a page is self-contained,
+   depending on earlier pages at most through state they keep track of
+   in printer::skip_special() and printer::skip_page().
+*/
+
+#ifdef _POSIX_VERSION
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Copy part of a temporary file to a stream.
+
+   fd: In-parameter, the temporary file.
+   from: In-parameter, the offset of the first byte to be copied.
+   to: In-parameter, the offset after the last byte to be copied, or
+       -1 to copy up to the end of the file.
+   fp: In-parameter, the stream to write to.
+*/
+void
+copy_temporary_file(int fd, off_t from, off_t to, FILE *fp)
+{
+  char buf[BUFSIZ];
+  if (lseek(fd, from, SEEK_SET) < 0)
+    fatal("cannot seek in temporary file: %1", strerror(errno));
+  while ((to < 0) || (from < to)) {
+    size_t n = sizeof buf;
+    if ((to >= 0) && ((off_t) n > to - from))
+      n = (size_t) (to - from);
+    ssize_t nread = read(fd, buf, n);
+    if (nread < 0)
+      fatal("cannot read temporary file: %1", strerror(errno));
+    if (0 == nread)
+      break;
+    if (fwrite(buf, 1, (size_t) nread, fp) != (size_t) nread)
+      fatal("output error");
+    from += nread;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Create a temporary file that is removed as soon as it is closed.
+
+   Return: A file descriptor open for reading and writing.
+*/
+int
+make_temporary_file(void)
+{
+  char *templ = xtmptemplate("-pages", "p");
+  errno = 0;
+  int fd = mkstemp(templ);
+  if (fd < 0)
+    fatal("cannot create temporary file: %1", strerror(errno));
+  (void) unlink(templ);
+  delete[] templ;
+  return fd;
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Record in the index of a page worker where its output and
+   diagnostics for the pages rendered so far end.
+*/
+void
+record_page_output(void)
+{
+  off_t ends[2];
+  fflush(stdout);
+  fflush(stderr);
+  ends[0] = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+  ends[1] = lseek(STDERR_FILENO, 0, SEEK_CUR);
+  if ((ends[0] < 0) || (ends[1] < 0)
+      || (write(worker_index_fd, ends, sizeof ends)
+	  != (ssize_t) sizeof ends))
+    fatal("cannot record extent of page output: %1", strerror(errno));
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Render a share of the pages of a file; called in a page worker
+   process.  Never returns.
+
+   worker: In-parameter, the number of this page worker.
+   filename: In-parameter, the file to be interpreted.
+   out_fd, err_fd, index_fd: In-parameters, the temporary files for
+                             output, diagnostics, and index.
+*/
+void
+run_page_worker(const int worker, const char *filename,
+		const int out_fd, const int err_fd, const int index_fd)
+{
+  page_worker = worker;
+  worker_stderr_fd = err_fd;
+  worker_index_fd = index_fd;
+  if ((dup2(out_fd, STDOUT_FILENO) < 0)
+      || (dup2(null_fd, STDERR_FILENO) < 0))
+    fatal("cannot redirect output of page worker: %1",
+	  strerror(errno));
+  is_rendering = false;
+  select_page_worker();		// the prologue goes with page 1
+  interpret_troff_output_file(filename);
+  if (is_rendering)
+    record_page_output();
+  exit(EXIT_SUCCESS);
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   In a page worker, start or stop rendering as the current page
+   requires.
+
+   Page n (counting from 1) is rendered by worker (n - 1) % page_jobs;
+   anything before the first page goes with it.  While passing over a
+   page, the diagnostics are discarded: the worker that renders the
+   page issues them.  On stopping, the worker records where its output
+   for the page ends.
+*/
+void
+select_page_worker(void)
+{
+  int page = (npages > 0) ? (npages - 1) : 0;
+  bool is_mine = ((page % page_jobs) == page_worker);
+  if (is_mine == is_rendering)
+    return;
+  if (is_rendering)
+    record_page_output();
+  fflush(stderr);
+  if (dup2(is_mine ? worker_stderr_fd : null_fd, STDERR_FILENO) < 0)
+    fatal("cannot redirect diagnostics of page worker: %1",
+	  strerror(errno));
+  is_rendering = is_mine;
+}
+
+#endif // _POSIX_VERSION
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Interpret the output of a device-independent troff, rendering its
+   pages in page_jobs processes.
+
+   Standard input, or any other file that is not a regular file, is
+   first copied to a temporary file, so that each worker can read it.
+   If a worker fails, output stops where it failed, and this process
+   exits with the worker's status, as if it had failed itself.
+
+   filename: "-" for standard input, normal file name otherwise
+*/
+void
+interpret_pages_in_parallel(const char *filename)
+{
+#ifdef _POSIX_VERSION
+  struct page_worker_files {
+    pid_t pid;
+    int status;
+    int out_fd;
+    int err_fd;
+    int index_fd;
+    off_t out_pos;
+    off_t err_pos;
+  };
+  char *spool_name = spool_input(filename);
+  if (spool_name != 0 /* nullptr */)
+    spooled_input = spool_name;
+  null_fd = open(NULL_DEV, O_WRONLY);
+  if (null_fd < 0)
+    fatal("cannot open '%1': %2", NULL_DEV, strerror(errno));
+  page_worker_files *workers = new page_worker_files[page_jobs];
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 0; i < page_jobs; i++) {
+    page_worker_files &w = workers[i];
+    w.out_fd = make_temporary_file();
+    w.err_fd = make_temporary_file();
+    w.index_fd = make_temporary_file();
+    w.out_pos = 0;
+    w.err_pos = 0;
+    w.pid = fork();
+    if (w.pid < 0)
+      fatal("cannot fork: %1", strerror(errno));
+    if (0 == w.pid)
+      run_page_worker(i, filename, w.out_fd, w.err_fd, w.index_fd);
+  }
+  for (int i = 0; i < page_jobs; i++) {
+    int status;
+    while (waitpid(workers[i].pid, &status, 0) < 0)
+      if (errno != EINTR)
+	fatal("cannot wait for page worker: %1", strerror(errno));
+    workers[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+  }
+  if (spool_name != 0 /* nullptr */) {
+    (void) unlink(spool_name);
+    delete[] spool_name;
+    spooled_input = 0 /* nullptr */;
+  }
+  (void) close(null_fd);
+  null_fd = -1;
+  // Copy the pages in order.  Where a worker's index ends, the file
+  // ended or that worker failed; either way, nothing further was
+  // rendered in order.
+  int exit_status = 0;
+  for (int page = 0; ; page++) {
+    page_worker_files &w = workers[page % page_jobs];
+    off_t ends[2];
+    if (lseek(w.index_fd, (off_t) (page / page_jobs) * sizeof ends,
+	      SEEK_SET) < 0)
+      fatal("cannot seek in temporary file: %1", strerror(errno));
+    if (read(w.index_fd, ends, sizeof ends) != (ssize_t) sizeof ends) {
+      copy_temporary_file(w.out_fd, w.out_pos, -1, stdout);
+      copy_temporary_file(w.err_fd, w.err_pos, -1, stderr);
+      exit_status = w.status;
+      break;
+    }
+    copy_temporary_file(w.out_fd, w.out_pos, ends[0], stdout);
+    copy_temporary_file(w.err_fd, w.err_pos, ends[1], stderr);
+    w.out_pos = ends[0];
+    w.err_pos = ends[1];
+  }
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 0; i < page_jobs; i++) {
+    if (0 == exit_status)
+      exit_status = workers[i].status;
+    (void) close(workers[i].out_fd);
+    (void) close(workers[i].err_fd);
+    (void) close(workers[i].index_fd);
+  }
+  delete[] workers;
+  if (exit_status != 0)
+    exit(exit_status);
+#else
+  fatal("page-parallel rendering is not supported on this system");
+#endif
+}
+
+
+/**********************************************************************
+                    reading the input in passes
+ **********************************************************************/
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Interpret the output of a device-independent troff input_passes
+   times, for a printer that must have seen the whole document before
+   it can write the start of it.  At the end of each reading but the
+   last, the printer's end_pass() method is called.
+
+   Only the first reading reports problems short of fatal ones; the
+   others, reading the same input, would just repeat them.
+
+   filename: "-" for standard input, normal file name otherwise
+*/
+void
+interpret_in_passes(const char *filename)
+{
+  char *spool_name = spool_input(filename);
+  if (spool_name != 0 /* nullptr */)
+    spooled_input = spool_name;
+  for (input_pass = 1; input_pass <= input_passes; input_pass++) {
+    interpret_troff_output_file(filename);
+    if (0 /* nullptr */ == pr)	// done, or there was nothing to read
+      break;
+    want_fatal_diagnostics_only = true;
+  }
+  want_fatal_diagnostics_only = false;
+  if (spool_name != 0 /* nullptr */) {
+    (void) unlink(spool_name);
+    delete[] spool_name;
+    spooled_input = 0 /* nullptr */;
+  }
+  input_pass = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Remove the temporary copy of the input, if any, when exiting before
+   its reader could; but leave it to the parent of a page worker.
+*/
+void
+remove_spooled_input(void)
+{
+  if ((spooled_input != 0 /* nullptr */) && (page_worker < 0))
+    (void) unlink(spooled_input);
+}
+
+//////////////////////////////////////////////////////////////////////
+/*
+   Copy an input file that can be read only once, such as standard
+   input or a pipe, to a temporary file, so that it can be read again.
+
+   filename: "-" for standard input, normal file name otherwise
+
+   Return: The name of the temporary file, which the caller is to
+           unlink and delete[]; null if the file is a regular file or
+           cannot be opened.
+*/
+char *
+spool_input(const char *filename)
+{
+  struct stat st;
+  bool is_stdin = (filename[0] == '-' && filename[1] == '\0');
+  if (!is_stdin
+      && ((stat(filename, &st) != 0) || S_ISREG(st.st_mode)))
+    return 0 /* nullptr */;
+  FILE *in = is_stdin ? stdin : fopen(filename, "r");
+  if (0 /* nullptr */ == in)
+    return 0 /* nullptr */;
+  static bool is_removal_registered = false;
+  if (!is_removal_registered) {
+    (void) atexit(remove_spooled_input);
+    is_removal_registered = true;
+  }
+  char *spool_name = xtmptemplate("-input", "i");
+  errno = 0;
+  int fd = mkstemp(spool_name);
+  if (fd < 0)
+    fatal("cannot create temporary file: %1", strerror(errno));
+  char buf[BUFSIZ];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, in)) > 0)
+    if (write(fd, buf, n) != (ssize_t) n) {
+      (void) unlink(spool_name);
+      fatal("cannot write temporary file: %1", strerror(errno));
+    }
+  (void) close(fd);
+  if (!is_stdin)
+    fclose(in);
+  return spool_name;
+}
+
+
 /**********************************************************************
                      exported part (by driver.h)
  **********************************************************************/
@@ -1560,13 +2444,29 @@ interpret_troff_output_file(const char *filename)
   EnvStack env_stack = EnvStack();
 #endif // USE_ENV_STACK
 
+  if ((page_jobs > 1) && (page_worker < 0)) {
+    interpret_pages_in_parallel(filename);
+    return;
+  }
+  if ((input_passes > 1) && (0 == input_pass)) {
+    interpret_in_passes(filename);
+    return;
+  }
+
   // setup of global variables
   npages = 0;
   current_lineno = 1;
+  is_binary_input = false;
   // 'pr' is initialized after the prologue.
   // 'device' is set by the 1st prologue command.
 
-  if (filename[0] == '-' && filename[1] == '\0')
+  if (spooled_input != 0 /* nullptr */) {
+    current_file = fopen(spooled_input, "r");
+    if (0 /* nullptr */ == current_file)
+      fatal("cannot open temporary file '%1': %2", spooled_input,
+	    strerror(errno));
+  }
+  else if (filename[0] == '-' && filename[1] == '\0')
     current_file = stdin;
   else {
     errno = 0;
@@ -1576,6 +2476,7 @@ interpret_troff_output_file(const char *filename)
       return;
     }
   }
+  input_ptr = input_end = input_buf + 1;
   remember_filename(filename);
 
   if (current_env != 0)
@@ -1589,6 +2490,9 @@ interpret_troff_output_file(const char *filename)
   current_env->slant = 0;
   current_env->size = 0;
   current_env->vpos = -1;
+  delete glyph_names;
+  glyph_names = new StringArray;
+  forget_skipped_widths();
 
   // parsing of prologue (first 3 commands)
   {
@@ -1604,17 +2508,15 @@ interpret_troff_output_file(const char *filename)
     str_arg = get_string_arg();
     if (str_arg[0] != 'T')
       fatal("the first command must be 'x T'");
-    delete[] str_arg;
     char *tmp_dev = get_string_arg();
     if (pr == 0) {		// note: 'pr' initialized after prologue
-      device = tmp_dev;
+      device = strsave(tmp_dev);
       if (0 /* nullptr */ == font::load_desc())
 	fatal("cannot load description of '%1' device", tmp_dev);
     }
     else {
       if (device == 0 || strcmp(device, tmp_dev) != 0)
 	fatal("all files must use the same device");
-      delete[] tmp_dev;
     }
     skip_line_x();		// ignore further arguments
     current_env->size = 10 * font::sizescale;
@@ -1626,7 +2528,6 @@ interpret_troff_output_file(const char *filename)
     str_arg = get_string_arg();
     if (str_arg[0] != 'r')
       fatal("the second command must be 'x res'");
-    delete[] str_arg;
     int_arg = get_integer_arg();
     EnvInt font_res = font::res;
     if (int_arg != font_res)
@@ -1646,7 +2547,6 @@ interpret_troff_output_file(const char *filename)
     str_arg = get_string_arg();
     if (str_arg[0] != 'i')
       fatal("the third command must be 'x init'");
-    delete[] str_arg;
     skip_line_x();
   }
 
@@ -1702,7 +2602,7 @@ interpret_troff_output_file(const char *filename)
 	c = next_arg_begin();
 	if ((int) c == '\n' || (int) c == EOF)
 	  error("character argument expected");
-	else
+	else if (is_rendering)
 	  pr->set_ascii_char((unsigned char) c, current_env);
 	break;
       }
@@ -1713,7 +2613,7 @@ interpret_troff_output_file(const char *filename)
 	Char c = next_arg_begin();
 	if (c == '\n' || c == EOF)
 	  error("missing argument to 'c' command");
-	else
+	else if (is_rendering)
 	  pr->set_ascii_char((unsigned char) c, current_env);
 	break;
       }
@@ -1722,8 +2622,8 @@ interpret_troff_output_file(const char *filename)
 	if (npages <= 0)
 	  fatal_command(command);
 	char *str_arg = get_string_arg();
-	pr->set_special_char(str_arg, current_env);
-	delete[] str_arg;
+	if (is_rendering)
+	  pr->set_special_char(str_arg, current_env);
 	break;
       }
     case 'D':			// drawing commands
@@ -1738,7 +2638,6 @@ interpret_troff_output_file(const char *filename)
       {
 	char *str_arg = get_extended_arg();
 	remember_source_filename(str_arg);
-	delete[] str_arg;
 	break;
       }
     case 'h':			// h: relative horizontal move
@@ -1753,27 +2652,30 @@ interpret_troff_output_file(const char *filename)
       break;
     case 'm':			// m: stroke color
       parse_color_command(current_env->col);
-      pr->change_color(current_env);
+      if (is_rendering)
+	pr->change_color(current_env);
       break;
     case 'n':			// n: print end of line
 				// ignore two arguments (historically)
       if (npages <= 0)
 	fatal_command(command);
-      pr->end_of_line();
+      if (is_rendering)
+	pr->end_of_line();
       (void) get_integer_arg();
       (void) get_integer_arg();
       break;
     case 'N':			// N: print char with given int code
-      if (npages <= 0)
-	fatal_command(command);
-      pr->set_numbered_char(get_integer_arg(), current_env);
-      break;
+      {
+	if (npages <= 0)
+	  fatal_command(command);
+	IntArg n = get_integer_arg();
+	if (is_rendering)
+	  pr->set_numbered_char(n, current_env);
+	break;
+      }
     case 'p':			// p: start new page with given number
-      if (npages > 0)
-	pr->end_page(current_env->vpos);
-      npages++;			// increment # of processed pages
-      pr->begin_page(get_integer_arg());
-      current_env->vpos = 0;
+      finish_page();
+      start_page(get_integer_arg());
       break;
     case 's':			// s: set point size
       current_env->size = get_integer_arg();
@@ -1781,36 +2683,15 @@ interpret_troff_output_file(const char *filename)
 	current_env->height = 0;
       break;
     case 't':			// t: print a text word
-      {
-	char c;
-	if (npages <= 0)
-	  fatal_command(command);
-	char *str_arg = get_string_arg();
-	size_t i = 0;
-	while ((c = str_arg[i++]) != '\0') {
-	  EnvInt w;
-	  pr->set_ascii_char((unsigned char) c, current_env, &w);
-	  current_env->hpos += w;
-	}
-	delete[] str_arg;
-	break;
-      }
+      if (npages <= 0)
+	fatal_command(command);
+      set_word(0);
+      break;
     case 'u':			// u: print spaced word
-      {
-	char c;
-	if (npages <= 0)
-	  fatal_command(command);
-	EnvInt kern = (EnvInt) get_integer_arg();
-	char *str_arg = get_string_arg();
-	size_t i = 0;
-	while ((c = str_arg[i++]) != '\0') {
-	  EnvInt w;
-	  pr->set_ascii_char((unsigned char) c, current_env, &w);
-	  current_env->hpos += w + kern;
-	}
-	delete[] str_arg;
-	break;
-      }
+      if (npages <= 0)
+	fatal_command(command);
+      set_word((EnvInt) get_integer_arg());
+      break;
     case 'v':			// v: relative vertical move
       if (npages <= 0)
 	fatal_command(command);
@@ -1827,22 +2708,31 @@ interpret_troff_output_file(const char *filename)
       stopped = parse_x_command();
       break;
     default:
-      warning("unrecognized command '%1'", (unsigned char) command);
-      skip_line();
+      if (is_binary_input && ((int) command & 0x80))
+	parse_binary_command(command);
+      else {
+	warning("unrecognized command '%1'", (unsigned char) command);
+	skip_line();
+      }
       break;
     } // end of switch
   } // end of while
 
   // end of file reached
-  if (npages > 0)
-    pr->end_page(current_env->vpos);
-  delete pr;
-  pr = 0;
+  finish_page();
+  if ((input_pass > 0) && (input_pass < input_passes))
+    pr->end_pass();
+  else {
+    delete pr;
+    pr = 0;
+  }
   fclose(current_file);
   // If 'stopped' is not 'true' here then there wasn't any 'x stop'.
   if (!stopped)
     warning("no final 'x stop' command");
   delete_current_env();
+  delete glyph_names;
+  glyph_names = 0;
 }
 
 // Local Variables:
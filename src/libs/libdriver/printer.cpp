@@ -173,6 +173,18 @@ void printer::devtag(char *, const environment *, char)
 {
 }
 
+void printer::skip_special(char *, const environment *, char)
+{
+}
+
+void printer::skip_page(int)
+{
+}
+
+void printer::end_pass()
+{
+}
+
 // TODO: 1st and 3rd args should be `const`.
 void printer::draw(int, int *, int, const environment *)
 {
@@ -30,6 +30,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 enum error_type { DEBUG, WARNING, ERROR, FATAL };
 
+bool want_fatal_diagnostics_only = false;
+
 static void do_error_with_file_and_line(const char *filename,
 					const char *source_filename,
 					int lineno,
@@ -39,6 +41,8 @@ static void do_error_with_file_and_line(const char *filename,
 					const errarg &arg2,
 					const errarg &arg3)
 {
+  if (want_fatal_diagnostics_only && (type != FATAL))
+    return;
   bool need_space = false;
   if (program_name != 0 /* nullptr */) {
     fputs(program_name, stderr);
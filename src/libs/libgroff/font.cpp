@@ -39,6 +39,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "font.h"
 #include "unicode.h"
 #include "paper.h"
+#include "stringclass.h" // prerequisite of snapshot.h
+#include "snapshot.h"
 
 const char *const WS = " \t\n\r";
 
@@ -56,22 +58,26 @@ struct font_char_metric {
   int end_code;
 };
 
-struct font_kern_list {
-  glyph *glyph1;
-  glyph *glyph2;
+// A slot of the kerning pair table; `index1` is -1 in an empty one.
+struct font_kern_entry {
+  int index1;
+  int index2;
   int amount;
-  font_kern_list *next;
+};
 
-  font_kern_list(glyph *, glyph *, int,
-		 font_kern_list * = 0 /* nullptr */);
+// A code point range whose characters have the metrics of `metric`.
+struct font_wchar_range {
+  int start;
+  int end;
+  font_char_metric *metric;
 };
 
+// A slot of the widths cache; `point_size` is -1 in an empty one.
 struct font_widths_cache {
-  font_widths_cache *next;
   int point_size;
   int *width;
 
-  font_widths_cache(int, int, font_widths_cache * = 0 /* nullptr */);
+  font_widths_cache();
   ~font_widths_cache();
 };
 
@@ -233,10 +239,11 @@ int glyph_to_unicode(glyph *g)
 /* font functions */
 
 font::font(const char *fn) : ligatures(0),
-  kern_hash_table(0 /* nullptr */),
+  kern_table(0 /* nullptr */), kern_table_size(0), nkerns(0),
   space_width(0), special(false), internalname(0 /* nullptr */),
   slant(0.0), zoom(0), ch_index(0 /* nullptr */), nindices(0),
-  ch(0 /* nullptr */), wch(0 /* nullptr */), ch_used(0), ch_size(0),
+  ch(0 /* nullptr */), wch(0 /* nullptr */),
+  wch_ranges(0 /* nullptr */), nwch_ranges(0), ch_used(0), ch_size(0),
   widths_cache(0 /* nullptr */)
 {
   filename = new char[strlen(fn) + 1];
@@ -250,24 +257,11 @@ font::~font()
       delete[] ch[i].special_device_coding;
   delete[] ch;
   delete[] ch_index;
-  if (kern_hash_table) {
-    for (int i = 0; i < KERN_HASH_TABLE_SIZE; i++) {
-      font_kern_list *kerns = kern_hash_table[i];
-      while (kerns) {
-	font_kern_list *tem = kerns;
-	kerns = kerns->next;
-	delete tem;
-      }
-    }
-    delete[] kern_hash_table;
-  }
+  delete[] kern_table;
   delete[] filename;
   delete[] internalname;
-  while (widths_cache) {
-    font_widths_cache *tem = widths_cache;
-    widths_cache = widths_cache->next;
-    delete tem;
-  }
+  delete[] widths_cache;
+  delete[] wch_ranges;
   struct font_char_metric *wcp, *nwcp;
   for (wcp = wch; wcp != 0 /* nullptr */; wcp = nwcp) {
     nwcp = wcp->next;
@@ -380,13 +374,9 @@ bool font::is_special()
   return special;
 }
 
-font_widths_cache::font_widths_cache(int ps, int ch_size,
-				     font_widths_cache *p)
-: next(p), point_size(ps)
+font_widths_cache::font_widths_cache()
+: point_size(-1), width(0 /* nullptr */)
 {
-  width = new int[ch_size];
-  for (int i = 0; i < ch_size; i++)
-    width[i] = -1;
 }
 
 font_widths_cache::~font_widths_cache()
@@ -396,15 +386,83 @@ font_widths_cache::~font_widths_cache()
 
 struct font_char_metric *font::get_font_wchar_metric(int uc)
 {
-  struct font_char_metric *wcp;
-  for (wcp = wch; wcp != 0 /* nullptr */; wcp = wcp->next) {
-    if (wcp->code <= uc && uc <= wcp->end_code) {
-      return wcp;
-    }
+  int lo = 0;
+  int hi = nwch_ranges;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (uc < wch_ranges[mid].start)
+      hi = mid;
+    else if (uc > wch_ranges[mid].end)
+      lo = mid + 1;
+    else
+      return wch_ranges[mid].metric;
   }
   return 0 /* nullptr */;
 }
 
+// Build `wch_ranges` from `wch`.  Ranges may overlap; where they do,
+// the one defined last, which is nearest the head of `wch`, wins.  So
+// lay the ranges down from the tail of `wch` to its head, each one
+// cutting away whatever it covers of those laid down before it.
+
+void font::index_wchar_ranges()
+{
+  delete[] wch_ranges;
+  wch_ranges = 0 /* nullptr */;
+  nwch_ranges = 0;
+  int n = 0;
+  font_char_metric *wcp;
+  for (wcp = wch; wcp != 0 /* nullptr */; wcp = wcp->next)
+    n++;
+  if (0 == n)
+    return;
+  font_char_metric **order = new font_char_metric *[n];
+  int i = n;
+  for (wcp = wch; wcp != 0 /* nullptr */; wcp = wcp->next)
+    order[--i] = wcp;
+  // Each range laid down splits at most one earlier range in two.
+  font_wchar_range *ranges = new font_wchar_range[2 * n];
+  font_wchar_range *tem = new font_wchar_range[2 * n];
+  int used = 0;
+  for (i = 0; i < n; i++) {
+    int start = order[i]->code;
+    int end = order[i]->end_code;
+    if (end < start)
+      continue;
+    int k = 0;
+    int j;
+    for (j = 0; j < used && ranges[j].start < start; j++) {
+      tem[k] = ranges[j];
+      if (tem[k].end >= start)
+	tem[k].end = start - 1;
+      k++;
+    }
+    tem[k].start = start;
+    tem[k].end = end;
+    tem[k].metric = order[i];
+    k++;
+    for (j = 0; j < used; j++)
+      if (ranges[j].end > end) {
+	tem[k] = ranges[j];
+	if (tem[k].start <= end)
+	  tem[k].start = end + 1;
+	k++;
+      }
+    font_wchar_range *swap = ranges;
+    ranges = tem;
+    tem = swap;
+    used = k;
+  }
+  delete[] tem;
+  delete[] order;
+  if (0 == used)
+    delete[] ranges;
+  else {
+    wch_ranges = ranges;
+    nwch_ranges = used;
+  }
+}
+
 int font::get_width(glyph *g, int point_size)
 {
   int idx = glyph_to_index(g);
@@ -419,41 +477,35 @@ int font::get_width(glyph *g, int point_size)
     else
       real_size = int(point_size * double(zoom) / 1000.0 + .5);
   }
-  int uc = glyph_to_ucs_codepoint(g);
-  font_char_metric *wcp = 0 /* nullptr */;
-  if (uc > 0)
-    wcp = get_font_wchar_metric(uc);
-  if (wcp != 0 && !(idx < nindices && ch_index[idx] >= 0)) {
-    return scale(wcp->width, point_size);
-  }
   if (idx < nindices && ch_index[idx] >= 0) {
     // Explicitly enumerated glyph
     int i = ch_index[idx];
     if (real_size == unitwidth || font::use_unscaled_charwidths)
       return ch[i].width;
-
-    if (!widths_cache)
-      widths_cache = new font_widths_cache(real_size, ch_size);
-    else if (widths_cache->point_size != real_size) {
-      font_widths_cache **p;
-      for (p = &widths_cache; *p; p = &(*p)->next)
-	if ((*p)->point_size == real_size)
-	  break;
-      if (*p) {
-	font_widths_cache *tem = *p;
-	*p = (*p)->next;
-	tem->next = widths_cache;
-	widths_cache = tem;
-      }
-      else
-	widths_cache = new font_widths_cache(real_size, ch_size,
-					     widths_cache);
+    if (0 /* nullptr */ == widths_cache)
+      widths_cache = new font_widths_cache[WIDTHS_CACHE_SIZE];
+    // Sizes are often multiples of `sizescale`; spread them out.
+    unsigned slot = (unsigned(real_size) * 2654435761U) >> 28;
+    font_widths_cache *c = &widths_cache[slot % WIDTHS_CACHE_SIZE];
+    if (c->point_size != real_size) {
+      if (0 /* nullptr */ == c->width)
+	c->width = new int[ch_size];
+      for (int j = 0; j < ch_size; j++)
+	c->width[j] = -1;
+      c->point_size = real_size;
     }
-    int &w = widths_cache->width[i];
+    int &w = c->width[i];
     if (w < 0)
       w = scale(ch[i].width, point_size);
     return w;
   }
+  int uc = glyph_to_ucs_codepoint(g);
+  font_char_metric *wcp = 0 /* nullptr */;
+  if (uc > 0)
+    wcp = get_font_wchar_metric(uc);
+  if (wcp != 0 /* nullptr */) {
+    return scale(wcp->width, point_size);
+  }
   if (is_unicode) {
     // Unicode font
     int width = 24; // XXX: Add a request to override this.
@@ -603,37 +655,64 @@ int font::get_space_width(int point_size)
   return scale(space_width, point_size);
 }
 
-font_kern_list::font_kern_list(glyph *g1, glyph *g2, int n, font_kern_list *p)
-: glyph1(g1), glyph2(g2), amount(n), next(p)
+inline unsigned font::hash_kern(int idx1, int idx2)
 {
+  unsigned h = unsigned(idx1) * 2654435761U + unsigned(idx2);
+  return h ^ (h >> 15);
 }
 
-inline int font::hash_kern(glyph *g1, glyph *g2)
-{
-  int n = ((glyph_to_index(g1) << 10) + glyph_to_index(g2))
-	  % KERN_HASH_TABLE_SIZE;
-  return n < 0 ? -n : n;
-}
+// The kerning pair table is probed linearly and doubled when half
+// full.  A pair given again replaces the amount given before.
 
 void font::add_kern(glyph *g1, glyph *g2, int amount)
 {
-  if (!kern_hash_table) {
-    kern_hash_table = new font_kern_list *[int(KERN_HASH_TABLE_SIZE)];
-    for (int i = 0; i < KERN_HASH_TABLE_SIZE; i++)
-      kern_hash_table[i] = 0;
+  if (2 * (nkerns + 1) > kern_table_size) {
+    font_kern_entry *old_table = kern_table;
+    int old_size = kern_table_size;
+    kern_table_size = (0 == old_size) ? 64 : 2 * old_size;
+    kern_table = new font_kern_entry[kern_table_size];
+    for (int i = 0; i < kern_table_size; i++)
+      kern_table[i].index1 = -1;
+    nkerns = 0;
+    for (int i = 0; i < old_size; i++)
+      if (old_table[i].index1 >= 0) {
+	unsigned mask = unsigned(kern_table_size) - 1;
+	unsigned j = hash_kern(old_table[i].index1,
+			       old_table[i].index2) & mask;
+	while (kern_table[j].index1 >= 0)
+	  j = (j + 1) & mask;
+	kern_table[j] = old_table[i];
+	nkerns++;
+      }
+    delete[] old_table;
   }
-  font_kern_list **p = kern_hash_table + hash_kern(g1, g2);
-  *p = new font_kern_list(g1, g2, amount, *p);
+  int idx1 = glyph_to_index(g1);
+  int idx2 = glyph_to_index(g2);
+  unsigned mask = unsigned(kern_table_size) - 1;
+  unsigned j = hash_kern(idx1, idx2) & mask;
+  for (; kern_table[j].index1 >= 0; j = (j + 1) & mask)
+    if (kern_table[j].index1 == idx1 && kern_table[j].index2 == idx2) {
+      kern_table[j].amount = amount;
+      return;
+    }
+  kern_table[j].index1 = idx1;
+  kern_table[j].index2 = idx2;
+  kern_table[j].amount = amount;
+  nkerns++;
 }
 
 int font::get_kern(glyph *g1, glyph *g2, int point_size)
 {
-  if (kern_hash_table) {
-    for (font_kern_list *p = kern_hash_table[hash_kern(g1, g2)]; p;
-	 p = p->next)
-      if (g1 == p->glyph1 && g2 == p->glyph2)
-	return scale(p->amount, point_size);
-  }
+  if (0 == nkerns)
+    return 0;
+  int idx1 = glyph_to_index(g1);
+  int idx2 = glyph_to_index(g2);
+  unsigned mask = unsigned(kern_table_size) - 1;
+  for (unsigned j = hash_kern(idx1, idx2) & mask;
+       kern_table[j].index1 >= 0;
+       j = (j + 1) & mask)
+    if (kern_table[j].index1 == idx1 && kern_table[j].index2 == idx2)
+      return scale(kern_table[j].amount, point_size);
   return 0;
 }
 
@@ -792,6 +871,7 @@ void font::compact()
     delete[] old_ch;
     ch_size = ch_used;
   }
+  index_wchar_ranges();
 }
 
 void font::add_entry(glyph *g, const font_char_metric &metric)
@@ -829,6 +909,137 @@ font *font::load_font(const char *fn, bool want_diagnostic,
   return f;
 }
 
+static void write_metric(snapshot_writer &w,
+			 const font_char_metric &m)
+{
+  w.put_int(m.type);
+  w.put_int(m.code);
+  w.put_int(m.width);
+  w.put_int(m.height);
+  w.put_int(m.depth);
+  w.put_int(m.pre_math_space);
+  w.put_int(m.italic_correction);
+  w.put_int(m.subscript_correction);
+  w.put_int(m.end_code);
+  w.put_string(m.special_device_coding);
+}
+
+static char *copy_string(const char *s)
+{
+  char *p = new char[strlen(s) + 1];
+  strcpy(p, s);
+  return p;
+}
+
+static void read_metric(snapshot_reader &r, font_char_metric *m)
+{
+  m->type = char(r.get_int());
+  m->code = r.get_int();
+  m->width = r.get_int();
+  m->height = r.get_int();
+  m->depth = r.get_int();
+  m->pre_math_space = r.get_int();
+  m->italic_correction = r.get_int();
+  m->subscript_correction = r.get_int();
+  m->end_code = r.get_int();
+  const char *s = r.get_string();
+  m->special_device_coding = (s != 0 /* nullptr */) ? copy_string(s)
+			     : 0 /* nullptr */;
+  m->next = 0 /* nullptr */;
+}
+
+// Glyphs are written as their indices.
+void font::write_image(snapshot_writer &w)
+{
+  w.put_string(filename);
+  w.put_string(internalname);
+  w.put_int(int(ligatures));
+  w.put_int(space_width);
+  w.put_int(special);
+  w.put_double(slant);
+  w.put_int(zoom);
+  w.put_int(nindices);
+  if (nindices > 0)
+    w.put_bytes(ch_index, nindices * sizeof(int));
+  w.put_int(ch_used);
+  for (int i = 0; i < ch_used; i++)
+    write_metric(w, ch[i]);
+  int nwch = 0;
+  font_char_metric *wcp;
+  for (wcp = wch; wcp != 0 /* nullptr */; wcp = wcp->next)
+    nwch++;
+  w.put_int(nwch);
+  for (wcp = wch; wcp != 0 /* nullptr */; wcp = wcp->next)
+    write_metric(w, *wcp);
+  w.put_int(nkerns);
+  for (int i = 0; i < kern_table_size; i++)
+    if (kern_table[i].index1 >= 0) {
+      w.put_int(kern_table[i].index1);
+      w.put_int(kern_table[i].index2);
+      w.put_int(kern_table[i].amount);
+    }
+}
+
+font *font::read_image(snapshot_reader &r,
+		       glyph *(*index_to_glyph)(int))
+{
+  const char *fn = r.get_string();
+  if (0 /* nullptr */ == fn)
+    return 0 /* nullptr */;
+  font *f = new font(fn);
+  const char *iname = r.get_string();
+  if (iname != 0 /* nullptr */)
+    f->internalname = copy_string(iname);
+  f->ligatures = unsigned(r.get_int());
+  f->space_width = r.get_int();
+  f->special = (r.get_int() != 0);
+  f->slant = r.get_double();
+  f->zoom = r.get_int();
+  int n = r.get_count(sizeof(int));
+  const void *indices = r.get_bytes(n * sizeof(int));
+  if (n > 0 && indices != 0 /* nullptr */) {
+    f->ch_index = new int[n];
+    memcpy(f->ch_index, indices, n * sizeof(int));
+    f->nindices = n;
+  }
+  n = r.get_count();
+  if (n > 0) {
+    f->ch = new font_char_metric[n];
+    f->ch_size = n;
+    for (; f->ch_used < n && r.is_valid(); f->ch_used++)
+      read_metric(r, &f->ch[f->ch_used]);
+  }
+  n = r.get_count();
+  font_char_metric **wcpp = &f->wch;
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    *wcpp = new font_char_metric;
+    read_metric(r, *wcpp);
+    wcpp = &(*wcpp)->next;
+  }
+  n = r.get_count();
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    int idx1 = r.get_int();
+    int idx2 = r.get_int();
+    int amount = r.get_int();
+    glyph *g1 = index_to_glyph(idx1);
+    glyph *g2 = index_to_glyph(idx2);
+    if (UNDEFINED_GLYPH == g1 || UNDEFINED_GLYPH == g2) {
+      r.invalidate();
+      break;
+    }
+    f->add_kern(g1, g2, amount);
+  }
+  f->index_wchar_ranges();
+  for (int i = 0; i < f->nindices; i++)
+    if (f->ch_index[i] >= f->ch_used)
+      r.invalidate();
+  if (!r.is_valid()) {
+    delete f;
+    return 0 /* nullptr */;
+  }
+  return f;
+}
+
 static char *trim_arg(char *p)
 {
   if (0 /* nullptr */ == p)
@@ -113,6 +113,16 @@ void search_path::command_line_dir(const char *s)
   delete[] old;
 }
 
+SEARCH_PATH_OPEN_HANDLER search_path::open_handler = 0 /* nullptr */;
+
+SEARCH_PATH_OPEN_HANDLER
+search_path::set_open_handler(SEARCH_PATH_OPEN_HANDLER f)
+{
+  SEARCH_PATH_OPEN_HANDLER old = open_handler;
+  open_handler = f;
+  return old;
+}
+
 FILE *search_path::open_file(const char *name, char **pathp)
 {
   assert(name != 0 /* nullptr */);
@@ -122,6 +132,8 @@ FILE *search_path::open_file(const char *name, char **pathp)
       return 0 /* nullptr */;
     }
     FILE *fp = fopen(name, "r");
+    if (open_handler != 0 /* nullptr */)
+      open_handler(name, (fp != 0 /* nullptr */));
     if (fp != 0 /* nullptr */) {
       if (pathp != 0 /* nullptr */)
 	*pathp = strsave(name);
@@ -156,6 +168,8 @@ FILE *search_path::open_file(const char *name, char **pathp)
     }
     FILE *fp = fopen(path, "r");
     int err = errno;
+    if (open_handler != 0 /* nullptr */)
+      open_handler(path, (fp != 0 /* nullptr */));
     if (fp != 0 /* nullptr */) {
       if (pathp != 0 /* nullptr */)
 	*pathp = path;
@@ -191,6 +205,8 @@ FILE *search_path::open_file_cautiously(const char *name, char **pathp,
       return 0 /* nullptr */;
     }
     FILE *fp = fopen(name, mode);
+    if (reading && open_handler != 0 /* nullptr */)
+      open_handler(name, (fp != 0 /* nullptr */));
     if (fp != 0 /* nullptr */) {
       if (pathp != 0 /* nullptr */)
 	*pathp = strsave(name);
@@ -226,6 +242,8 @@ FILE *search_path::open_file_cautiously(const char *name, char **pathp,
     }
     FILE *fp = fopen(path, mode);
     int err = errno;
+    if (open_handler != 0 /* nullptr */)
+      open_handler(path, (fp != 0 /* nullptr */));
     if (fp != 0 /* nullptr */) {
       if (pathp != 0 /* nullptr */)
 	*pathp = path;
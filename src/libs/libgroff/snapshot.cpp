@@ -0,0 +1,136 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h> // memcpy(), strlen()
+
+// libgroff
+#include "stringclass.h" // prerequisite of snapshot.h
+#include "snapshot.h"
+
+void snapshot_writer::put_int(int n)
+{
+  buf.append(reinterpret_cast<const char *>(&n), sizeof n);
+}
+
+void snapshot_writer::put_double(double d)
+{
+  buf.append(reinterpret_cast<const char *>(&d), sizeof d);
+}
+
+// A string is stored as its length, its characters, and a null
+// terminator, so that a reader can hand out pointers into its image.
+void snapshot_writer::put_string(const char *s)
+{
+  if (0 /* nullptr */ == s) {
+    put_int(-1);
+    return;
+  }
+  size_t len = strlen(s);
+  put_int(int(len));
+  buf.append(s, len + 1);
+}
+
+void snapshot_writer::put_bytes(const void *p, size_t n)
+{
+  buf.append(static_cast<const char *>(p), n);
+}
+
+// Alignment is relative to the start of the image; a reader of an
+// image that begins at a suitably aligned address (such as a mapped
+// file) can then point into it for arrays of the padded size.
+void snapshot_writer::align(size_t n)
+{
+  while (buf.length() % n != 0)
+    buf += '\0';
+}
+
+snapshot_reader::snapshot_reader(const char *p, size_t n)
+: start(p), ptr(p), end(p + n), is_ok(true)
+{
+}
+
+void snapshot_reader::align(size_t n)
+{
+  size_t pad = (n - size_t(ptr - start) % n) % n;
+  (void) get_bytes(pad);
+}
+
+const void *snapshot_reader::get_bytes(size_t n)
+{
+  if (!is_ok || size_t(end - ptr) < n) {
+    is_ok = false;
+    return 0 /* nullptr */;
+  }
+  const char *p = ptr;
+  ptr += n;
+  return p;
+}
+
+int snapshot_reader::get_int()
+{
+  int n = 0;
+  const void *p = get_bytes(sizeof n);
+  if (p != 0 /* nullptr */)
+    memcpy(&n, p, sizeof n);
+  return n;
+}
+
+int snapshot_reader::get_count(size_t element_size)
+{
+  int n = get_int();
+  if (n < 0 || (element_size > 0
+		&& size_t(n) > size_t(end - ptr) / element_size)) {
+    is_ok = false;
+    return 0;
+  }
+  return n;
+}
+
+double snapshot_reader::get_double()
+{
+  double d = 0.0;
+  const void *p = get_bytes(sizeof d);
+  if (p != 0 /* nullptr */)
+    memcpy(&d, p, sizeof d);
+  return d;
+}
+
+const char *snapshot_reader::get_string()
+{
+  int len = get_int();
+  if (len < 0) {
+    if (len != -1)
+      is_ok = false;
+    return 0 /* nullptr */;
+  }
+  const char *s = static_cast<const char *>(get_bytes(size_t(len) + 1));
+  if (s != 0 /* nullptr */ && s[len] != '\0') {
+    is_ok = false;
+    return 0 /* nullptr */;
+  }
+  return s;
+}
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
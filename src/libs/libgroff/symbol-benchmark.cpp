@@ -0,0 +1,157 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+// Time the interning of the identifiers found in roff input files, such
+// as the macro packages in tmac/, the way GNU troff interns them when
+// reading requests, macro calls, and escape sequences.
+//
+// usage: symbol-benchmark [-n passes] file ...
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h> // fclose(), fopen(), getc(), printf()
+#include <stdlib.h> // atoi(), exit(), EXIT_SUCCESS
+#include <string.h> // strchr(), strcmp(), strerror()
+#include <sys/time.h> // gettimeofday()
+
+#include <string>
+#include <vector>
+
+#include "errarg.h"
+#include "error.h"
+#include "symbol.h"
+
+static double current_time()
+{
+  struct timeval tv;
+  (void) gettimeofday(&tv, 0 /* nullptr */);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static bool is_name_char(int c)
+{
+  return (c > ' ') && (c < 127) && (c != '\\') && (c != ']');
+}
+
+// Collect a name after a control character or an escape sequence that
+// takes one: `\n`, `\*`, `\f`, `\[`, and so forth, with `(xx` and
+// `[name]` forms.
+
+static void collect_names(const char *filename,
+			  std::vector<std::string> &names)
+{
+  FILE *fp = fopen(filename, "r");
+  if (0 /* nullptr */ == fp)
+    fatal("cannot open '%1': %2", filename, strerror(errno));
+  std::string text;
+  int c;
+  while ((c = getc(fp)) != EOF)
+    text += char(c);
+  fclose(fp);
+  size_t n = text.size();
+  for (size_t i = 0; i < n; i++) {
+    std::string name;
+    if (('.' == text[i] || '\'' == text[i])
+	&& (0 == i || '\n' == text[i - 1])) {
+      size_t j = i + 1;
+      while (j < n && (' ' == text[j] || '\t' == text[j]))
+	j++;
+      while (j < n && is_name_char(text[j]))
+	name += text[j++];
+      i = j - 1;
+    }
+    else if ('\\' == text[i] && i + 1 < n) {
+      size_t j = i + 1;
+      if (strchr("n*fgFmM", text[j]) != 0 /* nullptr */) {
+	j++;
+	// skip an autoincrement or autodecrement sign
+	if (j < n && ('+' == text[j] || '-' == text[j])
+	    && 'n' == text[i + 1])
+	  j++;
+      }
+      else if (text[j] != '(' && text[j] != '[') {
+	i = j;
+	continue;
+      }
+      if (j >= n)
+	break;
+      if ('(' == text[j] && j + 2 < n)
+	name = text.substr(j + 1, 2);
+      else if ('[' == text[j]) {
+	for (j++; j < n && is_name_char(text[j]); j++)
+	  name += text[j];
+      }
+      else if (is_name_char(text[j]))
+	name = text[j];
+      i = j;
+    }
+    if (!name.empty())
+      names.push_back(name);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  program_name = argv[0];
+  int passes = 100;
+  int i = 1;
+  if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+    passes = atoi(argv[i + 1]);
+    i += 2;
+  }
+  if (i >= argc || passes <= 0) {
+    fprintf(stderr, "usage: %s [-n passes] file ...\n", program_name);
+    exit(2);
+  }
+  std::vector<std::string> names;
+  for (; i < argc; i++)
+    collect_names(argv[i], names);
+  if (names.empty())
+    fatal("no identifiers found");
+  // Copy the names into one array of C strings, as troff presents them
+  // to the symbol constructor from its own token buffer.
+  std::vector<const char *> cnames;
+  for (size_t k = 0; k < names.size(); k++)
+    cnames.push_back(names[k].c_str());
+  size_t count = cnames.size();
+  double start = current_time();
+  for (size_t k = 0; k < count; k++)
+    (void) symbol(cnames[k]);
+  double insert_time = current_time() - start;
+  unsigned long checksum = 0;
+  start = current_time();
+  for (int pass = 0; pass < passes; pass++)
+    for (size_t k = 0; k < count; k++)
+      checksum += symbol(cnames[k]).hash();
+  double lookup_time = current_time() - start;
+  printf("%lu identifiers, %d passes (checksum %lu)\n",
+	 static_cast<unsigned long>(count), passes, checksum);
+  printf("first pass: %.1f ns per identifier\n",
+	 insert_time * 1e9 / count);
+  printf("later passes: %.1f ns per identifier\n",
+	 lookup_time * 1e9 / (double(count) * passes));
+  exit(EXIT_SUCCESS);
+}
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
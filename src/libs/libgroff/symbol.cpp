@@ -23,7 +23,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #endif
 
 #include <assert.h>
-#include <string.h> // strcat(), strcmp(), strcpy(), strlen()
+#include <stdint.h> // uint32_t
+#include <string.h> // memcpy(), strcat(), strcmp(), strcpy(), strlen()
 #include <stdlib.h> // calloc()
 
 #include "cset.h" // csprint()
@@ -34,11 +35,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "error.h"
 #include "symbol.h"
 
+struct symbol::table_entry {
+  unsigned int hash;
+  const char *s;
+};
+
 // Create an anonymous global symbol table to house two constants.
 
-const char **symbol::table = 0 /* nullptr */;
-int symbol::table_occupancy = 0;
-int symbol::table_size = 0;
+symbol::table_entry *symbol::table = 0 /* nullptr */;
+unsigned int symbol::table_occupancy = 0;
+unsigned int symbol::table_size = 0;
 char *symbol::block = 0 /* nullptr */;
 size_t symbol::block_size = 0;
 
@@ -49,114 +55,103 @@ const symbol EMPTY_SYMBOL("");
 #undef BLOCK_SIZE
 #endif
 
-const int BLOCK_SIZE = 1024;
-// the table will increase in size as necessary
-// the size will be chosen from the following array
-// add some more if you want
-static const unsigned int table_sizes[] = {
-  101, 503, 1009, 2003, 3001, 4001, 5003, 10007, 20011, 40009, 80021,
-  160001, 500009, 1000003, 1500007, 2000003, 0
-};
-// Don't populate table entries above this ratio.
-const double FULL_MAX = 0.3;
+const int BLOCK_SIZE = 4096;
+// The table doubles in size as necessary; GNU troff interns over a
+// thousand names at start-up, so start with room for them.
+const unsigned int INITIAL_TABLE_SIZE = 2048;
+const unsigned int MAX_TABLE_SIZE = 1U << 21;
 
-static unsigned int hash_string(const char *p)
+// FNV-1a, finished with MurmurHash3's mixing step so that the low bits,
+// which select a table slot, depend on every input byte.  Also store
+// the string's length in `*lenp`.
+
+static unsigned int hash_string(const char *p, size_t *lenp)
 {
-  // compute a hash code; this assumes 32-bit unsigned ints
-  // see p436 of  Compilers by Aho, Sethi & Ullman
-  // give special treatment to two-character names
-  unsigned int hc = 0, g;
-  if (*p != 0) {
-    hc = *p++;
-    if (*p != 0) {
-      hc <<= 7;
-      hc += *p++;
-      for (; *p != 0; p++) {
-	hc <<= 4;
-	hc += *p;
-	if ((g = (hc & 0xf0000000)) == 0) {
-	  hc ^= g >> 24;
-	  hc ^= g;
-	}
-      }
-    }
+  uint32_t hc = 2166136261U;
+  const char *start = p;
+  for (; *p != '\0'; p++) {
+    hc ^= static_cast<unsigned char>(*p);
+    hc *= 16777619U;
   }
+  *lenp = p - start;
+  hc ^= hc >> 16;
+  hc *= 0x85ebca6bU;
+  hc ^= hc >> 13;
+  hc *= 0xc2b2ae35U;
+  hc ^= hc >> 16;
   return hc;
 }
 
-// Tell compiler that a variable is intentionally unused.
-inline void unused(void *) { }
-
 symbol::symbol(const char *p, int how)
 {
   if (p == 0 /* nullptr */) {
     s = 0 /* nullptr */;
     return;
   }
-  if (*p == 0 /* nullptr */) {
-    s = "";
-    return;
-  }
   if (table == 0 /* nullptr */) {
-    table_size = table_sizes[0];
-    table = const_cast<const char **>(new char *[table_size]);
-    for (int i = 0; i < table_size; i++)
-      table[i] = 0 /* nullptr */;
+    table_size = INITIAL_TABLE_SIZE;
+    table = new table_entry[table_size]();
     table_occupancy = 0;
   }
-  unsigned int hc = hash_string(p);
-  const char **pp;
-  for (pp = table + hc % table_size;
-       *pp != 0 /* nullptr */;
-       (pp == table ? (pp = (table + table_size - 1)) : --pp))
-    if (strcmp(p, *pp) == 0) {
-      s = *pp;
+  size_t len;
+  unsigned int hc = hash_string(p, &len);
+  unsigned int mask = table_size - 1;
+  unsigned int i;
+  // Probe linearly, comparing the stored hash codes first so that
+  // strings are compared only on a probable match.
+  for (i = hc & mask;
+       table[i].s != 0 /* nullptr */;
+       i = (i + 1) & mask)
+    if ((table[i].hash == hc) && (strcmp(p, table[i].s) == 0)) {
+      s = table[i].s;
       return;
     }
   if (how == MUST_ALREADY_EXIST) {
     s = 0 /* nullptr */;
     return;
   }
-  if ((table_occupancy >= (table_size - 1))
-      || (table_occupancy >= (table_size * FULL_MAX))) {
-    const char **old_table = table;
+  // Keep the table at most half full.
+  if (table_occupancy >= (table_size / 2)) {
+    table_entry *old_table = table;
     unsigned int old_table_size = table_size;
-    int i;
-    for (i = 1; table_sizes[i] <= old_table_size; i++)
-      if (table_sizes[i] == 0)
-	fatal("cannot construct symbol table larger than %1 entries",
-	      table_sizes[(i - 1)]);
-    table_size = table_sizes[i];
-    table_occupancy = 0;
-    table = const_cast<const char **>(new char *[table_size]);
-    for (i = 0; i < table_size; i++)
-      table[i] = 0 /* nullptr */;
-    for (pp = old_table + old_table_size - 1;
-	 pp >= old_table;
-	 --pp) {
-	   symbol temp(*pp, 1); /* insert it into the new table */
-	   unused(&temp);
-	 }
+    if (old_table_size >= MAX_TABLE_SIZE)
+      fatal("cannot construct symbol table larger than %1 entries",
+	    old_table_size);
+    table_size *= 2;
+    mask = table_size - 1;
+    table = new table_entry[table_size]();
+    for (unsigned int j = 0; j < old_table_size; j++)
+      if (old_table[j].s != 0 /* nullptr */) {
+	unsigned int k;
+	for (k = old_table[j].hash & mask;
+	     table[k].s != 0 /* nullptr */;
+	     k = (k + 1) & mask)
+	  ;
+	table[k] = old_table[j];
+      }
     delete[] old_table;
-    for (pp = table + hc % table_size;
-	 *pp != 0 /* nullptr */;
-	 (pp == table ? pp = table + table_size - 1 : --pp))
+    for (i = hc & mask;
+	 table[i].s != 0 /* nullptr */;
+	 i = (i + 1) & mask)
       ;
   }
   ++table_occupancy;
-  if (how == DONT_STORE)
-    s = *pp = p;
-  else {
-    size_t len = strlen(p) + 1;
-    if ((block == 0 /* nullptr */) || (block_size < len)) {
-      block_size = len > BLOCK_SIZE ? len : BLOCK_SIZE;
-      block = new char [block_size];
-    }
-    (void) strcpy(block, p);
-    s = *pp = block;
-    block += len;
-    block_size -= len;
+  // Store the hash code, aligned, ahead of the contents; see
+  // `symbol::hash()`.
+  const size_t align = sizeof (unsigned int);
+  size_t need = (align + len + 1 + align - 1) / align * align;
+  if ((block == 0 /* nullptr */) || (block_size < need)) {
+    block_size = need > BLOCK_SIZE ? need : BLOCK_SIZE;
+    block = new char [block_size];
   }
+  *reinterpret_cast<unsigned int *>(block) = hc;
+  char *contents = block + align;
+  (void) memcpy(contents, p, len + 1);
+  block += need;
+  block_size -= need;
+  table[i].hash = hc;
+  table[i].s = contents;
+  s = contents;
 }
 
 symbol catenate(symbol s1, symbol s2)
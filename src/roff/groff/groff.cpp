@@ -26,9 +26,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h> // CHAR_MAX, INT_MAX
 #include <stdio.h> // EOF, FILE, fflush(), setbuf(), stderr, stdout
-#include <stdlib.h> // exit(), EXIT_SUCCESS, free(), getenv(), setenv()
-#include <string.h> // strerror(), strsignal()
+#include <stdlib.h> // exit(), EXIT_SUCCESS, free(), getenv(), qsort(),
+			// setenv(), strtol()
+#include <string.h> // memcpy(), strerror(), strsignal()
 
 #include <getopt.h> // getopt_long()
 //
@@ -45,6 +47,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "posix.h"
 #include "nonposix.h"
 
+#ifdef _POSIX_VERSION
+#include <sys/wait.h> // WEXITSTATUS(), WIFEXITED()
+#endif
+
 #include "lib.h"
 
 #include "errarg.h"
@@ -119,7 +125,14 @@ bool need_postdriver = true;
 
 possible_command commands[NCOMMANDS];
 
+// Measure and report the commands' resource usage?
+enum { STATS_NONE, STATS_TEXT, STATS_JSON } stats_format = STATS_NONE;
+
 int run_commands(bool no_pipe);
+void print_stats(int ncommands, char ***argvs,
+		 const struct command_stats *stats);
+int run_jobs(int njobs, int first_index, int ndocs, char **inputs,
+	     const char *suffix, int Vflag);
 void print_commands(FILE *);
 void append_arg_to_string(const char *arg, string &str);
 void handle_unknown_desc_command(const char *command, const char *arg,
@@ -170,6 +183,7 @@ int main(int argc, char **argv)
   int is_xhtml = 0;
   int eflag = 0;
   int need_pic = 0;
+  int njobs = 0;
   int opt;
   const char *command_prefix = getenv("GROFF_COMMAND_PREFIX");
   const char *encoding = getenv("GROFF_ENCODING");
@@ -179,6 +193,8 @@ int main(int argc, char **argv)
   static const struct option long_options[] = {
     { "help", no_argument, 0 /* nullptr */, 'h' },
     { "version", no_argument, 0 /* nullptr */, 'v' },
+    { "jobs", required_argument, 0 /* nullptr */, CHAR_MAX + 1 },
+    { "stats", optional_argument, 0 /* nullptr */, CHAR_MAX + 2 },
     { 0 /* nullptr */, 0, 0 /* nullptr */, 0 }
   };
   while ((opt = getopt_long(argc, argv,
@@ -378,6 +394,33 @@ int main(int argc, char **argv)
       Xflag++;
       need_postdriver = false;
       break;
+    case CHAR_MAX + 1: // --jobs
+      {
+	char *end;
+	errno = 0;
+	long n = strtol(optarg, &end, 10);
+	if (end == optarg || *end != '\0' || n < 1 || n > INT_MAX
+	    || errno != 0) {
+	  error("'--jobs' option requires a positive integer argument,"
+		" got '%1'", optarg);
+	  usage(stderr);
+	  xexit(2);
+	}
+	njobs = int(n);
+      }
+      break;
+    case CHAR_MAX + 2: // --stats
+      if ((0 /* nullptr */ == optarg) || strcmp(optarg, "text") == 0)
+	stats_format = STATS_TEXT;
+      else if (strcmp(optarg, "json") == 0)
+	stats_format = STATS_JSON;
+      else {
+	error("'--stats' option argument must be 'text' or 'json', got"
+	      " '%1'", optarg);
+	usage(stderr);
+	xexit(2);
+      }
+      break;
     case '?':
       if (optopt != 0)
 	error("unrecognized command-line option '%1'", char(optopt));
@@ -398,6 +441,33 @@ int main(int argc, char **argv)
       break;
     }
   }
+  if (njobs > 0) {
+    const char *conflict = 0 /* nullptr */;
+    if (iflag)
+      conflict = "-i";
+    else if (lflag)
+      conflict = "-l";
+    else if (want_version_info)
+      conflict = "-v";
+    else if (Xflag)
+      conflict = "-X";
+    if (conflict != 0 /* nullptr */) {
+      error("option '%1' cannot be combined with '--jobs'", conflict);
+      usage(stderr);
+      xexit(2);
+    }
+    if (optind == argc) {
+      error("'--jobs' option requires input file operands");
+      usage(stderr);
+      xexit(2);
+    }
+    for (int i = optind; i < argc; i++)
+      if (strcmp(argv[i], "-") == 0) {
+	error("standard input cannot be an operand with '--jobs'");
+	usage(stderr);
+	xexit(2);
+      }
+  }
   if (need_pic)
     commands[PIC_INDEX].set_name(command_prefix, "pic");
   if (encoding != 0 /* nullptr */) {
@@ -512,7 +582,7 @@ int main(int argc, char **argv)
   for (first_index = 0; first_index < TROFF_INDEX; first_index++)
     if (commands[first_index].get_name() != 0 /* nullptr */)
       break;
-  if (optind < argc) {
+  if (optind < argc && 0 == njobs) {
     if (argv[optind][0] == '-' && argv[optind][1] != '\0')
       commands[first_index].append_arg("--");
     for (int i = optind; i < argc; i++)
@@ -549,6 +619,14 @@ int main(int argc, char **argv)
     newpath += '\0';
     xsetenv("PATH", newpath.contents(), 1 /* overwrite */);
   }
+  if (njobs > 0) {
+    // The output of `-Z`, `-a`, and `-z` is not the device's.
+    int status = run_jobs(njobs, first_index, argc - optind,
+			  argv + optind, (zflag ? "grout" : device),
+			  Vflag) << 2;
+    assert(status < 65 || 0 == "run_jobs() returned too many bits");
+    xexit(status);
+  }
   if (Vflag)
     print_commands(Vflag == 1 ? stdout : stderr);
   if (Vflag == 1)
@@ -642,7 +720,254 @@ int run_commands(bool no_pipe)
   for (int i = 0; i < NCOMMANDS; i++)
     if (commands[i].get_name() != 0 /* nullptr */)
       v[ncommands++] = commands[i].get_argv();
-  return run_pipeline(ncommands, v, no_pipe);
+  if (STATS_NONE == stats_format)
+    return run_pipeline(ncommands, v, no_pipe, 0 /* nullptr */);
+  struct command_stats stats[NCOMMANDS];
+  int status = run_pipeline(ncommands, v, no_pipe, stats);
+  print_stats(ncommands, v, stats);
+  return status;
+}
+
+// Write a measurement with `precision` digits after the decimal point
+// to the standard error stream, or, if it is unavailable, a
+// placeholder.  In a table, right-align it in a column `width` wide.
+
+static void put_measurement(double value, int precision, int width)
+{
+  if (STATS_JSON == stats_format) {
+    if (value < 0)
+      fputs("null", stderr);
+    else
+      fprintf(stderr, "%.*f", precision, value);
+  }
+  else {
+    if (value < 0)
+      fprintf(stderr, " %*s", width, "-");
+    else
+      fprintf(stderr, " %*.*f", width, precision, value);
+  }
+}
+
+// Report the commands' resource usage to the standard error stream,
+// as a table or a JSON array of objects.
+
+void print_stats(int ncommands, char ***argvs,
+		 const struct command_stats *stats)
+{
+  if (STATS_JSON == stats_format) {
+    fputc('[', stderr);
+    for (int i = 0; i < ncommands; i++) {
+      fputs((i > 0) ? ",\n {\"command\": " : "{\"command\": ", stderr);
+      string(xbasename(argvs[i][0])).json_dump();
+      fputs(", \"wall_time\": ", stderr);
+      put_measurement(stats[i].wall_time, 3, 0);
+      fputs(", \"user_time\": ", stderr);
+      put_measurement(stats[i].user_time, 3, 0);
+      fputs(", \"system_time\": ", stderr);
+      put_measurement(stats[i].system_time, 3, 0);
+      fputs(", \"max_rss_kib\": ", stderr);
+      put_measurement(stats[i].max_rss, 0, 0);
+      fputs(", \"output_bytes\": ", stderr);
+      put_measurement(stats[i].output_bytes, 0, 0);
+      fputc('}', stderr);
+    }
+    fputs("]\n", stderr);
+  }
+  else {
+    fprintf(stderr, "%-12s %8s %8s %8s %10s %12s\n", "command",
+	    "wall(s)", "user(s)", "sys(s)", "RSS(KiB)", "output(B)");
+    for (int i = 0; i < ncommands; i++) {
+      fprintf(stderr, "%-12s", xbasename(argvs[i][0]));
+      put_measurement(stats[i].wall_time, 3, 8);
+      put_measurement(stats[i].user_time, 3, 8);
+      put_measurement(stats[i].system_time, 3, 8);
+      put_measurement(stats[i].max_rss, 0, 10);
+      put_measurement(stats[i].output_bytes, 0, 12);
+      fputc('\n', stderr);
+    }
+  }
+  fflush(stderr);
+}
+
+// Multi-document mode
+//
+// With `--jobs=N`, each input file is formatted by a pipeline of its
+// own, writing to a file in the working directory named after the
+// input with a suffix appended, and up to N pipelines run at once.
+// Each pipeline is run by a child of groff, so that its wait() in
+// run_pipeline() collects only that pipeline's commands.  A
+// pipeline's diagnostics go to a temporary file and are copied to the
+// standard error stream after those of all previous documents, so that
+// they come out in the order of the operands.
+
+struct job {
+  pid_t pid;
+  int diagnostics_fd;
+  bool is_done;
+};
+
+static int make_diagnostics_file()
+{
+  char *templ = xtmptemplate("-jobs", "j");
+  errno = 0;
+  int fd = mkstemp(templ);
+  if (fd < 0)
+    fatal("cannot create temporary file: %1", strerror(errno));
+  (void) unlink(templ);
+  delete[] templ;
+  return fd;
+}
+
+static void copy_diagnostics(int fd)
+{
+  char buf[BUFSIZ];
+  ssize_t n;
+  if (lseek(fd, 0, SEEK_SET) < 0)
+    fatal("cannot rewind temporary file: %1", strerror(errno));
+  while ((n = read(fd, buf, sizeof buf)) > 0)
+    fwrite(buf, 1, size_t(n), stderr);
+  if (n < 0)
+    fatal("cannot read temporary file: %1", strerror(errno));
+  fflush(stderr);
+}
+
+static int compare_names(const void *p1, const void *p2)
+{
+  return strcmp(*static_cast<char * const *>(p1),
+		*static_cast<char * const *>(p2));
+}
+
+// Called in a child process; never returns.
+static void run_job(int first_index, const char *input,
+		    const char *output, int diagnostics_fd, int Vflag)
+{
+  if (dup2(diagnostics_fd, STDERR_FILENO) < 0)
+    _exit(EXEC_FAILED_EXIT_STATUS);
+  (void) close(diagnostics_fd);
+  if (input[0] == '-')
+    commands[first_index].append_arg("--");
+  commands[first_index].append_arg(input);
+  if (Vflag)
+    print_commands(Vflag == 1 ? stdout : stderr);
+  int status = 0;
+  if (Vflag != 1) {
+    errno = 0;
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+		  0666);
+    if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+      error("cannot open output file '%1': %2", output,
+	    strerror(errno));
+      status = 1;
+    }
+    else {
+      (void) close(fd);
+      status = run_commands(false /* no_pipe */);
+    }
+  }
+  fflush(stdout);
+  fflush(stderr);
+  // Skip exit(), which would run groff's clean-up a second time.
+  _exit(status);
+}
+
+#ifdef _POSIX_VERSION
+// Map the wait status of a run_job() process to the bits that
+// run_pipeline() uses: 1 for a failed command, 2 for one killed by a
+// signal, and 4 for one that couldn't be run.
+
+static int job_status(int status)
+{
+  if (!WIFEXITED(status))
+    return 2;
+  int exit_status = WEXITSTATUS(status);
+  if (EXEC_FAILED_EXIT_STATUS == exit_status)
+    return 4;
+  // run_job() exits with run_commands()'s bits; anything else means
+  // it failed some other way.
+  if ((exit_status & ~7) != 0)
+    return 1;
+  return exit_status;
+}
+#endif
+
+// Run a pipeline for each of the `ndocs` files in `inputs`, up to
+// `njobs` at a time.  Return the bitwise OR of the pipelines' status
+// bits, as run_commands() would.
+
+int run_jobs(int njobs, int first_index, int ndocs, char **inputs,
+	     const char *suffix, int Vflag)
+{
+#ifdef _POSIX_VERSION
+  // Writing the pipelines one after another keeps them in order.
+  if (1 == Vflag)
+    njobs = 1;
+  char **outputs = new char *[ndocs];
+  for (int i = 0; i < ndocs; i++) {
+    const char *base = xbasename(inputs[i]);
+    outputs[i] = new char[strlen(base) + 1 + strlen(suffix) + 1];
+    strcpy(outputs[i], base);
+    strcat(outputs[i], ".");
+    strcat(outputs[i], suffix);
+  }
+  char **sorted = new char *[ndocs];
+  memcpy(sorted, outputs, ndocs * sizeof(char *));
+  qsort(sorted, ndocs, sizeof(char *), compare_names);
+  for (int i = 1; i < ndocs; i++)
+    if (strcmp(sorted[i - 1], sorted[i]) == 0)
+      fatal("more than one input file would be formatted to '%1'",
+	    sorted[i]);
+  delete[] sorted;
+  job *jobs = new job[ndocs];
+  int next_to_start = 0;
+  int next_to_report = 0;
+  int running = 0;
+  int ret = 0;
+  while (next_to_report < ndocs) {
+    while (running < njobs && next_to_start < ndocs) {
+      job &j = jobs[next_to_start];
+      j.diagnostics_fd = make_diagnostics_file();
+      j.is_done = false;
+      fflush(stdout);
+      fflush(stderr);
+      j.pid = fork();
+      if (j.pid < 0)
+	fatal("cannot fork: %1", strerror(errno));
+      if (0 == j.pid)
+	run_job(first_index, inputs[next_to_start],
+		outputs[next_to_start], j.diagnostics_fd, Vflag);
+      running++;
+      next_to_start++;
+    }
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      if (EINTR == errno)
+	continue;
+      fatal("cannot wait for child process: %1", strerror(errno));
+    }
+    for (int i = next_to_report; i < next_to_start; i++)
+      if (jobs[i].pid == pid && !jobs[i].is_done) {
+	jobs[i].is_done = true;
+	ret |= job_status(status);
+	running--;
+	break;
+      }
+    while (next_to_report < next_to_start
+	   && jobs[next_to_report].is_done) {
+      copy_diagnostics(jobs[next_to_report].diagnostics_fd);
+      (void) close(jobs[next_to_report].diagnostics_fd);
+      next_to_report++;
+    }
+  }
+  for (int i = 0; i < ndocs; i++)
+    delete[] outputs[i];
+  delete[] outputs;
+  delete[] jobs;
+  return ret;
+#else
+  fatal("'--jobs' option is not supported on this system");
+  return 0;
+#endif
 }
 
 possible_command::possible_command()
@@ -863,7 +1188,7 @@ void usage(FILE *stream)
 " [-o page-list] [-P postprocessor-argument] [-r cnumeric-expression]"
 " [-r register=numeric-expression] [-T output-device]"
 " [-w warning-category] [-W warning-category]"
-" [file ...]\n"
+" [--jobs=n] [--stats[=format]] [file ...]\n"
 "usage: %s {-v | --version}\n"
 "usage: %s {-h | --help}\n",
 	  program_name, program_name, program_name);
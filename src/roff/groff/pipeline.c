@@ -36,6 +36,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #ifdef _POSIX_VERSION
 
 #include <sys/wait.h>
+#include <sys/time.h> /* gettimeofday() */
+#include <sys/resource.h> /* struct rusage, wait4() */
 #define PID_T pid_t
 
 #else /* not _POSIX_VERSION */
@@ -75,7 +77,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "pipeline.h"
 
 /* Prototype */
-int run_pipeline(int, char ***, bool);
+int run_pipeline(int, char ***, bool, struct command_stats *);
 
 #ifdef __cplusplus
 extern "C" {
@@ -91,6 +93,20 @@ extern const char *i_to_a(int);		/* from libgroff */
 
 static void sys_fatal(const char *);
 
+/* Mark every measurement of `ncommands` commands as unavailable. */
+static void clear_stats(int ncommands, struct command_stats *stats)
+{
+  int i;
+
+  for (i = 0; i < ncommands; i++) {
+    stats[i].wall_time = -1;
+    stats[i].user_time = -1;
+    stats[i].system_time = -1;
+    stats[i].max_rss = -1;
+    stats[i].output_bytes = -1;
+  }
+}
+
 #if defined(__MSDOS__) \
     || (defined(_WIN32) && !defined(_UWIN) && !defined(__CYGWIN__)) \
     || defined(__EMX__)
@@ -203,7 +219,8 @@ int is_system_shell(const char *prog)
   and before waiting for any of the children.
 */
 
-int run_pipeline(int ncommands, char ***commands, bool no_pipe)
+int run_pipeline(int ncommands, char ***commands, bool no_pipe,
+		 struct command_stats *stats)
 {
   int i;
   int last_input = 0;	/* pacify some compilers */
@@ -213,6 +230,8 @@ int run_pipeline(int ncommands, char ***commands, bool no_pipe)
   char err_str[BUFSIZ];
   PID_T pids[MAX_COMMANDS];
 
+  if (stats != NULL)
+    clear_stats(ncommands, stats);
   for (i = 0; i < ncommands; i++) {
     int pdes[2];
     PID_T pid;
@@ -349,7 +368,8 @@ static RETSIGTYPE signal_catcher(int signo)
   child_interrupted++;
 }
 
-int run_pipeline(int ncommands, char ***commands, bool no_pipe)
+int run_pipeline(int ncommands, char ***commands, bool no_pipe,
+		 struct command_stats *stats)
 {
   int save_stdin = dup(0);
   int save_stdout = dup(1);
@@ -374,6 +394,9 @@ int run_pipeline(int ncommands, char ***commands, bool no_pipe)
   tmpfiles[0] = tempnam(tmpdir, NULL);
   tmpfiles[1] = tempnam(tmpdir, NULL);
 
+  if (stats != NULL)
+    clear_stats(ncommands, stats);
+
   for (i = 0; i < ncommands; i++) {
     int exit_status;
     RETSIGTYPE (*prev_handler)(int);
@@ -436,22 +459,134 @@ int run_pipeline(int ncommands, char ***commands, bool no_pipe)
 
 #else /* not __MSDOS__, not _WIN32 */
 
-int run_pipeline(int ncommands, char ***commands, bool no_pipe)
+static double seconds_since(const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start->tv_sec)
+	 + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+/* A byte count sent by a counting process to run_pipeline(). */
+struct byte_count {
+  int index;
+  long bytes;
+};
+
+/* Copy the data arriving on the pipe read end `from` to a new pipe,
+   counting it, in a child process.  When the writer closes the pipe,
+   send the count on `report_fd`, tagged with `index`.  Return the read
+   end of the new pipe; store the child's process ID in `*pidp`. */
+static int interpose_counter(int from, int index, int report_fd,
+			     PID_T *pidp)
+{
+  int pdes[2];
+  PID_T pid;
+
+  if (pipe(pdes) < 0)
+    sys_fatal("pipe");
+  pid = fork();
+  if (pid < 0)
+    sys_fatal("fork");
+  if (pid == 0) {
+    /* child */
+    static char buf[65536];
+    struct byte_count count;
+    bool is_writable = true;
+
+    /* If the reader goes away, stop; the writer then gets SIGPIPE as
+       it would have without us. */
+    signal(SIGPIPE, SIG_IGN);
+    if (close(pdes[0]) < 0)
+      sys_fatal("close");
+    count.index = index;
+    count.bytes = 0;
+    while (is_writable) {
+      ssize_t n = read(from, buf, sizeof buf);
+      char *p = buf;
+
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n <= 0)
+	break;
+      while (n > 0) {
+	ssize_t written = write(pdes[1], p, n);
+
+	if (written < 0) {
+	  if (errno == EINTR)
+	    continue;
+	  is_writable = false;
+	  break;
+	}
+	p += written;
+	n -= written;
+	count.bytes += written;
+      }
+    }
+    /* A write this small to a pipe is atomic. */
+    (void)write(report_fd, &count, sizeof count);
+    _exit(0);
+  }
+  /* in the parent */
+  if (close(from) < 0 || close(pdes[1]) < 0)
+    sys_fatal("close");
+  *pidp = pid;
+  return pdes[0];
+}
+
+/* Record the resource usage of a command that has exited. */
+static void note_stats(struct command_stats *st,
+		       const struct timeval *start,
+		       const struct rusage *usage)
+{
+  st->wall_time = seconds_since(start);
+#ifdef HAVE_WAIT4
+  st->user_time = usage->ru_utime.tv_sec
+		  + usage->ru_utime.tv_usec / 1e6;
+  st->system_time = usage->ru_stime.tv_sec
+		    + usage->ru_stime.tv_usec / 1e6;
+  /* Linux and the BSDs report kibibytes, macOS bytes. */
+#ifdef __APPLE__
+  st->max_rss = usage->ru_maxrss / 1024;
+#else
+  st->max_rss = usage->ru_maxrss;
+#endif
+#endif /* HAVE_WAIT4 */
+}
+
+int run_pipeline(int ncommands, char ***commands, bool no_pipe,
+		 struct command_stats *stats)
 {
   int i;
   int last_input = 0;
   PID_T pids[MAX_COMMANDS];
+  PID_T counter_pids[MAX_COMMANDS];
+  struct timeval start_times[MAX_COMMANDS];
+  int report_pipe[2];
   int ret = 0;
   int proc_count = ncommands;
 
+  if (stats != NULL) {
+    clear_stats(ncommands, stats);
+    if (pipe(report_pipe) < 0)
+      sys_fatal("pipe");
+    /* Only the counting processes, which do not exec, need it. */
+    if (fcntl(report_pipe[0], F_SETFD, FD_CLOEXEC) < 0
+	|| fcntl(report_pipe[1], F_SETFD, FD_CLOEXEC) < 0)
+      sys_fatal("fcntl");
+  }
   for (i = 0; i < ncommands; i++) {
     int pdes[2];
     PID_T pid;
 
+    counter_pids[i] = -1;
     if ((i != ncommands - 1) && !no_pipe) {
       if (pipe(pdes) < 0)
 	sys_fatal("pipe");
     }
+    if (stats != NULL)
+      gettimeofday(&start_times[i], NULL);
     pid = fork();
     if (pid < 0)
       sys_fatal("fork");
@@ -489,19 +624,40 @@ int run_pipeline(int ncommands, char ***commands, bool no_pipe)
       if (close(pdes[1]) < 0)
 	sys_fatal("close");
       last_input = pdes[0];
+      if (stats != NULL) {
+	last_input = interpose_counter(last_input, i, report_pipe[1],
+				       &counter_pids[i]);
+	proc_count++;
+      }
     }
     pids[i] = pid;
   }
+  if (stats != NULL && close(report_pipe[1]) < 0)
+    sys_fatal("close");
   while (proc_count > 0) {
     int status;
+    struct rusage usage;
+#ifdef HAVE_WAIT4
+    PID_T pid = (stats != NULL) ? wait4(-1, &status, 0, &usage)
+				: wait(&status);
+#else
     PID_T pid = wait(&status);
+#endif
 
     if (pid < 0)
       sys_fatal("wait");
+    for (i = 0; i < ncommands; i++)
+      if (counter_pids[i] == pid) {
+	counter_pids[i] = -1;
+	--proc_count;
+	break;
+      }
     for (i = 0; i < ncommands; i++)
       if (pids[i] == pid) {
 	pids[i] = -1;
 	--proc_count;
+	if (stats != NULL)
+	  note_stats(&stats[i], &start_times[i], &usage);
 	if (WIFSIGNALED(status)) {
 	  ret |= 2;
 	  int sig = WTERMSIG(status);
@@ -544,6 +700,16 @@ int run_pipeline(int ncommands, char ***commands, bool no_pipe)
 	break;
       }
   }
+  if (stats != NULL) {
+    struct byte_count count;
+
+    while (read(report_pipe[0], &count, sizeof count)
+	   == (ssize_t)sizeof count)
+      if (count.index >= 0 && count.index < ncommands)
+	stats[count.index].output_bytes = count.bytes;
+    if (close(report_pipe[0]) < 0)
+      sys_fatal("close");
+  }
   return ret;
 }
 
@@ -16,9 +16,20 @@ for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+/* What run_pipeline() measures for each command when asked to.  Times
+   are in seconds.  A negative value means that the measurement is not
+   available; output is counted only for commands writing to a pipe. */
+struct command_stats {
+  double wall_time;
+  double user_time;
+  double system_time;
+  long max_rss;			/* in kibibytes */
+  long output_bytes;
+};
+
 #ifdef __cplusplus
 extern "C" {
-  int run_pipeline(int, char ***, bool);
+  int run_pipeline(int, char ***, bool, struct command_stats *);
 }
 #endif
 
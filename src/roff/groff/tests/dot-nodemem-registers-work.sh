@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+    echo "...FAILED" >&2
+    fail=yes
+}
+
+# Unit-test `.nodemem` and `.nodemempeak` registers.
+
+input='.
+The quick brown fox jumps over the lazy dog.
+.nr live \n[.nodemem]
+.nr peak1 \n[.nodemempeak]
+.br
+.tm live=\n[live]
+.tm after-break=\n[.nodemem]
+.tm peak=\n[peak1]
+.'
+
+output=$(printf '%s\n' "$input" | "$groff" -T ascii -z 2>&1)
+echo "$output"
+
+echo "checking that a pending output line occupies node memory" >&2
+echo "$output" | grep -q '^live=[1-9][0-9]*$' || wail
+
+echo "checking that breaking the line releases its nodes" >&2
+echo "$output" | grep -qx 'after-break=0' || wail
+
+echo "checking that peak node memory is at least live node memory" >&2
+peak=$(echo "$output" | sed -n 's/^peak=//p')
+live=$(echo "$output" | sed -n 's/^live=//p')
+test "${peak:-0}" -ge "${live:-1}" || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=4 tabstop=4 textwidth=72:
@@ -0,0 +1,85 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+# The test changes directories, so the path to groff must be absolute.
+groff="${abs_top_builddir:-$PWD}/test-groff"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=groff-jobs.d
+
+cleanup () {
+  cd "$olddir" && rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+olddir=$PWD
+mkdir "$dir" && cd "$dir" || exit 99
+
+# The first document takes a while, so that the second one finishes
+# before it does.
+printf '%s\n' '.tm first' '.nr x 0 1' '.while \n+x<20000 .nr y \nx' \
+  'one' > slow.tr
+printf '%s\n' '.tm second' 'two' > fast.tr
+printf '%s\n' 'three' > three.tr
+
+echo "checking that --jobs formats each document to its own file" >&2
+error=$("$groff" -T utf8 --jobs=2 slow.tr fast.tr three.tr 2>&1) \
+  || wail
+echo "$error"
+test "$(cat slow.tr.utf8)" = one || wail
+test "$(cat fast.tr.utf8)" = two || wail
+test "$(cat three.tr.utf8)" = three || wail
+
+echo "checking that --jobs reports diagnostics in operand order" >&2
+test "$error" = "$(printf '%s\n' first second)" || wail
+
+echo "checking that --jobs names intermediate output files" >&2
+"$groff" -T utf8 -Z --jobs=2 three.tr || wail
+grep -q '^tthree' three.tr.grout || wail
+
+echo "checking that --jobs fails if any document does" >&2
+"$groff" -T utf8 --jobs=2 three.tr nonexistent.tr && wail
+test "$(cat three.tr.utf8)" = three || wail
+
+echo "checking that --jobs rejects clashing output file names" >&2
+mkdir sub && cp three.tr sub || exit 99
+"$groff" -T utf8 --jobs=2 three.tr sub/three.tr && wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
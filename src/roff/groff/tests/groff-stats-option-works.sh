@@ -0,0 +1,62 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+input='.
+hello, world
+.'
+
+expected=$(printf '%s\n' "$input" | "$groff" -T utf8)
+
+echo "checking that --stats does not alter the output" >&2
+output=$(printf '%s\n' "$input" | "$groff" -T utf8 --stats 2>/dev/null)
+test "$output" = "$expected" || wail
+
+echo "checking that --stats reports each command in a table" >&2
+report=$(printf '%s\n' "$input" | "$groff" -T utf8 --stats 2>&1 \
+  >/dev/null)
+echo "$report"
+echo "$report" | grep -q '^command  *wall' || wail
+# troff's output is counted, but that of the last command is not.
+echo "$report" | grep -Eq '^troff( +[0-9.]+){4} +[1-9][0-9]*$' || wail
+echo "$report" | grep -Eq '^grotty( +[0-9.]+){4} +-$' || wail
+
+echo "checking that --stats=json reports each command" >&2
+report=$(printf '%s\n' "$input" | "$groff" -T utf8 --stats=json 2>&1 \
+  >/dev/null)
+echo "$report"
+echo "$report" | grep -q '^\[{"command": "troff", "wall_time": ' \
+  || wail
+echo "$report" \
+  | grep -q '"command": "grotty", .*"output_bytes": null}]$' || wail
+
+echo "checking that --stats rejects an unknown format" >&2
+printf '%s\n' "$input" | "$groff" -T utf8 --stats=xml && wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
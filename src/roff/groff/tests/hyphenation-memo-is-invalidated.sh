@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+# The formatter remembers the hyphenation points it finds in each word;
+# verify that changes to the exceptions are nevertheless honored.
+
+input='.
+.ll 8n
+.ad l
+.hy 1
+hyphenation
+.br
+.hw hyphena-tion
+hyphenation
+.br
+.rhw hyphenation
+hyphenation
+.'
+
+output=$(printf '%s\n' "$input" | "$groff" -T ascii -ww)
+echo "$output"
+
+echo "checking hyphenation from patterns" >&2
+test "$(echo "$output" | sed -n 1p)" = 'hyphen-' || wail
+
+echo "checking hyphenation from 'hw' request" >&2
+test "$(echo "$output" | sed -n 3p)" = 'hyphena-' || wail
+
+echo "checking hyphenation after 'rhw' request" >&2
+test "$(echo "$output" | sed -n 5p)" = 'hyphen-' || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+groff="${abs_top_builddir:-.}/test-groff"
+troff="${abs_top_builddir:-.}/troff"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=hyphenation-pattern-cache.d
+patterns=$dir/hyphen.test
+cache=$patterns.hpc
+
+cleanup () {
+  rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+mkdir "$dir" || exit 99
+printf '\\patterns{\nc1d\n}\n' > "$patterns"
+
+input='.
+.ll 4n
+.ad l
+.hla xx
+.hpf hyphen.test
+.hy 1
+abcdef
+.'
+
+echo "checking that troff writes a pattern cache file" >&2
+echo ".hla xx
+.hpf hyphen.test" | "$troff" $fontdirs -M "$dir" -R -z \
+  --write-hyphenation-caches
+test -f "$cache" || wail
+
+echo "checking that patterns are read from the cache" >&2
+# Change the patterns but keep the file older than its cache.
+printf '\\patterns{\nb1c\n}\n' > "$patterns"
+touch -t 200001010000 "$patterns"
+output=$(echo "$input" | "$groff" -M "$dir" -T ascii)
+echo "$output"
+test "$(echo "$output" | sed -n 1p)" = 'abc-' || wail
+
+echo "checking that a stale cache is ignored" >&2
+touch -t 200001010000 "$cache"
+touch -t 200101010000 "$patterns"
+output=$(echo "$input" | "$groff" -M "$dir" -T ascii)
+echo "$output"
+test "$(echo "$output" | sed -n 1p)" = 'ab-' || wail
+
+echo "checking that a corrupt cache is ignored" >&2
+printf '\\patterns{\nc1d\n}\n' > "$patterns"
+echo ".hla xx
+.hpf hyphen.test" | "$troff" $fontdirs -M "$dir" -R -z \
+  --write-hyphenation-caches
+printf '\\patterns{\nb1c\n}\n' > "$patterns"
+touch -t 200001010000 "$patterns"
+# The cache ends with the operations of the only pattern, "c1d", and
+# their terminator.  Make the pattern's operation reach back further
+# than any word.
+size=$(wc -c < "$cache")
+printf '\310' \
+  | dd of="$cache" bs=1 seek=$((size - 4)) conv=notrunc 2>/dev/null
+output=$(echo "$input" | "$groff" -M "$dir" -T ascii)
+echo "$output"
+test "$(echo "$output" | sed -n 1p)" = 'ab-' || wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+input='.
+.de show
+.  tm \\n(.$: 1=[\\$1] 3=[\\$3] *=[\\$*] ^=[\\$^]
+..
+.de inner
+.  tm inner: \\n(.$: [\\$1] [\\$2] [\\$3]
+..
+.de outer
+.  show \\$@
+.  shift
+.  show \\$@
+.  inner \\$@
+.  shift 5
+.  show \\$@
+..
+.ds str \\$2
+.de call-string
+.  tm string: [\\*[str]]
+..
+.outer a "b c" "" "d ""e"""
+.call-string x y z
+.'
+
+expected='4: 1=[a] 3=[] *=[a b c  d "e"] ^=["a" "b c" "" "d "e""]
+3: 1=[b c] 3=[d "e"] *=[b c  d "e"] ^=["b c" "" "d "e""]
+inner: 3: [b c] [] [d "e"]
+0: 1=[] 3=[] *=[] ^=[]
+string: [y]'
+
+echo "checking macro argument interpolation and shifting" >&2
+output=$(printf "%s\n" "$input" | "$groff" -z 2>&1)
+echo "$output"
+test "$output" = "$expected" || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it over
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+  echo ...FAILED >&2
+  fail=YES
+}
+
+# troff formats runs of ordinary input characters together.  Verify
+# that characters treated specially in the middle of such a run still
+# get their special treatment.
+
+input='.
+.nf
+.tr ab
+abracadabra
+.tr aa
+.char x [ex]
+taxicab
+.rchar x
+.fc # ^
+.ta 20n
+#left^right#
+.fc
+.ec @
+back\slash@(emdash
+.ec
+.fi
+.hy 0
+.ll 8n
+.cflags 4 -
+abc-defghij
+.'
+
+output=$(printf '%s\n' "$input" | "$groff" -T ascii -W break)
+echo "$output"
+
+echo "checking translation within a run" >&2
+echo "$output" | grep -qx 'bbrbcbdbbrb' || wail
+
+echo "checking character defined as a macro within a run" >&2
+echo "$output" | grep -qx 'ta\[ex\]icab' || wail
+
+echo "checking field delimiter and padding within a run" >&2
+echo "$output" | grep -qx 'left  *right' || wail
+
+echo "checking changed escape character within a run" >&2
+echo "$output" | grep -qx 'back\\slash--dash' || wail
+
+echo "checking break flag within a run" >&2
+echo "$output" | grep -qx 'abc-' || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+groff="${abs_top_builddir:-.}/test-groff"
+
+fail=
+
+wail () {
+    echo "...FAILED" >&2
+    fail=yes
+}
+
+# Unit-test total-fit line breaking.  The first-fit breaker sets the
+# first output line tight, leaving the second to absorb three ens of
+# slack in three spaces; the total-fit breaker spreads the slack across
+# four spaces on the first line instead.
+
+input='.
+.ll 24n
+.nh
+.nr first-fit \n[.padj]
+.padj
+.nr total-fit \n[.padj]
+There would at who is he could thing their and but down could how some
+then.
+.sp
+.padj 0
+There would at who is he could thing their and but down could how some
+then.
+.pl \n[nl]u
+.tm first-fit=\n[first-fit] total-fit=\n[total-fit]
+.'
+
+output=$(printf '%s\n' "$input" | "$groff" -T ascii 2>&1)
+echo "$output"
+
+echo "checking that .padj register reflects setting" >&2
+echo "$output" | grep -qx 'first-fit=0 total-fit=1' || wail
+
+echo "checking total-fit line breaking" >&2
+test "$(echo "$output" | sed -n '2,3p')" = 'There  would  at  who is
+he could thing their and' || wail
+
+echo "checking that first-fit line breaking can be restored" >&2
+test "$(echo "$output" | sed -n '7,8p')" = 'There would at who is he
+could  thing  their  and' || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=4 tabstop=4 textwidth=72:
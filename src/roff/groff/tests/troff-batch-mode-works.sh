@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+troff="${abs_top_builddir:-.}/troff"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+tmacdirs="-M ${abs_top_srcdir:-..}/tmac"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=troff-batch-mode.d
+
+cleanup () {
+  rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+mkdir "$dir" || exit 99
+printf '%s\n' \
+  '.de greet' \
+  'hello, \\$1!' \
+  '..' \
+  '.nr count 3 1' > "$dir/batchtest.tmac"
+printf '%s\n' '.greet world' '\n+[count]' > "$dir/doc1.tr"
+printf '%s\n' '.greet moon' '\n+[count]' '.nr count 10' \
+  > "$dir/doc2.tr"
+
+run () {
+  "$troff" $fontdirs $tmacdirs -M "$dir" -T utf8 -m batchtest "$@"
+}
+
+expected1=$(run "$dir/doc1.tr")
+expected2=$(run "$dir/doc2.tr")
+
+echo "checking that batch mode formats each listed document" >&2
+printf '%s\t%s\n' "$dir/doc1.tr" "$dir/out1" "$dir/doc2.tr" \
+  "$dir/out2" "$dir/doc1.tr" "$dir/out3" > "$dir/list"
+status=$(run --batch="$dir/list") || wail
+echo "$status"
+test "$(cat "$dir/out1")" = "$expected1" || wail
+test "$(cat "$dir/out2")" = "$expected2" || wail
+
+echo "checking that each document starts from the start-up state" >&2
+test "$(cat "$dir/out3")" = "$expected1" || wail
+
+echo "checking that batch mode reports each document's status" >&2
+expected_status=$(printf '0\t%s\n' "$dir/out1" "$dir/out2" \
+  "$dir/out3")
+test "$status" = "$expected_status" || wail
+
+echo "checking that batch mode reads a list from the standard input" >&2
+status=$(printf '%s\t%s\n' "$dir/nonexistent.tr" "$dir/out4" \
+  "$dir/doc2.tr" "$dir/out5" | run --batch=- 2>/dev/null) && wail
+echo "$status"
+echo "$status" | grep -q "^1	$dir/out4\$" || wail
+test "$(cat "$dir/out5")" = "$expected2" || wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+troff="${abs_top_builddir:-.}/troff"
+grotty="${abs_top_builddir:-.}/grotty"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+# Exercise text, special and numbered characters, motions, a device
+# extension command, a drawing command (which stays textual), and
+# transparent throughput.
+input='.
+.ll 40n
+.ad l
+Hello, world\[em]and \[lq]quoted\[rq] text.
+.br
+\[em]\N"65"\h"3n"\X"tty: link https://example.com/"link\X"tty: link"
+.sp
+\D"l 10n 0"
+.br
+\!# a comment passed through
+after the line
+.'
+
+echo "checking that troff announces binary output" >&2
+output=$(echo "$input" | "$troff" $fontdirs -T utf8 --binary-output \
+  | sed -n 4p)
+echo "$output"
+test "$output" = 'x binary 1' || wail
+
+echo "checking that binary output formats as text output does" >&2
+text=$(echo "$input" | "$troff" $fontdirs -T utf8 \
+  | "$grotty" $fontdirs)
+binary=$(echo "$input" | "$troff" $fontdirs -T utf8 --binary-output \
+  | "$grotty" $fontdirs)
+echo "$text"
+echo "$binary"
+test -n "$text" || wail
+test "$text" = "$binary" || wail
+
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
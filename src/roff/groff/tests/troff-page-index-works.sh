@@ -0,0 +1,127 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+troff="${abs_top_builddir:-.}/troff"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=troff-page-index.d
+
+cleanup () {
+  rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+mkdir "$dir" || exit 99
+
+input='.
+.pl 2i
+.de tp
+.tl @@- % -@@
+.sp
+..
+.wh 0 tp
+one
+.bp
+two
+.bp
+three
+.bp
+four
+.'
+
+# Print the line of file $1 that begins at byte offset $2.
+line_at () {
+  tail -c +$(( $2 + 1 )) "$1" | sed 1q
+}
+
+echo "checking that every page written is indexed" >&2
+printf '%s\n' "$input" \
+  | "$troff" $fontdirs -T ps --page-index="$dir/index" > "$dir/out" \
+    2> /dev/null
+cat "$dir/index"
+test $(wc -l < "$dir/index") -eq 4 || wail
+
+echo "checking that each page's entry locates its 'p' command" >&2
+end=
+while read page offset length
+do
+  test "$(line_at "$dir/out" $offset)" = "p$page" || wail
+  test -z "$end" || test $offset -eq $end || wail
+  end=$(( offset + length ))
+done < "$dir/index"
+
+echo "checking that the last page's entry ends at the trailer" >&2
+test "$(line_at "$dir/out" $end)" = "x trailer" || wail
+
+echo "checking that only selected pages are indexed" >&2
+printf '%s\n' "$input" \
+  | "$troff" $fontdirs -T ps -o 2,4 --page-index="$dir/index" \
+    > "$dir/out" 2> /dev/null
+cat "$dir/index"
+test "$(cut -d ' ' -f 1 "$dir/index" | tr '\n' ' ')" = "2 4 " || wail
+while read page offset length
+do
+  test "$(line_at "$dir/out" $offset)" = "p$page" || wail
+done < "$dir/index"
+
+echo "checking that each document of a batch gets its own index" >&2
+printf '%s\n' "$input" > "$dir/doc1.tr"
+printf '%s\n' '.pl 2i' one .bp two > "$dir/doc2.tr"
+printf '%s\t%s\n' "$dir/doc1.tr" "$dir/out1" "$dir/doc2.tr" \
+  "$dir/out2" \
+  | "$troff" $fontdirs -T ps --batch=- --page-index="$dir/batch" \
+    > /dev/null 2>&1
+test -f "$dir/batch" && wail
+for n in 1 2
+do
+  cat "$dir/batch.$n"
+  while read page offset length
+  do
+    test "$(line_at "$dir/out$n" $offset)" = "p$page" || wail
+    end=$(( offset + length ))
+  done < "$dir/batch.$n"
+  test "$(line_at "$dir/out$n" $end)" = "x trailer" || wail
+done
+test $(wc -l < "$dir/batch.1") -eq 4 || wail
+test $(wc -l < "$dir/batch.2") -eq 2 || wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
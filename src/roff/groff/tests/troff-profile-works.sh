@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+troff="${abs_top_builddir:-.}/troff"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+tmacdirs="-M ${abs_top_srcdir:-..}/tmac"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=troff-profile.d
+
+cleanup () {
+  rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+mkdir "$dir" || exit 99
+
+input='.
+.de inner
+\\$1
+..
+.de outer
+.inner \\$1
+.inner \\$1
+..
+.de countdown
+.if \\$1>0 .countdown \\$1-1
+..
+.outer hello
+.outer world
+.countdown 5
+.'
+
+run () {
+  printf '%s\n' "$input" \
+    | "$troff" $fontdirs $tmacdirs -T utf8 "$@"
+}
+
+expected=$(run)
+
+echo "checking that profiling does not alter the output" >&2
+output=$(run --profile="$dir/report" --profile-stacks="$dir/stacks")
+test "$output" = "$expected" || wail
+
+echo "checking that the profile report counts calls" >&2
+cat "$dir/report"
+grep -Eq '^ +2( +[0-9.]+){6} macro +outer$' "$dir/report" || wail
+grep -Eq '^ +4( +[0-9.]+){6} macro +inner$' "$dir/report" || wail
+grep -Eq '^ +6( +[0-9.]+){6} macro +countdown$' "$dir/report" || wail
+grep -Eq '^ +[0-9]+( +[0-9.]+){6} request +if$' "$dir/report" || wail
+
+echo "checking that the profile stacks record nesting" >&2
+cat "$dir/stacks"
+grep -q '^outer;inner [0-9][0-9]*$' "$dir/stacks" || wail
+grep -q '^countdown;countdown;\[if\] [0-9][0-9]*$' "$dir/stacks" \
+  || wail
+
+echo "checking that each document of a batch gets its own profile" >&2
+printf '.de one\n..\n.one\n' > "$dir/doc1"
+printf '.de two\n..\n.two\n' > "$dir/doc2"
+printf '%s\t%s\n' "$dir/doc1" "$dir/out1" "$dir/doc2" "$dir/out2" \
+  | "$troff" $fontdirs $tmacdirs -T utf8 --batch=- \
+    --profile="$dir/batch" > /dev/null
+grep -q ' macro  *one$' "$dir/batch.1" || wail
+grep -q ' macro  *two$' "$dir/batch.1" && wail
+grep -q ' macro  *two$' "$dir/batch.2" || wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# Copyright 2026 Free Software Foundation, Inc.
+#
+# This file is part of groff, the GNU roff typesetting system.
+#
+# groff is free software; you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# groff is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+troff="${abs_top_builddir:-.}/troff"
+fontdirs="-F ${abs_top_builddir:-.}/font -F ${abs_top_srcdir:-..}/font"
+tmacdirs="-M ${abs_top_srcdir:-..}/tmac"
+
+fail=
+
+wail () {
+  echo "...FAILED" >&2
+  fail=yes
+}
+
+dir=troff-snapshot.d
+snapshot=$dir/test.snap
+
+cleanup () {
+  rm -rf "$dir"
+}
+
+# A process handling a fatal signal should:
+#   1.  Mask all fatal signals of interest.  (GBR often excludes ABRT.)
+#   2.  Perform cleanup operations.
+#   3.  Unmask the signal (removing the handler).
+#   4.  Signal its own process group with the signal caught so that the
+#       the children exit and shell accurately reports how the process
+#       died.
+fatals="HUP INT QUIT TERM"
+for s in $fatals
+do
+  trap "trap '' $fatals; cleanup; trap - $fatals; kill -$s -$$" $s
+done
+
+mkdir "$dir" || exit 99
+printf '%s\n' \
+  '.ds greeting hello' \
+  '.de greet' \
+  '\\*[greeting], \\$1!' \
+  '..' \
+  '.nr count 3 1' \
+  '.ll 5i' > "$dir/snaptest.tmac"
+
+input='.
+.greet world
+\n+[count] \n[.l]u
+.'
+
+run () {
+  printf '%s\n' "$input" \
+    | "$troff" $fontdirs $tmacdirs -M "$dir" -T utf8 -m snaptest "$@"
+}
+
+expected=$(run)
+echo "$expected"
+
+echo "checking that troff writes a snapshot file" >&2
+output=$(run --snapshot="$snapshot")
+test -f "$snapshot" || wail
+test "$output" = "$expected" || wail
+
+echo "checking that a restored snapshot yields the same output" >&2
+output=$(run --snapshot="$snapshot")
+test "$output" = "$expected" || wail
+
+echo "checking that a changed start-up file invalidates the snapshot" >&2
+printf '%s\n' '.ds greeting goodbye' >> "$dir/snaptest.tmac"
+output=$(run --snapshot="$snapshot")
+echo "$output"
+echo "$output" | grep -q 'goodbye' || wail
+output=$(run --snapshot="$snapshot")
+echo "$output" | grep -q 'goodbye' || wail
+
+echo "checking that troff declines to snapshot unsupported requests" >&2
+rm -f "$snapshot"
+printf '%s\n' '.tm snaptest loaded' >> "$dir/snaptest.tmac"
+error=$(run --snapshot="$snapshot" 2>&1 >/dev/null)
+echo "$error"
+echo "$error" | grep -q 'not writing snapshot file' || wail
+test -f "$snapshot" && wail
+
+cleanup
+test -z "$fail"
+
+# vim:set autoindent expandtab shiftwidth=2 tabstop=2 textwidth=72:
@@ -26,6 +26,8 @@ extern bool using_character_classes;	// was `class` request invoked?
 extern void recompute_character_flags();
 
 class macro;
+class snapshot_writer;
+class snapshot_reader;
 
 // libgroff has a simpler `charinfo` class that stores much less
 // information.
@@ -87,6 +89,7 @@ public:
   bool prohibits_break_before();
   bool prohibits_break_after();
   bool is_interword_space();
+  bool is_plain();
   unsigned char get_hyphenation_code();
   unsigned char get_ascii_code();
   unsigned char get_asciify_code();
@@ -123,10 +126,17 @@ public:
   void describe_flags();
   void dump_flags();
   void dump();
+  bool write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 extern charinfo *lookup_charinfo(symbol,
 				 bool /* suppress_creation */ = false);
+// While a snapshot is written or read, look up a `charinfo` by the
+// index that its `glyph` base class records, and vice versa (a null
+// pointer has index -1); see input.cpp.
+extern charinfo *charinfo_for_glyph_index(int);
+extern int charinfo_glyph_index(charinfo *);
 extern charinfo *charset_table[];
 
 inline bool charinfo::overlaps_horizontally()
@@ -199,6 +209,21 @@ inline bool charinfo::is_interword_space()
   return (flags & IS_INTERWORD_SPACE);
 }
 
+// Can the character be formatted as a bare glyph node?  It must not be
+// translated, defined as a macro, or flagged to affect line breaking.
+inline bool charinfo::is_plain()
+{
+  if (using_character_classes)
+    recompute_character_flags();
+  return ((TRANSLATE_NONE == special_translation)
+	  && (0 /* nullptr */ == translation)
+	  && (0 /* nullptr */ == mac)
+	  && !(flags & (ALLOWS_BREAK_BEFORE | ALLOWS_BREAK_AFTER
+			| IGNORES_SURROUNDING_HYPHENATION_CODES
+			| PROHIBITS_BREAK_BEFORE | PROHIBITS_BREAK_AFTER
+			| IS_INTERWORD_SPACE)));
+}
+
 inline bool charinfo::is_numbered()
 {
   return (number >= 0);
@@ -34,28 +34,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "errarg.h" // prerequisite of error.h
 #include "error.h"
 
-// is 'p' a good size for a hash table
-
-static bool is_good_size(ssize_t p)
-{
-  const ssize_t SMALL = 10;
-  ssize_t i;
-  for (i = 2; i <= (p / 2); i++)
-    if ((p % i) == 0)
-      return false;
-  for (i = 0x100; ; i <<= 8) {
-    if (((i % p) <= SMALL) || ((i % p) > (p - SMALL)))
-      return false;
-    if (i > (SSIZE_MAX >> 8))
-      break;
-  }
-  return true;
-}
-
 dictionary::dictionary(ssize_t n)
-  : capacity(n), occupancy(0), threshold(0.5), factor(1.5)
+  : capacity(1), occupancy(0)
 {
-  table = new association[n];
+  // Use a power of 2 so that a symbol's hash code can be masked, not
+  // divided, to find its home slot.
+  while (capacity < n)
+    capacity <<= 1;
+  table = new association[capacity];
 }
 
 // see Knuth, Sorting and Searching, p518, Algorithm L
@@ -63,10 +49,11 @@ dictionary::dictionary(ssize_t n)
 
 void *dictionary::lookup(symbol s, void *v)
 {
+  ssize_t mask = capacity - 1;
   ssize_t i;
-  for (i = ssize_t(s.hash() % capacity);
+  for (i = ssize_t(s.hash() & mask);
        table[i].v != 0 /* nullptr */;
-       i == 0 ? i = (capacity - 1) : --i)
+       i = (i + 1) & mask)
     if (s == table[i].s) {
       if (v != 0 /* nullptr */) {
 	void *temp = table[i].v;
@@ -81,17 +68,13 @@ void *dictionary::lookup(symbol s, void *v)
   ++occupancy;
   table[i].v = v;
   table[i].s = s;
-  if (((static_cast<double>(occupancy) / static_cast<double>(capacity))
-      >= threshold) || ((occupancy + 1) >= capacity)) {
+  // Keep the table at most half full.
+  if (occupancy >= (capacity / 2)) {
     ssize_t old_capacity = capacity;
-    capacity = ssize_t(capacity * factor);
-    while (!is_good_size(capacity))
-      ++capacity;
-    if (capacity < 0)
-      // If `capacity` wrapped, its old value must have fit in a signed
-      // integer.
+    if (capacity > (SSIZE_MAX / 2))
       fatal("cannot grow dictionary beyond %1 entries",
 	    static_cast<int>(old_capacity));
+    capacity <<= 1;
     association *old_table = table;
     table = new association[capacity];
     occupancy = 0;
@@ -119,24 +102,26 @@ void *dictionary::remove(symbol s)
   // this relies on the fact that we are using linear probing
   // XXX: This method requires us to use a signed type for `i` and thus
   // for container capacity and occupancy.  -- GBR, 2026
+  ssize_t mask = capacity - 1;
   ssize_t i;
-  for (i = ssize_t(s.hash() % capacity);
+  for (i = ssize_t(s.hash() & mask);
        table[i].v != 0 /* nullptr */ && s != table[i].s;
-       i == 0 ? i = (capacity - 1) : --i)
+       i = (i + 1) & mask)
     ;
   void *p = table[i].v;
   while (table[i].v != 0 /* nullptr */) {
     table[i].v = 0 /* nullptr */;
     ssize_t j = i;
     ssize_t r;
+    // Find the next entry that may move back to the vacated slot `j`:
+    // one whose home slot `r` does not lie cyclically in (j, i].
     do {
-      --i;
-      if (i < 0)
-	i = capacity - 1;
+      i = (i + 1) & mask;
       if (table[i].v == 0 /* nullptr */)
 	break;
-      r = ssize_t(table[i].s.hash() % capacity);
-    } while ((i <= r && r < j) || (r < j && j < i) || (j < i && i <= r));
+      r = ssize_t(table[i].s.hash() & mask);
+    } while ((j < r && r <= i) || (i < j && j < r)
+	     || (r <= i && i < j));
     table[j] = table[i];
   }
   if (p != 0 /* nullptr */)
@@ -40,10 +40,8 @@ public:
 };
 
 class dictionary {
-  ssize_t capacity;
+  ssize_t capacity; // a power of 2
   ssize_t occupancy;
-  double threshold;
-  double factor;
   association *table;
 public:
   dictionary(ssize_t);
@@ -39,7 +39,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "symbol.h" // prerequisite of dictionary.h and color.h
 #include "color.h" // prerequisite of env.h
 #include "lib.h" // i_to_a()
-#include "stringclass.h" // prerequisite of mtsm.h
+#include "stringclass.h" // prerequisite of mtsm.h, snapshot.h
+#include "snapshot.h"
 
 // troff
 #include "troff.h" // prerequisite of hvunits.h, token.h; units
@@ -510,6 +511,8 @@ void top_level_diversion::transparent_output(unsigned char c)
     fatal("attempting transparent output from top-level diversion"
 	  " before first page has started, when a top-of-page trap is"
 	  " defined; invoke break or flush request beforehand");
+  if (!the_output->is_selected_for_printing())
+    return;
   const char *s = encode_for_stream_output(c);
   while (*s)
     the_output->transparent_char(*s++);
@@ -631,6 +634,99 @@ void top_level_diversion::change_trap(symbol nam, vunits pos)
 	  nam.contents());
 }
 
+// A snapshot is taken only before the first page has begun, so the
+// top-level diversion is all there is to save.
+
+void top_level_diversion::write_image(snapshot_writer &w)
+{
+  w.put_int(vertical_position.to_units());
+  w.put_int(high_water_mark.to_units());
+  w.put_int(is_in_no_space_mode);
+  w.put_int(marked_place.to_units());
+  modified_tag.write_image(w);
+  w.put_int(page_number);
+  w.put_int(page_count);
+  w.put_int(last_page_count);
+  w.put_int(page_length.to_units());
+  w.put_int(prev_page_offset.to_units());
+  w.put_int(page_offset.to_units());
+  int ntraps = 0;
+  for (trap *p = page_trap_list; p != 0 /* nullptr */; p = p->next)
+    ntraps++;
+  w.put_int(ntraps);
+  for (trap *p = page_trap_list; p != 0 /* nullptr */; p = p->next) {
+    w.put_string(p->nm.contents());
+    w.put_int(p->position.to_units());
+  }
+  w.put_int(overriding_next_page_number);
+  w.put_int(next_page_number);
+  w.put_int(ejecting_page);
+}
+
+void top_level_diversion::read_image(snapshot_reader &r)
+{
+  vertical_position = r.get_int();
+  high_water_mark = r.get_int();
+  is_in_no_space_mode = r.get_int();
+  marked_place = r.get_int();
+  modified_tag.read_image(r);
+  page_number = r.get_int();
+  page_count = r.get_int();
+  last_page_count = r.get_int();
+  page_length = r.get_int();
+  prev_page_offset = r.get_int();
+  page_offset = r.get_int();
+  while (page_trap_list != 0 /* nullptr */) {
+    trap *tem = page_trap_list;
+    page_trap_list = page_trap_list->next;
+    delete tem;
+  }
+  trap **pp = &page_trap_list;
+  int ntraps = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < ntraps; i++) {
+    const char *s = r.get_string();
+    vunits pos = r.get_int();
+    *pp = new trap((0 /* nullptr */ == s) ? symbol() : symbol(s), pos,
+		   0 /* nullptr */);
+    pp = &(*pp)->next;
+  }
+  overriding_next_page_number = r.get_int();
+  next_page_number = r.get_int();
+  ejecting_page = r.get_int();
+}
+
+bool write_diversion_snapshot(snapshot_writer &w)
+{
+  if (curdiv != topdiv) {
+    decline_snapshot("diversion '%1' is open",
+		     curdiv->get_diversion_name());
+    return false;
+  }
+  if (topdiv->before_first_page_status != 1) {
+    decline_snapshot("the first page has begun");
+    return false;
+  }
+  topdiv->write_image(w);
+  w.put_int(nl_reg_contents);
+  w.put_int(last_post_line_extra_space);
+  w.put_int(honor_vertical_position_traps);
+  w.put_int(truncated_space.to_units());
+  w.put_int(needed_space.to_units());
+  return true;
+}
+
+void read_diversion_snapshot(snapshot_reader &r)
+{
+  topdiv->read_image(r);
+  nl_reg_contents = r.get_int();
+  last_post_line_extra_space = r.get_int();
+  honor_vertical_position_traps = r.get_int();
+  truncated_space = r.get_int();
+  needed_space = r.get_int();
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+}
+
 void top_level_diversion::print_traps()
 {
   for (trap *p = page_trap_list; p != 0 /* nullptr */; p = p->next)
@@ -20,6 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 void do_divert(bool /* appending */, bool /* boxing */);
 void end_diversions();
 
+class snapshot_writer;
+class snapshot_reader;
+
 class diversion {
   friend void do_divert(bool /* appending */, bool /* boxing */);
   friend void end_diversions();
@@ -150,6 +153,8 @@ public:
   void clear_diversion_trap();
   void print_diversion_trap();
   void set_last_page() { last_page_count = page_count; }
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 inline void top_level_diversion::set_page_offset(hunits h)
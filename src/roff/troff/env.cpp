@@ -28,12 +28,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <math.h> // ceil(), fabs()
 #include <stdio.h> // prerequisite of mtsm.h, searchpath.h
 #include <stdlib.h> // strtol()
-#include <string.h> // strchr(), strcpy(), strerror(), strncmp(),
-		    // strstr()
+#include <string.h> // memcmp(), memset(), strchr(), strcpy(),
+		    // strerror(), strncmp(), strstr()
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h> // mmap(), munmap()
+#endif
 
 #include <stack> // prerequisite of mtsm.h
 #include <vector>
-#include <algorithm> // find()
+#include <algorithm> // find(), max()
+
+#include "posix.h" // fstat(), getpid(), open(), read(), stat()
+#include "nonposix.h" // FOPEN_WB, O_BINARY
 
 #include "symbol.h" // prerequisite of dictionary.h and color.h
 #include "color.h" // prerequisite of env.h
@@ -51,7 +58,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "charinfo.h"
 #include "dictionary.h" // object
 #include "hvunits.h" // prerequisite of div.h; hunits, vunits
-#include "stringclass.h" // prerequisite of mtsm.h
+#include "stringclass.h" // prerequisite of mtsm.h, snapshot.h
+#include "snapshot.h"
 #include "mtsm.h" // prerequisite of div.h; statem
 #include "div.h" // curdiv
 #include "env.h" // environment, font_size
@@ -401,13 +409,13 @@ void environment::add_char(charinfo *ci)
   dump_node_list_in_reverse(line);
 #endif
   if ((!suppress_push) && gc_np) {
-    if (gc_np && (gc_np->state == 0 /* nullptr */)) {
-      gc_np->state = construct_state(false);
-      gc_np->push_state = get_diversion_state();
+    if (gc_np && (gc_np->get_state() == 0 /* nullptr */)) {
+      gc_np->set_state(construct_state(false));
+      gc_np->set_push_state(get_diversion_state());
     }
-    else if (line && (line->state == 0 /* nullptr */)) {
-      line->state = construct_state(false);
-      line->push_state = get_diversion_state();
+    else if (line && (line->get_state() == 0 /* nullptr */)) {
+      line->set_state(construct_state(false));
+      line->set_push_state(get_diversion_state());
     }
   }
 #if 0
@@ -416,6 +424,35 @@ void environment::add_char(charinfo *ci)
 #endif
 }
 
+// Add a run of ordinary input characters to the line as `add_char()`
+// would one at a time.  Runs of characters needing nothing but a glyph
+// from the current font go to `add_glyph_run()` together.
+
+void environment::add_chars(const unsigned char *s, int n)
+{
+  const unsigned char *end = s + n;
+  while (s < end) {
+    if ((line != 0 /* nullptr */)
+	&& (current_tab == TAB_NONE)
+	&& !was_line_interrupted
+	&& !is_writing_html) {
+      // Stop short of characters that `add_char()` treats specially.
+      const unsigned char *p = s;
+      for (; p < end; p++) {
+	charinfo *ci = charset_table[*p];
+	if ((ci == field_delimiter_char)
+	    || (ci == padding_indicator_char)
+	    || (ci == hyphen_indicator_char))
+	  break;
+      }
+      s += add_glyph_run(&line, s, int(p - s), this, &width_total);
+      if (s == end)
+	break;
+    }
+    add_char(charset_table[*s++]);
+  }
+}
+
 node *environment::make_char_node(charinfo *ci)
 {
   return make_node(ci, this);
@@ -427,9 +464,9 @@ void environment::add_node(node *nd)
   if (0 /* nullptr */ == nd)
     return;
   if (!suppress_push) {
-    if (nd->is_special && (0 /* nullptr */ == nd->state))
-      nd->state = construct_state(false);
-    nd->push_state = get_diversion_state();
+    if (nd->is_special && (0 /* nullptr */ == nd->get_state()))
+      nd->set_state(construct_state(false));
+    nd->set_push_state(get_diversion_state());
   }
   if ((current_tab != TAB_NONE) || has_current_field)
     nd->freeze_space();
@@ -839,6 +876,7 @@ environment::environment(symbol nm)
   hyphen_line_max(-1),
   hyphenation_space(H0),
   hyphenation_margin(H0),
+  want_total_fit(false),
   composite(false),
   pending_lines(0 /* nullptr */),
 #ifdef WIDOW_CONTROL
@@ -933,6 +971,7 @@ environment::environment(const environment *e)
   hyphen_line_max(e->hyphen_line_max),
   hyphenation_space(e->hyphenation_space),
   hyphenation_margin(e->hyphenation_margin),
+  want_total_fit(e->want_total_fit),
   composite(false),
   pending_lines(0 /* nullptr */),
 #ifdef WIDOW_CONTROL
@@ -1029,6 +1068,7 @@ void environment::copy(const environment *e)
   hyphen_line_count = 0;
   hyphenation_space = e->hyphenation_space;
   hyphenation_margin = e->hyphenation_margin;
+  want_total_fit = e->want_total_fit;
   composite = false;
   stroke_color= e->stroke_color;
   prev_stroke_color = e->prev_stroke_color;
@@ -1036,6 +1076,230 @@ void environment::copy(const environment *e)
   prev_fill_color = e->prev_fill_color;
 }
 
+// An environment's image.  Partially collected output, such as a
+// pending line, has no image; the caller checks for it.
+
+static void write_family_image(snapshot_writer &w, font_family *f)
+{
+  w.put_string((0 /* nullptr */ == f) ? 0 /* nullptr */
+	       : f->nm.contents());
+}
+
+static font_family *read_family_image(snapshot_reader &r)
+{
+  const char *s = r.get_string();
+  return (0 /* nullptr */ == s) ? 0 /* nullptr */
+	 : lookup_family(symbol(s));
+}
+
+static charinfo *read_charinfo_image(snapshot_reader &r)
+{
+  int i = r.get_int();
+  charinfo *ci = charinfo_for_glyph_index(i);
+  if (i >= 0 && 0 /* nullptr */ == ci)
+    r.invalidate();
+  return ci;
+}
+
+bool environment::write_image(snapshot_writer &w)
+{
+  // `tab_contents` is meaningful only while a tab is current.
+  if (line != 0 /* nullptr */ || current_tab != TAB_NONE
+      || leader_node != 0 /* nullptr */
+      || margin_character_node != 0 /* nullptr */
+      || numbering_nodes != 0 /* nullptr */
+      || pending_lines != 0 /* nullptr */)
+    return false;
+  w.put_int(prev_line_length.to_units());
+  w.put_int(line_length.to_units());
+  w.put_int(prev_title_length.to_units());
+  w.put_int(title_length.to_units());
+  w.put_int(prev_size.to_scaled_points());
+  w.put_int(size.to_scaled_points());
+  w.put_int(requested_size);
+  w.put_int(prev_requested_size);
+  w.put_int(char_height);
+  w.put_int(char_slant);
+  w.put_int(prev_fontno);
+  w.put_int(fontno);
+  write_family_image(w, prev_family);
+  write_family_image(w, family);
+  w.put_int(space_size);
+  w.put_int(sentence_space_size);
+  w.put_int(adjust_mode);
+  w.put_int(is_filling);
+  w.put_int(was_line_interrupted);
+  w.put_int(was_previous_line_interrupted);
+  w.put_int(centered_line_count);
+  w.put_int(right_aligned_line_count);
+  w.put_int(prev_vertical_spacing.to_units());
+  w.put_int(vertical_spacing.to_units());
+  w.put_int(prev_post_vertical_spacing.to_units());
+  w.put_int(post_vertical_spacing.to_units());
+  w.put_int(prev_line_spacing);
+  w.put_int(line_spacing);
+  w.put_int(prev_indent.to_units());
+  w.put_int(indent.to_units());
+  w.put_int(temporary_indent.to_units());
+  w.put_int(have_temporary_indent);
+  w.put_int(saved_indent.to_units());
+  w.put_int(target_text_length.to_units());
+  w.put_int(pre_underline_fontno);
+  w.put_int(underlined_line_count);
+  w.put_int(underline_spaces);
+  w.put_string(input_trap.contents());
+  w.put_int(input_trap_count);
+  w.put_int(continued_input_trap);
+  w.put_int(prev_text_length.to_units());
+  w.put_int(width_total.to_units());
+  w.put_int(space_total);
+  w.put_int(input_line_start.to_units());
+  w.put_int(tab_width.to_units());
+  w.put_int(tab_distance.to_units());
+  w.put_int(using_line_tabs);
+  w.put_int(current_tab);
+  w.put_int(charinfo_glyph_index(tab_char));
+  w.put_int(charinfo_glyph_index(leader_char));
+  w.put_int(has_current_field);
+  w.put_int(field_distance.to_units());
+  w.put_int(pre_field_width.to_units());
+  w.put_int(field_spaces);
+  w.put_int(tab_field_spaces);
+  w.put_int(tab_precedes_field);
+  w.put_int(is_discarding);
+  w.put_int(is_spreading);
+  w.put_int(margin_character_flags);
+  w.put_int(margin_character_distance.to_units());
+  w.put_int(line_number_digit_width.to_units());
+  w.put_int(number_text_separation);
+  w.put_int(line_number_indent);
+  w.put_int(line_number_multiple);
+  w.put_int(no_number_count);
+  w.put_int(int(hyphenation_mode));
+  w.put_int(int(hyphenation_mode_default));
+  w.put_int(hyphen_line_count);
+  w.put_int(hyphen_line_max);
+  w.put_int(hyphenation_space.to_units());
+  w.put_int(hyphenation_margin.to_units());
+  w.put_int(want_total_fit);
+  w.put_int(composite);
+#ifdef WIDOW_CONTROL
+  w.put_int(want_widow_control);
+#endif /* WIDOW_CONTROL */
+  write_color_image(w, stroke_color);
+  write_color_image(w, prev_stroke_color);
+  write_color_image(w, fill_color);
+  write_color_image(w, prev_fill_color);
+  w.put_int(control_character);
+  w.put_int(no_break_control_character);
+  w.put_int(seen_space);
+  w.put_int(seen_eol);
+  w.put_int(suppress_next_eol);
+  w.put_int(seen_break);
+  tabs.write_image(w);
+  w.put_int(charinfo_glyph_index(hyphen_indicator_char));
+  return true;
+}
+
+void environment::read_image(snapshot_reader &r)
+{
+  prev_line_length = r.get_int();
+  line_length = r.get_int();
+  prev_title_length = r.get_int();
+  title_length = r.get_int();
+  prev_size = font_size(r.get_int());
+  size = font_size(r.get_int());
+  requested_size = r.get_int();
+  prev_requested_size = r.get_int();
+  char_height = r.get_int();
+  char_slant = r.get_int();
+  prev_fontno = r.get_int();
+  fontno = r.get_int();
+  prev_family = read_family_image(r);
+  family = read_family_image(r);
+  if (0 /* nullptr */ == prev_family || 0 /* nullptr */ == family)
+    r.invalidate();
+  space_size = r.get_int();
+  sentence_space_size = r.get_int();
+  adjust_mode = r.get_int();
+  is_filling = r.get_int();
+  was_line_interrupted = r.get_int();
+  was_previous_line_interrupted = r.get_int();
+  centered_line_count = r.get_int();
+  right_aligned_line_count = r.get_int();
+  prev_vertical_spacing = r.get_int();
+  vertical_spacing = r.get_int();
+  prev_post_vertical_spacing = r.get_int();
+  post_vertical_spacing = r.get_int();
+  prev_line_spacing = r.get_int();
+  line_spacing = r.get_int();
+  prev_indent = r.get_int();
+  indent = r.get_int();
+  temporary_indent = r.get_int();
+  have_temporary_indent = r.get_int();
+  saved_indent = r.get_int();
+  target_text_length = r.get_int();
+  pre_underline_fontno = r.get_int();
+  underlined_line_count = r.get_int();
+  underline_spaces = r.get_int();
+  const char *s = r.get_string();
+  input_trap = (0 /* nullptr */ == s) ? symbol() : symbol(s);
+  input_trap_count = r.get_int();
+  continued_input_trap = r.get_int();
+  prev_text_length = r.get_int();
+  width_total = r.get_int();
+  space_total = r.get_int();
+  input_line_start = r.get_int();
+  tab_width = r.get_int();
+  tab_distance = r.get_int();
+  using_line_tabs = r.get_int();
+  int t = r.get_int();
+  if (t < TAB_NONE || t > TAB_RIGHT)
+    r.invalidate();
+  else
+    current_tab = tab_type(t);
+  tab_char = read_charinfo_image(r);
+  leader_char = read_charinfo_image(r);
+  has_current_field = r.get_int();
+  field_distance = r.get_int();
+  pre_field_width = r.get_int();
+  field_spaces = r.get_int();
+  tab_field_spaces = r.get_int();
+  tab_precedes_field = r.get_int();
+  is_discarding = r.get_int();
+  is_spreading = r.get_int();
+  margin_character_flags = (unsigned char) r.get_int();
+  margin_character_distance = r.get_int();
+  line_number_digit_width = r.get_int();
+  number_text_separation = r.get_int();
+  line_number_indent = r.get_int();
+  line_number_multiple = r.get_int();
+  no_number_count = r.get_int();
+  hyphenation_mode = (unsigned int) r.get_int();
+  hyphenation_mode_default = (unsigned int) r.get_int();
+  hyphen_line_count = r.get_int();
+  hyphen_line_max = r.get_int();
+  hyphenation_space = r.get_int();
+  hyphenation_margin = r.get_int();
+  want_total_fit = r.get_int();
+  composite = r.get_int();
+#ifdef WIDOW_CONTROL
+  want_widow_control = r.get_int();
+#endif /* WIDOW_CONTROL */
+  stroke_color = read_color_image(r);
+  prev_stroke_color = read_color_image(r);
+  fill_color = read_color_image(r);
+  prev_fill_color = read_color_image(r);
+  control_character = (unsigned char) r.get_int();
+  no_break_control_character = (unsigned char) r.get_int();
+  seen_space = r.get_int();
+  seen_eol = r.get_int();
+  suppress_next_eol = r.get_int();
+  seen_break = r.get_int();
+  tabs.read_image(r);
+  hyphen_indicator_char = read_charinfo_image(r);
+}
+
 environment::~environment()
 {
   delete leader_node;
@@ -2142,6 +2406,21 @@ void hyphenation_margin_request() // .hym
   skip_line();
 }
 
+int environment::get_total_fit()
+{
+  return want_total_fit;
+}
+
+void total_fit_request() // .padj
+{
+  int n;
+  if (has_arg() && read_integer(&n))
+    curenv->want_total_fit = (n > 0);
+  else
+    curenv->want_total_fit = true;
+  skip_line();
+}
+
 breakpoint *environment::choose_breakpoint()
 {
   hunits x = width_total;
@@ -2262,6 +2541,15 @@ void environment::possibly_hyphenate_line(bool must_break_here)
     }
   if (*startp == 0 /* nullptr */)
     return;
+  (void) hyphenate_word(startp);
+}
+
+// Hyphenate the word whose last (rightmost) node `*startp` points to,
+// replacing its nodes in the list.  Return a pointer to the link that
+// now points to the node preceding the word, from which a caller can
+// continue a leftward scan.
+node **environment::hyphenate_word(node **startp)
+{
   node *tem = *startp;
   do {
     tem = tem->next;
@@ -2311,6 +2599,33 @@ void environment::possibly_hyphenate_line(bool must_break_here)
     tem = tem1->add_self(tem, &sl);
   }
   *startp = tem;
+  node **endp = startp;
+  while (*endp != end)
+    endp = &(*endp)->next;
+  return endp;
+}
+
+// Hyphenate every word of the pending output line, so that the
+// total-fit line breaker can consider all of their breakpoints.
+void environment::hyphenate_all_words()
+{
+  assert(line != 0 /* nullptr */);
+  hyphenation_type prev_type = line->get_hyphenation_type();
+  node **startp = &line->next;
+  while (*startp != 0 /* nullptr */) {
+    hyphenation_type this_type = (*startp)->get_hyphenation_type();
+    if (prev_type == HYPHENATION_UNNECESSARY
+	&& this_type == HYPHENATION_PERMITTED) {
+      // The node preceding the word is never `HYPHENATION_PERMITTED`,
+      // so it cannot start another word.
+      startp = hyphenate_word(startp);
+      prev_type = this_type;
+    }
+    else {
+      prev_type = this_type;
+      startp = &(*startp)->next;
+    }
+  }
 }
 
 static node *node_list_reverse(node *nd)
@@ -2373,6 +2688,14 @@ void environment::possibly_break_line(bool must_break_here,
   if (!is_filling || (current_tab != TAB_NONE) || has_current_field
       || is_dummy_env)
     return;
+  if (want_total_fit) {
+    // Break lines only once the paragraph is complete; do_break()
+    // calls break_paragraph() too.  `\p` completes it early, and we
+    // then spread its last line below.
+    if (!must_adjust)
+      return;
+    break_paragraph();
+  }
   while ((line != 0 /* nullptr */)
 	 && (must_adjust
 	     // When a macro follows a paragraph in fill mode, the
@@ -2383,117 +2706,405 @@ void environment::possibly_break_line(bool must_break_here,
     if (0 /* nullptr */ == bp)
       // we'll find one eventually
       return;
-    node *pre, *post;
-    node **ndp = &line;
-    while (*ndp != bp->nd)
-      ndp = &(*ndp)->next;
-    bp->nd->split(bp->index, &pre, &post);
-    *ndp = post;
-    // The space deficit tells us how much the line is overset if
-    // negative, or underset if positive, relative to the configured
-    // line length.
-    hunits space_deficit = (target_text_length - bp->width);
-    // An overset line always gets a warning.
-    if (space_deficit < H0) {
-      double dsd = static_cast<double>(space_deficit.to_units());
-      output_warning(WARN_BREAK, "cannot %1 line; overset by %2%3",
-		     (ADJUST_BOTH == adjust_mode) ? "adjust" : "break",
-		     in_nroff_mode
-		     ? static_cast<int>(ceil(fabs(dsd / hresolution)))
-		     : fabs(dsd / warn_scale),
-		     in_nroff_mode ? 'n' : warn_scaling_unit);
-    }
-    // An underset line warns only if it requires adjustment but no
-    // adjustable spaces exist on the line.
-    else if ((ADJUST_BOTH == adjust_mode)
-	     && (space_deficit > H0)
-	     && (0 == bp->nspaces)) {
-      double dsd = static_cast<double>(space_deficit.to_units());
-      output_warning(WARN_BREAK, "cannot adjust line; underset by %1%2",
-		     in_nroff_mode
-		     ? static_cast<int>(ceil(fabs(dsd / hresolution)))
-		     : fabs(dsd / warn_scale),
-		     in_nroff_mode ? 'n' : warn_scaling_unit);
+    bool is_output = output_broken_line(bp, &was_centered);
+    delete bp;
+    if (!is_output)
+      return;
+  }
+}
+
+// Split the pending output line at breakpoint `bp`, adjust the part
+// before it, and output that.  Return false if that part is an
+// unbreakable, overset line that we cannot output.
+bool environment::output_broken_line(breakpoint *bp, bool *was_centered)
+{
+  node *pre, *post;
+  node **ndp = &line;
+  while (*ndp != bp->nd)
+    ndp = &(*ndp)->next;
+  bp->nd->split(bp->index, &pre, &post);
+  *ndp = post;
+  // The space deficit tells us how much the line is overset if
+  // negative, or underset if positive, relative to the configured
+  // line length.
+  hunits space_deficit = (target_text_length - bp->width);
+  // An overset line always gets a warning.
+  if (space_deficit < H0) {
+    double dsd = static_cast<double>(space_deficit.to_units());
+    output_warning(WARN_BREAK, "cannot %1 line; overset by %2%3",
+		   (ADJUST_BOTH == adjust_mode) ? "adjust" : "break",
+		   in_nroff_mode
+		   ? static_cast<int>(ceil(fabs(dsd / hresolution)))
+		   : fabs(dsd / warn_scale),
+		   in_nroff_mode ? 'n' : warn_scaling_unit);
+  }
+  // An underset line warns only if it requires adjustment but no
+  // adjustable spaces exist on the line.
+  else if ((ADJUST_BOTH == adjust_mode)
+	   && (space_deficit > H0)
+	   && (0 == bp->nspaces)) {
+    double dsd = static_cast<double>(space_deficit.to_units());
+    output_warning(WARN_BREAK, "cannot adjust line; underset by %1%2",
+		   in_nroff_mode
+		   ? static_cast<int>(ceil(fabs(dsd / hresolution)))
+		   : fabs(dsd / warn_scale),
+		   in_nroff_mode ? 'n' : warn_scaling_unit);
+  }
+  // The extra space is the amount of space to distribute among the
+  // adjustable space nodes in an output line; this process occurs
+  // only if adjustment is enabled.  We may however want to synthesize
+  // an extra indentation from it if centering or right-aligning.
+  hunits extra_space = H0;
+  switch (adjust_mode) {
+  case ADJUST_BOTH:
+    if (bp->nspaces != 0)
+      extra_space = space_deficit;
+    break;
+  case ADJUST_CENTER:
+    saved_indent += space_deficit / 2;
+    *was_centered = true;
+    break;
+  case ADJUST_RIGHT:
+    saved_indent += space_deficit;
+    break;
+  case ADJUST_LEFT:
+  case ADJUST_CENTER - 1:
+  case ADJUST_RIGHT - 1:
+    break;
+  default:
+    assert(0 == "unhandled case of `adjust_mode`");
+  }
+  hunits output_width = bp->width; // 0 if no breakpoint is found.
+  if (distribute_space(pre, bp->nspaces, extra_space))
+    output_width += extra_space;
+  // If we had an unbreakable, overset line, we can do no more.
+  if (output_width <= 0)
+    return false;
+  input_line_start -= output_width;
+  if (bp->hyphenated)
+    hyphen_line_count++;
+  else
+    hyphen_line_count = 0;
+  // Normally, the do_break() member function discards trailing spaces
+  // (cf. horizontal motions) from input lines.  But when `\p` is
+  // used, that mechanism is bypassed, so we do the equivalent here.
+  space_total = 0;
+  width_total = 0;
+  node *first_non_discardable = 0 /* nullptr */;
+  node *tem;
+  for (tem = line; tem != 0 /* nullptr */; tem = tem->next)
+    if (!tem->discardable())
+      first_non_discardable = tem;
+  node *to_be_discarded;
+  if (first_non_discardable != 0 /* nullptr */) {
+    to_be_discarded = first_non_discardable->next;
+    first_non_discardable->next = 0 /* nullptr */;
+    for (tem = line; tem != 0 /* nullptr */; tem = tem->next) {
+      width_total += tem->width();
+      space_total += tem->nspaces();
     }
-    // The extra space is the amount of space to distribute among the
-    // adjustable space nodes in an output line; this process occurs
-    // only if adjustment is enabled.  We may however want to synthesize
-    // an extra indentation from it if centering or right-aligning.
-    hunits extra_space = H0;
-    switch (adjust_mode) {
-    case ADJUST_BOTH:
-      if (bp->nspaces != 0)
-	extra_space = space_deficit;
-      break;
-    case ADJUST_CENTER:
-      saved_indent += space_deficit / 2;
-      was_centered = true;
-      break;
-    case ADJUST_RIGHT:
-      saved_indent += space_deficit;
-      break;
-    case ADJUST_LEFT:
-    case ADJUST_CENTER - 1:
-    case ADJUST_RIGHT - 1:
-      break;
-    default:
-      assert(0 == "unhandled case of `adjust_mode`");
+    is_discarding = false;
+  }
+  else {
+    is_discarding = true;
+    to_be_discarded = line;
+    line = 0 /* nullptr */;
+  }
+  // Do output_line() here so that line will be 0 iff the
+  // the environment will be empty.
+  output_line(pre, output_width, *was_centered);
+  while (to_be_discarded != 0 /* nullptr */) {
+    tem = to_be_discarded;
+    to_be_discarded = to_be_discarded->next;
+    input_line_start -= tem->width();
+    delete tem;
+  }
+  if (line != 0 /* nullptr */) {
+    if (have_temporary_indent) {
+      saved_indent = temporary_indent;
+      have_temporary_indent = false;
     }
-    hunits output_width = bp->width; // 0 if no breakpoint is found.
-    if (distribute_space(pre, bp->nspaces, extra_space))
-      output_width += extra_space;
-    // If we had an unbreakable, overset line, we can do no more.
-    if (output_width <= 0)
-      return;
-    input_line_start -= output_width;
-    if (bp->hyphenated)
-      hyphen_line_count++;
     else
-      hyphen_line_count = 0;
-    delete bp;
-    // Normally, the do_break() member function discards trailing spaces
-    // (cf. horizontal motions) from input lines.  But when `\p` is
-    // used, that mechanism is bypassed, so we do the equivalent here.
-    space_total = 0;
-    width_total = 0;
-    node *first_non_discardable = 0 /* nullptr */;
-    node *tem;
-    for (tem = line; tem != 0 /* nullptr */; tem = tem->next)
-      if (!tem->discardable())
-	first_non_discardable = tem;
-    node *to_be_discarded;
-    if (first_non_discardable != 0 /* nullptr */) {
-      to_be_discarded = first_non_discardable->next;
-      first_non_discardable->next = 0 /* nullptr */;
-      for (tem = line; tem != 0 /* nullptr */; tem = tem->next) {
-	width_total += tem->width();
-	space_total += tem->nspaces();
+      saved_indent = indent;
+    target_text_length = line_length - saved_indent;
+  }
+  return true;
+}
+
+// The total-fit line breaker, after Knuth and Plass, chooses all of a
+// paragraph's breakpoints at once, minimizing the sum over its output
+// lines of "demerits", which grow with the cube of the stretch each
+// line needs and with hyphenation.  We reduce the pending output line
+// to a flat array of its feasible breakpoints; each records the
+// cumulative width and adjustable space count of the material (boxes
+// and glue) preceding it and of that preceding the start of the next
+// line.  Dynamic programming over a list of "active" breakpoints--those
+// that can still begin a line that fits--then finds the best
+// predecessor of each breakpoint in time linear in the length of the
+// paragraph.  The arrays persist from paragraph to paragraph, so we do
+// not allocate per breakpoint.
+
+struct total_fit_break {
+  node *nd;			// where to split the line (at index 0)
+  hunits width;			// of line ending here
+  int nspaces;			// adjustable spaces up to here
+  hunits restart_width;		// width preceding the next line
+  int restart_nspaces;		// adjustable spaces preceding it
+  int rank;			// position of `nd` in reversed list
+  int restart_rank;		// position of next line's first node
+  bool is_hyphenated;
+  int prev;			// best predecessor; -1 if unreachable
+  double demerits;		// of best paragraph prefix ending here
+  int line_count;		// of that prefix
+  int hyphen_run;		// consecutive hyphenated lines
+};
+
+static std::vector<total_fit_break> total_fit_breaks;
+static std::vector<int> total_fit_active;
+static std::vector<int> total_fit_path;
+static std::vector<node *> total_fit_pieces;
+
+// These are plain TeX's defaults.
+static const double total_fit_line_penalty = 10;
+static const double total_fit_hyphen_penalty = 50;
+static const double total_fit_double_hyphen_demerits = 10000;
+static const double total_fit_final_hyphen_demerits = 5000;
+static const double total_fit_max_badness = 10000;
+// Any overset line outweighs every combination of underset ones.
+static const double total_fit_overset_demerits = 1e15;
+
+// Rate how badly a line with `nspaces` adjustable spaces that is
+// `slack` short of the line length fits.  A line within the tolerance
+// that `.hys` (when adjusting) or `.hym` (otherwise) sets fits
+// perfectly, just as those requests keep the first-fit breaker from
+// hyphenating such a line.
+double environment::total_fit_badness(hunits slack, int nspaces)
+{
+  double stretch;
+  if (ADJUST_BOTH == adjust_mode) {
+    if (0 == nspaces)
+      return slack.is_zero() ? 0 : total_fit_max_badness;
+    if ((slack / nspaces) <= hyphenation_space)
+      return 0;
+    hunits sw = env_space_width(this);
+    stretch = static_cast<double>(nspaces)
+	      * (sw > H0 ? sw.to_units() : hresolution);
+  }
+  else {
+    if (slack <= hyphenation_margin)
+      return 0;
+    // Measure raggedness against 2 ems of stretch at the end of the
+    // line, as TeX's `\raggedright` does.
+    stretch = 2.0 * (get_size() > 0 ? get_size() : hresolution);
+  }
+  double r = slack.to_units() / stretch;
+  double badness = 100 * r * r * r;
+  return (badness < total_fit_max_badness) ? badness
+					    : total_fit_max_badness;
+}
+
+// Break the pending output line of a complete paragraph at the
+// breakpoints the total-fit algorithm chooses, outputting all but its
+// last line.  Consecutive hyphenated lines are limited per `.hlm`.
+void environment::break_paragraph()
+{
+  if (!is_filling || (current_tab != TAB_NONE) || has_current_field
+      || is_dummy_env || (0 /* nullptr */ == line))
+    return;
+  hyphenate_all_words();
+  // Build the array of breakpoints.  The node list is in reverse order,
+  // so we see the last breakpoint first.  We don't break after the last
+  // node that would survive at the start of an output line; the
+  // remainder of the paragraph is its last line.
+  total_fit_breaks.clear();
+  hunits x = width_total;
+  int s = space_total;
+  hunits end_width = H0;
+  hunits keep_x = x;
+  int keep_s = s;
+  int keep_rank = -1;
+  bool seen_text = false;
+  int rank = 0;
+  for (node *nd = line; nd != 0 /* nullptr */; nd = nd->next, rank++) {
+    x -= nd->width();
+    s -= nd->nspaces();
+    if (seen_text && (nd->nbreaks() > 0)) {
+      total_fit_break b;
+      hunits pre_width;
+      b.is_hyphenated = nd->get_pre_break_width(&pre_width);
+      b.nd = nd;
+      b.width = x + pre_width;
+      b.nspaces = s;
+      b.restart_width = keep_x;
+      b.restart_nspaces = keep_s;
+      b.rank = rank;
+      b.restart_rank = keep_rank;
+      b.prev = -1;
+      total_fit_breaks.push_back(b);
+    }
+    if (!nd->discardable()) {
+      if (!seen_text) {
+	end_width = x + nd->width();
+	seen_text = true;
       }
-      is_discarding = false;
+      keep_x = x;
+      keep_s = s;
+      keep_rank = rank;
     }
-    else {
-      is_discarding = true;
-      to_be_discarded = line;
-      line = 0 /* nullptr */;
+  }
+  if (total_fit_breaks.empty())
+    return;
+  // The start of the paragraph is a pseudo-breakpoint that precedes
+  // every node.
+  total_fit_break start;
+  start.nd = 0 /* nullptr */;
+  start.width = start.restart_width = H0;
+  start.nspaces = start.restart_nspaces = 0;
+  start.rank = start.restart_rank = rank;
+  start.is_hyphenated = false;
+  start.prev = -1;
+  start.demerits = 0;
+  start.line_count = 0;
+  start.hyphen_run = hyphen_line_count;
+  total_fit_breaks.push_back(start);
+  std::reverse(total_fit_breaks.begin(), total_fit_breaks.end());
+  const hunits first_target = target_text_length;
+  const hunits target = line_length - indent;
+  const int nbreaks = int(total_fit_breaks.size());
+  total_fit_active.clear();
+  total_fit_active.push_back(0);
+  for (int i = 1; i < nbreaks; i++) {
+    total_fit_break &b = total_fit_breaks[i];
+    int rescue = -1;
+    size_t kept = 0;
+    for (size_t j = 0; j < total_fit_active.size(); j++) {
+      int ai = total_fit_active[j];
+      const total_fit_break &a = total_fit_breaks[ai];
+      // A breakpoint among the discardable nodes that would begin the
+      // line cannot end it.
+      if (b.rank > a.restart_rank) {
+	total_fit_active[kept++] = ai;
+	continue;
+      }
+      hunits len = b.width - a.restart_width;
+      hunits tl = (0 == a.line_count) ? first_target : target;
+      // Spaces don't shrink, so no later breakpoint fits either.
+      if (len > tl) {
+	rescue = ai;
+	continue;
+      }
+      total_fit_active[kept++] = ai;
+      if (b.is_hyphenated && (hyphen_line_max >= 0)
+	  && (a.hyphen_run + 1 > hyphen_line_max))
+	continue;
+      double d = total_fit_line_penalty
+		 + total_fit_badness(tl - len,
+				     b.nspaces - a.restart_nspaces);
+      d *= d;
+      if (b.is_hyphenated) {
+	d += total_fit_hyphen_penalty * total_fit_hyphen_penalty;
+	if (a.is_hyphenated)
+	  d += total_fit_double_hyphen_demerits;
+      }
+      d += a.demerits;
+      if ((b.prev < 0) || (d < b.demerits)) {
+	b.prev = ai;
+	b.demerits = d;
+      }
+    }
+    total_fit_active.resize(kept);
+    // If no line ending here fits and nothing remains active, the
+    // paragraph contains a word too wide for the line; set it overset
+    // on a line of its own, starting from the latest breakpoint
+    // possible, as the first-fit breaker would.
+    if ((b.prev < 0) && (0 == kept) && (rescue >= 0)) {
+      b.prev = rescue;
+      b.demerits = total_fit_breaks[rescue].demerits
+		   + total_fit_overset_demerits;
+    }
+    if (b.prev >= 0) {
+      const total_fit_break &a = total_fit_breaks[b.prev];
+      b.line_count = a.line_count + 1;
+      b.hyphen_run = b.is_hyphenated ? (a.hyphen_run + 1) : 0;
+      total_fit_active.push_back(i);
     }
-    // Do output_line() here so that line will be 0 iff the
-    // the environment will be empty.
-    output_line(pre, output_width, was_centered);
-    while (to_be_discarded != 0 /* nullptr */) {
-      tem = to_be_discarded;
-      to_be_discarded = to_be_discarded->next;
-      input_line_start -= tem->width();
-      delete tem;
+  }
+  // Choose the breakpoint that best precedes the last line.  It need
+  // not be adjusted, so any length that fits is as good as another.
+  int best = -1;
+  double best_demerits = 0;
+  for (size_t j = 0; j < total_fit_active.size(); j++) {
+    int ai = total_fit_active[j];
+    const total_fit_break &a = total_fit_breaks[ai];
+    hunits tl = (0 == a.line_count) ? first_target : target;
+    double d = a.demerits;
+    if ((end_width - a.restart_width) > tl)
+      d += total_fit_overset_demerits;
+    if (a.is_hyphenated)
+      d += total_fit_final_hyphen_demerits;
+    if ((best < 0) || (d < best_demerits)) {
+      best = ai;
+      best_demerits = d;
     }
-    if (line != 0 /* nullptr */) {
-      if (have_temporary_indent) {
-	saved_indent = temporary_indent;
-	have_temporary_indent = false;
+  }
+  total_fit_path.clear();
+  for (int i = best; i > 0; i = total_fit_breaks[i].prev)
+    total_fit_path.push_back(i);
+  if (total_fit_path.empty())
+    return;
+  std::reverse(total_fit_path.begin(), total_fit_path.end());
+  // Cut the node list before each breakpoint but the first, so that
+  // breaking each output line walks only the nodes of it and the next.
+  total_fit_pieces.clear();
+  node **linkp = &line;
+  node *piece = line;
+  for (size_t i = total_fit_path.size() - 1; i > 0; i--) {
+    node *nd = total_fit_breaks[total_fit_path[i]].nd;
+    while (*linkp != nd)
+      linkp = &(*linkp)->next;
+    *linkp = 0 /* nullptr */;
+    total_fit_pieces.push_back(piece);
+    piece = nd;
+    linkp = &nd->next;
+  }
+  line = piece;
+  width_total = H0;
+  space_total = 0;
+  for (node *nd = line; nd != 0 /* nullptr */; nd = nd->next) {
+    width_total += nd->width();
+    space_total += nd->nspaces();
+  }
+  bool was_centered = (centered_line_count > 0);
+  bool is_output = true;
+  const total_fit_break *prev = &total_fit_breaks[0];
+  for (size_t i = 0; i < total_fit_path.size(); i++) {
+    if (i > 0) {
+      // Reattach the piece holding the next output line's breakpoint.
+      piece = total_fit_pieces.back();
+      total_fit_pieces.pop_back();
+      node *last = piece;
+      for (;;) {
+	width_total += last->width();
+	space_total += last->nspaces();
+	if (0 /* nullptr */ == last->next)
+	  break;
+	last = last->next;
       }
-      else
-	saved_indent = indent;
-      target_text_length = line_length - saved_indent;
+      last->next = line;
+      line = piece;
     }
+    if (!is_output)
+      continue;
+    const total_fit_break *b = &total_fit_breaks[total_fit_path[i]];
+    breakpoint bp;
+    bp.next = 0 /* nullptr */;
+    bp.width = b->width - prev->restart_width;
+    bp.nspaces = b->nspaces - prev->restart_nspaces;
+    bp.nd = b->nd;
+    bp.index = 0;
+    bp.hyphenated = b->is_hyphenated;
+    is_output = output_broken_line(&bp, &was_centered);
+    prev = b;
   }
 }
 
@@ -2625,26 +3236,28 @@ void environment::construct_format_state(node *nd, bool was_centered,
 {
   if (is_writing_html) {
     // find first glyph node which has a state.
-    while (nd != 0 /* nullptr */ && nd->state == 0 /* nullptr */)
+    while (nd != 0 /* nullptr */ && nd->get_state() == 0 /* nullptr */)
       nd = nd->next;
-    if (nd == 0 /* nullptr */ || (nd->state == 0 /* nullptr */))
+    if (nd == 0 /* nullptr */)
       return;
+    statem *s = nd->get_state();
     if (seen_space)
-      nd->state->add_tag(MTSM_SP, seen_space);
+      s->add_tag(MTSM_SP, seen_space);
     if (seen_eol && topdiv == curdiv)
-      nd->state->add_tag(MTSM_EOL);
+      s->add_tag(MTSM_EOL);
     seen_space = false;
     seen_eol = false;
     if (was_centered)
-      nd->state->add_tag(MTSM_CE, centered_line_count + 1);
+      s->add_tag(MTSM_CE, centered_line_count + 1);
     else
-      nd->state->add_tag_if_unknown(MTSM_CE, 0);
-    nd->state->add_tag_if_unknown(MTSM_FI, filling);
+      s->add_tag_if_unknown(MTSM_CE, 0);
+    s->add_tag_if_unknown(MTSM_FI, filling);
     nd = nd->next;
     while (nd != 0 /* nullptr */) {
-      if (nd->state != 0 /* nullptr */) {
-	nd->state->sub_tag_ce();
-	nd->state->add_tag_if_unknown(MTSM_FI, filling);
+      s = nd->get_state();
+      if (s != 0 /* nullptr */) {
+	s->sub_tag_ce();
+	s->add_tag_if_unknown(MTSM_FI, filling);
       }
       nd = nd->next;
     }
@@ -2655,14 +3268,15 @@ void environment::construct_new_line_state(node *nd)
 {
   if (is_writing_html) {
     // find first glyph node which has a state.
-    while (nd != 0 /* nullptr */ && nd->state == 0 /* nullptr */)
+    while (nd != 0 /* nullptr */ && nd->get_state() == 0 /* nullptr */)
       nd = nd->next;
-    if (nd == 0 /* nullptr */ || nd->state == 0 /* nullptr */)
+    if (nd == 0 /* nullptr */)
       return;
+    statem *s = nd->get_state();
     if (seen_space)
-      nd->state->add_tag(MTSM_SP, seen_space);
+      s->add_tag(MTSM_SP, seen_space);
     if (seen_eol && topdiv == curdiv)
-      nd->state->add_tag(MTSM_EOL);
+      s->add_tag(MTSM_EOL);
     seen_space = false;
     seen_eol = false;
   }
@@ -2690,8 +3304,11 @@ void environment::do_break(bool want_forced_adjustment)
       line = new space_node(H0, get_fill_color(), line);
       space_total++;
     }
-    possibly_break_line(false /* must break here */,
-			want_forced_adjustment);
+    if (want_total_fit && !want_forced_adjustment)
+      break_paragraph();
+    else
+      possibly_break_line(false /* must break here */,
+			  want_forced_adjustment);
   }
   while (line != 0 /* nullptr */ && line->discardable()) {
     width_total -= line->width();
@@ -3098,6 +3715,37 @@ void tab_stops::operator=(const tab_stops &ts)
   }
 }
 
+void tab_stops::write_image(snapshot_writer &w)
+{
+  for (int i = 0; i < 2; i++) {
+    int n = 0;
+    tab *list = (0 == i) ? initial_list : repeated_list;
+    for (tab *t = list; t != 0 /* nullptr */; t = t->next)
+      n++;
+    w.put_int(n);
+    for (tab *t = list; t != 0 /* nullptr */; t = t->next) {
+      w.put_int(t->pos.to_units());
+      w.put_int(t->type);
+    }
+  }
+}
+
+void tab_stops::read_image(snapshot_reader &r)
+{
+  clear();
+  for (int i = 0; i < 2; i++) {
+    int n = r.get_count(2 * sizeof(int));
+    for (int j = 0; j < n; j++) {
+      hunits pos = r.get_int();
+      int type = r.get_int();
+      if (type < TAB_NONE || type > TAB_RIGHT)
+	r.invalidate();
+      else
+	add_tab(pos, tab_type(type), (1 == i));
+    }
+  }
+}
+
 static void configure_tab_stops_request() // .ta
 {
   hunits pos;
@@ -3762,6 +4410,9 @@ void environment::dump()
   errprint("  hyphenation space: %1u\n", hyphenation_space.to_units());
   errprint("  hyphenation margin: %1u\n",
 	   hyphenation_margin.to_units());
+  errprint("  line breaking: %1\n",
+	   want_total_fit ? "total-fit (paragraph at once)"
+	     : "first-fit (line at a time)");
 #ifdef WIDOW_CONTROL
   errprint("  widow control: %1\n", want_widow_control ? "yes" : "no");
 #endif /* WIDOW_CONTROL */
@@ -3805,40 +4456,175 @@ static void print_pending_output_line_request() // .pline
 // Hyphenation - TeX's hyphenation algorithm with a less fancy
 // implementation.
 
+// We use `unsigned char` for offsets in hyphenation exception words.
+// C++11: constexpr
+static const int WORD_MAX = UCHAR_MAX;
+// C++11: constexpr
+static const size_t wordbuflen = WORD_MAX + 1 /* '\0' */;
+// C++11: constexpr
+static const size_t bpbuflen = WORD_MAX + 2 /* leading '-' + '\0' */;
+
 struct trie_node;
 
 class trie {
-  trie_node *tp;
-  virtual void do_match(int, void *) = 0;
   virtual void do_delete(void *) = 0;
   void delete_trie_node(trie_node *);
+protected:
+  trie_node *tp;
 public:
   trie() : tp(0 /* nullptr */) {}
   virtual ~trie();		// virtual to shut up g++
   void insert(const char *, int, void *);
-  // find calls do_match for each match it finds
-  void find(const char *, int);
   void clear();
 };
 
+// A state of the compiled pattern automaton.  The goto function is a
+// double-array trie: the transition from state `s` on character class
+// `c` leads to state `base[s] + c` if that state's `check` is `s`.
+struct hyphen_state {
+  int base;
+  int check;			// parent state; -1 if slot is free
+  int fail;			// longest proper suffix that is a state
+  int dict;			// nearest state on `fail` chain with ops
+  int ops;			// index into `ops` member; -1 if none
+};
+
+// An inter-letter value that a matching pattern contributes, packed.
+// A pattern's operations end with one whose `num` is zero.
+struct hyphen_op {
+  unsigned char distance;	// from end of pattern
+  unsigned char num;
+};
+
+// The patterns are collected in a trie as they are read, and compiled,
+// when first needed after a change, into an Aho-Corasick automaton so
+// that hyphenating a word takes a single pass over it.
+//
+// The automaton can instead come from a cache file written beside a
+// pattern file (see `write_cache()`), in which case the trie is rebuilt
+// from it only if more patterns are added.
 class hyphen_trie : private trie {
-  int *h;
-  void do_match(int i, void *v);
+  bool is_compiled;
+  unsigned char char_class[UCHAR_MAX + 1];	// 0 if in no pattern
+  std::vector<hyphen_state> states;
+  std::vector<hyphen_op> ops;
+  const hyphen_state *state_table;	// `states`, or in `cache_addr`
+					// or a snapshot
+  int nstates;
+  const hyphen_op *op_table;		// likewise `ops`
+  void *cache_addr;			// mapped cache file, if any
+  size_t cache_len;
+  std::vector<char> *exception_log;	// used by `write_cache()`
   void do_delete(void *v);
   void insert_pattern(const char *, int, int *);
   void insert_hyphenation(dictionary *, const char *, int);
   int hpf_getc(FILE *f);
+  void read_patterns_file(FILE *, dictionary *);
+  void clear();
+  void compile();
+  void use_compiled_vectors();
+  int free_head;			// used only by `compile()`
+  int free_tail;
+  int branch_head;
+  int place_children(const trie_node *);
+  int next_state(int, int);
+  void decompile();
+  void decompile_state(int, char *, int, const unsigned char *, int);
+  bool read_cache(FILE *, const char *, bool, dictionary *);
+  void write_cache(FILE *, const char *);
 public:
-  hyphen_trie() {}
-  ~hyphen_trie() {}
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
+  hyphen_trie() : is_compiled(false), state_table(0 /* nullptr */),
+    nstates(0), op_table(0 /* nullptr */), cache_addr(0 /* nullptr */),
+    cache_len(0), exception_log(0 /* nullptr */) {}
+  ~hyphen_trie() { clear(); }
   void hyphenate(const char *, int, int *);
   void interpret_patterns_file(const char *, bool, dictionary *);
 };
 
+// The hyphenation points that a language's exceptions or patterns give
+// a word, before the hyphenation mode is applied.  Bit `k` of `breaks`
+// is set if a break is permitted after the word's character `k + 1`.
+struct hyphenation_points {
+  enum { USER_EXCEPTION, PATTERN_FILE_EXCEPTION, PATTERN } source;
+  unsigned char breaks[(WORD_MAX + CHAR_BIT - 1) / CHAR_BIT];
+};
+
+// A bounded, direct-mapped memo of words' hyphenation points, keyed by
+// the words' hyphenation codes.  Repetitive text thus seldom needs to
+// consult the exceptions or run the patterns.  Anything that changes a
+// language's exceptions or patterns must clear its memo.
+class hyphenation_memo {
+  struct entry {
+    char *word;			// not null-terminated
+    int len;
+    hyphenation_points points;
+  };
+  std::vector<entry> table;	// allocated on first use
+  static const size_t table_size = 2048;
+  size_t slot(const char *, int);
+public:
+  hyphenation_memo() {}
+  ~hyphenation_memo() { clear(); }
+  const hyphenation_points *lookup(const char *, int);
+  void insert(const char *, int, const hyphenation_points *);
+  void clear();
+};
+
+size_t hyphenation_memo::slot(const char *word, int len)
+{
+  // FNV-1a
+  unsigned int h = 2166136261U;
+  for (int i = 0; i < len; i++) {
+    h ^= static_cast<unsigned char>(word[i]);
+    h *= 16777619U;
+  }
+  return h % table_size;
+}
+
+const hyphenation_points *hyphenation_memo::lookup(const char *word,
+						   int len)
+{
+  if (table.empty())
+    return 0 /* nullptr */;
+  const entry &e = table[slot(word, len)];
+  if (e.word != 0 /* nullptr */ && e.len == len
+      && memcmp(e.word, word, len) == 0)
+    return &e.points;
+  return 0 /* nullptr */;
+}
+
+void hyphenation_memo::insert(const char *word, int len,
+			      const hyphenation_points *points)
+{
+  if (table.empty()) {
+    entry empty;
+    (void) memset(&empty, 0, sizeof empty);
+    table.resize(table_size, empty);
+  }
+  entry &e = table[slot(word, len)];
+  if (e.len < len) {
+    delete[] e.word;
+    e.word = new char[len];
+  }
+  memcpy(e.word, word, len);
+  e.len = len;
+  e.points = *points;
+}
+
+void hyphenation_memo::clear()
+{
+  for (size_t i = 0; i < table.size(); i++)
+    delete[] table[i].word;
+  table.clear();
+}
+
 struct hyphenation_language {
   symbol name;
   dictionary exceptions;
   hyphen_trie patterns;
+  hyphenation_memo memo;
   hyphenation_language(symbol nm) : name(nm), exceptions(501) {}
   ~hyphenation_language() { }
 };
@@ -3924,14 +4710,6 @@ static void environment_switch() // .ev
   skip_line();
 }
 
-// We use `unsigned char` for offsets in hyphenation exception words.
-// C++11: constexpr
-static const int WORD_MAX = UCHAR_MAX;
-// C++11: constexpr
-static const size_t wordbuflen = WORD_MAX + 1 /* '\0' */;
-// C++11: constexpr
-static const size_t bpbuflen = WORD_MAX + 2 /* leading '-' + '\0' */;
-
 // Gather a hyphenation exception word from the input, storing it
 // without hyphens as a C string in `word`, advancing the input stream
 // pointer to the end of the word.
@@ -4032,6 +4810,7 @@ static void add_hyphenation_exception_words_request() // .hw
     skip_line();
     return;
   }
+  current_language->memo.clear();
   // C++11: char wordbuf[wordbuflen]{};
   unsigned char wordbuf[wordbuflen];
   (void) memset(wordbuf, 0, wordbuflen);
@@ -4081,6 +4860,7 @@ static void remove_hyphenation_exception_words_request() // .rhw
     skip_line();
     return;
   }
+  current_language->memo.clear();
   while (has_arg()) {
     // C++11: constexpr
     static const size_t readbufsz = WORD_MAX;
@@ -4274,22 +5054,6 @@ void trie::insert(const char *pat, int patlen, void *val)
   }
 }
 
-void trie::find(const char *pat, int patlen)
-{
-  trie_node *p = tp;
-  for (int i = 0; p != 0 && i < patlen; i++) {
-    while (p != 0 && p->c < pat[i])
-      p = p->right;
-    if (p != 0 && p->c == pat[i]) {
-      if (p->val != 0)
-	do_match(i+1, p->val);
-      p = p->down;
-    }
-    else
-      break;
-  }
-}
-
 struct operation {
   operation *next;
   short distance;
@@ -4309,6 +5073,24 @@ void hyphen_trie::insert_pattern(const char *pat, int patlen, int *num)
     if (num[i] != 0)
       op = new operation(num[i], patlen - i, op);
   insert(pat, patlen, op);
+  is_compiled = false;
+}
+
+void hyphen_trie::clear()
+{
+  trie::clear();
+  states.clear();
+  ops.clear();
+  state_table = 0 /* nullptr */;
+  nstates = 0;
+  op_table = 0 /* nullptr */;
+#ifdef HAVE_MMAP
+  if (cache_addr != 0 /* nullptr */)
+    (void) munmap(cache_addr, cache_len);
+#endif
+  cache_addr = 0 /* nullptr */;
+  cache_len = 0;
+  is_compiled = false;
 }
 
 void hyphen_trie::insert_hyphenation(dictionary *ex, const char *pat,
@@ -4318,6 +5100,11 @@ void hyphen_trie::insert_hyphenation(dictionary *ex, const char *pat,
   unsigned char pos[WORD_MAX + 2];
   int i = 0, j = 0;
   int npos = 0;
+  if (exception_log != 0 /* nullptr */) {
+    exception_log->push_back(char(patlen >> 8));
+    exception_log->push_back(char(patlen & 0xff));
+    exception_log->insert(exception_log->end(), pat, pat + patlen);
+  }
   while (j < patlen) {
     unsigned char c = pat[j++];
     if (c == '-') {
@@ -4342,28 +5129,259 @@ void hyphen_trie::insert_hyphenation(dictionary *ex, const char *pat,
   }
 }
 
-void hyphen_trie::hyphenate(const char *word, int len, int *hyphens)
+// Find a `base` for the state whose children are the sibling list
+// `p`: one at which every child's slot is free.  Claim those slots and
+// return it.
+//
+// Free slots are kept in an ascending doubly linked list threaded
+// through their `base` (next) and `fail` (previous) members, so that
+// the search skips occupied slots; slots past the end of `states` are
+// free and not on the list.
+int hyphen_trie::place_children(const trie_node *p)
+{
+  int lo = char_class[static_cast<unsigned char>(p->c)];
+  int base;
+  // A state with several children seldom fits in the sparse holes left
+  // low in the array, so such states are placed starting where the last
+  // one that needed a long search went.
+  bool is_branch = (p->right != 0 /* nullptr */);
+  int f = free_head;
+  if (is_branch && branch_head > f)
+    f = branch_head;
+  for (int ntries = 0; ; ntries++) {
+    bool is_free = (f >= int(states.size()) || states[f].check == -1);
+    base = f - lo;
+    if (is_free && base >= 0) {
+      const trie_node *q;
+      for (q = p->right; q != 0 /* nullptr */; q = q->right) {
+	size_t t = base + char_class[static_cast<unsigned char>(q->c)];
+	if (t < states.size() && states[t].check != -1)
+	  break;
+      }
+      if (0 /* nullptr */ == q) {
+	if (is_branch && ntries > 16)
+	  branch_head = f;
+	break;
+      }
+    }
+    if (is_free && f < int(states.size()))
+      f = states[f].base;
+    else
+      f++;			// `branch_head` might have been taken
+  }
+  for (const trie_node *q = p; q != 0 /* nullptr */; q = q->right) {
+    int t = base + char_class[static_cast<unsigned char>(q->c)];
+    while (int(states.size()) <= t) {
+      int n = int(states.size());
+      hyphen_state s = { n + 1, -1, free_tail, 0, -1 };
+      states.push_back(s);
+      if (free_tail < 0)
+	free_head = n;
+      free_tail = n;
+    }
+    int prev = states[t].fail;
+    int next = states[t].base;
+    if (prev < 0)
+      free_head = next;
+    else
+      states[prev].base = next;
+    if (next < int(states.size()))
+      states[next].fail = prev;
+    else
+      free_tail = prev;
+    states[t].check = 0;	// claimed; the caller sets the parent
+  }
+  return base;
+}
+
+// Return the goto transition from state `s` on character class `c`, or
+// -1 if there is none.
+inline int hyphen_trie::next_state(int s, int c)
 {
-  int j;
-  for (j = 0; j < len + 1; j++)
-    hyphens[j] = 0;
-  for (j = 0; j < len - 1; j++) {
-    h = hyphens + j;
-    find(word + j, len - j);
+  int t = state_table[s].base + c;
+  if (t < nstates && state_table[t].check == s)
+    return t;
+  return -1;
+}
+
+void hyphen_trie::use_compiled_vectors()
+{
+  state_table = states.empty() ? 0 /* nullptr */ : &states[0];
+  nstates = int(states.size());
+  op_table = ops.empty() ? 0 /* nullptr */ : &ops[0];
+}
+
+void hyphen_trie::compile()
+{
+  is_compiled = true;
+  states.clear();
+  ops.clear();
+  use_compiled_vectors();
+  (void) memset(char_class, 0, sizeof char_class);
+  if (0 /* nullptr */ == tp)
+    return;
+  // Number the characters that occur in patterns, so that the
+  // double array need not be as wide as the character set.
+  bool seen[UCHAR_MAX + 1];
+  (void) memset(seen, 0, sizeof seen);
+  std::vector<const trie_node *> queue;
+  queue.push_back(tp);
+  for (size_t i = 0; i < queue.size(); i++)
+    for (const trie_node *p = queue[i]; p != 0 /* nullptr */;
+	 p = p->right) {
+      seen[static_cast<unsigned char>(p->c)] = true;
+      if (p->down != 0 /* nullptr */)
+	queue.push_back(p->down);
+    }
+  int nclasses = 0;
+  for (int c = 0; c <= UCHAR_MAX; c++)
+    if (seen[c])
+      char_class[c] = ++nclasses;
+  // Lay out the states breadth-first, so that every state on a new
+  // state's failure path has already been placed.  `queue` now pairs
+  // each placed state with its children.
+  queue.clear();
+  std::vector<int> queue_state;
+  hyphen_state root = { 0, -2, 0, 0, -1 };
+  states.push_back(root);
+  queue.push_back(tp);
+  queue_state.push_back(0);
+  free_head = 1;
+  free_tail = -1;
+  branch_head = 1;
+  for (size_t i = 0; i < queue.size(); i++) {
+    int s = queue_state[i];
+    int base = place_children(queue[i]);
+    use_compiled_vectors();
+    states[s].base = base;
+    for (const trie_node *p = queue[i]; p != 0 /* nullptr */;
+	 p = p->right) {
+      int c = char_class[static_cast<unsigned char>(p->c)];
+      int t = base + c;
+      states[t].check = s;
+      states[t].base = 0;
+      int f = 0;
+      if (s != 0) {
+	for (f = states[s].fail; ; f = states[f].fail) {
+	  int g = next_state(f, c);
+	  if (g >= 0) {
+	    f = g;
+	    break;
+	  }
+	  if (0 == f)
+	    break;
+	}
+      }
+      states[t].fail = f;
+      states[t].dict = (states[f].ops >= 0) ? f : states[f].dict;
+      states[t].ops = -1;
+      if (p->val != 0 /* nullptr */) {
+	states[t].ops = int(ops.size());
+	for (const operation *op = static_cast<operation *>(p->val);
+	     op != 0 /* nullptr */; op = op->next) {
+	  hyphen_op hop = { static_cast<unsigned char>(op->distance),
+			    static_cast<unsigned char>(op->num) };
+	  ops.push_back(hop);
+	}
+	hyphen_op end = { 0, 0 };
+	ops.push_back(end);
+      }
+      if (p->down != 0 /* nullptr */) {
+	queue.push_back(p->down);
+	queue_state.push_back(t);
+      }
+    }
   }
+  use_compiled_vectors();
 }
 
-inline int max(int m, int n)
+// Rebuild the trie from an automaton read from a cache file, so that
+// patterns can be added to it.
+void hyphen_trie::decompile()
 {
-  return m > n ? m : n;
+  unsigned char class_char[UCHAR_MAX + 1];
+  int nclasses = 0;
+  for (int c = 0; c <= UCHAR_MAX; c++)
+    if (char_class[c] != 0) {
+      class_char[char_class[c]] = c;
+      if (char_class[c] > nclasses)
+	nclasses = char_class[c];
+    }
+  char buf[WORD_MAX + 1];
+  decompile_state(0, buf, 0, class_char, nclasses);
+  // Drop the cached automaton but keep the trie.
+  trie_node *saved_tp = tp;
+  tp = 0 /* nullptr */;
+  clear();
+  tp = saved_tp;
 }
 
-void hyphen_trie::do_match(int i, void *v)
+void hyphen_trie::decompile_state(int s, char *buf, int len,
+				  const unsigned char *class_char,
+				  int nclasses)
 {
-  operation *op = static_cast<operation *>(v);
-  while (op != 0) {
-    h[i - op->distance] = max(h[i - op->distance], op->num);
-    op = op->next;
+  if (state_table[s].ops >= 0) {
+    int num[WORD_MAX + 1];
+    for (int i = 0; i <= len; i++)
+      num[i] = 0;
+    for (const hyphen_op *op = &op_table[state_table[s].ops];
+	 op->num != 0; op++)
+      num[len - op->distance] = op->num;
+    insert_pattern(buf, len, num);
+  }
+  if (len >= WORD_MAX)
+    return;
+  for (int c = 1; c <= nclasses; c++) {
+    int t = next_state(s, c);
+    if (t >= 0) {
+      buf[len] = class_char[c];
+      decompile_state(t, buf, len + 1, class_char, nclasses);
+    }
+  }
+}
+
+// Store in `hyphens` the greatest inter-letter value that any pattern
+// assigns to each position in `word`, which has length `len` and is
+// bracketed by dots.
+void hyphen_trie::hyphenate(const char *word, int len, int *hyphens)
+{
+  for (int j = 0; j < len + 1; j++)
+    hyphens[j] = 0;
+  if (!is_compiled)
+    compile();
+  if (0 == nstates || len < 2)
+    return;
+  // No pattern applies that starts at the final dot.
+  int last = next_state(0,
+    char_class[static_cast<unsigned char>(word[len - 1])]);
+  int s = 0;
+  for (int i = 0; i < len; i++) {
+    int c = char_class[static_cast<unsigned char>(word[i])];
+    if (0 == c) {
+      s = 0;
+      continue;
+    }
+    for (;;) {
+      int t = next_state(s, c);
+      if (t >= 0) {
+	s = t;
+	break;
+      }
+      if (0 == s)
+	break;
+      s = state_table[s].fail;
+    }
+    for (int m = (state_table[s].ops >= 0) ? s : state_table[s].dict;
+	 m != 0; m = state_table[m].dict) {
+      if ((i == len - 1) && (m == last))
+	continue;
+      for (const hyphen_op *op = &op_table[state_table[m].ops];
+	   op->num != 0; op++) {
+	int *hp = hyphens + (i + 1 - op->distance);
+	if (*hp < op->num)
+	  *hp = op->num;
+      }
+    }
   }
 }
 
@@ -4443,16 +5461,328 @@ fail:
   return c;
 }
 
+// A hyphenation pattern cache file holds, in host byte order, an
+// `hpc_header`, the automaton's states and operations, and the
+// hyphenation exceptions of one pattern file; each exception is its
+// length in two bytes, most significant first, and then its text.  A
+// cache is used only if it is at least as new as its pattern file and
+// was written with the same `.hpfcode` mappings in effect.
+
+#define HPC_MAGIC 0x48504331	// "HPC1"
+#define HPC_VERSION 1
+
+struct hpc_header {
+  int magic;
+  int version;
+  unsigned char code_table[UCHAR_MAX + 1];
+  unsigned char char_class[UCHAR_MAX + 1];
+  int nstates;
+  int nops;
+  int exceptions_size;
+};
+
+static const char hpc_suffix[] = ".hpc";
+
+// Read `n` bytes from `fd` into `p`, resuming after short reads and
+// interruptions; fail at end of file or on error.
+
+static bool read_fully(int fd, char *p, size_t n)
+{
+  while (n > 0) {
+    ssize_t got = read(fd, p, n);
+    if (got < 0) {
+      if (EINTR == errno)
+	continue;
+      return false;
+    }
+    if (0 == got)
+      return false;
+    p += got;
+    n -= size_t(got);
+  }
+  return true;
+}
+
+// Check that the automaton read from a cache file can be run by
+// `hyphenate()` and `decompile_state()` without leaving its tables or
+// the caller's buffers.  Every state in use must have a parent,
+// failure, and dictionary state in use, the latter two shallower than
+// itself so that their chains end at the root, and a run of operations
+// that ends within the table and reaches back no further than the
+// start of the state's pattern.
+
+static bool is_valid_automaton(const hyphen_state *st, int nstates,
+			       const hyphen_op *op, int nops)
+{
+  if (0 == nstates)
+    return true;
+  if (st[0].check != -2)
+    return false;
+  // The greatest distance in the run of operations starting at each
+  // index, or -1 if the run has no terminator.
+  std::vector<int> run_max(nops + 1);
+  run_max[nops] = -1;
+  for (int k = nops - 1; k >= 0; k--)
+    if (0 == op[k].num)
+      run_max[k] = 0;
+    else if (run_max[k + 1] < 0)
+      run_max[k] = -1;
+    else
+      run_max[k] = std::max(run_max[k + 1], int(op[k].distance));
+  // The depth of each state in the trie, found by walking up the
+  // `check` links; -1 if not yet known, -2 if on the current walk.
+  std::vector<int> depth(nstates, -1);
+  depth[0] = 0;
+  std::vector<int> path;
+  for (int s = 1; s < nstates; s++) {
+    int p = s;
+    while (st[p].check != -1 && depth[p] == -1) {
+      depth[p] = -2;
+      path.push_back(p);
+      p = st[p].check;
+      if (p < 0 || p >= nstates)
+	return false;
+    }
+    if (!path.empty() && depth[p] < 0)
+      return false;		// a free slot or a cycle
+    for (int d = depth[p]; !path.empty(); path.pop_back())
+      depth[path.back()] = ++d;
+  }
+  for (int s = 0; s < nstates; s++) {
+    if (-1 == depth[s])
+      continue;			// a free slot; never reached
+    const hyphen_state &h = st[s];
+    if (h.base < 0 || h.base >= nstates
+	|| h.fail < 0 || h.fail >= nstates || depth[h.fail] < 0
+	|| h.dict < 0 || h.dict >= nstates || depth[h.dict] < 0
+	|| (0 == s ? (h.fail != 0 || h.dict != 0)
+		   : (depth[h.fail] >= depth[s]
+		      || depth[h.dict] >= depth[s]))
+	|| (h.dict != 0 && st[h.dict].ops < 0)
+	|| h.ops < -1 || h.ops >= nops
+	|| (h.ops >= 0 && (run_max[h.ops] < 0
+			   || run_max[h.ops] > depth[s])))
+      return false;
+  }
+  return true;
+}
+
+// Try to load the cache of the pattern file `path`, open as `fp`.
+bool hyphen_trie::read_cache(FILE *fp, const char *path, bool appending,
+			     dictionary *ex)
+{
+  size_t pathlen = strlen(path);
+  char *cache_path = new char[pathlen + sizeof hpc_suffix];
+  strcpy(cache_path, path);
+  strcpy(cache_path + pathlen, hpc_suffix);
+  int fd = open(cache_path, O_RDONLY | O_BINARY);
+  delete[] cache_path;
+  if (fd < 0)
+    return false;
+  struct stat pattern_sb, cache_sb;
+  if (fstat(fileno(fp), &pattern_sb) < 0 || fstat(fd, &cache_sb) < 0
+      || !S_ISREG(cache_sb.st_mode)
+      || cache_sb.st_mtime < pattern_sb.st_mtime
+      || size_t(cache_sb.st_size) < sizeof(hpc_header)) {
+    close(fd);
+    return false;
+  }
+  size_t len = size_t(cache_sb.st_size);
+  void *addr = 0 /* nullptr */;
+  std::vector<char> buffer;
+#ifdef HAVE_MMAP
+  addr = mmap(0 /* nullptr */, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == addr)
+    addr = 0 /* nullptr */;
+#endif
+  const char *image = static_cast<const char *>(addr);
+  if (0 /* nullptr */ == image) {
+    buffer.resize(len);
+    if (!read_fully(fd, &buffer[0], len)) {
+      close(fd);
+      return false;
+    }
+    image = &buffer[0];
+  }
+  close(fd);
+  hpc_header header;
+  memcpy(&header, image, sizeof header);
+  size_t states_len = size_t(header.nstates) * sizeof(hyphen_state);
+  size_t ops_len = size_t(header.nops) * sizeof(hyphen_op);
+  bool is_usable = (header.magic == HPC_MAGIC
+		    && header.version == HPC_VERSION
+		    && header.nstates >= 0 && header.nops >= 0
+		    && header.exceptions_size >= 0
+		    && (sizeof header + states_len + ops_len
+			+ size_t(header.exceptions_size)) == len
+		    && memcmp(header.code_table, hpf_code_table,
+			      sizeof header.code_table) == 0);
+  // Patterns from a cache can't be merged into ones already present.
+  if (is_usable && header.nstates > 0 && appending
+      && (tp != 0 /* nullptr */ || nstates > 0))
+    is_usable = false;
+  if (is_usable)
+    is_usable = is_valid_automaton(
+      reinterpret_cast<const hyphen_state *>(image + sizeof header),
+      header.nstates,
+      reinterpret_cast<const hyphen_op *>(image + sizeof header
+					  + states_len),
+      header.nops);
+  if (!is_usable) {
+#ifdef HAVE_MMAP
+    if (addr != 0 /* nullptr */)
+      (void) munmap(addr, len);
+#endif
+    return false;
+  }
+  const char *p = image + sizeof header;
+  if (header.nstates > 0) {
+    clear();
+    memcpy(char_class, header.char_class, sizeof char_class);
+    if (addr != 0 /* nullptr */) {
+      cache_addr = addr;
+      cache_len = len;
+      state_table = reinterpret_cast<const hyphen_state *>(p);
+      op_table = reinterpret_cast<const hyphen_op *>(p + states_len);
+      nstates = header.nstates;
+    }
+    else {
+      states.resize(header.nstates);
+      memcpy(&states[0], p, states_len);
+      ops.resize(header.nops);
+      if (header.nops > 0)
+	memcpy(&ops[0], p + states_len, ops_len);
+      use_compiled_vectors();
+    }
+    is_compiled = true;
+  }
+  p += states_len + ops_len;
+  const char *end = p + header.exceptions_size;
+  while (end - p >= 2) {
+    int patlen = (static_cast<unsigned char>(p[0]) << 8)
+		 | static_cast<unsigned char>(p[1]);
+    p += 2;
+    if (patlen > end - p || patlen > WORD_MAX + 1)
+      break;
+    insert_hyphenation(ex, p, patlen);
+    p += patlen;
+  }
+#ifdef HAVE_MMAP
+  if (addr != 0 /* nullptr */ && addr != cache_addr)
+    (void) munmap(addr, len);
+#endif
+  return true;
+}
+
+// Write a cache of the pattern file `path`, open as `fp`, beside it.
+void hyphen_trie::write_cache(FILE *fp, const char *path)
+{
+  hyphen_trie patterns;
+  dictionary exceptions(501);
+  std::vector<char> log;
+  patterns.exception_log = &log;
+  patterns.read_patterns_file(fp, &exceptions);
+  rewind(fp);
+  patterns.compile();
+  hpc_header header;
+  (void) memset(&header, 0, sizeof header);
+  header.magic = HPC_MAGIC;
+  header.version = HPC_VERSION;
+  memcpy(header.code_table, hpf_code_table, sizeof header.code_table);
+  memcpy(header.char_class, patterns.char_class,
+	 sizeof header.char_class);
+  header.nstates = patterns.nstates;
+  header.nops = int(patterns.ops.size());
+  header.exceptions_size = int(log.size());
+  // Write to a temporary file and rename it, so that a concurrent run
+  // never sees a partial cache.
+  string cache_path(path);
+  cache_path += hpc_suffix;
+  string temp_path(cache_path);
+  temp_path += ".tmp";
+  temp_path += i_to_a(getpid());
+  cache_path += '\0';
+  temp_path += '\0';
+  errno = 0;
+  FILE *cfp = fopen(temp_path.contents(), FOPEN_WB);
+  if (0 /* nullptr */ == cfp) {
+    error("cannot open hyphenation pattern cache file '%1' for"
+	  " writing: %2", temp_path.contents(), strerror(errno));
+    return;
+  }
+  bool is_ok = (fwrite(&header, sizeof header, 1, cfp) == 1);
+  if (is_ok && header.nstates > 0)
+    is_ok = (fwrite(patterns.state_table, sizeof(hyphen_state),
+		    header.nstates, cfp) == size_t(header.nstates));
+  if (is_ok && header.nops > 0)
+    is_ok = (fwrite(patterns.op_table, sizeof(hyphen_op), header.nops,
+		    cfp) == size_t(header.nops));
+  if (is_ok && !log.empty())
+    is_ok = (fwrite(&log[0], 1, log.size(), cfp) == log.size());
+  if (fclose(cfp) != 0)
+    is_ok = false;
+  if (is_ok && rename(temp_path.contents(), cache_path.contents()) != 0)
+    is_ok = false;
+  if (!is_ok) {
+    error("cannot write hyphenation pattern cache file '%1': %2",
+	  cache_path.contents(), strerror(errno));
+    (void) unlink(temp_path.contents());
+  }
+}
+
+// A snapshot holds the compiled automaton, which is used in place in
+// the snapshot image, much as in a mapped cache file.
+
+void hyphen_trie::write_image(snapshot_writer &w)
+{
+  if (!is_compiled)
+    compile();
+  // The operations may be in a cache file, so count them.
+  int nops = 0;
+  for (int s = 0; s < nstates; s++)
+    if (state_table[s].ops >= 0) {
+      int k = state_table[s].ops;
+      while (op_table[k].num != 0)
+	k++;
+      if (k + 1 > nops)
+	nops = k + 1;
+    }
+  w.put_bytes(char_class, sizeof char_class);
+  w.put_int(nstates);
+  w.put_int(nops);
+  w.align(sizeof(int));
+  if (nstates > 0)
+    w.put_bytes(state_table, nstates * sizeof(hyphen_state));
+  if (nops > 0)
+    w.put_bytes(op_table, nops * sizeof(hyphen_op));
+}
+
+void hyphen_trie::read_image(snapshot_reader &r)
+{
+  clear();
+  const void *cc = r.get_bytes(sizeof char_class);
+  int ns = r.get_count(sizeof(hyphen_state));
+  int nops = r.get_count(sizeof(hyphen_op));
+  r.align(sizeof(int));
+  const void *st = r.get_bytes(ns * sizeof(hyphen_state));
+  const void *op = r.get_bytes(nops * sizeof(hyphen_op));
+  if (!r.is_valid())
+    return;
+  memcpy(char_class, cc, sizeof char_class);
+  if (ns > 0) {
+    state_table = static_cast<const hyphen_state *>(st);
+    op_table = static_cast<const hyphen_op *>(op);
+    nstates = ns;
+  }
+  is_compiled = true;
+}
+
 void hyphen_trie::interpret_patterns_file(const char *name,
 					  bool appending,
 					  dictionary *ex)
 {
   if (!appending)
     clear();
-  char buf[WORD_MAX + 1];
-  for (int i = 0; i < WORD_MAX + 1; i++)
-    buf[i] = 0;
-  int num[WORD_MAX + 1];
   errno = 0;
   char *path = 0;
   FILE *fp = mac_path->open_file(name, &path);
@@ -4461,6 +5791,26 @@ void hyphen_trie::interpret_patterns_file(const char *name,
 	  strerror(errno));
     return;
   }
+  if (want_hyphenation_caches_written)
+    write_cache(fp, path);
+  if (read_cache(fp, path, appending, ex)) {
+    fclose(fp);
+    free(path);
+    return;
+  }
+  if (0 /* nullptr */ == tp && nstates > 0)
+    decompile();
+  read_patterns_file(fp, ex);
+  fclose(fp);
+  free(path);
+}
+
+void hyphen_trie::read_patterns_file(FILE *fp, dictionary *ex)
+{
+  char buf[WORD_MAX + 1];
+  for (int i = 0; i < WORD_MAX + 1; i++)
+    buf[i] = 0;
+  int num[WORD_MAX + 1];
   int c = hpf_getc(fp);
   bool have_patterns = false;		// seen \patterns
   bool is_final_pattern = false;	// have a trailing closing brace
@@ -4581,9 +5931,6 @@ void hyphen_trie::interpret_patterns_file(const char *name,
       }
     }
   }
-  fclose(fp);
-  free(path);
-  return;
 }
 
 class hyphenation_language_reg : public reg {
@@ -4660,6 +6007,7 @@ void init_env_requests()
   init_request("nh", no_hyphenate);
   init_request("nm", number_lines);
   init_request("nn", no_number);
+  init_request("padj", total_fit_request);
   init_request("pev", print_environment_request);
   init_request("pline", print_pending_output_line_request);
   init_request("ps", point_size);
@@ -4711,6 +6059,7 @@ void init_env_requests()
   init_hunits_env_reg(".n", get_prev_text_length);
   init_int_env_reg(".nm", get_numbering_nodes);
   init_int_env_reg(".nn", get_no_number_count);
+  init_int_env_reg(".padj", get_total_fit);
   init_int_env_reg(".ps", get_point_size);
   init_int_env_reg(".psr", get_requested_point_size);
   init_vunits_env_reg(".pvs", get_post_vertical_spacing);
@@ -4761,6 +6110,56 @@ void init_env_requests()
 
 // Appendix H of _The TeXbook_ is useful background for the following.
 
+// Find the hyphenation points of the word in `hbuf`, which has a
+// leading and room for a trailing byte around the `len` hyphenation
+// codes of its letters.
+static void find_hyphenation_points(char *hbuf, int len,
+				    hyphenation_points *points)
+{
+  char *bufp = hbuf + 1;
+  (void) memset(points->breaks, 0, sizeof points->breaks);
+  // Check hyphenation exceptions defined with `hw` request.
+  assert((bufp + len) < (hbuf + WORD_MAX + 2 + 1));
+  bufp[len] = '\0';
+  unsigned char *pos = static_cast<unsigned char *>(
+		       current_language->exceptions.lookup(bufp));
+  if (pos != 0 /* nullptr */)
+    points->source = hyphenation_points::USER_EXCEPTION;
+  else {
+    // Check `\hyphenation' entries from pattern files; such entries
+    // are marked with a trailing space.
+    assert((hbuf + len + 1) < (hbuf + WORD_MAX + 2 + 1));
+    bufp[len] = ' ';
+    bufp[len + 1] = '\0';
+    pos = static_cast<unsigned char *>(
+	  current_language->exceptions.lookup(bufp));
+    if (pos != 0 /* nullptr */)
+      points->source = hyphenation_points::PATTERN_FILE_EXCEPTION;
+  }
+  if (pos != 0 /* nullptr */) {
+    // Exception break points are ascending positions counted from 1.
+    for (int i = 1, j = 0; i <= len; i++)
+      if (pos[j] == i) {
+	points->breaks[(i - 1) / CHAR_BIT] |= 1U << ((i - 1) % CHAR_BIT);
+	j++;
+      }
+    return;
+  }
+  points->source = hyphenation_points::PATTERN;
+  hbuf[0] = hbuf[len + 1] = '.';
+  int num[WORD_MAX + 2 + 1];
+  (void) memset(num, 0, sizeof num);
+  current_language->patterns.hyphenate(hbuf, len + 2, num);
+  // The position of a hyphenation point gets marked with an odd
+  // number.  Example:
+  //
+  //   hbuf:  . h e l p f u l .
+  //   num:  0 0 0 2 4 3 0 0 0 0
+  for (int k = 0; k < len; k++)
+    if (num[k + 2] & 1)
+      points->breaks[k / CHAR_BIT] |= 1U << (k % CHAR_BIT);
+}
+
 static void hyphenate(hyphen_list *h, unsigned int flags)
 {
   if (0 /* nullptr */ == current_language)
@@ -4797,79 +6196,48 @@ static void hyphenate(hyphen_list *h, unsigned int flags)
     }
     hyphen_list *nexth = tem;
     if (len >= 2) {
-      // Check hyphenation exceptions defined with `hw` request.
-      assert((bufp + len) < (hbuf + sizeof hbuf));
-      bufp[len] = '\0';
-      unsigned char *pos = static_cast<unsigned char *>(
-			   current_language->exceptions.lookup(bufp));
-      if (pos != 0 /* nullptr */) {
-	int j = 0;
-	int i = 1;
-	for (tem = h; tem != 0 /* nullptr */; tem = tem->next, i++)
-	  if (pos[j] == i) {
-	    tem->is_hyphen = true;
-	    j++;
-	  }
+      const hyphenation_points *points
+	= current_language->memo.lookup(bufp, len);
+      hyphenation_points found;
+      if (0 /* nullptr */ == points) {
+	find_hyphenation_points(hbuf, len, &found);
+	current_language->memo.insert(bufp, len, &found);
+	points = &found;
       }
-      else {
-	// Check `\hyphenation' entries from pattern files; such entries
-	// are marked with a trailing space.
-	assert((hbuf + len + 1) < (hbuf + sizeof hbuf));
-	bufp[len] = ' ';
-	bufp[len + 1] = '\0';
-	pos = static_cast<unsigned char *>(
-	      current_language->exceptions.lookup(bufp));
-	if (pos != 0 /* nullptr */) {
-	  int j = 0;
-	  int i = 1;
-	  tem = h;
-	  if (pos[j] == i) {
-	    if (flags & HYPHEN_FIRST_CHAR)
-	      tem->is_hyphen = true;
-	    j++;
-	  }
-	  tem = tem->next;
-	  i++;
-	  if (pos[j] == i) {
-	    if (!(flags & HYPHEN_NOT_FIRST_CHARS))
-	      tem->is_hyphen = true;
-	    j++;
-	  }
-	  tem = tem->next;
-	  i++;
-	  if (!(flags & HYPHEN_LAST_CHAR))
-	    --len;
-	  if (flags & HYPHEN_NOT_LAST_CHARS)
-	    --len;
-	  for (; i < len && tem; tem = tem->next, i++)
-	    if (pos[j] == i) {
-	      tem->is_hyphen = true;
-	      j++;
-	    }
+      // Apply the hyphenation mode, which user-defined exceptions
+      // ignore.  Break positions must precede `limit`, except that
+      // pattern file exceptions may always break after the first or
+      // second character if the mode permits.
+      int limit = len;
+      bool is_first_ok = true;
+      bool is_second_ok = true;
+      if (points->source != hyphenation_points::USER_EXCEPTION) {
+	is_first_ok = (flags & HYPHEN_FIRST_CHAR);
+	is_second_ok = !(flags & HYPHEN_NOT_FIRST_CHARS);
+	if (points->source == hyphenation_points::PATTERN) {
+	  limit = len - 2;
+	  if (flags & HYPHEN_LAST_CHAR)
+	    ++limit;
 	}
 	else {
-	  hbuf[0] = hbuf[len + 1] = '.';
-	  int num[WORD_MAX + 2 + 1];
-	  (void) memset(num, 0, sizeof num);
-	  current_language->patterns.hyphenate(hbuf, len + 2, num);
-	  // The position of a hyphenation point gets marked with an odd
-	  // number.  Example:
-	  //
-	  //   hbuf:  . h e l p f u l .
-	  //   num:  0 0 0 2 4 3 0 0 0 0
-	  if (!(flags & HYPHEN_FIRST_CHAR))
-	    num[2] = 0;
-	  if (flags & HYPHEN_NOT_FIRST_CHARS)
-	    num[3] = 0;
-	  if (flags & HYPHEN_LAST_CHAR)
-	    ++len;
-	  if (flags & HYPHEN_NOT_LAST_CHARS)
-	    --len;
-	  int i;
-	  for (i = 2, tem = h; i < len && tem; tem = tem->next, i++)
-	    if (num[i] & 1)
-	      tem->is_hyphen = true;
+	  limit = len - 1;
+	  if (!(flags & HYPHEN_LAST_CHAR))
+	    --limit;
 	}
+	if (flags & HYPHEN_NOT_LAST_CHARS)
+	  --limit;
+      }
+      bool is_limit_strict
+	= (points->source == hyphenation_points::PATTERN);
+      int k;
+      for (k = 0, tem = h; k < len && tem; tem = tem->next, k++) {
+	if (!(points->breaks[k / CHAR_BIT] & (1U << (k % CHAR_BIT))))
+	  continue;
+	if ((0 == k && !is_first_ok) || (1 == k && !is_second_ok))
+	  continue;
+	if (k >= limit && (k >= 2 || is_limit_strict))
+	  continue;
+	tem->is_hyphen = true;
       }
     }
     h = nexth;
@@ -4882,9 +6250,11 @@ static void update_hyphenation_patterns_from_file(bool appending)
   if (filename != 0 /* nullptr */) {
     if (0 /* nullptr */ == current_language)
       error("no current hyphenation language");
-    else
+    else {
       current_language->patterns.interpret_patterns_file(filename,
 	  appending, &current_language->exceptions);
+      current_language->memo.clear();
+    }
   }
 }
 
@@ -4927,6 +6297,153 @@ void init_hyphenation_pattern_requests()
   init_request("rhw", remove_hyphenation_exception_words_request);
 }
 
+// The environment section of a snapshot holds the hyphenation
+// languages and code table, the environments, and the environment
+// stack.
+
+bool write_environment_snapshot(snapshot_writer &w)
+{
+  std::vector<hyphenation_language *> languages;
+  dictionary_iterator lang_iter(language_dictionary);
+  symbol s;
+  hyphenation_language *lang;
+  while (lang_iter.get(&s, reinterpret_cast<void **>(&lang)))
+    languages.push_back(lang);
+  w.put_int(int(languages.size()));
+  for (size_t i = 0; i < languages.size(); i++) {
+    lang = languages[i];
+    w.put_string(lang->name.contents());
+    std::vector<std::pair<symbol, const char *> > words;
+    dictionary_iterator ex_iter(lang->exceptions);
+    unsigned char *pos;
+    while (ex_iter.get(&s, reinterpret_cast<void **>(&pos)))
+      words.push_back(std::make_pair(s,
+	  reinterpret_cast<const char *>(pos)));
+    w.put_int(int(words.size()));
+    for (size_t j = 0; j < words.size(); j++) {
+      w.put_string(words[j].first.contents());
+      w.put_string(words[j].second);
+    }
+    lang->patterns.write_image(w);
+  }
+  w.put_string((0 /* nullptr */ == current_language) ? 0 /* nullptr */
+	       : current_language->name.contents());
+  w.put_bytes(hpf_code_table, UCHAR_MAX + 1);
+  w.put_int(charinfo_glyph_index(field_delimiter_char));
+  w.put_int(charinfo_glyph_index(padding_indicator_char));
+  w.put_int(translate_space_to_dummy);
+  std::vector<environment *> envs;
+  dictionary_iterator env_iter(env_dictionary);
+  environment *e;
+  while (env_iter.get(&s, reinterpret_cast<void **>(&e)))
+    envs.push_back(e);
+  w.put_int(int(envs.size()));
+  for (size_t i = 0; i < envs.size(); i++) {
+    w.put_string(envs[i]->name.contents());
+    if (!envs[i]->write_image(w)) {
+      decline_snapshot("environment '%1' has pending output",
+		       envs[i]->name.contents());
+      return false;
+    }
+  }
+  int depth = 0;
+  for (env_list_node *p = env_stack; p != 0 /* nullptr */; p = p->next)
+    depth++;
+  w.put_int(depth);
+  for (env_list_node *p = env_stack; p != 0 /* nullptr */; p = p->next)
+    w.put_string(p->env->name.contents());
+  w.put_string(curenv->name.contents());
+  return true;
+}
+
+static environment *lookup_environment_image(snapshot_reader &r)
+{
+  const char *s = r.get_string();
+  environment *e = (0 /* nullptr */ == s) ? 0 /* nullptr */
+		   : static_cast<environment *>
+		     (env_dictionary.lookup(symbol(s)));
+  if (0 /* nullptr */ == e)
+    r.invalidate();
+  return e;
+}
+
+void read_environment_snapshot(snapshot_reader &r)
+{
+  int nlanguages = r.get_count(sizeof(int));
+  for (int i = 0; i < nlanguages && r.is_valid(); i++) {
+    const char *s = r.get_string();
+    if (0 /* nullptr */ == s) {
+      r.invalidate();
+      break;
+    }
+    symbol nm(s);
+    hyphenation_language *lang = static_cast<hyphenation_language *>
+      (language_dictionary.lookup(nm));
+    if (0 /* nullptr */ == lang) {
+      lang = new hyphenation_language(nm);
+      (void) language_dictionary.lookup(nm, lang);
+    }
+    int nwords = r.get_count(2 * sizeof(int));
+    for (int j = 0; j < nwords && r.is_valid(); j++) {
+      const char *word = r.get_string();
+      const char *pos = r.get_string();
+      if (0 /* nullptr */ == word || 0 /* nullptr */ == pos) {
+	r.invalidate();
+	break;
+      }
+      size_t len = strlen(pos) + 1;
+      unsigned char *tem = new unsigned char[len];
+      memcpy(tem, pos, len);
+      tem = static_cast<unsigned char *>
+	    (lang->exceptions.lookup(symbol(word), tem));
+      delete[] tem;
+    }
+    lang->patterns.read_image(r);
+  }
+  const char *s = r.get_string();
+  current_language = (0 /* nullptr */ == s) ? 0 /* nullptr */
+		     : static_cast<hyphenation_language *>
+		       (language_dictionary.lookup(symbol(s)));
+  if (s != 0 /* nullptr */ && 0 /* nullptr */ == current_language)
+    r.invalidate();
+  const void *codes = r.get_bytes(UCHAR_MAX + 1);
+  if (codes != 0 /* nullptr */)
+    memcpy(hpf_code_table, codes, UCHAR_MAX + 1);
+  int i = r.get_int();
+  field_delimiter_char = charinfo_for_glyph_index(i);
+  i = r.get_int();
+  padding_indicator_char = charinfo_for_glyph_index(i);
+  translate_space_to_dummy = r.get_int();
+  int nenvs = r.get_count(sizeof(int));
+  for (int j = 0; j < nenvs && r.is_valid(); j++) {
+    s = r.get_string();
+    if (0 /* nullptr */ == s) {
+      r.invalidate();
+      break;
+    }
+    symbol nm(s);
+    environment *e
+      = static_cast<environment *>(env_dictionary.lookup(nm));
+    if (0 /* nullptr */ == e) {
+      e = new environment(nm);
+      (void) env_dictionary.lookup(nm, e);
+    }
+    e->read_image(r);
+  }
+  int depth = r.get_count(sizeof(int));
+  env_list_node **pp = &env_stack;
+  for (int j = 0; j < depth && r.is_valid(); j++) {
+    environment *e = lookup_environment_image(r);
+    *pp = new env_list_node(e, 0 /* nullptr */);
+    pp = &(*pp)->next;
+  }
+  environment *e = lookup_environment_image(r);
+  if (e != 0 /* nullptr */)
+    curenv = e;
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+}
+
 // Local Variables:
 // fill-column: 72
 // mode: C++
@@ -74,6 +74,8 @@ hunits env_half_narrow_space_width(environment *);
 int env_get_zoom(environment *);
 
 struct tab;
+class snapshot_writer;
+class snapshot_reader;
 
 enum tab_type { TAB_NONE, TAB_LEFT, TAB_CENTER, TAB_RIGHT };
 
@@ -95,6 +97,8 @@ public:
   void add_tab(hunits /* pos */, tab_type /* type */,
 	       bool /* is_repeated */);
   const char *to_string();
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 class charinfo;
@@ -132,6 +136,7 @@ void no_hyphenate();
 void hyphen_line_max_request();
 void hyphenation_space_request();
 void hyphenation_margin_request();
+void total_fit_request();
 void line_width();
 #if 0
 void tabs_save();
@@ -220,6 +225,7 @@ class environment {
   int hyphen_line_max;
   hunits hyphenation_space;
   hunits hyphenation_margin;
+  bool want_total_fit;		// break paragraphs all at once
   bool composite;	// used for construction of composite character
   pending_output_line *pending_lines;
 #ifdef WIDOW_CONTROL
@@ -249,6 +255,12 @@ class environment {
 #endif /* WIDOW_CONTROL */
   breakpoint *choose_breakpoint();
   void possibly_hyphenate_line(bool /* must_break_here */ = false);
+  node **hyphenate_word(node ** /* startp */);
+  void hyphenate_all_words();
+  double total_fit_badness(hunits /* slack */, int /* nspaces */);
+  void break_paragraph();
+  bool output_broken_line(breakpoint * /* bp */,
+			  bool * /* was_centered */);
   void start_field();
   void wrap_up_field();
   void add_padding();
@@ -335,6 +347,7 @@ public:
   int get_hyphen_line_count();
   hunits get_hyphenation_space();
   hunits get_hyphenation_margin();
+  int get_total_fit();
   int get_underlined_line_count();
   int get_centered_line_count();
   int get_input_trap_line_count();
@@ -372,6 +385,7 @@ public:
   void advance_to_tab_stop(bool /* use_leader */ = false);
   void add_node(node *);
   void add_char(charinfo *);
+  void add_chars(const unsigned char *, int);
   void add_hyphen_indicator();
   void add_italic_correction();
   void space();
@@ -393,6 +407,8 @@ public:
   void construct_new_line_state(node *n);
   void dump_troff_state();
   void dump_pending_nodes();
+  bool write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 
   friend void title_length();
   friend void adjust();
@@ -418,6 +434,7 @@ public:
   friend void hyphen_line_max_request();
   friend void hyphenation_space_request();
   friend void hyphenation_margin_request();
+  friend void total_fit_request();
   friend void line_width();
 #if 0
   friend void tabs_save();
@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <errno.h> // ENOENT, errno
 #include <locale.h> // setlocale()
 #include <stdcountof.h>
+#include <stdint.h> // uint64_t, UINT64_C
 #include <stdio.h> // prerequisite of searchpath.h
 		   // EOF, FILE, clearerr(), fclose(), fflush(),
 		   // fileno(), fopen(), fprintf(), fseek(), getc(),
@@ -34,18 +35,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 		   // ungetc()
 #include <stdlib.h> // atoi(), exit(), EXIT_FAILURE, EXIT_SUCCESS,
 		    // free(), getenv(), setenv(), strtol(), system()
-#include <string.h> // memset(), strcpy(), strdup(), strerror()
+#include <string.h> // memchr(), memcpy(), memset(), strcpy(), strdup(),
+		    // strerror()
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h> // mmap(), munmap()
+#endif
 
 // GNU extensions to C standard library
 #include <getopt.h> // getopt_long()
 
+#include <map>
 #include <stack>
+#include <vector>
 
 // operating system services
-// needed for getpid() and isatty()
+// needed for dup2(), fork(), getpid(), isatty(), and _exit()
 #include "posix.h"
 #include "nonposix.h"
 
+#ifdef _POSIX_VERSION
+#include <sys/wait.h> // waitpid(), WEXITSTATUS(), WIFEXITED(),
+		      // WTERMSIG()
+#endif
+
 // build configuration
 #include "defs.h"
 
@@ -62,7 +75,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "font.h" // prerequisite of charinfo.h
 #include "json-encode.h" // json_encode_char()
 #include "lib.h" // i_to_a(), is_invalid_input_char(), ui_to_a()
-#include "stringclass.h" // prerequisite of mtsm.h
+#include "stringclass.h" // prerequisite of mtsm.h, snapshot.h
+#include "snapshot.h"
 #include "unicode.h"
 
 // troff
@@ -81,6 +95,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 		       // safer_macro_path
 #include "request.h" // prerequisite of node.h; macro
 #include "node.h"
+#include "profile.h"
 #include "reg.h"
 
 #define MACRO_PREFIX "tmac."
@@ -140,8 +155,17 @@ bool want_att_compat = false;
 bool want_abstract_output = false;
 bool want_nodes_dumped = false;
 bool want_output_suppressed = false;
+bool want_hyphenation_caches_written = false;
+bool want_binary_output = false;
+const char *page_index_file_name = 0 /* nullptr */;
 bool is_writing_html = false;
 static int suppression_level = 0;	// depth of nested \O escapes
+// Used while reading the start-up files for a snapshot; see below.
+static bool is_recording_for_snapshot = false;
+static dictionary recorded_request_dictionary(101);
+static dictionary recorded_variable_dictionary(17);
+static int diagnostic_count = 0;
+static bool was_time_of_day_interpolated = false;
 
 bool in_nroff_mode = false;
 // TODO: Kill this off in groff 1.24.0 release + 2 years.  See env.cpp.
@@ -211,6 +235,7 @@ static bool read_line_rule_expression(units * /* res */,
 static bool read_size(int *);
 static symbol read_delimited_identifier();
 static void init_registers();
+static bool is_time_of_day_register(reg *);
 static void trapping_blank_line();
 
 class input_iterator;
@@ -368,7 +393,7 @@ static void assign_no_break_control_character_request() // .c2
   skip_line();
 }
 
-struct arg_list;
+class arg_list;
 
 class input_iterator {
 public:
@@ -389,7 +414,8 @@ private:
   virtual bool has_args() { return false; }
   virtual int nargs() { return 0; }
   virtual input_iterator *get_arg(int) { return 0 /* nullptr */; }
-  virtual arg_list *get_arg_list() { return 0 /* nullptr */; }
+  virtual arg_list *get_arg_list(int * /* firstp */)
+    { return 0 /* nullptr */; }
   virtual symbol get_macro_name() { return NULL_SYMBOL; }
   virtual bool space_follows_arg(int) { return false; }
   virtual bool get_break_flag() { return false; }
@@ -442,6 +468,37 @@ public:
   int is_boundary() { return 2; }
 };
 
+// Find the first invalid input character in [p, e), returning `e` if
+// there is none.  Most input is clean, so examine a machine word at a
+// time; only a byte with neither bit 5 nor bit 6 set (a C0 or C1
+// control character) can be invalid, and only words containing such a
+// byte are checked against `invalid_char_table`.
+static const unsigned char *find_invalid_input_char(
+  const unsigned char *p, const unsigned char *e)
+{
+  const uint64_t ones = UINT64_C(0x0101010101010101);
+  while ((e - p) >= 8) {
+    uint64_t w;
+    memcpy(&w, p, sizeof w);
+    // Each byte of `t` is 0x60 exactly when `(byte & 0x60) == 0`, and
+    // has its high bit set otherwise; no carries cross byte lanes.
+    uint64_t t = (w & (ones * 0x60)) + (ones * 0x60);
+    if ((~t & (ones * 0x80)) != 0)
+      for (int i = 0; i < 8; i++)
+	if (is_invalid_input_char(p[i]))
+	  return p + i;
+    p += 8;
+  }
+  for (; p < e; p++)
+    if (is_invalid_input_char(*p))
+      return p;
+  return e;
+}
+
+// A file_iterator reads regular files in large blocks and hands whole
+// lines to the input stack directly from its block buffer.  The
+// standard input stream and pipes are read a character at a time
+// because other requests (`rd`) may consume from the same stream.
 class file_iterator : public input_iterator {
   FILE *fp;
   int lineno;
@@ -451,7 +508,16 @@ class file_iterator : public input_iterator {
   bool seen_escape;
   enum { BUF_SIZE = 512 };
   unsigned char buf[BUF_SIZE];
+  enum { BLOCK_SIZE = 64 * 1024 };
+  unsigned char *block;		// null unless reading a regular file
+  unsigned char *block_ptr;	// start of unconsumed input in `block`
+  unsigned char *block_end;	// end of valid data in `block`
+  unsigned char *invalid_ptr;	// first invalid character, or block_end
   void close();
+  void select_input_strategy();
+  bool fill_block();
+  int fill_from_block();
+  int fill_from_stream();
 public:
   file_iterator(FILE *, const char *, bool = false);
   ~file_iterator();
@@ -467,7 +533,9 @@ public:
 
 file_iterator::file_iterator(FILE *f, const char *fn, bool popened)
 : fp(f), lineno(1), was_popened(popened),
-  seen_newline(false), seen_escape(false)
+  seen_newline(false), seen_escape(false), block(0 /* nullptr */),
+  block_ptr(0 /* nullptr */), block_end(0 /* nullptr */),
+  invalid_ptr(0 /* nullptr */)
 {
   filename = strdup(const_cast<char *>(fn));
   if ((font::use_charnames_in_special) && (fn != 0 /* nullptr */)) {
@@ -475,11 +543,13 @@ file_iterator::file_iterator(FILE *f, const char *fn, bool popened)
       init_output();
     the_output->put_filename(fn, popened);
   }
+  select_input_strategy();
 }
 
 file_iterator::~file_iterator()
 {
   close();
+  delete[] block;
 }
 
 void file_iterator::close()
@@ -492,6 +562,24 @@ void file_iterator::close()
     fclose(fp);
 }
 
+// Use block reads only for regular files that nothing else reads.
+void file_iterator::select_input_strategy()
+{
+  struct stat sb;
+  bool want_block = (fp != stdin) && !was_popened
+		    && (fstat(fileno(fp), &sb) == 0)
+		    && S_ISREG(sb.st_mode);
+  if (want_block) {
+    if (0 /* nullptr */ == block)
+      block = new unsigned char[BLOCK_SIZE];
+  }
+  else {
+    delete[] block;
+    block = 0 /* nullptr */;
+  }
+  block_ptr = block_end = invalid_ptr = block;
+}
+
 bool file_iterator::next_file(FILE *f, const char *s)
 {
   close();
@@ -502,33 +590,67 @@ bool file_iterator::next_file(FILE *f, const char *s)
   was_popened = false;
   ptr = 0 /* nullptr */;
   endptr = 0 /* nullptr */;
+  select_input_strategy();
   return true;
 }
 
-// TODO: Define a function, say, process_input_character().
-//
-// Delegate the actual work on inbounding a UTF-8 sequence from the
-// standard I/O stream to some gnulib module (research needed).  Prepare
-// for exceptional conditions:
-//   1.  EOF
-//   2.  incomplete UTF-8 sequence
-//   3.  invalid UTF-8 sequence (overlong encoding, outside code range)
-//
-// If an exceptional condition occurs, throw an exception of a type we
-// define; our callers must catch it.  The result of the exception is
-// likely either to abort collection of the syntactical item being
-// collected (such as an identifier) and/or to decide we've reached the
-// end of input.  Follow the pattern(s) of existing EOF handling.
-//
-// If no exception occurs, apply Normalization Form D (if gnulib
-// can't/doesn't do that), and return an std::vector<> of `char32_t`.
+// Read the next block of the file; return `false` at end of file.
+bool file_iterator::fill_block()
+{
+  assert(block != 0 /* nullptr */);
+  size_t n = fread(block, 1, BLOCK_SIZE, fp);
+  block_ptr = block;
+  block_end = block + n;
+  invalid_ptr = const_cast<unsigned char *>(
+    find_invalid_input_char(block_ptr, block_end));
+  return (n > 0);
+}
 
-// Returns an unsigned char or `EOF`.
-int file_iterator::fill(node **)
+// Hand the next line (or, if the line straddles a block boundary, the
+// part of it remaining in the block) to the input stack in place.
+int file_iterator::fill_from_block()
+{
+  for (;;) {
+    if ((block_ptr == block_end) && !fill_block()) {
+      ptr = endptr = block_ptr;
+      return EOF;
+    }
+    unsigned char *start = block_ptr;
+    unsigned char *nl = static_cast<unsigned char *>(
+      memchr(start, '\n', block_end - start));
+    unsigned char *e = (nl != 0 /* nullptr */) ? nl + 1 : block_end;
+    block_ptr = e;
+    // Squeeze invalid characters out of this line, in order, so that
+    // diagnostics bear the line number they did before.
+    if (invalid_ptr < e) {
+      unsigned char *q = invalid_ptr;
+      for (unsigned char *p = invalid_ptr; p < e; p++) {
+	if (is_invalid_input_char(*p))
+	  warning(WARN_INPUT, "invalid input character code %1",
+		  int(*p));
+	else
+	  *q++ = *p;
+      }
+      e = q;
+      invalid_ptr = const_cast<unsigned char *>(
+	find_invalid_input_char(block_ptr, block_end));
+    }
+    if (nl != 0 /* nullptr */) {
+      seen_escape = false;
+      seen_newline = true;
+    }
+    else if (e > start)
+      seen_escape = ('\\' == e[-1]);
+    if (e > start) {
+      ptr = start;
+      endptr = e;
+      return *ptr++;
+    }
+  }
+}
+
+int file_iterator::fill_from_stream()
 {
-  if (seen_newline)
-    lineno++;
-  seen_newline = false;
   unsigned char *p = buf;
   ptr = p;
   unsigned char *e = p + BUF_SIZE;
@@ -559,8 +681,50 @@ int file_iterator::fill(node **)
   }
 }
 
+// TODO: Define a function, say, process_input_character().
+//
+// Delegate the actual work on inbounding a UTF-8 sequence from the
+// standard I/O stream to some gnulib module (research needed).  Prepare
+// for exceptional conditions:
+//   1.  EOF
+//   2.  incomplete UTF-8 sequence
+//   3.  invalid UTF-8 sequence (overlong encoding, outside code range)
+//
+// If an exceptional condition occurs, throw an exception of a type we
+// define; our callers must catch it.  The result of the exception is
+// likely either to abort collection of the syntactical item being
+// collected (such as an identifier) and/or to decide we've reached the
+// end of input.  Follow the pattern(s) of existing EOF handling.
+//
+// If no exception occurs, apply Normalization Form D (if gnulib
+// can't/doesn't do that), and return an std::vector<> of `char32_t`.
+
+// Returns an unsigned char or `EOF`.
+int file_iterator::fill(node **)
+{
+  if (seen_newline)
+    lineno++;
+  seen_newline = false;
+  if (block != 0 /* nullptr */)
+    return fill_from_block();
+  return fill_from_stream();
+}
+
 int file_iterator::peek()
 {
+  if (block != 0 /* nullptr */) {
+    for (;;) {
+      if ((block_ptr == block_end) && !fill_block())
+	return EOF;
+      if (block_ptr < invalid_ptr)
+	return *block_ptr;
+      warning(WARN_INPUT, "invalid input character code %1",
+	      int(*block_ptr));
+      block_ptr++;
+      invalid_ptr = const_cast<unsigned char *>(
+	find_invalid_input_char(block_ptr, block_end));
+    }
+  }
   // TODO: process_input_character()
   int c = getc(fp);
   while (is_invalid_input_char(c)) {
@@ -612,10 +776,11 @@ input_iterator nil_iterator;
 class input_stack {
 public:
   static int get(node **);
+  static const unsigned char *get_ordinary_chars(int * /* lenp */);
   static int peek();
   static void push(input_iterator *);
   static input_iterator *get_arg(int);
-  static arg_list *get_arg_list();
+  static arg_list *get_arg_list(int * /* firstp */);
   static symbol get_macro_name();
   static bool space_follows_arg(int);
   static int get_break_flag();
@@ -653,6 +818,7 @@ private:
 };
 
 input_iterator *input_stack::top = &nil_iterator;
+unsigned long input_characters_read = 0;
 int input_stack::level = 0;
 int input_stack::limit = DEFAULT_INPUT_STACK_LIMIT;
 int input_stack::div_level = 0;
@@ -683,6 +849,7 @@ inline int input_stack::get_div_level()
 inline int input_stack::get(node **np)
 {
   int res = (top->ptr < top->endptr) ? *top->ptr++ : finish_get(np);
+  input_characters_read++;
   if (res == '\n') {
     have_formattable_input_on_interrupted_line = have_formattable_input;
     have_formattable_input = false;
@@ -690,6 +857,32 @@ inline int input_stack::get(node **np)
   return res;
 }
 
+// Would `token::next()` read `c` as a `TOKEN_CHAR` with no side
+// effect?
+
+static inline bool is_ordinary_char(unsigned char c)
+{
+  return (((c > ' ') && (c < INPUT_DELETE))
+	  || ((c > INPUT_NO_BREAK_SPACE) && (c != INPUT_SOFT_HYPHEN)))
+	 && (c != escape_char);
+}
+
+// Consume the ordinary characters at the front of the current input
+// iterator's buffer, without refilling it, and return a pointer to
+// them, storing their count in `*lenp`.
+
+const unsigned char *input_stack::get_ordinary_chars(int *lenp)
+{
+  const unsigned char *start = top->ptr;
+  const unsigned char *p = start;
+  while ((p < top->endptr) && is_ordinary_char(*p))
+    p++;
+  top->ptr = p;
+  *lenp = int(p - start);
+  input_characters_read += *lenp;
+  return start;
+}
+
 int input_stack::finish_get(node **np)
 {
   for (;;) {
@@ -829,12 +1022,12 @@ input_iterator *input_stack::get_arg(int i)
   return 0 /* nullptr */;
 }
 
-arg_list *input_stack::get_arg_list()
+arg_list *input_stack::get_arg_list(int *firstp)
 {
   input_iterator *p;
   for (p = top; p != 0 /* nullptr */; p = p->next)
     if (p->has_args())
-      return p->get_arg_list();
+      return p->get_arg_list(firstp);
   return 0 /* nullptr */;
 }
 
@@ -1754,6 +1947,73 @@ static void print_color_request() // .pcolor
   skip_line();
 }
 
+// A color's image is its kind (null, the default color, or another),
+// and for the last its name, scheme, and components.  Reading one back
+// yields the defined color of that name if it is equal, so that
+// environments share color objects with the dictionary as they did.
+
+void write_color_image(snapshot_writer &w, color *c)
+{
+  if (0 /* nullptr */ == c) {
+    w.put_int(0);
+    return;
+  }
+  if (&default_color == c) {
+    w.put_int(1);
+    return;
+  }
+  w.put_int(2);
+  w.put_string(c->nm.contents());
+  unsigned int comp[4];
+  w.put_int(c->get_components(comp));
+  for (int i = 0; i < 4; i++)
+    w.put_int(int(comp[i]));
+}
+
+color *read_color_image(snapshot_reader &r)
+{
+  int kind = r.get_int();
+  if (0 == kind)
+    return 0 /* nullptr */;
+  if (1 == kind)
+    return &default_color;
+  const char *name = r.get_string();
+  int scheme = r.get_int();
+  unsigned int comp[4];
+  for (int i = 0; i < 4; i++)
+    comp[i] = (unsigned int) r.get_int();
+  if (kind != 2 || 0 /* nullptr */ == name) {
+    r.invalidate();
+    return &default_color;
+  }
+  color *c = new color(symbol(name));
+  switch (scheme) {
+  case DEFAULT:
+    c->set_default();
+    break;
+  case RGB:
+    c->set_rgb(comp[0], comp[1], comp[2]);
+    break;
+  case CMY:
+    c->set_cmy(comp[0], comp[1], comp[2]);
+    break;
+  case CMYK:
+    c->set_cmyk(comp[0], comp[1], comp[2], comp[3]);
+    break;
+  case GRAY:
+    c->set_gray(comp[0]);
+    break;
+  default:
+    r.invalidate();
+  }
+  color *defined = static_cast<color *>(color_dictionary.lookup(c->nm));
+  if (defined != 0 /* nullptr */ && *defined == *c) {
+    delete c;
+    return defined;
+  }
+  return c;
+}
+
 node *do_overstrike() // \o
 {
   overstrike_node *osnode = new overstrike_node;
@@ -3676,8 +3936,15 @@ void process_input_stack()
 		warning(WARN_SYNTAX, "ignoring %1 on input line after"
 			" output line continuation escape sequence",
 			tok.description());
-	      else
+	      else {
 		curenv->add_char(charset_table[ch]);
+		// Take any ordinary characters that follow as a run.
+		int len;
+		const unsigned char *run
+		  = input_stack::get_ordinary_chars(&len);
+		if (len > 0)
+		  curenv->add_chars(run, len);
+	      }
 	      tok.next();
 	      if (tok.type != token::TOKEN_CHAR)
 		break;
@@ -3918,58 +4185,63 @@ macro *request_or_macro::to_macro()
   return 0 /* nullptr */;
 }
 
-request::request(REQUEST_FUNCP pp) : p(pp)
-{
-}
-
-void request::invoke(symbol, bool)
+request::request(REQUEST_FUNCP pp, symbol s) : p(pp), nm(s)
 {
-  (*p)();
 }
 
-struct char_block {
-  enum { SIZE = 128 };
-  unsigned char s[SIZE];
-  char_block *next;
-  char_block();
-};
-
-char_block::char_block()
-: next(0 /* nullptr */)
+void request::invoke(symbol s, bool)
 {
+  if (is_recording_for_snapshot)
+    (void) recorded_request_dictionary.lookup(nm, this);
+  if (is_profiling) {
+    int frame = begin_profile_frame(s, true /* is_request */);
+    (*p)();
+    end_profile_frame(frame);
+  }
+  else
+    (*p)();
 }
 
+// A char_list stores the text of a macro, string, or diversion in one
+// contiguous buffer so that access by offset takes constant time and
+// appending takes amortized constant time.  A null byte stands for the
+// next node in the accompanying `node_list`.
+//
+// A buffer is never moved while it is shared: anyone reading it (such
+// as a `string_iterator`) holds a reference to its `macro_header`, and
+// `macro::append()` copies a shared header rather than grow it.
+//
 // TODO: grochar
 class char_list {
 public:
   char_list();
   ~char_list();
   void append(unsigned char);
+  void append(const unsigned char *, int);
   void set(unsigned char, int);
   unsigned char get(int);
   int get_length();
+  bool is_full();
+  void reserve(int);
 private:
-  unsigned char *ptr;
+  unsigned char *buf;
   int length;
-  char_block *head;
-  char_block *tail;
+  int capacity;
+  friend class macro;
   friend class macro_header;
   friend class string_iterator;
+  friend class arg_list;
+  friend class joined_args_iterator;
 };
 
 char_list::char_list()
-: ptr(0 /* nullptr */), length(0), head(0 /* nullptr */),
-  tail(0 /* nullptr */)
+: buf(0 /* nullptr */), length(0), capacity(0)
 {
 }
 
 char_list::~char_list()
 {
-  while (head != 0) {
-    char_block *tem = head;
-    head = head->next;
-    delete tem;
-  }
+  delete[] buf;
 }
 
 int char_list::get_length()
@@ -3977,55 +4249,55 @@ int char_list::get_length()
   return length;
 }
 
+bool char_list::is_full()
+{
+  return (length == capacity);
+}
+
+// Ensure room for at least `n` characters.
+void char_list::reserve(int n)
+{
+  if (n <= capacity)
+    return;
+  int new_capacity = (capacity > 0) ? capacity
+		     : static_cast<int>(default_buffer_size);
+  while (new_capacity < n) {
+    if (new_capacity > (INT_MAX / 2))
+      fatal("macro, string, or diversion is too long");
+    new_capacity *= 2;
+  }
+  unsigned char *new_buf = new unsigned char[new_capacity];
+  if (length > 0)
+    (void) memcpy(new_buf, buf, length);
+  delete[] buf;
+  buf = new_buf;
+  capacity = new_capacity;
+}
+
 void char_list::append(unsigned char c)
 {
-  if (tail == 0) {
-    head = tail = new char_block;
-    ptr = tail->s;
-  }
-  else {
-    if (ptr >= tail->s + char_block::SIZE) {
-      tail->next = new char_block;
-      tail = tail->next;
-      ptr = tail->s;
-    }
-  }
-  *ptr++ = c;
-  length++;
+  if (length == capacity)
+    reserve(length + 1);
+  buf[length++] = c;
+}
+
+void char_list::append(const unsigned char *s, int n)
+{
+  reserve(length + n);
+  (void) memcpy(buf + length, s, n);
+  length += n;
 }
 
 void char_list::set(unsigned char c, int offset)
 {
   assert(length > offset);
-  // optimization for access at the end
-  int boundary = length - (length % char_block::SIZE);
-  if (offset >= boundary) {
-    *(tail->s + offset - boundary) = c;
-    return;
-  }
-  char_block *tem = head;
-  int l = 0;
-  for (;;) {
-    l += char_block::SIZE;
-    if (l > offset) {
-      *(tem->s + offset % char_block::SIZE) = c;
-      return;
-    }
-    tem = tem->next;
-  }
+  buf[offset] = c;
 }
 
 unsigned char char_list::get(int offset)
 {
   assert(length > offset);
-  char_block *tem = head;
-  int l = 0;
-  for (;;) {
-    l += char_block::SIZE;
-    if (l > offset)
-      return *(tem->s + offset % char_block::SIZE);
-    tem = tem->next;
-  }
+  return buf[offset];
 }
 
 class node_list {
@@ -4078,6 +4350,7 @@ public:
   node_list nl;
   macro_header() { count = 1; }
   macro_header *copy(int);
+  bool must_copy_to_append(int);
   void json_dump_macro();
   void json_dump_diversion();
 };
@@ -4162,7 +4435,7 @@ void macro::append(unsigned char c)
   assert(c != 0);
   if (p == 0 /* nullptr */)
     p = new macro_header;
-  if (p->cl.get_length() != length) {
+  if (p->must_copy_to_append(length)) {
     macro_header *tem = p->copy(length);
     if (--(p->count) <= 0)
       delete p;
@@ -4178,6 +4451,12 @@ void macro::set(unsigned char c, int offset)
 {
   assert(p != 0 /* nullptr */);
   assert(c != 0);
+  // Don't alter the contents of other macros sharing this header.
+  if (p->count > 1) {
+    macro_header *tem = p->copy(length);
+    --(p->count);
+    p = tem;
+  }
   p->cl.set(c, offset);
 }
 
@@ -4209,7 +4488,7 @@ void macro::append(node *n)
   assert(n != 0 /* nullptr */);
   if (p == 0 /* nullptr */)
     p = new macro_header;
-  if (p->cl.get_length() != length) {
+  if (p->must_copy_to_append(length)) {
     macro_header *tem = p->copy(length);
     if (--(p->count) <= 0)
       delete p;
@@ -4264,6 +4543,47 @@ void macro::chop()
     length -= 1;
 }
 
+// Write an image of the macro to a snapshot.  Nodes have no image; if
+// the macro contains any, return false.
+bool macro::write_image(snapshot_writer &w)
+{
+  const unsigned char *s = (p != 0 /* nullptr */) ? p->cl.buf
+			   : 0 /* nullptr */;
+  if (length > 0 && memchr(s, 0, length) != 0 /* nullptr */)
+    return false;
+  w.put_string(filename);
+  w.put_int(lineno);
+  w.put_int(is_empty_macro);
+  w.put_int(is_a_diversion);
+  w.put_int(is_a_string);
+  w.put_int(length);
+  if (length > 0)
+    w.put_bytes(s, length);
+  return true;
+}
+
+// The file name points into the snapshot image, which the caller must
+// keep.
+void macro::read_image(snapshot_reader &r)
+{
+  filename = r.get_string();
+  lineno = r.get_int();
+  is_empty_macro = r.get_int();
+  is_a_diversion = r.get_int();
+  is_a_string = r.get_int();
+  int n = r.get_count();
+  const void *s = r.get_bytes(n);
+  if (p != 0 /* nullptr */ && --(p->count) <= 0)
+    delete p;
+  p = 0 /* nullptr */;
+  length = 0;
+  if (n > 0 && s != 0 /* nullptr */) {
+    p = new macro_header;
+    p->cl.append(static_cast<const unsigned char *>(s), n);
+    length = n;
+  }
+}
+
 void macro::print_size()
 {
   errprint("%1", length);
@@ -4303,25 +4623,34 @@ void macro::json_dump()
   }
 }
 
+// Can a macro of length `n` sharing this header append to it in place?
+// Not if another macro has already appended its own text, and not if
+// the buffer would have to grow while others still read it.
+
+bool macro_header::must_copy_to_append(int n)
+{
+  return (cl.get_length() != n) || ((count > 1) && cl.is_full());
+}
+
 // make a copy of the first n bytes
 
 macro_header *macro_header::copy(int n)
 {
   macro_header *p = new macro_header;
-  char_block *bp = cl.head;
-  unsigned char *ptr = bp->s;
+  p->cl.reserve(n + 1);
+  if (n > 0)
+    (void) memcpy(p->cl.buf, cl.buf, n);
+  p->cl.length = n;
   node *nd = nl.head;
-  while (--n >= 0) {
-    if (ptr >= bp->s + char_block::SIZE) {
-      bp = bp->next;
-      ptr = bp->s;
-    }
-    unsigned char c = *ptr++;
-    p->cl.append(c);
-    if (0U == c) {
-      p->nl.append(nd->copy());
-      nd = nd->next;
-    }
+  const unsigned char *s = cl.buf;
+  const unsigned char *e = cl.buf + n;
+  while (s < e) {
+    s = static_cast<const unsigned char *>(memchr(s, '\0', e - s));
+    if (0 /* nullptr */ == s)
+      break;
+    p->nl.append(nd->copy());
+    nd = nd->next;
+    s++;
   }
   return p;
 }
@@ -4394,7 +4723,6 @@ class string_iterator : public input_iterator {
   const char *how_invoked;
   bool seen_newline;
   int lineno;
-  char_block *bp;
   int count;			// of characters remaining
   node *nd;
   bool att_compat;
@@ -4405,6 +4733,8 @@ protected:
 public:
   string_iterator(const macro &, const char * = 0 /* nullptr */,
 		  symbol = NULL_SYMBOL);
+  string_iterator(const macro &, int /* start */, int /* len */,
+		  int /* node_index */, int /* arg_lineno */);
   int fill(node **); // returns an unsigned char or `EOF`
   int peek();
   bool get_location(bool /* allow_macro */, const char ** /* filep */,
@@ -4423,12 +4753,35 @@ string_iterator::string_iterator(const macro &m, const char *p,
 {
   count = mac.length;
   if (count != 0) {
-    bp = mac.p->cl.head;
     nd = mac.p->nl.head;
-    ptr = endptr = bp->s;
+    ptr = endptr = mac.p->cl.buf;
+  }
+  else {
+    nd = 0 /* nullptr */;
+    ptr = endptr = 0 /* nullptr */;
+  }
+  with_break = input_stack::get_break_flag();
+}
+
+// Iterate over `len` characters of `m` starting at offset `start`.
+// `node_index` counts the nodes that precede `start`.  If nonzero,
+// `arg_lineno` is the input line where the text began.
+
+string_iterator::string_iterator(const macro &m, int start, int len,
+				 int node_index, int arg_lineno)
+: input_iterator(m.is_a_diversion), mac(m),
+  how_invoked(0 /* nullptr */), seen_newline(false), lineno(1)
+{
+  if (arg_lineno > 0 && mac.lineno > 0)
+    lineno += arg_lineno - mac.lineno;
+  count = len;
+  if (count != 0) {
+    nd = mac.p->nl.head;
+    for (int i = 0; i < node_index; i++)
+      nd = nd->next;
+    ptr = endptr = mac.p->cl.buf + start;
   }
   else {
-    bp = 0 /* nullptr */;
     nd = 0 /* nullptr */;
     ptr = endptr = 0 /* nullptr */;
   }
@@ -4437,7 +4790,6 @@ string_iterator::string_iterator(const macro &m, const char *p,
 
 string_iterator::string_iterator()
 {
-  bp = 0 /* nullptr */;
   nd = 0 /* nullptr */;
   ptr = endptr = 0 /* nullptr */;
   seen_newline = false;
@@ -4461,10 +4813,6 @@ int string_iterator::fill(node **np)
   if (count <= 0)
     return EOF;
   const unsigned char *p = endptr;
-  if (p >= bp->s + char_block::SIZE) {
-    bp = bp->next;
-    p = bp->s;
-  }
   if (*p == '\0') {
     if (np != 0 /* nullptr */) {
       *np = nd->copy();
@@ -4478,9 +4826,7 @@ int string_iterator::fill(node **np)
     count--;
     return 0U;
   }
-  const unsigned char *e = bp->s + char_block::SIZE;
-  if (e - p > count)
-    e = p + count;
+  const unsigned char *e = p + count;
   ptr = p;
   while (p < e) {
     unsigned char c = *p;
@@ -4502,11 +4848,7 @@ int string_iterator::peek()
 {
   if (count <= 0)
     return EOF;
-  const unsigned char *p = endptr;
-  if (p >= bp->s + char_block::SIZE) {
-    p = bp->next->s;
-  }
-  return *p;
+  return *endptr;
 }
 
 bool string_iterator::get_location(bool allow_macro,
@@ -4576,42 +4918,92 @@ input_iterator *make_temp_iterator(const char *s)
 
 // this is used when macros with arguments are interpolated
 
-struct arg_list {
-  macro mac;
-  bool space_follows;
-  arg_list *next;
-  arg_list(const macro &, bool);
-  arg_list(const arg_list *);
-  ~arg_list();
+// The arguments of a macro call, stored back to back in one macro so
+// that each can be read in place.  Once complete, an argument list is
+// never changed, so iterators inheriting their caller's arguments
+// share it by reference count, and shifting it only advances the
+// sharing iterator's index of its first argument.
+
+class arg_list {
+  struct arg {
+    int start;
+    int length;
+    int node_index;		// nodes in `text` preceding `start`
+    int lineno;			// where it began, if known
+    bool space_follows;
+  };
+  std::vector<arg> args;
+  int nnodes;
+public:
+  int count;			// of references
+  macro text;
+  arg_list();
+  void begin_arg();
+  void end_arg(bool /* space_follows */);
+  int nargs() { return int(args.size()); }
+  input_iterator *get_arg(int);
+  bool space_follows_arg(int i) { return args[i].space_follows; }
+  int arg_start(int i) { return args[i].start; }
+  int arg_length(int i) { return args[i].length; }
 };
 
-arg_list::arg_list(const macro &m, bool b)
-: mac(m), space_follows(b), next(0 /* nullptr */)
+arg_list::arg_list()
+: nnodes(0), count(1)
 {
 }
 
-arg_list::arg_list(const arg_list *al)
-: next(0 /* nullptr */)
+void arg_list::begin_arg()
 {
-  mac = al->mac;
-  space_follows = al->space_follows;
-  arg_list **a = &next;
-  arg_list *p = al->next;
-  while (p != 0 /* nullptr */) {
-    *a = new arg_list(p->mac, p->space_follows);
-    p = p->next;
-    a = &(*a)->next;
+  arg a;
+  a.start = text.get_length();
+  a.length = 0;
+  a.node_index = nnodes;
+  const char *filename;
+  if (!input_stack::get_location(true /* allow macro */, &filename,
+				 &a.lineno))
+    a.lineno = 0;
+  a.space_follows = false;
+  args.push_back(a);
+}
+
+void arg_list::end_arg(bool space_follows)
+{
+  arg &a = args.back();
+  a.length = text.get_length() - a.start;
+  a.space_follows = space_follows;
+  if (a.length > 0) {
+    const unsigned char *p = text.p->cl.buf + a.start;
+    const unsigned char *e = p + a.length;
+    while ((p = static_cast<const unsigned char *>(memchr(p, '\0',
+							  e - p)))
+	   != 0 /* nullptr */) {
+      nnodes++;
+      p++;
+    }
   }
 }
 
-arg_list::~arg_list()
+// Return an iterator over argument `i` (counting from zero).
+
+input_iterator *arg_list::get_arg(int i)
+{
+  const arg &a = args[i];
+  return new string_iterator(text, a.start, a.length, a.node_index,
+			     a.lineno);
+}
+
+inline void release_arg_list(arg_list *al)
 {
+  if (al != 0 /* nullptr */ && --(al->count) <= 0)
+    delete al;
 }
 
 class macro_iterator : public string_iterator {
   arg_list *args;
+  int first_arg;		// index in `args` of `\$1`
   int argc;
   bool with_break;		// whether called as .foo or 'foo
+  int profile_frame;		// -1 if not profiled
 public:
   macro_iterator(symbol, macro &,
 		 const char * /* how_called */ = "macro",
@@ -4620,12 +5012,13 @@ public:
   ~macro_iterator();
   bool has_args() { return true; }
   input_iterator *get_arg(int);
-  arg_list *get_arg_list();
+  arg_list *get_arg_list(int *);
   symbol get_macro_name();
   bool space_follows_arg(int);
   bool get_break_flag() { return with_break; }
   int nargs() { return argc; }
-  void add_arg(const macro &, int);
+  macro &begin_arg();
+  void end_arg(bool);
   void shift(int);
   bool is_macro() { return true; }
   bool is_diversion();
@@ -4635,20 +5028,15 @@ input_iterator *macro_iterator::get_arg(int i)
 {
   if (i == 0)
     return make_temp_iterator(nm.contents());
-  if (i > 0 && i <= argc) {
-    arg_list *p = args;
-    for (int j = 1; j < i; j++) {
-      assert(p != 0);
-      p = p->next;
-    }
-    return new string_iterator(p->mac);
-  }
+  if (i > 0 && i <= argc)
+    return args->get_arg(first_arg + i - 1);
   else
     return 0 /* nullptr */;
 }
 
-arg_list *macro_iterator::get_arg_list()
+arg_list *macro_iterator::get_arg_list(int *firstp)
 {
+  *firstp = first_arg;
   return args;
 }
 
@@ -4659,38 +5047,165 @@ symbol macro_iterator::get_macro_name()
 
 bool macro_iterator::space_follows_arg(int i)
 {
-  if ((i > 0) && (i <= argc)) {
-    arg_list *p = args;
-    for (int j = 1; j < i; j++) {
-      assert(p != 0 /* nullptr */);
-      p = p->next;
-    }
-    return p->space_follows;
-  }
+  if ((i > 0) && (i <= argc))
+    return args->space_follows_arg(first_arg + i - 1);
   else
     return false;
 }
 
-void macro_iterator::add_arg(const macro &m, int s)
+// Start collecting the next argument; append its text to the macro
+// returned.
+
+macro &macro_iterator::begin_arg()
+{
+  if (0 /* nullptr */ == args)
+    args = new arg_list;
+  assert(args->count == 1);
+  args->begin_arg();
+  return args->text;
+}
+
+void macro_iterator::end_arg(bool space_follows)
 {
-  arg_list **p;
-  for (p = &args; *p != 0 /* nullptr */; p = &((*p)->next))
-    ;
-  *p = new arg_list(m, s);
+  args->end_arg(space_follows);
   ++argc;
 }
 
 void macro_iterator::shift(int n)
 {
-  while (n > 0 && argc > 0) {
-    arg_list *tem = args;
-    args = args->next;
-    delete tem;
-    --argc;
-    --n;
+  if (n > argc)
+    n = argc;
+  if (n > 0) {
+    first_arg += n;
+    argc -= n;
+  }
+}
+
+// An iterator over arguments `first` to `last` - 1 of an argument
+// list, joined as `\$*`, `\$@`, or `\$^` interpolate them.  Runs of
+// argument text are read in place; only the quotes and spaces between
+// them are synthesized.  A node ends the interpolation.
+
+class joined_args_iterator : public input_iterator {
+  arg_list *args;
+  int i;			// current argument
+  int last;
+  char how;			// '*', '@', or '^'
+  enum { PREFIX, BODY, SUFFIX } phase;
+  int pos;			// offset of next character in body
+  int end;
+  bool is_done;
+  unsigned char pending[4];	// synthesized characters
+  int load_chunk();
+public:
+  joined_args_iterator(arg_list *, int /* first */, int /* last */,
+		       char /* how */);
+  ~joined_args_iterator();
+  int fill(node **);
+  int peek();
+};
+
+joined_args_iterator::joined_args_iterator(arg_list *al, int first,
+					   int l, char h)
+: args(al), i(first), last(l), how(h), phase(PREFIX), pos(0), end(0),
+  is_done(false)
+{
+  args->count++;
+}
+
+joined_args_iterator::~joined_args_iterator()
+{
+  release_arg_list(args);
+}
+
+// Point `ptr` and `endptr` at the next run of characters and return
+// the first of them without consuming it, or return `EOF`.
+
+int joined_args_iterator::load_chunk()
+{
+  for (;;) {
+    if (is_done || i >= last)
+      return EOF;
+    int n = 0;
+    switch (phase) {
+    case PREFIX:
+      if ('@' == how) {
+	pending[n++] = '"';
+	pending[n++] = BEGIN_QUOTE;
+      }
+      pos = args->arg_start(i);
+      end = pos + args->arg_length(i);
+      phase = BODY;
+      break;
+    case BODY:
+      {
+	if (pos >= end) {
+	  phase = SUFFIX;
+	  continue;
+	}
+	const unsigned char *buf = args->text.p->cl.buf;
+	unsigned char c = buf[pos];
+	if (0U == c) {
+	  is_done = true;
+	  return EOF;
+	}
+	if (DOUBLE_QUOTE == c) {
+	  pos++;
+	  if ('^' == how)
+	    pending[n++] = '"';
+	  break;
+	}
+	int run_end = pos + 1;
+	while (run_end < end && buf[run_end] != 0U
+	       && buf[run_end] != DOUBLE_QUOTE)
+	  run_end++;
+	ptr = buf + pos;
+	endptr = buf + run_end;
+	pos = run_end;
+	return *ptr;
+      }
+    case SUFFIX:
+      if ('@' == how) {
+	pending[n++] = END_QUOTE;
+	pending[n++] = '"';
+      }
+      if ('^' == how ? args->space_follows_arg(i) : (i + 1 < last))
+	pending[n++] = ' ';
+      i++;
+      phase = PREFIX;
+      break;
+    }
+    if (n > 0) {
+      ptr = pending;
+      endptr = pending + n;
+      return *ptr;
+    }
   }
 }
 
+int joined_args_iterator::fill(node **)
+{
+  int c = load_chunk();
+  if (c != EOF)
+    ptr++;
+  return c;
+}
+
+int joined_args_iterator::peek()
+{
+  return load_chunk();
+}
+
+static input_iterator *make_joined_args_iterator(char how)
+{
+  int first;
+  arg_list *al = input_stack::get_arg_list(&first);
+  int n = input_stack::nargs();
+  if (0 /* nullptr */ == al || n <= 0)
+    return 0 /* nullptr */;
+  return new joined_args_iterator(al, first, first + n, how);
+}
+
 // This gets used by, e.g., .if '\?xxx\?''.
 
 bool operator==(const macro &m1, const macro &m2)
@@ -4806,7 +5321,7 @@ static void decode_macro_call_arguments(macro_iterator *mi)
 	c = read_character_in_copy_mode(&n);
       if (('\n' == c) || (EOF == c))
 	break;
-      macro arg;
+      macro &arg = mi->begin_arg();
       int quote_input_level = 0;
       bool was_warned = false; // about an input tab character
       arg.append(want_att_compat ? PUSH_COMP_MODE : PUSH_GROFF_MODE);
@@ -4848,7 +5363,7 @@ static void decode_macro_call_arguments(macro_iterator *mi)
 	}
       }
       arg.append(POP_GROFFCOMP_MODE);
-      mi->add_arg(arg, (' ' == c));
+      mi->end_arg(' ' == c);
     }
   }
 }
@@ -4866,7 +5381,7 @@ static void decode_escape_sequence_arguments(macro_iterator *mi)
     }
     if (']' == c)
       break;
-    macro arg;
+    macro &arg = mi->begin_arg();
     int quote_input_level = 0;
     bool was_warned = false; // about an input tab character
     if ('"' == c) {
@@ -4900,7 +5415,7 @@ static void decode_escape_sequence_arguments(macro_iterator *mi)
 	c = read_character_in_copy_mode(&n);
       }
     }
-    mi->add_arg(arg, (' ' == c));
+    mi->end_arg(' ' == c);
   }
 }
 
@@ -4928,31 +5443,36 @@ bool macro::is_empty()
 macro_iterator::macro_iterator(symbol s, macro &m,
 			       const char *how_called,
 			       bool want_arguments_initialized)
-: string_iterator(m, how_called, s), args(0 /* nullptr */), argc(0),
-  with_break(was_invoked_with_regular_control_character)
-{
+: string_iterator(m, how_called, s), args(0 /* nullptr */),
+  first_arg(0), argc(0),
+  with_break(was_invoked_with_regular_control_character),
+  profile_frame(-1)
+{
+  // A macro interpolated as a string keeps its caller's name.
+  if (is_profiling && strcmp(how_called, "string") != 0)
+    profile_frame = begin_profile_frame(s, false /* is_request */);
   if (want_arguments_initialized) {
-    arg_list *al = input_stack::get_arg_list();
+    arg_list *al = input_stack::get_arg_list(&first_arg);
     if (al != 0 /* nullptr */) {
-      args = new arg_list(al);
+      args = al;
+      args->count++;
       argc = input_stack::nargs();
     }
   }
 }
 
 macro_iterator::macro_iterator()
-: args(0 /* nullptr */), argc(0),
-  with_break(was_invoked_with_regular_control_character)
+: args(0 /* nullptr */), first_arg(0), argc(0),
+  with_break(was_invoked_with_regular_control_character),
+  profile_frame(-1)
 {
 }
 
 macro_iterator::~macro_iterator()
 {
-  while (args != 0 /* nullptr */) {
-    arg_list *tem = args;
-    args = args->next;
-    delete tem;
-  }
+  if (profile_frame >= 0)
+    end_profile_frame(profile_frame);
+  release_arg_list(args);
 }
 
 dictionary composite_dictionary(17);
@@ -5460,66 +5980,9 @@ static void interpolate_positional_parameter(symbol nm)
     copy_mode_error("missing positional argument number in copy mode");
   else if (s[1] == 0 && csdigit(s[0]))
     input_stack::push(input_stack::get_arg(s[0] - '0'));
-  else if (s[0] == '*' && s[1] == '\0') {
-    int limit = input_stack::nargs();
-    string args;
-    for (int i = 1; i <= limit; i++) {
-      input_iterator *p = input_stack::get_arg(i);
-      int c;
-      while ((c = p->get(0 /* nullptr */)) != EOF)
-	if (c != DOUBLE_QUOTE)
-	  args += c;
-      if (i != limit)
-	args += ' ';
-      delete p;
-    }
-    if (limit > 0) {
-      args += '\0';
-      input_stack::push(make_temp_iterator(args.contents()));
-    }
-  }
-  else if (s[0] == '@' && s[1] == '\0') {
-    int limit = input_stack::nargs();
-    string args;
-    for (int i = 1; i <= limit; i++) {
-      args += '"';
-      args += char(BEGIN_QUOTE);
-      input_iterator *p = input_stack::get_arg(i);
-      int c;
-      while ((c = p->get(0 /* nullptr */)) != EOF)
-	if (c != DOUBLE_QUOTE)
-	  args += c;
-      args += char(END_QUOTE);
-      args += '"';
-      if (i != limit)
-	args += ' ';
-      delete p;
-    }
-    if (limit > 0) {
-      args += '\0';
-      input_stack::push(make_temp_iterator(args.contents()));
-    }
-  }
-  else if (s[0] == '^' && s[1] == '\0') {
-    int limit = input_stack::nargs();
-    string args;
-    int c = input_stack::peek();
-    for (int i = 1; i <= limit; i++) {
-      input_iterator *p = input_stack::get_arg(i);
-      while ((c = p->get(0 /* nullptr */)) != EOF) {
-	if (DOUBLE_QUOTE == c)
-	  c = '"';
-	args += c;
-      }
-      if (input_stack::space_follows_arg(i))
-	args += ' ';
-      delete p;
-    }
-    if (limit > 0) {
-      args += '\0';
-      input_stack::push(make_temp_iterator(args.contents()));
-    }
-  }
+  else if ((s[0] == '*' || s[0] == '@' || s[0] == '^')
+	   && s[1] == '\0')
+    input_stack::push(make_joined_args_iterator(s[0]));
   else {
     const char *p;
     bool is_valid = true;
@@ -6150,6 +6613,9 @@ static void unformat_macro() // .unformat
 
 static void interpolate_environment_variable(symbol nm)
 {
+  if (is_recording_for_snapshot)
+    (void) recorded_variable_dictionary.lookup(nm,
+					       (void *) nm.contents());
   const char *s = getenv(nm.contents());
   if ((s != 0 /* nullptr */) && (*s != '\0'))
     input_stack::push(make_temp_iterator(s));
@@ -6159,6 +6625,8 @@ void interpolate_register(symbol nm, int inc)
 {
   reg *r = look_up_register(nm);
   assert(r != 0 /* nullptr */);
+  if (is_recording_for_snapshot && is_time_of_day_register(r))
+    was_time_of_day_interpolated = true;
   if (inc < 0)
     r->decrement();
   else if (inc > 0)
@@ -10042,6 +10510,841 @@ static void add_string(const char *s, string_list **p)
   *p = new string_list(s);
 }
 
+// Snapshots of start-up state
+//
+// With `--snapshot=FILE`, troff saves the state reached after reading
+// its start-up files (troffrc, macro packages given with `-m`, and
+// troffrc-end) in FILE, and on later runs with the same options
+// restores that state instead of reading them again.  A snapshot is
+// valid only for the same troff executable, command-line options,
+// device, day, working directory (if relative file names were
+// involved), environment variables consulted, and files tried while
+// starting up; if any of these differ, troff reads its start-up files
+// as usual and writes a new snapshot.
+//
+// Much state, such as open streams and pending output, cannot be
+// saved.  We therefore write a snapshot only if the start-up files
+// used no request outside the list below, produced no diagnostics,
+// and didn't consult the time of day or process ID; otherwise we say
+// why not and carry on.
+
+static bool write_charinfo_snapshot(snapshot_writer &);
+static void read_charinfo_snapshot(snapshot_reader &);
+
+static const char *snapshot_file_name = 0 /* nullptr */;
+static bool is_snapshot_declined = false;
+static snapshot_reader *snapshot_image = 0 /* nullptr */;
+static std::vector<const char *> snapshot_key;
+static dictionary snapshot_dependency_dictionary(101);
+static char dependency_found[] = "found";
+static char dependency_missing[] = "missing";
+
+static const char snapshot_magic[] = "GNU troff snapshot";
+static const int snapshot_version = 2;
+static const int snapshot_end_marker = 0x656e64; // "end"
+
+// Keep sorted; we search it with bsearch().
+static const char *const snapshot_safe_requests[] = {
+  "ad", "af", "aln", "als", "am", "am1", "ami", "ami1", "as", "as1",
+  "bd", "blm", "br", "c2", "cc", "cflags", "ch", "char", "chop",
+  "class", "color", "composite", "cp", "cs", "de", "de1", "defcolor",
+  "dei", "dei1", "di", "do", "ds", "ds1", "ec", "ecr", "ecs", "el",
+  "em", "eo", "ev", "evc", "fam", "fchar", "fi", "fp", "fschar",
+  "fspecial", "ft", "ftr", "hc", "hcode", "hla", "hlm", "hpf", "hpfa",
+  "hpfcode", "hw", "hy", "hydefault", "hym", "hys", "ie", "if", "ig",
+  "in", "kern", "lc", "length", "lf", "lg", "ll", "lsm", "lt", "mk",
+  "mso", "msoquiet", "na", "nf", "nh", "nop", "nr", "nroff", "ns",
+  "pl", "pn", "po", "ps", "rchar", "return", "rfschar", "rm", "rn",
+  "rr", "rs", "schar", "shc", "shift", "so", "special", "ss", "sty",
+  "substring", "ta", "tc", "ti", "tkf", "tr", "trin", "uf", "vs",
+  "warn", "warnscale", "wh", "while"
+};
+
+static int compare_request_names(const void *p1, const void *p2)
+{
+  return strcmp(*static_cast<const char *const *>(p1),
+		*static_cast<const char *const *>(p2));
+}
+
+// Registers that init_registers() sets from the time of day and the
+// process ID come first, then those it sets from the date.  A snapshot
+// records which of them still hold those values, so that they can be
+// set afresh after it is restored.
+static const char *const time_register_names[] = {
+  "seconds", "minutes", "hours", "$$",
+  "dw", "dy", "mo", "year", "yr"
+};
+static const int time_of_day_register_count = 4;
+static int time_register_values[countof(time_register_names)];
+
+void decline_snapshot(const char *reason, const errarg &arg)
+{
+  if (is_snapshot_declined)
+    return;
+  is_snapshot_declined = true;
+  string format("not writing snapshot file '%2': ");
+  format += reason;
+  format += '\0';
+  warning(WARN_FILE, format.contents(), arg, snapshot_file_name);
+}
+
+// This is a search path open handler; it must not disturb `errno`.
+static void note_snapshot_dependency(const char *path, bool was_found)
+{
+  int err = errno;
+  symbol s(path);
+  if (was_found
+      || (0 /* nullptr */ == snapshot_dependency_dictionary.lookup(s)))
+    (void) snapshot_dependency_dictionary.lookup(s, was_found
+						 ? dependency_found
+						 : dependency_missing);
+  errno = err;
+}
+
+// The key is the command line up to its operands, less the snapshot
+// option itself, followed by the device, environment variables that
+// affect how start-up files are found or interpreted, and the date.
+static void make_snapshot_key(char **argv, int nargs)
+{
+  for (int i = 1; i < nargs; i++) {
+    // No other long option begins with "--s"; getopt_long() accepts
+    // unambiguous abbreviations.
+    if (strncmp(argv[i], "--s", 3) == 0) {
+      if (0 /* nullptr */ == strchr(argv[i], '='))
+	i++;
+      continue;
+    }
+    snapshot_key.push_back(argv[i]);
+  }
+  snapshot_key.push_back(device);
+  static const char *const variables[] = {
+    "GROFF_TMAC_PATH", "GROFF_FONT_PATH", "HOME", "SOURCE_DATE_EPOCH"
+  };
+  for (size_t i = 0; i < countof(variables); i++) {
+    snapshot_key.push_back(variables[i]);
+    snapshot_key.push_back(getenv(variables[i]));
+  }
+  struct tm *t = current_time();
+  static char date[64];
+  (void) snprintf(date, sizeof date, "%d-%02d-%02d", 1900 + t->tm_year,
+		  t->tm_mon + 1, t->tm_mday);
+  snapshot_key.push_back(date);
+}
+
+static bool are_equal_strings(const char *s1, const char *s2)
+{
+  if ((0 /* nullptr */ == s1) || (0 /* nullptr */ == s2))
+    return (s1 == s2);
+  return (strcmp(s1, s2) == 0);
+}
+
+static char *get_working_directory()
+{
+  for (size_t n = 256; n <= 65536; n *= 2) {
+    char *buf = new char[n];
+    if (getcwd(buf, n) != 0 /* nullptr */)
+      return buf;
+    delete[] buf;
+    if (errno != ERANGE)
+      break;
+  }
+  return 0 /* nullptr */;
+}
+
+static void write_file_status(snapshot_writer &w, const char *path)
+{
+  struct stat sb;
+  bool exists = (stat(path, &sb) == 0);
+  w.put_int(exists);
+  if (exists) {
+    w.put_bytes(&sb.st_mtime, sizeof sb.st_mtime);
+    w.put_bytes(&sb.st_size, sizeof sb.st_size);
+  }
+}
+
+static bool is_file_status_current(snapshot_reader &r, const char *path)
+{
+  struct stat sb;
+  bool exists = (stat(path, &sb) == 0);
+  if (bool(r.get_int()) != exists)
+    return false;
+  if (!exists)
+    return true;
+  const void *mtime = r.get_bytes(sizeof sb.st_mtime);
+  const void *size = r.get_bytes(sizeof sb.st_size);
+  return (r.is_valid()
+	  && memcmp(mtime, &sb.st_mtime, sizeof sb.st_mtime) == 0
+	  && memcmp(size, &sb.st_size, sizeof sb.st_size) == 0);
+}
+
+static void write_snapshot_header(snapshot_writer &w)
+{
+  w.put_string(snapshot_magic);
+  w.put_int(snapshot_version);
+  w.put_string(Version_string);
+  w.put_int(int(sizeof(void *)));
+  w.put_int(int(sizeof(long)));
+  w.put_int(0x01020304);
+  w.put_int(int(snapshot_key.size()));
+  for (size_t i = 0; i < snapshot_key.size(); i++)
+    w.put_string(snapshot_key[i]);
+  std::vector<const char *> paths;
+  bool has_relative_path = false;
+  dictionary_iterator iter(snapshot_dependency_dictionary);
+  symbol s;
+  void *v;
+  while (iter.get(&s, &v)) {
+    paths.push_back(s.contents());
+    if (!IS_ABSOLUTE(s.contents()))
+      has_relative_path = true;
+  }
+  char *cwd = has_relative_path ? get_working_directory()
+				: 0 /* nullptr */;
+  w.put_string(cwd);
+  delete[] cwd;
+  w.put_int(int(paths.size()));
+  for (size_t i = 0; i < paths.size(); i++) {
+    w.put_string(paths[i]);
+    write_file_status(w, paths[i]);
+  }
+  std::vector<const char *> names;
+  dictionary_iterator variable_iter(recorded_variable_dictionary);
+  while (variable_iter.get(&s, &v))
+    names.push_back(s.contents());
+  w.put_int(int(names.size()));
+  for (size_t i = 0; i < names.size(); i++) {
+    w.put_string(names[i]);
+    w.put_string(getenv(names[i]));
+  }
+}
+
+// Return whether the snapshot was made under the same conditions as
+// this run; leave the reader just past the header.
+static bool read_snapshot_header(snapshot_reader &r)
+{
+  if (!are_equal_strings(r.get_string(), snapshot_magic)
+      || r.get_int() != snapshot_version
+      || !are_equal_strings(r.get_string(), Version_string)
+      || r.get_int() != int(sizeof(void *))
+      || r.get_int() != int(sizeof(long))
+      || r.get_int() != 0x01020304)
+    return false;
+  int n = r.get_count(sizeof(int));
+  if (size_t(n) != snapshot_key.size())
+    return false;
+  for (int i = 0; i < n; i++)
+    if (!are_equal_strings(r.get_string(), snapshot_key[i]))
+      return false;
+  const char *cwd = r.get_string();
+  if (cwd != 0 /* nullptr */) {
+    char *here = get_working_directory();
+    bool is_same = are_equal_strings(cwd, here);
+    delete[] here;
+    if (!is_same)
+      return false;
+  }
+  n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    const char *path = r.get_string();
+    if (0 /* nullptr */ == path || !is_file_status_current(r, path))
+      return false;
+  }
+  n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    const char *name = r.get_string();
+    const char *value = r.get_string();
+    if (0 /* nullptr */ == name
+	|| !are_equal_strings(getenv(name), value))
+      return false;
+  }
+  return r.is_valid();
+}
+
+// Map the snapshot file if we can; it stays mapped, since parts of the
+// restored state point into it.
+static bool open_snapshot()
+{
+  int fd = open(snapshot_file_name, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    return false;
+  struct stat sb;
+  if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode)) {
+    close(fd);
+    return false;
+  }
+  size_t len = size_t(sb.st_size);
+  void *addr = 0 /* nullptr */;
+#ifdef HAVE_MMAP
+  addr = mmap(0 /* nullptr */, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == addr)
+    addr = 0 /* nullptr */;
+#endif
+  char *buffer = 0 /* nullptr */;
+  const char *image = static_cast<const char *>(addr);
+  if (0 /* nullptr */ == image) {
+    buffer = new char[len + 1];
+    if (read(fd, buffer, len) != ssize_t(len)) {
+      delete[] buffer;
+      close(fd);
+      return false;
+    }
+    image = buffer;
+  }
+  close(fd);
+  snapshot_image = new snapshot_reader(image, len);
+  if (read_snapshot_header(*snapshot_image))
+    return true;
+  delete snapshot_image;
+  snapshot_image = 0 /* nullptr */;
+  delete[] buffer;
+#ifdef HAVE_MMAP
+  if (addr != 0 /* nullptr */)
+    (void) munmap(addr, len);
+#endif
+  return false;
+}
+
+static void start_snapshot_recording()
+{
+  (void) search_path::set_open_handler(note_snapshot_dependency);
+  is_recording_for_snapshot = true;
+}
+
+static symbol read_symbol_image(snapshot_reader &r)
+{
+  const char *s = r.get_string();
+  return (0 /* nullptr */ == s) ? NULL_SYMBOL : symbol(s);
+}
+
+// The input section holds the state that this file keeps: escape
+// characters, modes, warning settings, special macro names, colors,
+// composite glyph mappings, character classes, the conditional
+// stack, requests and macros, and which time registers to reset.
+
+static bool write_input_snapshot(snapshot_writer &w)
+{
+  if (have_formattable_input || are_traps_postponed) {
+    decline_snapshot("start-up files left input pending");
+    return false;
+  }
+  w.put_int(escape_char);
+  w.put_int(saved_escape_char);
+  w.put_int(want_att_compat);
+  w.put_int(in_nroff_mode);
+  w.put_int(want_color_output);
+  w.put_int(int(desired_warnings));
+  w.put_double(warn_scale);
+  w.put_int(warn_scaling_unit);
+  w.put_string(end_of_input_macro_name.contents());
+  w.put_string(blank_line_macro_name.contents());
+  w.put_string(leading_spaces_macro_name.contents());
+  std::vector<std::pair<symbol, void *> > entries;
+  dictionary_iterator color_iter(color_dictionary);
+  symbol s;
+  void *v;
+  while (color_iter.get(&s, &v))
+    entries.push_back(std::make_pair(s, v));
+  w.put_int(int(entries.size()));
+  for (size_t i = 0; i < entries.size(); i++) {
+    w.put_string(entries[i].first.contents());
+    write_color_image(w, static_cast<color *>(entries[i].second));
+  }
+  entries.clear();
+  dictionary_iterator composite_iter(composite_dictionary);
+  while (composite_iter.get(&s, &v))
+    entries.push_back(std::make_pair(s, v));
+  w.put_int(int(entries.size()));
+  for (size_t i = 0; i < entries.size(); i++) {
+    w.put_string(entries[i].first.contents());
+    w.put_string(static_cast<const char *>(entries[i].second));
+  }
+  entries.clear();
+  dictionary_iterator class_iter(char_class_dictionary);
+  while (class_iter.get(&s, &v))
+    entries.push_back(std::make_pair(s, v));
+  w.put_int(int(entries.size()));
+  for (size_t i = 0; i < entries.size(); i++) {
+    w.put_string(entries[i].first.contents());
+    w.put_int(charinfo_glyph_index(static_cast<charinfo *>
+				   (entries[i].second)));
+  }
+  w.put_int(using_character_classes);
+  std::stack<bool> conditions(if_else_stack);
+  std::vector<bool> predicates;
+  for (; !conditions.empty(); conditions.pop())
+    predicates.push_back(conditions.top());
+  w.put_int(int(predicates.size()));
+  for (size_t i = predicates.size(); i > 0; i--)
+    w.put_int(predicates[i - 1]);
+  // Requests and macros may have several names; list the distinct
+  // objects, then the names bound to them.  A request is identified by
+  // the name it was created with.
+  std::map<request_or_macro *, int> ids;
+  std::vector<std::pair<symbol, request_or_macro *> > objects;
+  std::vector<std::pair<symbol, int> > names;
+  object_dictionary_iterator request_iter(request_dictionary);
+  request_or_macro *rm;
+  while (request_iter.get(&s, reinterpret_cast<object **>(&rm))) {
+    std::map<request_or_macro *, int>::iterator it = ids.find(rm);
+    if (it == ids.end()) {
+      it = ids.insert(std::make_pair(rm, int(objects.size()))).first;
+      objects.push_back(std::make_pair(s, rm));
+    }
+    names.push_back(std::make_pair(s, it->second));
+  }
+  w.put_int(int(objects.size()));
+  for (size_t i = 0; i < objects.size(); i++) {
+    macro *m = objects[i].second->to_macro();
+    w.put_int(m != 0 /* nullptr */);
+    if (0 /* nullptr */ == m)
+      w.put_string(static_cast<request *>(objects[i].second)
+		   ->nm.contents());
+    else if (!m->write_image(w)) {
+      decline_snapshot("macro '%1' contains nodes",
+		       objects[i].first.contents());
+      return false;
+    }
+  }
+  w.put_int(int(names.size()));
+  for (size_t i = 0; i < names.size(); i++) {
+    w.put_string(names[i].first.contents());
+    w.put_int(names[i].second);
+  }
+  for (size_t i = 0; i < countof(time_register_names); i++) {
+    reg *r = static_cast<reg *>(register_dictionary
+				.lookup(time_register_names[i]));
+    units u;
+    w.put_int(r != 0 /* nullptr */ && r->get_value(&u)
+	      && u == time_register_values[i]);
+  }
+  return true;
+}
+
+static void read_input_snapshot(snapshot_reader &r,
+				bool *want_time_register_reset)
+{
+  escape_char = (unsigned char) r.get_int();
+  saved_escape_char = (unsigned char) r.get_int();
+  want_att_compat = r.get_int();
+  in_nroff_mode = r.get_int();
+  want_color_output = r.get_int();
+  desired_warnings = (unsigned int) r.get_int();
+  warn_scale = r.get_double();
+  warn_scaling_unit = char(r.get_int());
+  end_of_input_macro_name = read_symbol_image(r);
+  blank_line_macro_name = read_symbol_image(r);
+  leading_spaces_macro_name = read_symbol_image(r);
+  int n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    symbol nm = read_symbol_image(r);
+    color *c = read_color_image(r);
+    if (nm.is_null() || 0 /* nullptr */ == c)
+      r.invalidate();
+    else
+      (void) color_dictionary.lookup(nm, c);
+  }
+  n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    symbol from = read_symbol_image(r);
+    // The mapping can point into the image, which stays in memory.
+    const char *to = r.get_string();
+    if (from.is_null() || 0 /* nullptr */ == to)
+      r.invalidate();
+    else
+      (void) composite_dictionary.lookup(from,
+					 const_cast<char *>(to));
+  }
+  n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    symbol nm = read_symbol_image(r);
+    charinfo *ci = charinfo_for_glyph_index(r.get_int());
+    if (nm.is_null() || 0 /* nullptr */ == ci)
+      r.invalidate();
+    else
+      (void) char_class_dictionary.lookup(nm, ci);
+  }
+  using_character_classes = r.get_int();
+  while (!if_else_stack.empty())
+    if_else_stack.pop();
+  n = r.get_count(sizeof(int));
+  for (int i = 0; i < n; i++)
+    if_else_stack.push(r.get_int());
+  std::map<const char *, request_or_macro *> requests_by_name;
+  object_dictionary_iterator request_iter(request_dictionary);
+  symbol s;
+  request_or_macro *rm;
+  std::vector<symbol> defined_names;
+  while (request_iter.get(&s, reinterpret_cast<object **>(&rm))) {
+    if (0 /* nullptr */ == rm->to_macro())
+      requests_by_name[static_cast<request *>(rm)->nm.contents()] = rm;
+    defined_names.push_back(s);
+  }
+  n = r.get_count(sizeof(int));
+  std::vector<request_or_macro *> objects;
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    if (r.get_int()) {
+      macro *m = new macro;
+      m->read_image(r);
+      rm = m;
+    }
+    else {
+      const char *nm = r.get_string();
+      std::map<const char *, request_or_macro *>::iterator it
+	= requests_by_name.end();
+      if (nm != 0 /* nullptr */)
+	it = requests_by_name.find(symbol(nm).contents());
+      if (it == requests_by_name.end()) {
+	r.invalidate();
+	break;
+      }
+      rm = it->second;
+    }
+    rm->add_reference();
+    objects.push_back(rm);
+  }
+  for (size_t i = 0; i < defined_names.size(); i++)
+    request_dictionary.remove(defined_names[i]);
+  n = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    symbol nm = read_symbol_image(r);
+    int id = r.get_int();
+    if (nm.is_null() || id < 0 || size_t(id) >= objects.size())
+      r.invalidate();
+    else
+      request_dictionary.define(nm, objects[id]);
+  }
+  for (size_t i = 0; i < objects.size(); i++)
+    objects[i]->remove_reference();
+  for (size_t i = 0; i < countof(time_register_names); i++)
+    want_time_register_reset[i] = r.get_int();
+}
+
+static bool check_snapshot_conditions()
+{
+  if (diagnostic_count > 0) {
+    decline_snapshot("start-up files produced diagnostic messages");
+    return false;
+  }
+  if (was_time_of_day_interpolated) {
+    decline_snapshot("start-up files used the time of day or process"
+		     " ID");
+    return false;
+  }
+  dictionary_iterator iter(recorded_request_dictionary);
+  symbol s;
+  void *v;
+  while (iter.get(&s, &v)) {
+    const char *nm = s.contents();
+    if (0 /* nullptr */ == bsearch(&nm, snapshot_safe_requests,
+				   countof(snapshot_safe_requests),
+				   sizeof snapshot_safe_requests[0],
+				   compare_request_names)) {
+      decline_snapshot("start-up files used request '%1'", nm);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Write to a temporary file and rename it, so that a concurrent run
+// never sees a partial snapshot.
+static void write_snapshot_file(const snapshot_writer &w)
+{
+  string path(snapshot_file_name);
+  path += ".tmp";
+  path += i_to_a(getpid());
+  path += '\0';
+  errno = 0;
+  FILE *fp = fopen(path.contents(), FOPEN_WB);
+  if (0 /* nullptr */ == fp) {
+    error("cannot open snapshot file '%1' for writing: %2",
+	  path.contents(), strerror(errno));
+    return;
+  }
+  bool is_ok = (fwrite(w.contents(), 1, w.length(), fp) == w.length());
+  if (fclose(fp) != 0)
+    is_ok = false;
+  if (is_ok && rename(path.contents(), snapshot_file_name) != 0)
+    is_ok = false;
+  if (!is_ok) {
+    error("cannot write snapshot file '%1': %2", snapshot_file_name,
+	  strerror(errno));
+    (void) unlink(path.contents());
+  }
+}
+
+static void write_snapshot()
+{
+  is_recording_for_snapshot = false;
+  (void) search_path::set_open_handler(0 /* nullptr */);
+  if (!check_snapshot_conditions())
+    return;
+  snapshot_writer w;
+  write_snapshot_header(w);
+  if (!write_charinfo_snapshot(w)
+      || !write_font_snapshot(w)
+      || !write_input_snapshot(w)
+      || !write_register_snapshot(w)
+      || !write_environment_snapshot(w)
+      || !write_diversion_snapshot(w))
+    return;
+  w.put_int(snapshot_end_marker);
+  write_snapshot_file(w);
+}
+
+// Restore what the snapshot holds beyond characters and fonts, which
+// main() reads earlier, at the points where it would create them.
+static void restore_snapshot()
+{
+  snapshot_reader &r = *snapshot_image;
+  bool want_time_register_reset[countof(time_register_names)];
+  read_input_snapshot(r, want_time_register_reset);
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+  read_register_snapshot(r);
+  read_environment_snapshot(r);
+  read_diversion_snapshot(r);
+  if (r.get_int() != snapshot_end_marker || !r.is_valid())
+    fatal("snapshot file is corrupt");
+  for (size_t i = 0; i < countof(time_register_names); i++)
+    if (want_time_register_reset[i])
+      set_register(time_register_names[i], time_register_values[i]);
+}
+
+// Batch mode
+//
+// With `--batch=FILE`, troff reads start-up files once and then formats
+// each document listed in FILE (or the standard input, if FILE is "-")
+// in a child process forked from the initialized formatter, so that
+// every document starts from the same state without paying for
+// start-up again.  Each line of the list names an input file and,
+// after a tab, the file to which its output goes.  When a document is
+// done, troff writes its exit status and output file name, separated
+// by a tab, on a line to the standard output, so that a program
+// feeding the list through a pipe can tell when each output file is
+// complete.
+//
+// Start-up files can produce output, such as the beginning of a page.
+// While they are read, the standard output goes to an unlinked
+// temporary file; each child copies it to the start of its own output.
+// Output still buffered when a child is forked reaches its output
+// file when the child exits.
+
+static const char *batch_list_file_name = 0 /* nullptr */;
+static int batch_status_fd = -1;	// the original standard output
+static int batch_startup_output_fd = -1;
+static int batch_document_number = 0;	// in a child, from 1
+static string batch_page_index_file_name;
+
+// In batch mode, each document's page index and profile go to files
+// of its own, named by appending a dot and the document's number in
+// the list.
+
+static string document_file_name(const char *name)
+{
+  string s(name);
+  if (batch_document_number > 0) {
+    s += '.';
+    s += i_to_a(batch_document_number);
+  }
+  s += '\0';
+  return s;
+}
+
+// The list is read with read(2) rather than through a stdio stream,
+// whose buffer a child would inherit; the child's exit() would then
+// reposition the file offset that it shares with the parent.
+class batch_list_reader {
+  int fd;
+  char buf[BUFSIZ];
+  size_t pos;
+  size_t len;
+public:
+  batch_list_reader(int f) : fd(f), pos(0), len(0) {}
+  bool get_line(string *);
+};
+
+bool batch_list_reader::get_line(string *line)
+{
+  line->clear();
+  for (;;) {
+    if (pos == len) {
+      ssize_t n;
+      do
+	n = read(fd, buf, sizeof buf);
+      while (n < 0 && EINTR == errno);
+      if (n < 0)
+	fatal("cannot read batch list: %1", strerror(errno));
+      if (0 == n)
+	return !line->empty();
+      pos = 0;
+      len = size_t(n);
+    }
+    char c = buf[pos++];
+    if ('\n' == c)
+      return true;
+    *line += c;
+  }
+}
+
+static bool write_fully(int fd, const char *p, size_t n)
+{
+  while (n > 0) {
+    ssize_t written = write(fd, p, n);
+    if (written < 0) {
+      if (EINTR == errno)
+	continue;
+      return false;
+    }
+    p += written;
+    n -= size_t(written);
+  }
+  return true;
+}
+
+static void begin_batch()
+{
+#ifdef _POSIX_VERSION
+  char *templ = xtmptemplate("-batch", "b");
+  errno = 0;
+  int fd = mkstemp(templ);
+  if (fd < 0)
+    fatal("cannot create temporary file: %1", strerror(errno));
+  (void) unlink(templ);
+  delete[] templ;
+  batch_status_fd = dup(STDOUT_FILENO);
+  if (batch_status_fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+    fatal("cannot redirect standard output: %1", strerror(errno));
+  batch_startup_output_fd = fd;
+#else
+  fatal("batch mode is not supported on this system");
+#endif
+}
+
+#ifdef _POSIX_VERSION
+// Called in a child process; the parent writes nothing more to the
+// temporary file.
+static void copy_batch_startup_output(int out_fd, const char *out_name)
+{
+  struct stat sb;
+  if (fstat(batch_startup_output_fd, &sb) < 0)
+    fatal("cannot examine start-up output: %1", strerror(errno));
+  char buf[BUFSIZ];
+  for (off_t off = 0; off < sb.st_size; ) {
+    ssize_t n = pread(batch_startup_output_fd, buf, sizeof buf, off);
+    if (n <= 0)
+      fatal("cannot read start-up output: %1", strerror(errno));
+    if (!write_fully(out_fd, buf, size_t(n)))
+      fatal("cannot write output file '%1': %2", out_name,
+	    strerror(errno));
+    off += n;
+  }
+}
+
+static void format_batch_document(const char *input_name,
+				  const char *output_name)
+{
+  errno = 0;
+  int fd = open(output_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+		0666);
+  if (fd < 0)
+    fatal("cannot open output file '%1': %2", output_name,
+	  strerror(errno));
+  copy_batch_startup_output(fd, output_name);
+  if (dup2(fd, STDOUT_FILENO) < 0)
+    fatal("cannot redirect output to '%1': %2", output_name,
+	  strerror(errno));
+  (void) close(fd);
+  (void) close(batch_status_fd);
+  (void) close(batch_startup_output_fd);
+  process_input_file(input_name);
+  exit_troff();
+}
+#endif /* _POSIX_VERSION */
+
+static void run_batch(const char *list_name)
+{
+#ifdef _POSIX_VERSION
+  int fd = STDIN_FILENO;
+  if (strcmp(list_name, "-") != 0) {
+    errno = 0;
+    fd = open(list_name, O_RDONLY);
+    if (fd < 0)
+      fatal("cannot open batch list file '%1': %2", list_name,
+	    strerror(errno));
+  }
+  batch_list_reader list(fd);
+  string line;
+  int lineno = 0;
+  int ndocuments = 0;
+  int failures = 0;
+  while (list.get_line(&line)) {
+    lineno++;
+    if (line.empty())
+      continue;
+    char *input_name = line.extract();
+    char *output_name = strchr(input_name, '\t');
+    if (0 /* nullptr */ == output_name || '\0' == output_name[1]) {
+      error("batch list file '%1', line %2: expected input file name,"
+	    " tab, and output file name", list_name, lineno);
+      free(input_name);
+      failures++;
+      continue;
+    }
+    *output_name++ = '\0';
+    ndocuments++;
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0)
+      fatal("cannot fork: %1", strerror(errno));
+    if (0 == pid) {
+      batch_document_number = ndocuments;
+      if (page_index_file_name != 0 /* nullptr */) {
+	batch_page_index_file_name
+	  = document_file_name(page_index_file_name);
+	page_index_file_name = batch_page_index_file_name.contents();
+      }
+      format_batch_document(input_name, output_name);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+      if (errno != EINTR)
+	fatal("cannot wait for child process: %1", strerror(errno));
+    int exit_status = WIFEXITED(status) ? WEXITSTATUS(status)
+			: 128 + WTERMSIG(status);
+    if (exit_status != 0)
+      failures++;
+    string report(i_to_a(exit_status));
+    report += '\t';
+    report += output_name;
+    report += '\n';
+    if (!write_fully(batch_status_fd, report.contents(),
+		     report.length()))
+      fatal("cannot write batch status: %1", strerror(errno));
+    free(input_name);
+  }
+  fflush(stderr);
+  // Skip exit(), which would flush output buffered during start-up
+  // into the temporary file to no purpose.
+  _exit(failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+#endif
+}
+
+static const char *profile_report_file_name = 0 /* nullptr */;
+static const char *profile_stacks_file_name = 0 /* nullptr */;
+
+static void write_profile()
+{
+  if (profile_report_file_name != 0 /* nullptr */) {
+    string name = document_file_name(profile_report_file_name);
+    write_profile_report(name.contents());
+  }
+  if (profile_stacks_file_name != 0 /* nullptr */) {
+    string name = document_file_name(profile_stacks_file_name);
+    write_profile_stacks(name.contents());
+  }
+}
+
 static void usage(FILE *stream, const char *prog)
 {
   fprintf(stream,
@@ -10050,7 +11353,9 @@ static void usage(FILE *stream, const char *prog)
 " [-M macro-directory] [-n page-number] [-o page-list]"
 " [-r cnumeric-expression] [-r register=numeric-expression]"
 " [-T output-device] [-w warning-category] [-W warning-category]"
-" [file ...]\n"
+" [--batch=list-file] [--binary-output] [--page-index=file]"
+" [--profile=file] [--profile-stacks=file] [--snapshot=file]"
+" [--write-hyphenation-caches] [file ...]\n"
 "usage: %s {-v | --version}\n"
 "usage: %s --help\n",
 	  prog, prog, prog);
@@ -10095,6 +11400,15 @@ int main(int argc, char **argv)
   static const struct option long_options[] = {
     { "help", no_argument, 0 /* nullptr */, CHAR_MAX + 1 },
     { "version", no_argument, 0 /* nullptr */, 'v' },
+    { "write-hyphenation-caches", no_argument, 0 /* nullptr */,
+      CHAR_MAX + 2 },
+    { "binary-output", no_argument, 0 /* nullptr */, CHAR_MAX + 3 },
+    { "snapshot", required_argument, 0 /* nullptr */, CHAR_MAX + 4 },
+    { "batch", required_argument, 0 /* nullptr */, CHAR_MAX + 5 },
+    { "profile", required_argument, 0 /* nullptr */, CHAR_MAX + 6 },
+    { "profile-stacks", required_argument, 0 /* nullptr */,
+      CHAR_MAX + 7 },
+    { "page-index", required_argument, 0 /* nullptr */, CHAR_MAX + 8 },
     { 0, 0, 0, 0 }
   };
 #if defined(DEBUGGING)
@@ -10222,6 +11536,29 @@ int main(int argc, char **argv)
       usage(stdout, argv[0]);
       exit(EXIT_SUCCESS);
       break;
+    case CHAR_MAX + 2: // --write-hyphenation-caches
+      want_hyphenation_caches_written = true;
+      break;
+    case CHAR_MAX + 3: // --binary-output
+      want_binary_output = true;
+      break;
+    case CHAR_MAX + 4: // --snapshot
+      snapshot_file_name = optarg;
+      break;
+    case CHAR_MAX + 5: // --batch
+      batch_list_file_name = optarg;
+      break;
+    case CHAR_MAX + 6: // --profile
+      profile_report_file_name = optarg;
+      is_profiling = true;
+      break;
+    case CHAR_MAX + 7: // --profile-stacks
+      profile_stacks_file_name = optarg;
+      is_profiling = true;
+      break;
+    case CHAR_MAX + 8: // --page-index
+      page_index_file_name = optarg;
+      break;
     case '?':
       if (optopt != 0)
 	error("unrecognized command-line option '%1'", char(optopt));
@@ -10240,13 +11577,29 @@ int main(int argc, char **argv)
     default:
       assert(0 == "unhandled case of command-line option");
     }
+  if (batch_list_file_name != 0 /* nullptr */ && optind < argc) {
+    error("input file operands cannot be combined with '--batch'");
+    usage(stderr, argv[0]);
+    exit(2);
+  }
+  if (batch_list_file_name != 0 /* nullptr */)
+    begin_batch();
+  if (is_profiling)
+    atexit(write_profile);
   if (want_unsafe_requests)
     mac_path = &macro_path;
   set_string(".T", device);
   // TODO: Kill this off in groff 1.24.0 release + 2 years.  See env.cpp.
   if ((strcmp("pdf", device) == 0) || strcmp("ps", device) == 0)
     is_device_ps_or_pdf = true;
+  if (snapshot_file_name != 0 /* nullptr */) {
+    make_snapshot_key(argv, optind);
+    if (!open_snapshot())
+      start_snapshot_recording();
+  }
   init_charset_table();
+  if (snapshot_image != 0 /* nullptr */)
+    read_charinfo_snapshot(*snapshot_image);
   init_hpf_code_table();
   if (0 /* nullptr */ == font::load_desc())
     fatal("cannot load 'DESC' description file for device '%1'",
@@ -10263,24 +11616,30 @@ int main(int argc, char **argv)
     default_family = symbol(font::family);
   font_size::init_size_list(font::sizes);
   int i;
-  int j = 1;
-  if (font::style_table != 0 /* nullptr */)
-    for (i = 0; font::style_table[i] != 0 /* nullptr */; i++)
-      // Mounting a style can't actually fail due to a bad style name;
-      // that's not determined until the full font name is resolved.
-      // The DESC file also can't provoke a problem by requesting over a
-      // thousand slots in the style table.
-      if (!mount_style(j++, symbol(font::style_table[i])))
-	warning(WARN_FONT, "cannot mount style '%1' directed by 'DESC'"
-		" file for device '%2'", font::style_table[i], device);
-  for (i = 0; font::font_name_table[i] != 0 /* nullptr */; i++, j++)
-    // In the DESC file, a font name of 0 (zero) means "leave this
-    // position empty".
-    if (strcmp(font::font_name_table[i], "0") != 0)
-      if (!mount_font_at_position(symbol(font::font_name_table[i]), j))
-	warning(WARN_FONT, "cannot mount font '%1' directed by 'DESC'"
-		" file for device '%2'", font::font_name_table[i],
-		device);
+  if (snapshot_image != 0 /* nullptr */)
+    read_font_snapshot(*snapshot_image);
+  else {
+    int j = 1;
+    if (font::style_table != 0 /* nullptr */)
+      for (i = 0; font::style_table[i] != 0 /* nullptr */; i++)
+	// Mounting a style can't actually fail due to a bad style name;
+	// that's not determined until the full font name is resolved.
+	// The DESC file also can't provoke a problem by requesting over
+	// a thousand slots in the style table.
+	if (!mount_style(j++, symbol(font::style_table[i])))
+	  warning(WARN_FONT, "cannot mount style '%1' directed by"
+		  " 'DESC' file for device '%2'", font::style_table[i],
+		  device);
+    for (i = 0; font::font_name_table[i] != 0 /* nullptr */; i++, j++)
+      // In the DESC file, a font name of 0 (zero) means "leave this
+      // position empty".
+      if (strcmp(font::font_name_table[i], "0") != 0)
+	if (!mount_font_at_position(symbol(font::font_name_table[i]),
+				    j))
+	  warning(WARN_FONT, "cannot mount font '%1' directed by 'DESC'"
+		  " file for device '%2'", font::font_name_table[i],
+		  device);
+  }
   curdiv = topdiv = new top_level_diversion;
   if (have_explicit_first_page_number)
     topdiv->set_next_page_number(next_page_number);
@@ -10297,28 +11656,37 @@ int main(int argc, char **argv)
   init_reg_requests();
   init_hyphenation_pattern_requests();
   init_environments();
-  while (string_assignments != 0 /* nullptr */) {
-    do_string_assignment(string_assignments->s);
-    string_list *tem = string_assignments;
-    string_assignments = string_assignments->next;
-    delete tem;
-  }
-  while (register_assignments != 0 /* nullptr */) {
-    do_register_assignment(register_assignments->s);
-    string_list *tem = register_assignments;
-    register_assignments = register_assignments->next;
-    delete tem;
-  }
-  if (!want_startup_macro_files_skipped)
-    process_startup_file(INITIAL_STARTUP_FILE);
-  while (macros != 0 /* nullptr */) {
-    process_macro_package_argument(macros->s);
-    string_list *tem = macros;
-    macros = macros->next;
-    delete tem;
+  note_builtin_registers();
+  if (snapshot_image != 0 /* nullptr */)
+    restore_snapshot();
+  else {
+    while (string_assignments != 0 /* nullptr */) {
+      do_string_assignment(string_assignments->s);
+      string_list *tem = string_assignments;
+      string_assignments = string_assignments->next;
+      delete tem;
+    }
+    while (register_assignments != 0 /* nullptr */) {
+      do_register_assignment(register_assignments->s);
+      string_list *tem = register_assignments;
+      register_assignments = register_assignments->next;
+      delete tem;
+    }
+    if (!want_startup_macro_files_skipped)
+      process_startup_file(INITIAL_STARTUP_FILE);
+    while (macros != 0 /* nullptr */) {
+      process_macro_package_argument(macros->s);
+      string_list *tem = macros;
+      macros = macros->next;
+      delete tem;
+    }
+    if (!want_startup_macro_files_skipped)
+      process_startup_file(FINAL_STARTUP_FILE);
+    if (is_recording_for_snapshot)
+      write_snapshot();
   }
-  if (!want_startup_macro_files_skipped)
-    process_startup_file(FINAL_STARTUP_FILE);
+  if (batch_list_file_name != 0 /* nullptr */)
+    run_batch(batch_list_file_name);
   for (i = optind; i < argc; i++)
     process_input_file(argv[i]);
   if (optind >= argc || want_stdin_read_last)
@@ -10346,19 +11714,29 @@ static void configure_desired_warnings_request() // .warn
 static void init_registers()
 {
   struct tm *t = current_time();
-  set_register("seconds", int(t->tm_sec));
-  set_register("minutes", int(t->tm_min));
-  set_register("hours", int(t->tm_hour));
-  set_register("dw", int(t->tm_wday + 1));
-  set_register("dy", int(t->tm_mday));
-  set_register("mo", int(t->tm_mon + 1));
-  set_register("year", int(1900 + t->tm_year));
-  set_register("yr", int(t->tm_year));
-  set_register("$$", getpid());
+  time_register_values[0] = int(t->tm_sec);
+  time_register_values[1] = int(t->tm_min);
+  time_register_values[2] = int(t->tm_hour);
+  time_register_values[3] = getpid();
+  time_register_values[4] = int(t->tm_wday + 1);
+  time_register_values[5] = int(t->tm_mday);
+  time_register_values[6] = int(t->tm_mon + 1);
+  time_register_values[7] = int(1900 + t->tm_year);
+  time_register_values[8] = int(t->tm_year);
+  for (size_t i = 0; i < countof(time_register_names); i++)
+    set_register(time_register_names[i], time_register_values[i]);
   register_dictionary.define(".A",
       new readonly_text_register(want_abstract_output));
 }
 
+static bool is_time_of_day_register(reg *r)
+{
+  for (int i = 0; i < time_of_day_register_count; i++)
+    if (register_dictionary.lookup(time_register_names[i]) == r)
+      return true;
+  return false;
+}
+
 /*
  *  registers associated with \O
  */
@@ -10538,7 +11916,7 @@ object_dictionary request_dictionary(501);
 
 void init_request(const char *s, REQUEST_FUNCP f)
 {
-  request_dictionary.define(s, new request(f));
+  request_dictionary.define(s, new request(f, symbol(s)));
 }
 
 static request_or_macro *lookup_request(symbol nm)
@@ -10880,6 +12258,7 @@ static void do_error(error_type type,
 {
   const char *filename;
   int lineno;
+  diagnostic_count++;
   if (want_errors_inhibited && (type < FATAL))
     return;
   if (want_backtraces)
@@ -11422,6 +12801,170 @@ static charinfo *get_charinfo_by_index(int n, bool suppress_creation)
   }
 }
 
+// While a snapshot is written or read, this table maps glyph indices
+// to `charinfo` objects, so that other parts of the state can refer to
+// the latter by index.
+
+static std::vector<charinfo *> snapshot_charinfo_table;
+
+charinfo *charinfo_for_glyph_index(int i)
+{
+  if (i < 0 || size_t(i) >= snapshot_charinfo_table.size())
+    return 0 /* nullptr */;
+  return snapshot_charinfo_table[i];
+}
+
+static void add_to_snapshot_charinfo_table(charinfo *ci)
+{
+  size_t i = size_t(charinfo_glyph_index(ci));
+  if (i >= snapshot_charinfo_table.size())
+    snapshot_charinfo_table.resize(i + 1, 0 /* nullptr */);
+  snapshot_charinfo_table[i] = ci;
+}
+
+static void build_snapshot_charinfo_table()
+{
+  snapshot_charinfo_table.clear();
+  dictionary_iterator iter(charinfo_dictionary);
+  charinfo *ci;
+  symbol s;
+  while (iter.get(&s, reinterpret_cast<void **>(&ci)))
+    add_to_snapshot_charinfo_table(ci);
+  dictionary_iterator indexed_iter(indexed_charinfo_dictionary);
+  while (indexed_iter.get(&s, reinterpret_cast<void **>(&ci)))
+    add_to_snapshot_charinfo_table(ci);
+  for (int n = 0; n < 256; n++) {
+    ci = get_charinfo_by_index(n, true /* suppress creation */);
+    if (ci != 0 /* nullptr */)
+      add_to_snapshot_charinfo_table(ci);
+  }
+}
+
+int charinfo_glyph_index(charinfo *ci)
+{
+  return (0 /* nullptr */ == ci) ? -1 : glyph_to_index(ci->as_glyph());
+}
+
+bool charinfo::write_image(snapshot_writer &w)
+{
+  w.put_int(charinfo_glyph_index(translation));
+  w.put_int(special_translation);
+  w.put_int(hyphenation_code);
+  w.put_int(int(flags));
+  w.put_int(ascii_code);
+  w.put_int(asciify_code);
+  w.put_int(is_not_found);
+  w.put_int(is_transparently_translatable);
+  w.put_int(translatable_as_input);
+  w.put_int(mode);
+  w.put_int(mac != 0 /* nullptr */);
+  if (mac != 0 /* nullptr */ && !mac->write_image(w))
+    return false;
+  w.put_int(int(ranges.size()));
+  for (size_t i = 0; i < ranges.size(); i++) {
+    w.put_int(ranges[i].first);
+    w.put_int(ranges[i].second);
+  }
+  return true;
+}
+
+void charinfo::read_image(snapshot_reader &r)
+{
+  int i = r.get_int();
+  translation = charinfo_for_glyph_index(i);
+  if (i >= 0 && 0 /* nullptr */ == translation)
+    r.invalidate();
+  special_translation = (unsigned char) r.get_int();
+  hyphenation_code = (unsigned char) r.get_int();
+  flags = (unsigned int) r.get_int();
+  ascii_code = (unsigned char) r.get_int();
+  asciify_code = (unsigned char) r.get_int();
+  is_not_found = r.get_int();
+  is_transparently_translatable = r.get_int();
+  translatable_as_input = r.get_int();
+  int m = r.get_int();
+  if (m < CHAR_NORMAL || m > CHAR_SPECIAL_FALLBACK)
+    r.invalidate();
+  else
+    mode = char_mode(m);
+  if (r.get_int()) {
+    macro *tem = new macro;
+    tem->read_image(r);
+    delete set_macro(tem);
+  }
+  ranges.clear();
+  int n = r.get_count(2 * sizeof(int));
+  for (int j = 0; j < n; j++) {
+    int first = r.get_int();
+    ranges.push_back(std::pair<int, int>(first, r.get_int()));
+  }
+}
+
+// The charinfo section of a snapshot lists every `charinfo` by name,
+// or by number if it has none, in index order; then come their images.
+
+static bool write_charinfo_snapshot(snapshot_writer &w)
+{
+  build_snapshot_charinfo_table();
+  size_t n = snapshot_charinfo_table.size();
+  w.put_int(int(n));
+  for (size_t i = 0; i < n; i++) {
+    charinfo *ci = snapshot_charinfo_table[i];
+    if (0 /* nullptr */ == ci) {
+      decline_snapshot("a character object is unaccounted for");
+      return false;
+    }
+    w.put_string(ci->is_numbered() ? 0 /* nullptr */
+		 : ci->nm.contents());
+    w.put_int(ci->is_numbered() ? ci->get_number() : -1);
+  }
+  for (size_t i = 0; i < n; i++)
+    if (!snapshot_charinfo_table[i]->write_image(w)) {
+      decline_snapshot("a special character contains nodes");
+      return false;
+    }
+  return true;
+}
+
+static void read_charinfo_snapshot(snapshot_reader &r)
+{
+  build_snapshot_charinfo_table();
+  size_t nexisting = snapshot_charinfo_table.size();
+  int n = r.get_count(2 * sizeof(int));
+  if (size_t(n) < nexisting)
+    r.invalidate();
+  snapshot_charinfo_table.resize(nexisting < size_t(n) ? size_t(n)
+				 : nexisting, 0 /* nullptr */);
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    const char *s = r.get_string();
+    int number = r.get_int();
+    charinfo *ci;
+    if (size_t(i) < nexisting) {
+      ci = snapshot_charinfo_table[i];
+      if (0 /* nullptr */ == ci
+	  || ci->is_numbered() != (0 /* nullptr */ == s)
+	  || (s != 0 /* nullptr */ && strcmp(ci->nm.contents(), s) != 0)
+	  || (0 /* nullptr */ == s && ci->get_number() != number))
+	r.invalidate();
+      continue;
+    }
+    if (s != 0 /* nullptr */)
+      ci = lookup_charinfo(symbol(s));
+    else if (number >= 0)
+      ci = get_charinfo_by_index(number, false /* suppress creation */);
+    else
+      ci = 0 /* nullptr */;
+    if (0 /* nullptr */ == ci || charinfo_glyph_index(ci) != i)
+      r.invalidate();
+    else
+      snapshot_charinfo_table[i] = ci;
+  }
+  for (int i = 0; i < n && r.is_valid(); i++)
+    snapshot_charinfo_table[i]->read_image(r);
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+}
+
 // This overrides the same function from libgroff; while reading font
 // definition files it puts single-letter glyph names into
 // 'charset_table' and converts glyph names of the form '\x' ('x' a
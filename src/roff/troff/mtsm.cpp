@@ -36,7 +36,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "cset.h" // cset, csalpha(), csdigit(), csgraph(), cslower(),
 		  // csprint(), cspunct(), csupper()
 #include "lib.h" // i_to_a()
-#include "stringclass.h" // prerequisite of mtsm.h
+#include "stringclass.h" // prerequisite of mtsm.h, snapshot.h
+#include "snapshot.h"
 
 // troff
 #include "troff.h" // prerequisite of env.h, hvunits.h; units
@@ -59,18 +60,25 @@ int_value::~int_value()
 {
 }
 
-void int_value::diff(FILE *fp, const char *s, int_value compare)
+// Append `s` to `out`, stopping at any null character; the strings
+// here may carry one to terminate them.
+
+static void append_up_to_null(string &out, const string &s)
+{
+  int n = s.search('\0');
+  out.append(s.contents(), (n < 0) ? s.length() : size_t(n));
+}
+
+void int_value::diff(string &out, const char *s, int_value compare)
 {
   if (differs(compare)) {
-    fputs("x X ", fp);
-    fputs(s, fp);
-    fputs(" ", fp);
-    fputs(i_to_a(compare.value), fp);
-    fputs("\n", fp);
+    out += "x X ";
+    out += s;
+    out += ' ';
+    out += i_to_a(compare.value);
+    out += '\n';
     value = compare.value;
     is_known = 1;
-    if (want_html_debugging)
-      fflush(fp);
   }
 }
 
@@ -105,16 +113,14 @@ bool_value::~bool_value()
 {
 }
 
-void bool_value::diff(FILE *fp, const char *s, bool_value compare)
+void bool_value::diff(string &out, const char *s, bool_value compare)
 {
   if (differs(compare)) {
-    fputs("x X ", fp);
-    fputs(s, fp);
-    fputs("\n", fp);
+    out += "x X ";
+    out += s;
+    out += '\n';
     value = compare.value;
     is_known = 1;
-    if (want_html_debugging)
-      fflush(fp);
   }
 }
 
@@ -126,18 +132,16 @@ units_value::~units_value()
 {
 }
 
-void units_value::diff(FILE *fp, const char *s, units_value compare)
+void units_value::diff(string &out, const char *s, units_value compare)
 {
   if (differs(compare)) {
-    fputs("x X ", fp);
-    fputs(s, fp);
-    fputs(" ", fp);
-    fputs(i_to_a(compare.value), fp);
-    fputs("\n", fp);
+    out += "x X ";
+    out += s;
+    out += ' ';
+    out += i_to_a(compare.value);
+    out += '\n';
     value = compare.value;
     is_known = 1;
-    if (want_html_debugging)
-      fflush(fp);
   }
 }
 
@@ -162,14 +166,15 @@ string_value::~string_value()
 {
 }
 
-void string_value::diff(FILE *fp, const char *s, string_value compare)
+void string_value::diff(string &out, const char *s,
+			string_value compare)
 {
   if (differs(compare)) {
-    fputs("x X ", fp);
-    fputs(s, fp);
-    fputs(" ", fp);
-    fputs(compare.value.contents(), fp);
-    fputs("\n", fp);
+    out += "x X ";
+    out += s;
+    out += ' ';
+    append_up_to_null(out, compare.value);
+    out += '\n';
     value = compare.value;
     is_known = 1;
   }
@@ -220,29 +225,29 @@ statem::~statem()
 {
 }
 
-void statem::flush(FILE *fp, statem *compare)
+void statem::flush(string &out, statem *compare)
 {
-  int_values[MTSM_FI].diff(fp, "devtag:.fi",
+  int_values[MTSM_FI].diff(out, "devtag:.fi",
 			   compare->int_values[MTSM_FI]);
-  int_values[MTSM_RJ].diff(fp, "devtag:.rj",
+  int_values[MTSM_RJ].diff(out, "devtag:.rj",
 			   compare->int_values[MTSM_RJ]);
-  int_values[MTSM_SP].diff(fp, "devtag:.sp",
+  int_values[MTSM_SP].diff(out, "devtag:.sp",
 			   compare->int_values[MTSM_SP]);
-  units_values[MTSM_IN].diff(fp, "devtag:.in",
+  units_values[MTSM_IN].diff(out, "devtag:.in",
 			     compare->units_values[MTSM_IN]);
-  units_values[MTSM_LL].diff(fp, "devtag:.ll",
+  units_values[MTSM_LL].diff(out, "devtag:.ll",
 			     compare->units_values[MTSM_LL]);
-  units_values[MTSM_PO].diff(fp, "devtag:.po",
+  units_values[MTSM_PO].diff(out, "devtag:.po",
 			     compare->units_values[MTSM_PO]);
-  string_values[MTSM_TA].diff(fp, "devtag:.ta",
+  string_values[MTSM_TA].diff(out, "devtag:.ta",
 			      compare->string_values[MTSM_TA]);
-  units_values[MTSM_TI].diff(fp, "devtag:.ti",
+  units_values[MTSM_TI].diff(out, "devtag:.ti",
 			     compare->units_values[MTSM_TI]);
-  int_values[MTSM_CE].diff(fp, "devtag:.ce",
+  int_values[MTSM_CE].diff(out, "devtag:.ce",
 			   compare->int_values[MTSM_CE]);
-  bool_values[MTSM_EOL].diff(fp, "devtag:.eol",
+  bool_values[MTSM_EOL].diff(out, "devtag:.eol",
 			     compare->bool_values[MTSM_EOL]);
-  bool_values[MTSM_BR].diff(fp, "devtag:.br",
+  bool_values[MTSM_BR].diff(out, "devtag:.br",
 			    compare->bool_values[MTSM_BR]);
 #if defined(DEBUGGING)
   if (want_html_debugging) {
@@ -444,11 +449,11 @@ void mtsm::inherit(statem *s, int reset_bool)
   }
 }
 
-void mtsm::flush(FILE *fp, statem *s, string tag_list)
+void mtsm::flush(string &out, statem *s, string tag_list)
 {
   if (is_writing_html && (s != 0 /* nullptr */)) {
     inherit(s, 1);
-    driver->flush(fp, s);
+    driver->flush(out, s);
     // Set rj, ce, ti to unknown if they were known and
     // we have seen an eol or br.  This ensures that these values
     // are emitted during the next glyph (as they step from n..0
@@ -472,10 +477,7 @@ void mtsm::flush(FILE *fp, statem *s, string tag_list)
     // reset space value
     driver->int_values[MTSM_SP].set(0);
     // lastly write out any direct tag entries
-    if (tag_list != string("")) {
-      string t = tag_list + '\0';
-      fputs(t.contents(), fp);
-    }
+    append_up_to_null(out, tag_list);
   }
 }
 
@@ -548,13 +550,6 @@ int mtsm::changed(statem *s)
   return result;
 }
 
-void mtsm::add_tag(FILE *fp, string s)
-{
-  fflush(fp);
-  s += '\0';
-  fputs(s.contents(), fp);
-}
-
 /*
  *  state_set class
  */
@@ -638,6 +633,22 @@ units state_set::val(units_value_state)
   return unitsset;
 }
 
+void state_set::write_image(snapshot_writer &w)
+{
+  w.put_int(boolset);
+  w.put_int(intset);
+  w.put_int(unitsset);
+  w.put_int(stringset);
+}
+
+void state_set::read_image(snapshot_reader &r)
+{
+  boolset = r.get_int();
+  intset = r.get_int();
+  unitsset = r.get_int();
+  stringset = r.get_int();
+}
+
 // Local Variables:
 // fill-column: 72
 // mode: C++
@@ -34,7 +34,7 @@ struct int_value {
   int is_known;
   int_value();
   ~int_value();
-  void diff(FILE *, const char *, int_value);
+  void diff(string &, const char *, int_value);
   int differs(int_value);
   void set(int);
   void unset();
@@ -44,13 +44,13 @@ struct int_value {
 struct bool_value : public int_value {
   bool_value();
   ~bool_value();
-  void diff(FILE *, const char *, bool_value);
+  void diff(string &, const char *, bool_value);
 };
 
 struct units_value : public int_value {
   units_value();
   ~units_value();
-  void diff(FILE *, const char *, units_value);
+  void diff(string &, const char *, units_value);
   int differs(units_value);
   void set(hunits);
 };
@@ -60,7 +60,7 @@ struct string_value {
   int is_known;
   string_value();
   ~string_value();
-  void diff(FILE *, const char *, string_value);
+  void diff(string &, const char *, string_value);
   int differs(string_value);
   void set(string);
   void unset();
@@ -101,7 +101,7 @@ struct statem {
   statem();
   statem(statem *);
   ~statem();
-  void flush(FILE *, statem *);
+  void flush(string &, statem *);
   int changed(statem *);
   void merge(statem *, statem &);
   void add_tag(int_value_state, int);
@@ -131,11 +131,13 @@ public:
   ~mtsm();
   void push_state(statem *);
   void pop_state();
-  void flush(FILE *, statem *, string);
+  void flush(string &, statem *, string);
   int changed(statem *);
-  void add_tag(FILE *, string);
 };
 
+class snapshot_writer;
+class snapshot_reader;
+
 class state_set {
   int boolset;
   int intset;
@@ -158,6 +160,8 @@ public:
   int is_in(string_value_state);
   void add(units_value_state, int);
   units val(units_value_state);
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 // Local Variables:
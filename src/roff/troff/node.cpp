@@ -23,12 +23,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #endif
 
 #include <errno.h>
+#include <inttypes.h> // PRIuMAX, uintmax_t
 #include <stdckdint.h> // ckd_add() in suppress_node::tprint() hackery
 #include <stdio.h> // prerequisite of searchpath.h
 #include <stdlib.h> // free(), malloc()
-#include <string.h> // strerror()
+#include <string.h> // memcpy(), memset(), strerror()
 
+#include <map>
 #include <stack>
+#include <vector>
 
 // operating system services
 #include "posix.h"
@@ -61,9 +64,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "device.h"
 #include "font.h" // prerequisite of charinfo.h
 #include "lib.h" // i_to_a(), ui_to_a()
+#include "binary-output.h"
 #include "geometry.h" // adjust_arc_center()
 #include "json-encode.h" // json_encode_char()
-#include "stringclass.h"
+#include "stringclass.h" // prerequisite of snapshot.h
+#include "snapshot.h"
 
 // troff
 #include "troff.h" // prerequisite of env.h, hvunits.h; units
@@ -76,6 +81,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "env.h" // environment, font_size
 #include "request.h" // prerequisite of node.h; macro
 #include "node.h"
+#include "profile.h" // nodes_allocated
 #include "reg.h"
 
 static bool is_output_suppressed = false;
@@ -101,6 +107,143 @@ symbol HYPHEN_SYMBOL("hy");
 // Character used when a hyphen is inserted at a line break.
 static charinfo *soft_hyphen_char;
 
+// Nodes are allocated from pools, one per size class, carved out of
+// large slabs.  Most nodes live only until their output line is
+// written, so recycling them through free lists spares the general
+// allocator much traffic.  Pooled memory is not returned to the system.
+
+static const size_t node_size_granule = 8;
+static const size_t node_pool_max_size = 256;
+static const size_t node_slab_size = 32 * 1024;
+static void *node_free_list[(node_pool_max_size / node_size_granule)
+			    + 1];
+static size_t node_memory_in_use = 0;	// bytes
+static size_t node_memory_peak = 0;	// bytes
+unsigned long nodes_allocated = 0;	// see profile.h
+
+static inline size_t node_size_class(size_t n)
+{
+  return (n + node_size_granule - 1) / node_size_granule;
+}
+
+void *node::operator new(size_t n)
+{
+  size_t sc = node_size_class(n);
+  size_t sz = sc * node_size_granule;
+  nodes_allocated++;
+  node_memory_in_use += sz;
+  if (node_memory_in_use > node_memory_peak)
+    node_memory_peak = node_memory_in_use;
+  if (sz > node_pool_max_size)
+    return ::operator new(sz);
+  void **list = &node_free_list[sc];
+  if (0 /* nullptr */ == *list) {
+    char *slab = static_cast<char *>(::operator new(node_slab_size));
+    // Thread the free list so that nodes are handed out in address
+    // order.
+    for (size_t i = node_slab_size / sz; i > 0; i--) {
+      void *p = slab + ((i - 1) * sz);
+      *static_cast<void **>(p) = *list;
+      *list = p;
+    }
+  }
+  void *p = *list;
+  *list = *static_cast<void **>(p);
+  return p;
+}
+
+void node::operator delete(void *p, size_t n)
+{
+  if (0 /* nullptr */ == p)
+    return;
+  size_t sc = node_size_class(n);
+  size_t sz = sc * node_size_granule;
+  assert(node_memory_in_use >= sz);
+  node_memory_in_use -= sz;
+  if (sz > node_pool_max_size) {
+    ::operator delete(p);
+    return;
+  }
+  *static_cast<void **>(p) = node_free_list[sc];
+  node_free_list[sc] = p;
+}
+
+// Formatter state snapshots attached to nodes, for grohtml's benefit.
+// Only a node created while writing HTML ever has an entry here.
+
+struct node_states {
+  statem *state;
+  statem *push_state;
+};
+
+typedef std::map<node *, node_states> node_state_map;
+static node_state_map node_state_table;
+
+node::~node()
+{
+  if (node_state_table.empty())
+    return;
+  node_state_map::iterator it = node_state_table.find(this);
+  if (it != node_state_table.end()) {
+    delete it->second.state;
+    delete it->second.push_state;
+    node_state_table.erase(it);
+  }
+}
+
+statem *node::get_state()
+{
+  if (node_state_table.empty())
+    return 0 /* nullptr */;
+  node_state_map::iterator it = node_state_table.find(this);
+  return (it != node_state_table.end()) ? it->second.state
+	 : 0 /* nullptr */;
+}
+
+statem *node::get_push_state()
+{
+  if (node_state_table.empty())
+    return 0 /* nullptr */;
+  node_state_map::iterator it = node_state_table.find(this);
+  return (it != node_state_table.end()) ? it->second.push_state
+	 : 0 /* nullptr */;
+}
+
+// Take ownership of `s`, discarding any state the node already had.
+void node::set_state(statem *s)
+{
+  node_state_map::iterator it = node_state_table.find(this);
+  if (it == node_state_table.end()) {
+    if (0 /* nullptr */ == s)
+      return;
+    node_states ns = { s, 0 /* nullptr */ };
+    node_state_table.insert(std::make_pair(this, ns));
+    return;
+  }
+  delete it->second.state;
+  it->second.state = s;
+  if ((0 /* nullptr */ == s)
+      && (0 /* nullptr */ == it->second.push_state))
+    node_state_table.erase(it);
+}
+
+void node::set_push_state(statem *s)
+{
+  node_state_map::iterator it = node_state_table.find(this);
+  if (it == node_state_table.end()) {
+    if (0 /* nullptr */ == s)
+      return;
+    node_states ns = { 0 /* nullptr */, s };
+    node_state_table.insert(std::make_pair(this, ns));
+    return;
+  }
+  delete it->second.push_state;
+  it->second.push_state = s;
+  if ((0 /* nullptr */ == s)
+      && (0 /* nullptr */ == it->second.state))
+    node_state_table.erase(it);
+}
+
 enum constant_space_type {
   CONSTANT_SPACE_NONE,
   CONSTANT_SPACE_RELATIVE,
@@ -130,6 +273,7 @@ public:
   int operator==(const track_kerning_function &);
   int operator!=(const track_kerning_function &);
   hunits compute(int point_size);
+  friend class font_info;
 };
 
 struct font_lookup_info {
@@ -195,6 +339,8 @@ public:
   font *get_font() const;
   friend symbol get_font_name(int, environment *);
   friend symbol get_style_name(int);
+  void write_image(snapshot_writer &);
+  static font_info *read_image(snapshot_reader &, int, font *);
 };
 
 class tfont_spec {
@@ -219,14 +365,28 @@ public:
   friend tfont *font_info::get_tfont(font_size fs, int, int, int);
 };
 
+// The widths of the glyphs of a `tfont` for the ordinary input
+// characters (bytes), computed as each is first formatted; see
+// `add_glyph_run()`.
+
+struct byte_width_table {
+  enum { UNKNOWN, PRESENT, ABSENT };
+  int zoom;			// of the font when widths were computed
+  unsigned char status[256];
+  hunits width[256];
+};
+
 class tfont : public tfont_spec {
   static tfont *tfont_list;
   tfont *next;
   tfont *plain_version;
+  byte_width_table *byte_widths;
 public:
   tfont(tfont_spec &);
   int contains(charinfo *);
   hunits get_width(charinfo *c);
+  void check_byte_widths();
+  bool get_byte_width(unsigned char, hunits *);
   bool is_emboldened(hunits *); // "by how many hunits?" in argument
   bool is_constantly_spaced(hunits *); // "by how many hunits?" in arg
   hunits get_track_kern();
@@ -428,6 +588,90 @@ conditional_bold::conditional_bold(int f, hunits h, conditional_bold *x)
 {
 }
 
+static void write_special_font_list(snapshot_writer &w,
+				    special_font_list *sf)
+{
+  int n = 0;
+  for (special_font_list *p = sf; p != 0 /* nullptr */; p = p->next)
+    n++;
+  w.put_int(n);
+  for (special_font_list *p = sf; p != 0 /* nullptr */; p = p->next)
+    w.put_int(p->n);
+}
+
+static special_font_list *read_special_font_list(snapshot_reader &r)
+{
+  special_font_list *sf = 0 /* nullptr */;
+  special_font_list **pp = &sf;
+  int n = r.get_count(sizeof(int));
+  for (int i = 0; i < n; i++) {
+    *pp = new special_font_list;
+    (*pp)->n = r.get_int();
+    (*pp)->next = 0 /* nullptr */;
+    pp = &(*pp)->next;
+  }
+  return sf;
+}
+
+// The image of a mounted font omits the font description, which the
+// caller saves separately, and the cached `tfont`.
+void font_info::write_image(snapshot_writer &w)
+{
+  w.put_string(internal_name.contents());
+  w.put_string(external_name.contents());
+  w.put_int(has_emboldening);
+  w.put_int(bold_offset.to_units());
+  w.put_int(track_kern.non_zero);
+  w.put_int(track_kern.min_size);
+  w.put_int(track_kern.min_amount.to_units());
+  w.put_int(track_kern.max_size);
+  w.put_int(track_kern.max_amount.to_units());
+  w.put_int(is_constant_spaced);
+  w.put_int(constant_space);
+  int n = 0;
+  conditional_bold *p;
+  for (p = cond_bold_list; p != 0 /* nullptr */; p = p->next)
+    n++;
+  w.put_int(n);
+  for (p = cond_bold_list; p != 0 /* nullptr */; p = p->next) {
+    w.put_int(p->fontno);
+    w.put_int(p->offset.to_units());
+  }
+  write_special_font_list(w, sf);
+}
+
+font_info *font_info::read_image(snapshot_reader &r, int n, font *fm)
+{
+  const char *nm = r.get_string();
+  const char *enm = r.get_string();
+  font_info *fi = new font_info((0 /* nullptr */ == nm) ? NULL_SYMBOL
+				: symbol(nm), n,
+				(0 /* nullptr */ == enm) ? NULL_SYMBOL
+				: symbol(enm), fm);
+  fi->has_emboldening = r.get_int();
+  fi->bold_offset = r.get_int();
+  fi->track_kern.non_zero = r.get_int();
+  fi->track_kern.min_size = r.get_int();
+  fi->track_kern.min_amount = r.get_int();
+  fi->track_kern.max_size = r.get_int();
+  fi->track_kern.max_amount = r.get_int();
+  int cs = r.get_int();
+  if (cs < CONSTANT_SPACE_NONE || cs > CONSTANT_SPACE_ABSOLUTE)
+    r.invalidate();
+  else
+    fi->is_constant_spaced = constant_space_type(cs);
+  fi->constant_space = r.get_int();
+  int nbold = r.get_count(2 * sizeof(int));
+  conditional_bold **pp = &fi->cond_bold_list;
+  for (int i = 0; i < nbold; i++) {
+    int fontno = r.get_int();
+    *pp = new conditional_bold(fontno, r.get_int());
+    pp = &(*pp)->next;
+  }
+  fi->sf = read_special_font_list(r);
+  return fi;
+}
+
 void font_info::conditional_unbold(int fontno)
 {
   for (conditional_bold **p = &cond_bold_list;
@@ -576,6 +820,44 @@ hunits tfont::get_width(charinfo *c)
 	    + track_kern);
 }
 
+// Discard the byte width table if the font's zoom factor has changed
+// since it was filled in.  Call this before `get_byte_width()`.
+
+void tfont::check_byte_widths()
+{
+  int zoom = fm->get_zoom();
+  if (0 /* nullptr */ == byte_widths)
+    byte_widths = new byte_width_table;
+  else if (byte_widths->zoom == zoom)
+    return;
+  byte_widths->zoom = zoom;
+  memset(byte_widths->status, byte_width_table::UNKNOWN,
+	 sizeof byte_widths->status);
+}
+
+// Store in `*widthp` the width of the glyph for the ordinary input
+// character `c`, returning false if the font lacks it.
+
+inline bool tfont::get_byte_width(unsigned char c, hunits *widthp)
+{
+  switch (byte_widths->status[c]) {
+  case byte_width_table::PRESENT:
+    *widthp = byte_widths->width[c];
+    return true;
+  case byte_width_table::ABSENT:
+    return false;
+  }
+  charinfo *ci = charset_table[c];
+  if (!fm->contains(ci->as_glyph())) {
+    byte_widths->status[c] = byte_width_table::ABSENT;
+    return false;
+  }
+  byte_widths->width[c] = get_width(ci);
+  byte_widths->status[c] = byte_width_table::PRESENT;
+  *widthp = byte_widths->width[c];
+  return true;
+}
+
 vunits tfont::get_char_height(charinfo *c)
 {
   vunits v = fm->get_height(c->as_glyph(), size.to_scaled_points());
@@ -751,7 +1033,8 @@ inline bool tfont::is_kerned(charinfo *c1, charinfo *c2, hunits *res)
 
 tfont *tfont::tfont_list = 0 /* nullptr */;
 
-tfont::tfont(tfont_spec &spec) : tfont_spec(spec)
+tfont::tfont(tfont_spec &spec) : tfont_spec(spec),
+  byte_widths(0 /* nullptr */)
 {
   next = tfont_list;
   tfont_list = this;
@@ -859,14 +1142,40 @@ class troff_output_file : public real_output_file {
   bool has_page_begun;
   int cur_div_level;
   string tag_list;
+  // Output is collected here and written with one fwrite() call when
+  // the buffer fills or the output is flushed.
+  enum { OBUF_SIZE = 64 * 1024 };
+  char obuf[OBUF_SIZE];
+  size_t obuf_len;
+  uintmax_t bytes_flushed;	// from `obuf`; see output_offset()
+  // Where each page written begins, for `--page-index`.
+  struct page_start {
+    int number;
+    uintmax_t offset;
+  };
+  std::vector<page_start> page_starts;
+  // Binary output (see binary-output.h) interns glyph names, and
+  // buffers device extension commands to prefix them with a length.
+  std::map<charinfo *, int> glyph_index;
+  bool is_collecting_device_extension;
+  string device_extension;
   void do_motion();
+  void flush_obuf();
   void put(char c);
   void put(unsigned char c);
   void put(int i);
   void put(unsigned int i);
   void put(const char *s);
+  void put(const char *s, size_t len);
+  void put_varint(int i);
+  void put_counted(const char *s, size_t len);
+  void put_command(char cmd, int i);
+  void put_special_char(charinfo *ci);
+  void put_hmotion_char(int n, unsigned char c);
   void select_font(tfont *tf);
   void flush_tbuf();
+  uintmax_t output_offset() { return bytes_flushed + obuf_len; }
+  void write_page_index(uintmax_t);
 public:
   troff_output_file();
   ~troff_output_file();
@@ -901,44 +1210,156 @@ public:
   int get_hpos() { return hpos; }
   int get_vpos() { return vpos; }
   void add_to_tag_list(string s);
+  void put_tag(const string &s);
   void comment(string s);
   friend void space_char_hmotion_node::tprint(troff_output_file *);
   friend void unbreakable_space_node::tprint(troff_output_file *);
 };
 
-static void put_string(const char *s, FILE *fp)
+void troff_output_file::flush_obuf()
 {
-  if (fp != 0 /* nullptr */) {
-    for (; *s != '\0'; ++s)
-      putc(*s, fp);
-  }
+  if (obuf_len > 0 && fp != 0 /* nullptr */)
+    // Errors are caught by ferror() when the stream is closed.
+    (void) fwrite(obuf, 1, obuf_len, fp);
+  bytes_flushed += obuf_len;
+  obuf_len = 0;
 }
 
 inline void troff_output_file::put(char c)
 {
-  if (fp != 0 /* nullptr */)
-    putc(c, fp);
+  if (OBUF_SIZE == obuf_len)
+    flush_obuf();
+  obuf[obuf_len++] = c;
 }
 
 inline void troff_output_file::put(unsigned char c)
 {
-  if (fp != 0 /* nullptr */)
-    putc(c, fp);
+  put(char(c));
+}
+
+void troff_output_file::put(const char *s, size_t len)
+{
+  while (len > 0) {
+    if (OBUF_SIZE == obuf_len)
+      flush_obuf();
+    size_t n = OBUF_SIZE - obuf_len;
+    if (n > len)
+      n = len;
+    memcpy(obuf + obuf_len, s, n);
+    obuf_len += n;
+    s += n;
+    len -= n;
+  }
 }
 
 inline void troff_output_file::put(const char *s)
 {
-  put_string(s, fp);
+  put(s, strlen(s));
+}
+
+inline void troff_output_file::put(unsigned int i)
+{
+  // Format the digits backward into the end of a scratch buffer.
+  char buf[UINT_DIGITS];
+  char *p = buf + sizeof buf;
+  do {
+    *--p = '0' + (i % 10);
+    i /= 10;
+  } while (i != 0);
+  put(p, buf + sizeof buf - p);
 }
 
 inline void troff_output_file::put(int i)
 {
-  put_string(i_to_a(i), fp);
+  if (i < 0) {
+    put('-');
+    // Negate in unsigned arithmetic so that INT_MIN works.
+    put(0U - static_cast<unsigned int>(i));
+  }
+  else
+    put(static_cast<unsigned int>(i));
+}
+
+// Write a zigzag-encoded LEB128 integer: 7 bits per byte, least
+// significant group first, high bit set on all bytes but the last.
+
+void troff_output_file::put_varint(int i)
+{
+  unsigned int u = (static_cast<unsigned int>(i) << 1)
+		   ^ (i < 0 ? ~0U : 0U);
+  while (u >= 0x80) {
+    put(char((u & 0x7f) | 0x80));
+    u >>= 7;
+  }
+  put(char(u));
 }
 
-inline void troff_output_file::put(unsigned int i)
+void troff_output_file::put_counted(const char *s, size_t len)
 {
-  put_string(ui_to_a(i), fp);
+  put_varint(int(len));
+  put(s, len);
+}
+
+// Write a command taking a single integer argument, like 'H' or 'p'.
+
+inline void troff_output_file::put_command(char cmd, int i)
+{
+  if (want_binary_output) {
+    put(char(0x80 | cmd));
+    put_varint(i);
+  }
+  else {
+    put(cmd);
+    put(i);
+    put('\n');
+  }
+}
+
+// Move right by `n` (less than 100) basic units and write `c`.
+
+inline void troff_output_file::put_hmotion_char(int n,
+						unsigned char c)
+{
+  if (want_binary_output) {
+    put(char(BINARY_HMOTION_CHAR));
+    put_varint(n);
+  }
+  else {
+    put(char(n / 10 + '0'));
+    put(char(n % 10 + '0'));
+  }
+  put(c);
+}
+
+void troff_output_file::put_special_char(charinfo *ci)
+{
+  if (ci->is_numbered()) {
+    put_command('N', ci->get_number());
+    return;
+  }
+  const char *s = ci->nm.contents();
+  // A one-character name is escaped with a backslash: '\-' for '-'.
+  char escaped[3] = { '\\', s[0], '\0' };
+  if (0 == s[1])
+    s = escaped;
+  if (want_binary_output) {
+    std::map<charinfo *, int>::iterator it = glyph_index.find(ci);
+    if (it != glyph_index.end()) {
+      put(char(BINARY_C));
+      put_varint(it->second);
+    }
+    else {
+      int n = int(glyph_index.size());
+      glyph_index[ci] = n;
+      put(char(BINARY_GLYPH_DEFINE));
+      put_counted(s, strlen(s));
+    }
+  }
+  else {
+    put('C');
+    put(s);
+    put('\n');
+  }
 }
 
 void troff_output_file::start_device_extension(tfont *tf, color *gcol,
@@ -951,25 +1372,41 @@ void troff_output_file::start_device_extension(tfont *tf, color *gcol,
   fill_color(fcol);
   do_motion();
   if (!omit_command_prefix)
-    put("x X ");
+    start_device_extension();
 }
 
 void troff_output_file::start_device_extension()
 {
   flush_tbuf();
-  put("x X ");
+  if (want_binary_output) {
+    device_extension.clear();
+    is_collecting_device_extension = true;
+  }
+  else
+    put("x X ");
 }
 
 void troff_output_file::write_device_extension_char(unsigned char c)
 {
-  put(c);
-  if (c == '\n')
-    put('+');
+  if (is_collecting_device_extension)
+    device_extension += char(c);
+  else {
+    put(c);
+    if (c == '\n')
+      put('+');
+  }
 }
 
 void troff_output_file::end_device_extension()
 {
-  put('\n');
+  if (is_collecting_device_extension) {
+    put(char(BINARY_X));
+    put_counted(device_extension.contents(),
+		device_extension.length());
+    is_collecting_device_extension = false;
+  }
+  else
+    put('\n');
 }
 
 inline void troff_output_file::moveto(hunits h, vunits v)
@@ -986,8 +1423,8 @@ void troff_output_file::really_print_line(hunits x, vunits y, node *n,
   while (n != 0 /* nullptr */) {
     // Check whether we should push the current troff state and use
     // the state at the start of the invocation of this diversion.
-    if (n->div_nest_level > cur_div_level && n->push_state) {
-      state.push_state(n->push_state);
+    if (n->div_nest_level > cur_div_level && n->get_push_state()) {
+      state.push_state(n->get_push_state());
       cur_div_level = n->div_nest_level;
     }
     // Has the current diversion level decreased?  Then we must pop the
@@ -998,14 +1435,15 @@ void troff_output_file::really_print_line(hunits x, vunits y, node *n,
     }
     // Now check whether the state has changed.
     if ((is_on() || n->causes_tprint())
-	&& (state.changed(n->state) || n->is_tag() || n->is_special)) {
+	&& (state.changed(n->get_state()) || n->is_tag()
+	    || n->is_special)) {
       flush_tbuf();
       do_motion();
       must_update_drawing_position = true;
-      flush();
-      state.flush(fp, n->state, tag_list);
+      string tags;
+      state.flush(tags, n->get_state(), tag_list);
       tag_list = string("");
-      flush();
+      put(tags.contents(), tags.length());
     }
     n->tprint(this);
     n = n->next;
@@ -1016,18 +1454,22 @@ void troff_output_file::really_print_line(hunits x, vunits y, node *n,
   do_motion();
   must_update_drawing_position = true;
   hpos = 0;
-  put('n');
-  put(before.to_units());
-  put(' ');
-  put(after.to_units());
-  put('\n');
+  if (want_binary_output)
+    put(char(BINARY_n));
+  else {
+    put('n');
+    put(before.to_units());
+    put(' ');
+    put(after.to_units());
+    put('\n');
+  }
 }
 
 inline void troff_output_file::word_marker()
 {
   flush_tbuf();
   if (is_on())
-    put('w');
+    put(want_binary_output ? char(BINARY_w) : 'w');
 }
 
 inline void troff_output_file::right(hunits n)
@@ -1043,37 +1485,23 @@ inline void troff_output_file::down(vunits n)
 void troff_output_file::do_motion()
 {
   if (must_update_drawing_position) {
-    put('V');
-    put(vpos);
-    put('\n');
-    put('H');
-    put(hpos);
-    put('\n');
+    put_command('V', vpos);
+    put_command('H', hpos);
   }
   else {
     if (hpos != output_hpos) {
       units n = hpos - output_hpos;
-      if (n > 0 && n < hpos) {
-	put('h');
-	put(n);
-      }
-      else {
-	put('H');
-	put(hpos);
-      }
-      put('\n');
+      if (n > 0 && n < hpos)
+	put_command('h', n);
+      else
+	put_command('H', hpos);
     }
     if (vpos != output_vpos) {
       units n = vpos - output_vpos;
-      if (n > 0 && n < vpos) {
-	put('v');
-	put(n);
-      }
-      else {
-	put('V');
-	put(vpos);
-      }
-      put('\n');
+      if (n > 0 && n < vpos)
+	put_command('v', n);
+      else
+	put_command('V', vpos);
     }
   }
   output_vpos = vpos;
@@ -1090,20 +1518,30 @@ void troff_output_file::flush_tbuf()
 
   if (0 == tbuf_len)
     return;
-  if (0 == tbuf_kern)
-    put('t');
-  else {
-    put('u');
-    put(tbuf_kern);
-    put(' ');
-  }
   check_output_limits(hpos, vpos);
   assert(current_size > 0);
   check_output_limits(hpos, vpos - current_size);
 
-  for (int i = 0; i < tbuf_len; i++)
-    put(tbuf[i]);
-  put('\n');
+  if (want_binary_output) {
+    if (0 == tbuf_kern)
+      put(char(BINARY_t));
+    else {
+      put(char(BINARY_u));
+      put_varint(tbuf_kern);
+    }
+    put_counted(tbuf, tbuf_len);
+  }
+  else {
+    if (0 == tbuf_kern)
+      put('t');
+    else {
+      put('u');
+      put(tbuf_kern);
+      put(' ');
+    }
+    put(tbuf, tbuf_len);
+    put('\n');
+  }
   tbuf_len = 0;
 }
 
@@ -1138,21 +1576,7 @@ void troff_output_file::put_char_width(charinfo *ci, tfont *tf,
     flush_tbuf();
     do_motion();
     check_charinfo(tf, ci);
-    if (ci->is_numbered()) {
-      put('N');
-      put(ci->get_number());
-    }
-    else {
-      put('C');
-      const char *s = ci->nm.contents();
-      if (0 == s[1]) {
-	put('\\');
-	put(s[0]);
-      }
-      else
-	put(s);
-    }
-    put('\n');
+    put_special_char(ci);
     hpos += w.to_units() + kk;
   }
   else if (device_has_tcommand) {
@@ -1186,16 +1610,14 @@ void troff_output_file::put_char_width(charinfo *ci, tfont *tf,
 	&& (!gcol || gcol == current_stroke_color)
 	&& (!fcol || fcol == current_fill_color)
 	&& (n > 0) && (n < 100) && !must_update_drawing_position) {
-      put(char(n / 10 + '0'));
-      put(char(n % 10 + '0'));
-      put(c);
+      put_hmotion_char(n, c);
       output_hpos = hpos;
     }
     else {
       stroke_color(gcol);
       fill_color(fcol);
       do_motion();
-      put('c');
+      put(want_binary_output ? char(BINARY_c) : 'c');
       put(c);
     }
     hpos += w.to_units() + kk;
@@ -1215,21 +1637,7 @@ void troff_output_file::put_char(charinfo *ci, tfont *tf,
     fill_color(fcol);
     flush_tbuf();
     do_motion();
-    if (ci->is_numbered()) {
-      put('N');
-      put(ci->get_number());
-    }
-    else {
-      put('C');
-      const char *s = ci->nm.contents();
-      if (0 == s[1]) {
-	put('\\');
-	put(s[0]);
-      }
-      else
-	put(s);
-    }
-    put('\n');
+    put_special_char(ci);
   }
   else {
     int n = hpos - output_hpos;
@@ -1237,9 +1645,7 @@ void troff_output_file::put_char(charinfo *ci, tfont *tf,
 	&& (!gcol || gcol == current_stroke_color)
 	&& (!fcol || fcol == current_fill_color)
 	&& n > 0 && n < 100) {
-      put(char(n/10 + '0'));
-      put(char(n%10 + '0'));
-      put(c);
+      put_hmotion_char(n, c);
       output_hpos = hpos;
     }
     else {
@@ -1247,7 +1653,7 @@ void troff_output_file::put_char(charinfo *ci, tfont *tf,
       fill_color(fcol);
       flush_tbuf();
       do_motion();
-      put('c');
+      put(want_binary_output ? char(BINARY_c) : 'c');
       put(c);
     }
   }
@@ -1285,9 +1691,7 @@ void troff_output_file::select_font(tfont *tf)
     font_mounting_position[n] = nm;
   }
   if (current_font_number != n) {
-    put('f');
-    put(n);
-    put('\n');
+    put_command('f', n);
     current_font_number = n;
   }
   int zoom = tf->get_zoom();
@@ -1298,9 +1702,7 @@ void troff_output_file::select_font(tfont *tf)
   else
     size = tf->get_size().to_scaled_points();
   if (current_size != size) {
-    put('s');
-    put(size);
-    put('\n');
+    put_command('s', size);
     current_size = size;
   }
   int slant = tf->get_slant();
@@ -1444,6 +1846,13 @@ void troff_output_file::add_to_tag_list(string s)
   }
 }
 
+void troff_output_file::put_tag(const string &s)
+{
+  // The tag may carry a terminating null character.
+  int n = s.search('\0');
+  put(s.contents(), (n < 0) ? s.length() : size_t(n));
+}
+
 void troff_output_file::comment(string s)
 {
   flush_tbuf();
@@ -1552,9 +1961,7 @@ void troff_output_file::draw(char code, hvpair *point, int npoints,
   if (is_on()) {
     int size = fsize.to_scaled_points();
     if (current_size != size) {
-      put('s');
-      put(size);
-      put('\n');
+      put_command('s', size);
       current_size = size;
       current_tfont = 0;
     }
@@ -1616,11 +2023,8 @@ void troff_output_file::really_begin_page(int pageno,
 {
   flush_tbuf();
   if (has_page_begun) {
-    if (page_length > V0) {
-      put('V');
-      put(page_length.to_units());
-      put('\n');
-    }
+    if (page_length > V0)
+      put_command('V', page_length.to_units());
   }
   else
     has_page_begun = true;
@@ -1636,9 +2040,13 @@ void troff_output_file::really_begin_page(int pageno,
   must_update_drawing_position = true;
   for (int i = 0; i < mounting_position_count; i++)
     font_mounting_position[i] = NULL_SYMBOL;
-  put('p');
-  put(pageno);
-  put('\n');
+  if (page_index_file_name != 0 /* nullptr */) {
+    page_start ps;
+    ps.number = pageno;
+    ps.offset = output_offset();
+    page_starts.push_back(ps);
+  }
+  put_command('p', pageno);
 }
 
 void troff_output_file::really_copy_file(hunits x, vunits y,
@@ -1652,9 +2060,10 @@ void troff_output_file::really_copy_file(hunits x, vunits y,
   if (0 /* nullptr */ == ifp)
     error("cannot open '%1': %2", filename, strerror(errno));
   else {
-    int c;
-    while ((c = getc(ifp)) != EOF)
-      put(char(c));
+    char buf[BUFSIZ];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, ifp)) > 0)
+      put(buf, n);
     fclose(ifp);
   }
   must_update_drawing_position = true;
@@ -1672,12 +2081,40 @@ void troff_output_file::really_transparent_char(unsigned char c)
 
 troff_output_file::~troff_output_file()
 {
+  flush_obuf();
   delete[] font_mounting_position;
 }
 
+// Write a line for each page written, giving its number, and the byte
+// offset and length in the output of its `p` command and those that
+// follow it before the next page's or the trailer, which begins at
+// `end`.
+
+void troff_output_file::write_page_index(uintmax_t end)
+{
+  FILE *ifp = fopen(page_index_file_name, "w");
+  if (0 /* nullptr */ == ifp) {
+    error("cannot open page index file '%1': %2", page_index_file_name,
+	  strerror(errno));
+    return;
+  }
+  for (size_t i = 0; i < page_starts.size(); i++) {
+    uintmax_t next = (i + 1 < page_starts.size())
+		     ? page_starts[i + 1].offset : end;
+    fprintf(ifp, "%d %" PRIuMAX " %" PRIuMAX "\n",
+	    page_starts[i].number, page_starts[i].offset,
+	    next - page_starts[i].offset);
+  }
+  if (fclose(ifp) != 0)
+    error("cannot close page index file '%1': %2",
+	  page_index_file_name, strerror(errno));
+}
+
 void troff_output_file::trailer(vunits page_length)
 {
   flush_tbuf();
+  if (page_index_file_name != 0 /* nullptr */)
+    write_page_index(output_offset());
   if (was_any_page_in_output_list) {
     if (page_length > V0) {
       put("x trailer\n");
@@ -1689,6 +2126,9 @@ void troff_output_file::trailer(vunits page_length)
   else
     warning(WARN_RANGE, "no pages match output page selection list");
   put("x stop\n");
+  // We might exit without being destroyed; see
+  // div.cpp:write_any_trailer_and_exit().
+  flush_obuf();
 }
 
 troff_output_file::troff_output_file()
@@ -1696,7 +2136,8 @@ troff_output_file::troff_output_file()
   current_fill_color(0 /* nullptr */),
   current_stroke_color(0 /* nullptr */),
   mounting_position_count(10), tbuf_len(0),
-  has_page_begun(false), cur_div_level(0)
+  has_page_begun(false), cur_div_level(0), obuf_len(0),
+  bytes_flushed(0), is_collecting_device_extension(false)
 {
   font_mounting_position = new symbol[mounting_position_count];
   put("x T ");
@@ -1710,11 +2151,19 @@ troff_output_file::troff_output_file()
   put(vresolution);
   put('\n');
   put("x init\n");
+  if (want_binary_output) {
+    if (fp != 0 /* nullptr */)
+      SET_BINARY(fileno(fp));
+    put("x binary ");
+    put(BINARY_OUTPUT_VERSION);
+    put('\n');
+  }
 }
 
 void troff_output_file::flush()
 {
   flush_tbuf();
+  flush_obuf();
   real_output_file::flush();
 }
 
@@ -2042,6 +2491,8 @@ public:
   const char *type();
   bool causes_tprint();
   bool is_tag();
+  friend int add_glyph_run(node **, const unsigned char *, int,
+			   environment *, hunits *);
 };
 
 // Not derived from `container_node`; implements custom double container
@@ -2055,8 +2506,6 @@ class ligature_node : public glyph_node {
 		node * = 0 /* nullptr */);
 #endif
 public:
-  void *operator new(size_t);
-  void operator delete(void *);
   ligature_node(charinfo *, tfont *, color *, color *,
 		node *, node *, statem *, int,
 		node * = 0 /* nullptr */);
@@ -2127,6 +2576,7 @@ public:
 			      breakpoint * /* rest */ = 0 /* nullptr */,
 			      bool /* is_inner */ = false);
   int nbreaks();
+  bool get_pre_break_width(hunits *);
   int ends_sentence();
   void split(int, node **, node **);
   hyphenation_type get_hyphenation_type();
@@ -2139,16 +2589,6 @@ public:
   void dump_node();
 };
 
-void *ligature_node::operator new(size_t n)
-{
-  return new char[n];
-}
-
-void ligature_node::operator delete(void *p)
-{
-  delete[] (char *)p;
-}
-
 glyph_node::glyph_node(charinfo *c, tfont *t, color *gc, color *fc,
 		       statem *s, int divlevel, node *x)
 : charinfo_node(c, s, divlevel, x), tf(t), gcol(gc), fcol(fc)
@@ -2170,9 +2610,11 @@ glyph_node::glyph_node(charinfo *c, tfont *t,
 node *glyph_node::copy()
 {
 #ifdef STORE_WIDTH
-  return new glyph_node(ci, tf, gcol, fcol, wid, state, div_nest_level);
+  return new glyph_node(ci, tf, gcol, fcol, wid, get_state(),
+			div_nest_level);
 #else
-  return new glyph_node(ci, tf, gcol, fcol, state, div_nest_level);
+  return new glyph_node(ci, tf, gcol, fcol, get_state(),
+			div_nest_level);
 #endif
 }
 
@@ -2258,14 +2700,14 @@ node *glyph_node::merge_glyph_node(glyph_node *gn)
     if ((lig = tf->get_lig(ci, gn->ci)) != 0 /* nullptr */) {
       node *next1 = next;
       next = 0 /* nullptr */;
-      return new ligature_node(lig, tf, gcol, fcol, this, gn, state,
-			       gn->div_nest_level, next1);
+      return new ligature_node(lig, tf, gcol, fcol, this, gn,
+			       get_state(), gn->div_nest_level, next1);
     }
     hunits kern;
     if (tf->is_kerned(ci, gn->ci, &kern)) {
       node *next1 = next;
       next = 0 /* nullptr */;
-      return new kern_pair_node(kern, this, gn, state,
+      return new kern_pair_node(kern, this, gn, get_state(),
 				gn->div_nest_level, next1);
     }
   }
@@ -2356,10 +2798,10 @@ node *ligature_node::copy()
 {
 #ifdef STORE_WIDTH
   return new ligature_node(ci, tf, gcol, fcol, wid, n1->copy(),
-			   n2->copy(), state, div_nest_level);
+			   n2->copy(), get_state(), div_nest_level);
 #else
   return new ligature_node(ci, tf, gcol, fcol, n1->copy(), n2->copy(),
-			   state, div_nest_level);
+			   get_state(), div_nest_level);
 #endif
 }
 
@@ -2514,13 +2956,14 @@ node *kern_pair_node::add_discretionary_hyphen()
       next = 0 /* nullptr */;
       node *n = copy();
       glyph_node *gn = new glyph_node(soft_hyphen_char, tf, gcol, fcol,
-				      state, div_nest_level);
+				      get_state(), div_nest_level);
       node *nn = n->merge_glyph_node(gn);
       if (0 /* nullptr */ == nn) {
 	gn->next = n;
 	nn = gn;
       }
-      return new dbreak_node(this, nn, state, div_nest_level, next1);
+      return new dbreak_node(this, nn, get_state(), div_nest_level,
+			     next1);
     }
   }
   return this;
@@ -2543,7 +2986,7 @@ dbreak_node::~dbreak_node()
 
 node *kern_pair_node::copy()
 {
-  return new kern_pair_node(amount, n1->copy(), n2->copy(), state,
+  return new kern_pair_node(amount, n1->copy(), n2->copy(), get_state(),
 			    div_nest_level);
 }
 
@@ -2596,7 +3039,7 @@ void dump_node_list(node *n)
 node *dbreak_node::copy()
 {
   dbreak_node *p = new dbreak_node(copy_node_list(none),
-				   copy_node_list(pre), state,
+				   copy_node_list(pre), get_state(),
 				   div_nest_level);
   p->post = copy_node_list(post);
   return p;
@@ -2683,13 +3126,14 @@ node *node::add_discretionary_hyphen()
     next = 0 /* nullptr */;
     node *n = copy();
     glyph_node *gn = new glyph_node(soft_hyphen_char, tf, gcol, fcol,
-				    state, div_nest_level);
+				    get_state(), div_nest_level);
     node *n1 = n->merge_glyph_node(gn);
     if (0 /* nullptr */ == n1) {
       gn->next = n;
       n1 = gn;
     }
-    return new dbreak_node(this, n1, state, div_nest_level, next1);
+    return new dbreak_node(this, n1, get_state(), div_nest_level,
+			   next1);
   }
   return this;
 }
@@ -2758,13 +3202,15 @@ void node::dump_properties()
   fprintf(stderr, ", \"diversion level\": %d", div_nest_level);
   fprintf(stderr, ", \"is_special_node\": %s",
 	  is_special ? "true" : "false");
-  if (push_state) {
+  statem *ps = get_push_state();
+  if (ps != 0 /* nullptr */) {
     fputs(", \"push_state\": ", stderr);
-    push_state->display_state();
+    ps->display_state();
   }
-  if (state) {
+  statem *s = get_state();
+  if (s != 0 /* nullptr */) {
     fputs(", \"state\": ", stderr);
-    state->display_state();
+    s->display_state();
   }
   fflush(stderr);
 }
@@ -2936,8 +3382,8 @@ node *node::add_italic_correction(hunits *wd)
     node *next1 = next;
     next = 0 /* nullptr */;
     *wd += ic;
-    return new italic_corrected_node(this, ic, state, div_nest_level,
-				     next1);
+    return new italic_corrected_node(this, ic, get_state(),
+				     div_nest_level, next1);
   }
 }
 
@@ -2958,7 +3404,7 @@ void italic_corrected_node::dump_properties()
 
 node *italic_corrected_node::copy()
 {
-  return new italic_corrected_node(nodes->copy(), x, state,
+  return new italic_corrected_node(nodes->copy(), x, get_state(),
 				   div_nest_level);
 }
 
@@ -3106,7 +3552,7 @@ void break_char_node::dump_properties()
 node *break_char_node::copy()
 {
   return new break_char_node(nodes->copy(), break_code, prev_break_code,
-			     col, state, div_nest_level);
+			     col, get_state(), div_nest_level);
 }
 
 hunits break_char_node::width()
@@ -3222,7 +3668,7 @@ tfont *break_char_node::get_tfont()
 
 node *extra_size_node::copy()
 {
-  return new extra_size_node(n, state, div_nest_level);
+  return new extra_size_node(n, get_state(), div_nest_level);
 }
 
 extra_size_node::extra_size_node(vunits i, statem *s, int divlevel)
@@ -3244,7 +3690,7 @@ void extra_size_node::dump_properties()
 
 node *vertical_size_node::copy()
 {
-  return new vertical_size_node(n, state, div_nest_level);
+  return new vertical_size_node(n, get_state(), div_nest_level);
 }
 
 vertical_size_node::vertical_size_node(vunits i, statem *s,
@@ -3278,13 +3724,14 @@ void hmotion_node::dump_properties()
 
 node *hmotion_node::copy()
 {
-  return new hmotion_node(n, was_tab, unformat, col, state,
+  return new hmotion_node(n, was_tab, unformat, col, get_state(),
 			  div_nest_level);
 }
 
 node *space_char_hmotion_node::copy()
 {
-  return new space_char_hmotion_node(n, col, state, div_nest_level);
+  return new space_char_hmotion_node(n, col, get_state(),
+				     div_nest_level);
 }
 
 vmotion_node::vmotion_node(vunits i, color *c)
@@ -3308,7 +3755,7 @@ void vmotion_node::dump_properties()
 
 node *vmotion_node::copy()
 {
-  return new vmotion_node(n, col, state, div_nest_level);
+  return new vmotion_node(n, col, get_state(), div_nest_level);
 }
 
 node *dummy_node::copy()
@@ -3343,7 +3790,7 @@ node *hline_node::copy()
 {
   return new hline_node(x, (nodes != 0 /* nullptr */) ? nodes->copy()
 						      : 0 /* nullptr */,
-			state, div_nest_level);
+			get_state(), div_nest_level);
 }
 
 hunits hline_node::width()
@@ -3373,7 +3820,7 @@ node *vline_node::copy()
 {
   return new vline_node(x, (nodes != 0 /* nullptr */) ? nodes->copy()
 						      : 0 /* nullptr */,
-			state, div_nest_level);
+			get_state(), div_nest_level);
 }
 
 hunits vline_node::width()
@@ -3393,7 +3840,7 @@ zero_width_node::zero_width_node(node *nd)
 
 node *zero_width_node::copy()
 {
-  return new zero_width_node(copy_node_list(nodes), state,
+  return new zero_width_node(copy_node_list(nodes), get_state(),
 			     div_nest_level);
 }
 
@@ -3452,7 +3899,8 @@ void overstrike_node::dump_properties()
 
 node *overstrike_node::copy()
 {
-  overstrike_node *on = new overstrike_node(state, div_nest_level);
+  overstrike_node *on = new overstrike_node(get_state(),
+					     div_nest_level);
   for (node *tem = nodes; tem != 0 /* nullptr */; tem = tem->next)
     on->overstrike(tem->copy());
   return on;
@@ -3496,7 +3944,7 @@ void bracket_node::dump_properties()
 
 node *bracket_node::copy()
 {
-  bracket_node *on = new bracket_node(state, div_nest_level);
+  bracket_node *on = new bracket_node(get_state(), div_nest_level);
   node *last_node = 0 /* nullptr */;
   node *tem;
   if (nodes != 0 /* nullptr */)
@@ -3570,7 +4018,7 @@ space_node::~space_node()
 
 node *space_node::copy()
 {
-  return new space_node(n, set, was_escape_colon, col, state,
+  return new space_node(n, set, was_escape_colon, col, get_state(),
 			div_nest_level);
 }
 
@@ -3660,7 +4108,7 @@ void diverted_space_node::dump_properties()
 
 node *diverted_space_node::copy()
 {
-  return new diverted_space_node(n, state, div_nest_level);
+  return new diverted_space_node(n, get_state(), div_nest_level);
 }
 
 diverted_copy_file_node::diverted_copy_file_node(symbol s, statem *st,
@@ -3684,7 +4132,8 @@ void diverted_copy_file_node::dump_properties()
 
 node *diverted_copy_file_node::copy()
 {
-  return new diverted_copy_file_node(filename, state, div_nest_level);
+  return new diverted_copy_file_node(filename, get_state(),
+				     div_nest_level);
 }
 
 int node::ends_sentence()
@@ -4261,6 +4710,24 @@ int dbreak_node::nbreaks()
   return i;
 }
 
+// Store the width of the material that a break at index 0 of the node
+// appends to the output line, and report whether that break is a
+// hyphenated one.  The total-fit line breaker uses this instead of
+// get_breakpoints(), which allocates.
+bool node::get_pre_break_width(hunits *widthp)
+{
+  *widthp = H0;
+  return false;
+}
+
+bool dbreak_node::get_pre_break_width(hunits *widthp)
+{
+  *widthp = H0;
+  for (node *tem = pre; tem != 0 /* nullptr */; tem = tem->next)
+    *widthp += tem->width();
+  return true;
+}
+
 void node::split(int /*where*/, node ** /*prep*/, node ** /*postp*/)
 {
   assert(0 == "node::split() unimplemented");
@@ -4459,7 +4926,7 @@ bool device_extension_node::is_tag()
 
 node *device_extension_node::copy()
 {
-  return new device_extension_node(mac, tf, gcol, fcol, state,
+  return new device_extension_node(mac, tf, gcol, fcol, get_state(),
 				   div_nest_level,
 				   lacks_command_prefix);
 }
@@ -4545,7 +5012,7 @@ const char *suppress_node::type()
 node *suppress_node::copy()
 {
   return new suppress_node(emit_limits, is_on, filename, position,
-			   image_id, state, div_nest_level);
+			   image_id, get_state(), div_nest_level);
 }
 
 /* tag_node */
@@ -4578,7 +5045,7 @@ void tag_node::dump_properties()
 
 node *tag_node::copy()
 {
-  return new tag_node(tag_string, state, div_nest_level, delayed);
+  return new tag_node(tag_string, get_state(), div_nest_level, delayed);
 }
 
 void tag_node::tprint(troff_output_file *out)
@@ -4586,7 +5053,7 @@ void tag_node::tprint(troff_output_file *out)
   if (delayed)
     out->add_to_tag_list(tag_string);
   else
-    out->state.add_tag(out->fp, tag_string);
+    out->put_tag(tag_string);
 }
 
 bool tag_node::is_same_as(node *nd)
@@ -4863,7 +5330,7 @@ composite_node::~composite_node()
 
 node *composite_node::copy()
 {
-  return new composite_node(copy_node_list(nodes), ci, tf, state,
+  return new composite_node(copy_node_list(nodes), ci, tf, get_state(),
 			    div_nest_level);
 }
 
@@ -5043,7 +5510,7 @@ node *word_space_node::copy()
     w_new_curr = w_new_curr->next;
     w_old_curr = w_old_curr->next;
   }
-  return new word_space_node(n, set, col, w_new, unformat, state,
+  return new word_space_node(n, set, col, w_new, unformat, get_state(),
 			     div_nest_level);
 }
 
@@ -5087,7 +5554,8 @@ unbreakable_space_node::unbreakable_space_node(hunits d, int s,
 
 node *unbreakable_space_node::copy()
 {
-  return new unbreakable_space_node(n, set, col, state, div_nest_level);
+  return new unbreakable_space_node(n, set, col, get_state(),
+				    div_nest_level);
 }
 
 bool unbreakable_space_node::causes_tprint()
@@ -5213,8 +5681,8 @@ vunits draw_node::vertical_width()
 
 node *draw_node::copy()
 {
-  return new draw_node(code, point, npoints, sz, gcol, fcol, state,
-		       div_nest_level);
+  return new draw_node(code, point, npoints, sz, gcol, fcol,
+		       get_state(), div_nest_level);
 }
 
 void draw_node::tprint(troff_output_file *out)
@@ -5716,6 +6184,58 @@ node *make_node(charinfo *ci, environment *env)
     return make_glyph_node(ci, env);
 }
 
+// Add glyph nodes for the ordinary input characters `s[0]` through
+// `s[n - 1]` to the node list `*np` as `node::add_char()` would one at
+// a time, adding their widths to `*widthp`.  Stop at any character that
+// is not plain or that the current font lacks, and return the number
+// of characters added.  Resolving the font once and taking widths from
+// the tfont's byte width table saves most of the per-character work.
+
+int add_glyph_run(node **np, const unsigned char *s, int n,
+		  environment *env, hunits *widthp)
+{
+  int fontno = resolve_current_font_to_mounting_position(env);
+  if ((fontno < 0) || font_table[fontno]->is_style())
+    return 0;
+  tfont *tf = font_table[fontno]->get_tfont(env->get_font_size(),
+					    env->get_char_height(),
+					    env->get_char_slant(),
+					    fontno);
+  if (env->is_composite())
+    tf = tf->get_plain();
+  tf->check_byte_widths();
+  color *gcol = env->get_stroke_color();
+  color *fcol = env->get_fill_color();
+  node *nd = *np;
+  int i;
+  for (i = 0; i < n; i++) {
+    charinfo *ci = charset_table[s[i]];
+    hunits w;
+    if (!ci->is_plain() || !tf->get_byte_width(s[i], &w))
+      break;
+#ifdef STORE_WIDTH
+    glyph_node *gn = new glyph_node(ci, tf, gcol, fcol, w,
+				    0 /* nullptr */, 0);
+#else
+    glyph_node *gn = new glyph_node(ci, tf, gcol, fcol,
+				    0 /* nullptr */, 0);
+#endif
+    hunits old_width = nd->width();
+    node *p = nd->merge_glyph_node(gn);
+    if (0 /* nullptr */ == p) {
+      *widthp += w;
+      gn->next = nd;
+      nd = gn;
+    }
+    else {
+      *widthp += p->width() - old_width;
+      nd = p;
+    }
+  }
+  *np = nd;
+  return i;
+}
+
 bool character_exists(charinfo *ci, environment *env)
 {
   if (ci->get_special_translation() != charinfo::TRANSLATE_NONE)
@@ -6153,7 +6673,7 @@ node *left_italic_corrected_node::merge_glyph_node(glyph_node *gn)
 node *left_italic_corrected_node::copy()
 {
   left_italic_corrected_node *nd =
-    new left_italic_corrected_node(state, div_nest_level);
+    new left_italic_corrected_node(get_state(), div_nest_level);
   if (nodes != 0 /* nullptr */) {
     nd->nodes = nodes->copy();
     nd->x = x;
@@ -6274,7 +6794,8 @@ hyphen_list *left_italic_corrected_node::get_hyphen_list(
 node *left_italic_corrected_node::add_self(node *nd, hyphen_list **p)
 {
   if (nodes != 0 /* nullptr */) {
-    nd = new left_italic_corrected_node(state, div_nest_level, nd);
+    nd = new left_italic_corrected_node(get_state(), div_nest_level,
+					nd);
     nd = nodes->add_self(nd, p);
     nodes = 0 /* nullptr */;
     delete this;
@@ -6979,6 +7500,26 @@ void font_family::invalidate_selected_font_mounting_position(int n)
   }
 }
 
+void font_family::write_image(snapshot_writer &w)
+{
+  w.put_int(map_size);
+  w.put_bytes(map, map_size * sizeof(int));
+}
+
+void font_family::read_image(snapshot_reader &r)
+{
+  int n = r.get_count(sizeof(int));
+  const void *p = r.get_bytes(n * sizeof(int));
+  if (0 /* nullptr */ == p || n < 1) {
+    r.invalidate();
+    return;
+  }
+  delete[] map;
+  map_size = n;
+  map = new int[map_size];
+  memcpy(map, p, map_size * sizeof(int));
+}
+
 static void assign_style_to_font_mounting_position_request() // .sty
 {
   if (!has_arg()) {
@@ -7657,6 +8198,170 @@ const char *printing_reg::get_string()
     return "0";
 }
 
+// Report node memory in bytes, saturating at the largest register
+// value.
+class node_memory_reg : public reg {
+  size_t *p;
+public:
+  node_memory_reg(size_t *q) : p(q) {}
+  const char *get_string();
+};
+
+const char *node_memory_reg::get_string()
+{
+  return i_to_a((*p > INT_MAX) ? INT_MAX : static_cast<int>(*p));
+}
+
+static glyph *glyph_for_index(int i)
+{
+  charinfo *ci = charinfo_for_glyph_index(i);
+  return (0 /* nullptr */ == ci) ? UNDEFINED_GLYPH : ci->as_glyph();
+}
+
+// The font section of a snapshot lists the loaded font descriptions;
+// then the names under which they, or the failure to load them, are
+// known; then the mounting positions, the font translations, the
+// special fonts, and the families with their resolved positions.
+
+bool write_font_snapshot(snapshot_writer &w)
+{
+  std::map<font *, int> ids;
+  std::vector<font *> fonts;
+  std::vector<std::pair<symbol, int> > entries;
+  dictionary_iterator iter(font_dictionary);
+  symbol s;
+  font *fm;
+  while (iter.get(&s, reinterpret_cast<void **>(&fm))) {
+    int id = -1;
+    if (fm != &nonexistent_font) {
+      std::map<font *, int>::iterator it = ids.find(fm);
+      if (it == ids.end()) {
+	it = ids.insert(std::make_pair(fm, int(fonts.size()))).first;
+	fonts.push_back(fm);
+      }
+      id = it->second;
+    }
+    entries.push_back(std::make_pair(s, id));
+  }
+  for (int i = 0; i < font_table_size; i++)
+    if (font_table[i] != 0 /* nullptr */) {
+      fm = font_table[i]->get_font();
+      if (fm != 0 /* nullptr */ && ids.find(fm) == ids.end()) {
+	decline_snapshot("font at mounting position %1 is not known"
+			 " by name", i);
+	return false;
+      }
+    }
+  w.put_int(int(fonts.size()));
+  for (size_t i = 0; i < fonts.size(); i++)
+    fonts[i]->write_image(w);
+  w.put_int(int(entries.size()));
+  for (size_t i = 0; i < entries.size(); i++) {
+    w.put_string(entries[i].first.contents());
+    w.put_int(entries[i].second);
+  }
+  int nmounted = 0;
+  for (int i = 0; i < font_table_size; i++)
+    if (font_table[i] != 0 /* nullptr */)
+      nmounted++;
+  w.put_int(nmounted);
+  for (int i = 0; i < font_table_size; i++)
+    if (font_table[i] != 0 /* nullptr */) {
+      w.put_int(i);
+      fm = font_table[i]->get_font();
+      w.put_int((0 /* nullptr */ == fm) ? -1 : ids[fm]);
+      font_table[i]->write_image(w);
+    }
+  std::vector<std::pair<symbol, const char *> > translations;
+  dictionary_iterator tr_iter(font_translation_dictionary);
+  char *to;
+  while (tr_iter.get(&s, reinterpret_cast<void **>(&to)))
+    translations.push_back(std::make_pair(s, to));
+  w.put_int(int(translations.size()));
+  for (size_t i = 0; i < translations.size(); i++) {
+    w.put_string(translations[i].first.contents());
+    w.put_string(translations[i].second);
+  }
+  write_special_font_list(w, global_special_fonts);
+  w.put_int(underline_fontno);
+  w.put_int(global_ligature_mode);
+  w.put_int(global_kern_mode);
+  std::vector<font_family *> families;
+  dictionary_iterator fam_iter(family_dictionary);
+  font_family *fam;
+  while (fam_iter.get(&s, reinterpret_cast<void **>(&fam)))
+    families.push_back(fam);
+  w.put_int(int(families.size()));
+  for (size_t i = 0; i < families.size(); i++) {
+    w.put_string(families[i]->nm.contents());
+    families[i]->write_image(w);
+  }
+  return true;
+}
+
+void read_font_snapshot(snapshot_reader &r)
+{
+  std::vector<font *> fonts;
+  int nfonts = r.get_count(sizeof(int));
+  for (int i = 0; i < nfonts && r.is_valid(); i++) {
+    font *fm = font::read_image(r, glyph_for_index);
+    if (0 /* nullptr */ == fm)
+      r.invalidate();
+    else
+      fonts.push_back(fm);
+  }
+  int nentries = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < nentries && r.is_valid(); i++) {
+    const char *s = r.get_string();
+    int id = r.get_int();
+    if (0 /* nullptr */ == s || id < -1 || id >= int(fonts.size()))
+      r.invalidate();
+    else
+      (void) font_dictionary.lookup(symbol(s),
+				    (id < 0) ? &nonexistent_font
+				    : fonts[id]);
+  }
+  int nmounted = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < nmounted && r.is_valid(); i++) {
+    int n = r.get_int();
+    int id = r.get_int();
+    if (n < 0 || n > 10000 || id < -1 || id >= int(fonts.size())) {
+      r.invalidate();
+      break;
+    }
+    if (n >= font_table_size)
+      grow_font_table(n);
+    delete font_table[n];
+    font_table[n] = font_info::read_image(r, n,
+					  (id < 0) ? 0 /* nullptr */
+					  : fonts[id]);
+  }
+  int ntranslations = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < ntranslations && r.is_valid(); i++) {
+    const char *from = r.get_string();
+    const char *to = r.get_string();
+    if (0 /* nullptr */ == from || 0 /* nullptr */ == to)
+      r.invalidate();
+    else
+      (void) font_translation_dictionary.lookup(symbol(from),
+		  const_cast<char *>(symbol(to).contents()));
+  }
+  global_special_fonts = read_special_font_list(r);
+  underline_fontno = r.get_int();
+  global_ligature_mode = r.get_int();
+  global_kern_mode = r.get_int();
+  int nfamilies = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < nfamilies && r.is_valid(); i++) {
+    const char *s = r.get_string();
+    if (0 /* nullptr */ == s)
+      r.invalidate();
+    else
+      lookup_family(symbol(s))->read_image(r);
+  }
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+}
+
 void init_node_requests()
 {
   init_request("bd", embolden_font_request);
@@ -7682,6 +8387,10 @@ void init_node_requests()
       new readonly_boolean_register(&global_kern_mode));
   register_dictionary.define(".lg",
       new readonly_register(&global_ligature_mode));
+  register_dictionary.define(".nodemem",
+      new node_memory_reg(&node_memory_in_use));
+  register_dictionary.define(".nodemempeak",
+      new node_memory_reg(&node_memory_peak));
   register_dictionary.define(".P", new printing_reg);
   soft_hyphen_char = lookup_charinfo(HYPHEN_SYMBOL);
 }
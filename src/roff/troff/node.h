@@ -48,17 +48,25 @@ class glyph_node;
 class diverted_space_node;
 class token_node;
 
+// The formatter state snapshots (see mtsm.h) that grohtml needs are
+// not stored in the node itself, since they are null for every other
+// output device; `get_state()` and `get_push_state()` look them up in a
+// side table that is populated only when writing HTML.
 struct node {
   node *next;
   node *last;
-  statem *state;
-  statem *push_state;
   int div_nest_level;
   bool is_special;
   node();
   node(node *);
   node(node *, statem *, int);
   node(node *, statem *, int, bool);
+  void *operator new(size_t);
+  void operator delete(void *, size_t);
+  statem *get_state();
+  statem *get_push_state();
+  void set_state(statem *);
+  void set_push_state(statem *);
   virtual node *add_char(charinfo *, environment *, hunits *, int *,
 		 node ** /* glyph_comp_np */ = 0 /* nullptr */);
 
@@ -98,6 +106,7 @@ struct node {
 			      breakpoint * /* rest */ = 0 /* nullptr */,
 			      bool /* is_inner */ = false);
   virtual int nbreaks();
+  virtual bool get_pre_break_width(hunits *);
   virtual void split(int, node **, node **);
   virtual hyphenation_type get_hyphenation_type();
   virtual bool need_reread(bool *);
@@ -124,46 +133,30 @@ struct node {
 
 inline node::node()
 : next(0 /* nullptr */), last(0 /* nullptr */),
-  state(0 /* nullptr */), push_state(0 /* nullptr */),
   div_nest_level(0), is_special(false)
 {
 }
 
 inline node::node(node *n)
 : next(n), last(0 /* nullptr */),
-  state(0 /* nullptr */), push_state(0 /* nullptr */),
   div_nest_level(0), is_special(false)
 {
 }
 
 inline node::node(node *n, statem *s, int divlevel)
 : next(n), last(0 /* nullptr */),
-  push_state(0 /* nullptr */),
   div_nest_level(divlevel), is_special(false)
 {
   if (s != 0 /* nullptr */)
-    state = new statem(s);
-  else
-    state = 0 /* nullptr */;
+    set_state(new statem(s));
 }
 
 inline node::node(node *n, statem *s, int divlevel, bool special)
 : next(n), last(0 /* nullptr */),
-  push_state(0 /* nullptr */),
   div_nest_level(divlevel), is_special(special)
 {
   if (s != 0 /* nullptr */)
-    state = new statem(s);
-  else
-    state = 0 /* nullptr */;
-}
-
-inline node::~node()
-{
-  if (state != 0 /* nullptr */)
-    delete state;
-  if (push_state != 0 /* nullptr */)
-    delete push_state;
+    set_state(new statem(s));
 }
 
 // three-valued Boolean :-|
@@ -688,6 +681,8 @@ public:
 
 node *make_node(charinfo *, environment *);
 bool character_exists(charinfo *, environment *);
+int add_glyph_run(node **, const unsigned char *, int, environment *,
+		  hunits *);
 
 int same_node_list(node *, node *);
 node *reverse_node_list(node *);
@@ -751,6 +746,8 @@ public:
   ~font_family();
   int resolve(int);
   static void invalidate_selected_font_mounting_position(int);
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 extern int resolve_current_font_to_mounting_position(environment *);
@@ -0,0 +1,278 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h> // fclose(), fopen(), fprintf(), fputs()
+#include <string.h> // strcmp(), strerror()
+#include <sys/time.h> // gettimeofday()
+
+#include <algorithm> // std::sort()
+#include <map>
+#include <string>
+#include <utility> // std::make_pair(), std::pair
+#include <vector>
+
+#include "errarg.h" // prerequisite of error.h
+#include "error.h"
+#include "symbol.h" // prerequisite of profile.h
+#include "profile.h"
+
+bool is_profiling = false;
+
+namespace {
+
+struct profile_entry {
+  const char *name;
+  bool is_request;
+  unsigned long calls;
+  int depth;			// of open frames for this entry
+  double inclusive_time;	// seconds
+  double exclusive_time;
+  unsigned long inclusive_characters;
+  unsigned long exclusive_characters;
+  unsigned long inclusive_nodes;
+  unsigned long exclusive_nodes;
+};
+
+// A node of the call tree, from which the folded stacks are written.
+// The root, at index 0, stands for input read outside any call.
+struct call_tree_node {
+  profile_entry *entry;
+  std::map<profile_entry *, int> children;
+  double self_time;
+};
+
+struct frame {
+  int id;
+  profile_entry *entry;
+  int tree_index;
+  double start_time;
+  unsigned long start_characters;
+  unsigned long start_nodes;
+};
+
+}
+
+// Symbols are interned, so their contents pointers identify them.
+typedef std::pair<const char *, bool> entry_key;
+static std::map<entry_key, profile_entry> entries;
+static std::vector<call_tree_node> call_tree(1);
+static std::vector<frame> frames;
+static int next_frame_id = 0;
+static double last_event_time = -1;
+static unsigned long last_event_characters = 0;
+static unsigned long last_event_nodes = 0;
+
+static double current_time()
+{
+  struct timeval tv;
+  (void) gettimeofday(&tv, 0 /* nullptr */);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Charge what happened since the last event to the innermost frame and
+// return the time now.
+
+static double charge_innermost_frame()
+{
+  double now = current_time();
+  if (last_event_time < 0)
+    last_event_time = now;
+  double elapsed = now - last_event_time;
+  unsigned long characters
+    = input_characters_read - last_event_characters;
+  unsigned long nodes = nodes_allocated - last_event_nodes;
+  if (frames.empty())
+    call_tree[0].self_time += elapsed;
+  else {
+    const frame &f = frames.back();
+    f.entry->exclusive_time += elapsed;
+    f.entry->exclusive_characters += characters;
+    f.entry->exclusive_nodes += nodes;
+    call_tree[f.tree_index].self_time += elapsed;
+  }
+  last_event_time = now;
+  last_event_characters = input_characters_read;
+  last_event_nodes = nodes_allocated;
+  return now;
+}
+
+int begin_profile_frame(symbol nm, bool is_request)
+{
+  double now = charge_innermost_frame();
+  profile_entry &e = entries[entry_key(nm.contents(), is_request)];
+  if (0 /* nullptr */ == e.name) {
+    e.name = nm.contents();
+    e.is_request = is_request;
+  }
+  e.calls++;
+  e.depth++;
+  int parent = frames.empty() ? 0 : frames.back().tree_index;
+  std::map<profile_entry *, int>::iterator it
+    = call_tree[parent].children.find(&e);
+  int tree_index;
+  if (it != call_tree[parent].children.end())
+    tree_index = it->second;
+  else {
+    tree_index = int(call_tree.size());
+    call_tree_node n;
+    n.entry = &e;
+    n.self_time = 0;
+    call_tree.push_back(n);
+    call_tree[parent].children[&e] = tree_index;
+  }
+  frame f;
+  f.id = next_frame_id++;
+  f.entry = &e;
+  f.tree_index = tree_index;
+  f.start_time = now;
+  f.start_characters = input_characters_read;
+  f.start_nodes = nodes_allocated;
+  frames.push_back(f);
+  return f.id;
+}
+
+void end_profile_frame(int id)
+{
+  double now = charge_innermost_frame();
+  std::vector<frame>::iterator it = frames.end();
+  while (it != frames.begin()) {
+    --it;
+    if (it->id == id)
+      break;
+  }
+  if (frames.empty() || it->id != id)
+    return;
+  profile_entry *e = it->entry;
+  // Count a recursive call's cost only once, in its outermost frame.
+  if (--e->depth == 0) {
+    e->inclusive_time += now - it->start_time;
+    e->inclusive_characters += input_characters_read
+			       - it->start_characters;
+    e->inclusive_nodes += nodes_allocated - it->start_nodes;
+  }
+  frames.erase(it);
+}
+
+static bool is_costlier(const profile_entry *e1,
+			const profile_entry *e2)
+{
+  if (e1->exclusive_time != e2->exclusive_time)
+    return e1->exclusive_time > e2->exclusive_time;
+  return strcmp(e1->name, e2->name) < 0;
+}
+
+void write_profile_report(const char *filename)
+{
+  (void) charge_innermost_frame();
+  FILE *fp = fopen(filename, "w");
+  if (0 /* nullptr */ == fp) {
+    error("cannot open profile report file '%1': %2", filename,
+	  strerror(errno));
+    return;
+  }
+  std::vector<const profile_entry *> sorted;
+  for (std::map<entry_key, profile_entry>::const_iterator it
+	 = entries.begin();
+       it != entries.end();
+       ++it)
+    sorted.push_back(&it->second);
+  std::sort(sorted.begin(), sorted.end(), is_costlier);
+  fprintf(fp, "%10s %12s %12s %12s %12s %10s %10s %-7s %s\n", "calls",
+	  "incl(s)", "excl(s)", "incl(chars)", "excl(chars)",
+	  "incl(nodes)", "excl(nodes)", "type", "name");
+  for (size_t i = 0; i < sorted.size(); i++) {
+    const profile_entry *e = sorted[i];
+    fprintf(fp, "%10lu %12.6f %12.6f %12lu %12lu %10lu %10lu %-7s %s\n",
+	    e->calls, e->inclusive_time, e->exclusive_time,
+	    e->inclusive_characters, e->exclusive_characters,
+	    e->inclusive_nodes, e->exclusive_nodes,
+	    e->is_request ? "request" : "macro", e->name);
+  }
+  if (fclose(fp) != 0)
+    error("cannot close profile report file '%1': %2", filename,
+	  strerror(errno));
+}
+
+// Append a line for each stack in the subtree rooted at `index`, whose
+// calls are named by `path`, to `lines`.
+
+static void collect_stacks(int index, const std::string &path,
+			   std::vector<std::string> &lines)
+{
+  const call_tree_node &n = call_tree[index];
+  std::string name;
+  if (0 /* nullptr */ == n.entry)
+    name = "(top level)";
+  else if (n.entry->is_request) {
+    // Bracket requests to tell them from macros.
+    name = "[";
+    name += n.entry->name;
+    name += "]";
+  }
+  else
+    name = n.entry->name;
+  std::string stack = path.empty() ? name : (path + ";" + name);
+  // Flame graph tools expect integral sample counts; use microseconds.
+  // Give every call stack entered at least one, lest a quick one be
+  // missing from the graph altogether.
+  long microseconds = long(n.self_time * 1e6 + 0.5);
+  if ((microseconds < 1) && (n.entry != 0 /* nullptr */))
+    microseconds = 1;
+  if (microseconds > 0) {
+    char buf[32];
+    snprintf(buf, sizeof buf, " %ld", microseconds);
+    lines.push_back(stack + buf);
+  }
+  for (std::map<profile_entry *, int>::const_iterator it
+	 = n.children.begin();
+       it != n.children.end();
+       ++it)
+    collect_stacks(it->second, (0 /* nullptr */ == n.entry) ? ""
+			       : stack, lines);
+}
+
+void write_profile_stacks(const char *filename)
+{
+  (void) charge_innermost_frame();
+  FILE *fp = fopen(filename, "w");
+  if (0 /* nullptr */ == fp) {
+    error("cannot open profile stack file '%1': %2", filename,
+	  strerror(errno));
+    return;
+  }
+  std::vector<std::string> lines;
+  collect_stacks(0, "", lines);
+  std::sort(lines.begin(), lines.end());
+  for (size_t i = 0; i < lines.size(); i++) {
+    fputs(lines[i].c_str(), fp);
+    putc('\n', fp);
+  }
+  if (fclose(fp) != 0)
+    error("cannot close profile stack file '%1': %2", filename,
+	  strerror(errno));
+}
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
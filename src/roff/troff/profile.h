@@ -0,0 +1,51 @@
+/* Copyright 2026 Free Software Foundation, Inc.
+
+This file is part of groff, the GNU roff typesetting system.
+
+groff is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+groff is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+// A profiler of macro calls and request invocations.
+//
+// Each call opens a frame, which is closed when the request returns or
+// the macro's input iterator is popped.  Time elapsed, input characters
+// read, and nodes allocated between any two frame events are charged
+// to the innermost open frame; a frame's inclusive cost is everything
+// between its opening and closing.  Frames usually close in the
+// reverse of the order they opened, but not always: a request like
+// `return` can pop macros while it runs.
+
+extern bool is_profiling;
+
+// Maintained whether or not profiling is enabled, because testing a
+// flag would cost as much as counting.
+extern unsigned long input_characters_read;	// input.cpp
+extern unsigned long nodes_allocated;		// node.cpp
+
+// Open a frame for a call of `nm` and return an identifier to pass to
+// `end_profile_frame()`.
+extern int begin_profile_frame(symbol /* nm */,
+			       bool /* is_request */);
+extern void end_profile_frame(int);
+
+// Write a table of calls, sorted by exclusive time, to the named file.
+extern void write_profile_report(const char *);
+// Write the time spent in each distinct stack of calls, in the
+// "folded" format read by flame graph tools, to the named file.
+extern void write_profile_stacks(const char *);
+
+// Local Variables:
+// fill-column: 72
+// mode: C++
+// End:
+// vim: set cindent noexpandtab shiftwidth=2 textwidth=72:
@@ -26,6 +26,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include <stdio.h> // prerequisite of searchpath.h
 #include <string.h> // memset()
 
+#include <map>
+#include <vector>
+
 // libgroff
 #include "errarg.h" // prerequisite of troff.h
 #include "error.h" // prerequisite of troff.h
@@ -34,6 +37,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 #include "color.h" // prerequisite of env.h
 #include "cset.h" // csdigit()
 #include "lib.h" // INT_DIGITS
+#include "stringclass.h" // prerequisite of snapshot.h
+#include "snapshot.h"
 
 // troff
 #include "dictionary.h"
@@ -645,6 +650,150 @@ static void print_register_request()
   skip_line();
 }
 
+void general_reg::write_image(snapshot_writer &w)
+{
+  units n;
+  if (!get_value(&n))
+    n = 0;
+  w.put_int(format);
+  w.put_int(width);
+  w.put_int(inc);
+  w.put_int(n);
+}
+
+void general_reg::read_image(snapshot_reader &r)
+{
+  int f = r.get_int();
+  if (f != '1' && f != 'i' && f != 'I' && f != 'a' && f != 'A')
+    r.invalidate();
+  else
+    format = char(f);
+  width = r.get_int();
+  inc = r.get_int();
+  units n = r.get_int();
+  units old;
+  // Some registers reflect other state, and can't be written anyway.
+  if (!get_value(&old) || old != n)
+    set_value(n);
+}
+
+// Registers defined by troff itself, with their original names.  We
+// hold a reference to each, so that none is deleted and its address
+// reused for a register defined by the user.
+static std::map<reg *, symbol> builtin_registers;
+
+void note_builtin_registers()
+{
+  object_dictionary_iterator iter(register_dictionary);
+  symbol s;
+  reg *r;
+  while (iter.get(&s, reinterpret_cast<object **>(&r)))
+    if (builtin_registers.insert(std::make_pair(r, s)).second)
+      r->add_reference();
+}
+
+// The register section of a snapshot lists the distinct register
+// objects, then the names bound to them.  A built-in register is
+// identified by its original name; any other was made by a request
+// and so is a `number_reg`.
+
+bool write_register_snapshot(snapshot_writer &w)
+{
+  std::map<reg *, int> ids;
+  std::vector<reg *> regs;
+  std::vector<std::pair<symbol, int> > entries;
+  object_dictionary_iterator iter(register_dictionary);
+  symbol s;
+  reg *r;
+  while (iter.get(&s, reinterpret_cast<object **>(&r))) {
+    std::map<reg *, int>::iterator it = ids.find(r);
+    if (it == ids.end()) {
+      it = ids.insert(std::make_pair(r, int(regs.size()))).first;
+      regs.push_back(r);
+    }
+    entries.push_back(std::make_pair(s, it->second));
+  }
+  w.put_int(int(regs.size()));
+  for (size_t i = 0; i < regs.size(); i++) {
+    r = regs[i];
+    std::map<reg *, symbol>::iterator b = builtin_registers.find(r);
+    if (b != builtin_registers.end()) {
+      w.put_string(b->second.contents());
+      w.put_int(r->has_format());
+      if (r->has_format())
+	static_cast<general_reg *>(r)->write_image(w);
+    }
+    else {
+      w.put_string(0 /* nullptr */);
+      static_cast<general_reg *>(r)->write_image(w);
+    }
+  }
+  w.put_int(int(entries.size()));
+  for (size_t i = 0; i < entries.size(); i++) {
+    w.put_string(entries[i].first.contents());
+    w.put_int(entries[i].second);
+  }
+  return true;
+}
+
+void read_register_snapshot(snapshot_reader &r)
+{
+  // Symbols are unique, so their contents serve as keys.
+  std::map<const char *, reg *> builtins_by_name;
+  for (std::map<reg *, symbol>::iterator it = builtin_registers.begin();
+       it != builtin_registers.end(); ++it)
+    builtins_by_name[it->second.contents()] = it->first;
+  int n = r.get_count(sizeof(int));
+  std::vector<reg *> regs;
+  for (int i = 0; i < n && r.is_valid(); i++) {
+    const char *name = r.get_string();
+    reg *p;
+    if (name != 0 /* nullptr */) {
+      std::map<const char *, reg *>::iterator it
+	= builtins_by_name.find(symbol(name).contents());
+      if (it == builtins_by_name.end()) {
+	r.invalidate();
+	break;
+      }
+      p = it->second;
+      bool has_format = r.get_int();
+      if (has_format != p->has_format()) {
+	r.invalidate();
+	break;
+      }
+      if (has_format)
+	static_cast<general_reg *>(p)->read_image(r);
+    }
+    else {
+      p = new number_reg;
+      static_cast<general_reg *>(p)->read_image(r);
+    }
+    p->add_reference();
+    regs.push_back(p);
+  }
+  std::vector<symbol> names;
+  object_dictionary_iterator iter(register_dictionary);
+  symbol s;
+  reg *p;
+  while (iter.get(&s, reinterpret_cast<object **>(&p)))
+    names.push_back(s);
+  for (size_t i = 0; i < names.size(); i++)
+    register_dictionary.remove(names[i]);
+  int nentries = r.get_count(2 * sizeof(int));
+  for (int i = 0; i < nentries && r.is_valid(); i++) {
+    const char *name = r.get_string();
+    int id = r.get_int();
+    if (0 /* nullptr */ == name || id < 0 || id >= int(regs.size()))
+      r.invalidate();
+    else
+      register_dictionary.define(symbol(name), regs[id]);
+  }
+  for (size_t i = 0; i < regs.size(); i++)
+    regs[i]->remove_reference();
+  if (!r.is_valid())
+    fatal("snapshot file is corrupt");
+}
+
 void init_reg_requests()
 {
   init_request("rr", remove_register_request);
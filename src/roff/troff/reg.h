@@ -67,6 +67,8 @@ public:
 
   void set_value(units) = 0;
   bool get_value(units *) = 0;
+  void write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
 };
 
 class variable_reg : public general_reg {
@@ -31,8 +31,9 @@ public:
 class request : public request_or_macro {
   REQUEST_FUNCP p;
 public:
+  const symbol nm;		// name given by init_request()
   void invoke(symbol, bool);
-  request(REQUEST_FUNCP);
+  request(REQUEST_FUNCP, symbol);
 };
 
 void delete_request_or_macro(request_or_macro *);
@@ -41,6 +42,9 @@ extern object_dictionary request_dictionary;
 
 class macro_header;
 struct node;
+class color;
+class snapshot_writer;
+class snapshot_reader;
 
 class macro : public request_or_macro {
   const char *filename;		// where was it defined?
@@ -74,6 +78,8 @@ public:
   void clear_string_flag();
   void dump();
   void json_dump();
+  bool write_image(snapshot_writer &);
+  void read_image(snapshot_reader &);
   friend class string_iterator;
   friend bool operator==(const macro &, const macro &);
 };
@@ -87,6 +93,23 @@ extern void init_env_requests();
 extern void init_hyphenation_pattern_requests();
 extern void init_request(const char *, REQUEST_FUNCP);
 
+// Snapshots of the state reached after start-up; see input.cpp.  The
+// writers report whether the state was representable; if not, they
+// have said why with decline_snapshot().
+extern void decline_snapshot(const char *,
+			     const errarg & = empty_errarg);
+extern void write_color_image(snapshot_writer &, color *);
+extern color *read_color_image(snapshot_reader &);
+extern bool write_font_snapshot(snapshot_writer &);
+extern void read_font_snapshot(snapshot_reader &);
+extern bool write_register_snapshot(snapshot_writer &);
+extern void read_register_snapshot(snapshot_reader &);
+extern void note_builtin_registers();
+extern bool write_environment_snapshot(snapshot_writer &);
+extern void read_environment_snapshot(snapshot_reader &);
+extern bool write_diversion_snapshot(snapshot_writer &);
+extern void read_diversion_snapshot(snapshot_reader &);
+
 class charinfo;
 class environment;
 